@@ -0,0 +1,195 @@
+/*
+Copyright (C) 2006  Adam Charrett
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+
+crcbench.c
+
+Checks the CRC_32 engines in libdvbpsi against the bytewise implementation and
+measures how fast each one is.
+
+*/
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "types.h"
+
+#include <dvbpsi/crc32.h>
+
+/*******************************************************************************
+* Defines                                                                      *
+*******************************************************************************/
+/* Largest private section. */
+#define MAX_SECTION_SIZE 4096
+#define CHECK_ROUNDS     20000
+
+/*******************************************************************************
+* Prototypes                                                                   *
+*******************************************************************************/
+static void usage(char *appname);
+static int CheckEngine(dvbpsi_crc32_engine_t engine, uint8_t *buffer);
+static void BenchEngine(dvbpsi_crc32_engine_t engine, uint8_t *buffer, int size, double duration);
+static double Now(void);
+
+/*******************************************************************************
+* Global functions                                                             *
+*******************************************************************************/
+int main(int argc, char *argv[])
+{
+    uint8_t *buffer;
+    int size = MAX_SECTION_SIZE;
+    double duration = 1.0;
+    int failed = 0;
+    int i;
+
+    while (TRUE)
+    {
+        int c = getopt(argc, argv, "s:t:");
+        if (c == -1)
+        {
+            break;
+        }
+        switch (c)
+        {
+            case 's': size = atoi(optarg);
+            break;
+            case 't': duration = atof(optarg);
+            break;
+            default:
+            usage(argv[0]);
+            exit(1);
+        }
+    }
+
+    if ((size < 1) || (size > MAX_SECTION_SIZE) || (duration <= 0.0))
+    {
+        usage(argv[0]);
+        exit(1);
+    }
+
+    /* Room to start at any alignment. */
+    buffer = malloc(MAX_SECTION_SIZE + 64);
+    srand(1);
+    for (i = 0; i < MAX_SECTION_SIZE + 64; i ++)
+    {
+        buffer[i] = rand() & 0xff;
+    }
+
+    printf("Selected engine: %s\n", dvbpsi_Crc32EngineName(dvbpsi_Crc32SelectedEngine()));
+    for (i = 0; i < DVBPSI_CRC32_ENGINES; i ++)
+    {
+        if (!dvbpsi_Crc32EngineSupported(i))
+        {
+            printf("%-12s: not supported\n", dvbpsi_Crc32EngineName(i));
+            continue;
+        }
+        if (CheckEngine(i, buffer))
+        {
+            failed ++;
+            continue;
+        }
+        BenchEngine(i, buffer, size, duration);
+    }
+
+    free(buffer);
+    return failed ? 1 : 0;
+}
+
+/*******************************************************************************
+* Local Functions                                                              *
+*******************************************************************************/
+static void usage(char *appname)
+{
+    fprintf(stderr, "Usage:%s [-s <section size>] [-t <seconds per engine>]\n"
+                    "      -s <size>    : Size of the data to CRC (default %d, max %d).\n"
+                    "      -t <secs>    : Time to run each engine for (default 1).\n",
+                    appname, MAX_SECTION_SIZE, MAX_SECTION_SIZE);
+}
+
+/*
+ * Compare the engine with the bytewise engine over random lengths, alignments
+ * and starting values, and check that a section with its CRC appended gives 0.
+ */
+static int CheckEngine(dvbpsi_crc32_engine_t engine, uint8_t *buffer)
+{
+    uint8_t section[MAX_SECTION_SIZE + 4];
+    uint32_t crc;
+    int i;
+
+    for (i = 0; i < CHECK_ROUNDS; i ++)
+    {
+        int length = (i < MAX_SECTION_SIZE) ? i : (rand() % (MAX_SECTION_SIZE + 1));
+        int offset = rand() % 64;
+        uint32_t start = (i & 1) ? 0xffffffff : (uint32_t)rand();
+        uint32_t expected = dvbpsi_Crc32Engine(DVBPSI_CRC32_BYTEWISE, start, buffer + offset, length);
+        uint32_t result = dvbpsi_Crc32Engine(engine, start, buffer + offset, length);
+
+        if (result != expected)
+        {
+            printf("%-12s: FAILED length %d offset %d start 0x%08x: 0x%08x expected 0x%08x\n",
+                dvbpsi_Crc32EngineName(engine), length, offset, start, result, expected);
+            return -1;
+        }
+    }
+
+    memcpy(section, buffer, MAX_SECTION_SIZE);
+    crc = dvbpsi_Crc32Engine(engine, 0xffffffff, section, MAX_SECTION_SIZE);
+    section[MAX_SECTION_SIZE + 0] = (crc >> 24) & 0xff;
+    section[MAX_SECTION_SIZE + 1] = (crc >> 16) & 0xff;
+    section[MAX_SECTION_SIZE + 2] = (crc >> 8) & 0xff;
+    section[MAX_SECTION_SIZE + 3] = crc & 0xff;
+    if (dvbpsi_Crc32Engine(engine, 0xffffffff, section, sizeof(section)) != 0)
+    {
+        printf("%-12s: FAILED to validate a section with its own CRC\n", dvbpsi_Crc32EngineName(engine));
+        return -1;
+    }
+    return 0;
+}
+
+static void BenchEngine(dvbpsi_crc32_engine_t engine, uint8_t *buffer, int size, double duration)
+{
+    volatile uint32_t sink = 0;
+    unsigned long iterations = 0;
+    double start = Now();
+    double elapsed;
+
+    do
+    {
+        int i;
+        for (i = 0; i < 1000; i ++)
+        {
+            sink ^= dvbpsi_Crc32Engine(engine, 0xffffffff, buffer, size);
+        }
+        iterations += 1000;
+        elapsed = Now() - start;
+    }
+    while (elapsed < duration);
+
+    printf("%-12s: %9.1f MB/s %9.1f ns/section (%d bytes)\n", dvbpsi_Crc32EngineName(engine),
+        ((double)iterations * size) / (elapsed * 1000000.0),
+        (elapsed * 1000000000.0) / iterations, size);
+}
+
+static double Now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + (ts.tv_nsec / 1000000000.0);
+}
@@ -0,0 +1,363 @@
+/*
+Copyright (C) 2006  Adam Charrett
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+
+demuxbench.c
+
+Replays the EIT PID of a transport stream file through a libdvbpsi subtable
+demux, set up the same way as the dvbtoepg plugin, and measures how quickly the
+sections are demultiplexed. Also replays the PID through the section cache the
+TS reader uses to drop repeated sections and reports how many it catches.
+
+*/
+#include "config.h"
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "types.h"
+#include "logging.h"
+#include "objects.h"
+
+#include <dvbpsi/dvbpsi.h>
+#include <dvbpsi/psi.h>
+#include <dvbpsi/descriptor.h>
+#include <dvbpsi/demux.h>
+#include <dvbpsi/sections.h>
+#include <dvbpsi/eit.h>
+
+#include "sectioncache.h"
+
+/*******************************************************************************
+* Defines                                                                      *
+*******************************************************************************/
+#define TSPACKET_SIZE 188
+
+#define LOOKUP_ROUNDS 10
+
+/* Size of the direct mapped cache the section cache replaced. */
+#define OLD_CACHE_SIZE 256
+
+/*******************************************************************************
+* Prototypes                                                                   *
+*******************************************************************************/
+static void usage(char *appname);
+static uint8_t *LoadPackets(const char *filename, uint16_t pid, unsigned long *count);
+static void Replay(dvbpsi_handle demux, uint8_t *packets, unsigned long count);
+static void BenchDemux(dvbpsi_handle decoder, dvbpsi_psi_section_t *section);
+static void SubTableHandler(void *arg, dvbpsi_handle demuxHandle, uint8_t tableId, uint16_t extension);
+static void EITHandler(void *arg, dvbpsi_eit_t *eit);
+static void BenchLookups(dvbpsi_demux_t *demux);
+static void BenchCache(const char *name, unsigned int maxSize, uint8_t *packets, unsigned long count, int passes);
+static void CacheSection(void *arg, dvbpsi_handle handle, dvbpsi_psi_section_t *section);
+static double Now(void);
+
+/*******************************************************************************
+* Global variables                                                             *
+*******************************************************************************/
+char DataDirectory[PATH_MAX];
+
+static unsigned long long sectionCount = 0;
+static unsigned long long tableCount = 0;
+
+/*******************************************************************************
+* Global functions                                                             *
+*******************************************************************************/
+int main(int argc, char *argv[])
+{
+    char *input = NULL;
+    int pid = PID_EIT;
+    int passes = 10;
+    uint8_t *packets;
+    unsigned long count;
+    dvbpsi_handle demux;
+    dvbpsi_demux_t *p_demux;
+    double start, elapsed;
+    int i;
+
+    while (TRUE)
+    {
+        int c = getopt(argc, argv, "i:p:n:");
+        if (c == -1)
+        {
+            break;
+        }
+        switch (c)
+        {
+            case 'i': input = optarg;
+            break;
+            case 'p': pid = strtol(optarg, NULL, 0);
+            break;
+            case 'n': passes = atoi(optarg);
+            break;
+            default:
+            usage(argv[0]);
+            exit(1);
+        }
+    }
+
+    if ((input == NULL) || (pid < 0) || (pid > 0x1fff) || (passes < 1))
+    {
+        usage(argv[0]);
+        exit(1);
+    }
+
+    /* Errors are always written to stderr, so the log itself can be discarded. */
+    LoggingInitFile("/dev/null", 0);
+
+    packets = LoadPackets(input, pid, &count);
+    if (packets == NULL)
+    {
+        exit(1);
+    }
+    if (count == 0)
+    {
+        fprintf(stderr, "No packets on PID 0x%04x in %s\n", pid, input);
+        exit(1);
+    }
+
+    demux = dvbpsi_AttachDemux(SubTableHandler, NULL);
+    demux->pf_callback = BenchDemux;
+    p_demux = (dvbpsi_demux_t *)demux->p_private_decoder;
+
+    /* First pass creates the subtable decoders and decodes every table. */
+    start = Now();
+    Replay(demux, packets, count);
+    elapsed = Now() - start;
+    printf("First pass   : %lu packets, %llu sections, %llu tables, %u subtables, %.3fs\n",
+        count, sectionCount, tableCount, p_demux->i_subdec_count, elapsed);
+
+    /* Later passes are all repeats, as they are on air. */
+    sectionCount = 0;
+    start = Now();
+    for (i = 0; i < passes; i ++)
+    {
+        Replay(demux, packets, count);
+    }
+    elapsed = Now() - start;
+    printf("Repeat passes: %d, %.0f sections/s, %.1f ns/section\n", passes,
+        sectionCount / elapsed, (elapsed * 1000000000.0) / sectionCount);
+
+    BenchLookups(p_demux);
+
+    dvbpsi_DetachDemux(demux);
+
+    BenchCache("Cache", SECTIONCACHE_MAX_SIZE, packets, count, passes);
+    BenchCache("Cache (256)", OLD_CACHE_SIZE, packets, count, passes);
+
+    free(packets);
+    return 0;
+}
+
+/*******************************************************************************
+* Local Functions                                                              *
+*******************************************************************************/
+static void usage(char *appname)
+{
+    fprintf(stderr, "Usage:%s -i <file> [-p <pid>] [-n <passes>]\n"
+                    "      -i <file>    : Transport stream file to replay (for example from tsgen -E).\n"
+                    "      -p <pid>     : PID to demux (default 0x%04x).\n"
+                    "      -n <passes>  : Number of times to replay the sections once decoded (default 10).\n",
+                    appname, PID_EIT);
+}
+
+static uint8_t *LoadPackets(const char *filename, uint16_t pid, unsigned long *count)
+{
+    FILE *fp = fopen(filename, "rb");
+    uint8_t packet[TSPACKET_SIZE];
+    uint8_t *packets = NULL;
+    unsigned long allocated = 0;
+
+    if (fp == NULL)
+    {
+        perror(filename);
+        return NULL;
+    }
+
+    *count = 0;
+    while (fread(packet, TSPACKET_SIZE, 1, fp) == 1)
+    {
+        if ((packet[0] != 0x47) || ((((packet[1] & 0x1f) << 8) | packet[2]) != pid))
+        {
+            continue;
+        }
+        if (*count == allocated)
+        {
+            uint8_t *grown;
+            allocated = allocated ? allocated * 2 : 4096;
+            grown = realloc(packets, allocated * TSPACKET_SIZE);
+            if (grown == NULL)
+            {
+                fprintf(stderr, "Out of memory loading %s\n", filename);
+                free(packets);
+                fclose(fp);
+                return NULL;
+            }
+            packets = grown;
+        }
+        memcpy(packets + (*count * TSPACKET_SIZE), packet, TSPACKET_SIZE);
+        (*count) ++;
+    }
+    fclose(fp);
+    return packets;
+}
+
+static void Replay(dvbpsi_handle demux, uint8_t *packets, unsigned long count)
+{
+    unsigned long i;
+    for (i = 0; i < count; i ++)
+    {
+        dvbpsi_PushPacket(demux, packets + (i * TSPACKET_SIZE));
+    }
+}
+
+static void BenchDemux(dvbpsi_handle decoder, dvbpsi_psi_section_t *section)
+{
+    sectionCount ++;
+    dvbpsi_Demux(decoder, section);
+}
+
+static void SubTableHandler(void *arg, dvbpsi_handle demuxHandle, uint8_t tableId, uint16_t extension)
+{
+    if ((tableId >= 0x4e) && (tableId <= 0x6f))
+    {
+        dvbpsi_AttachEIT(demuxHandle, tableId, extension, EITHandler, NULL);
+    }
+}
+
+static void EITHandler(void *arg, dvbpsi_eit_t *eit)
+{
+    tableCount ++;
+    ObjectRefDec(eit);
+}
+
+/*
+ * Time looking up every subtable through the demux hash against walking the
+ * subtable list, which is how lookups used to be done.
+ */
+static void BenchLookups(dvbpsi_demux_t *demux)
+{
+    dvbpsi_demux_subdec_t *subdec;
+    uint32_t *ids;
+    unsigned int nrofIds = 0;
+    unsigned int i;
+    int round;
+    double start, hashTime, listTime;
+    unsigned long found = 0;
+
+    if (demux->i_subdec_count == 0)
+    {
+        return;
+    }
+    ids = malloc(demux->i_subdec_count * sizeof(uint32_t));
+    for (subdec = demux->p_first_subdec; subdec; subdec = subdec->p_next)
+    {
+        ids[nrofIds ++] = subdec->i_id;
+    }
+
+    start = Now();
+    for (round = 0; round < LOOKUP_ROUNDS; round ++)
+    {
+        for (i = 0; i < nrofIds; i ++)
+        {
+            if (dvbpsi_demuxGetSubDec(demux, ids[i] >> 16, ids[i] & 0xffff))
+            {
+                found ++;
+            }
+        }
+    }
+    hashTime = Now() - start;
+
+    start = Now();
+    for (round = 0; round < LOOKUP_ROUNDS; round ++)
+    {
+        for (i = 0; i < nrofIds; i ++)
+        {
+            for (subdec = demux->p_first_subdec; subdec; subdec = subdec->p_next)
+            {
+                if (subdec->i_id == ids[i])
+                {
+                    found ++;
+                    break;
+                }
+            }
+        }
+    }
+    listTime = Now() - start;
+
+    if (found != 2UL * LOOKUP_ROUNDS * nrofIds)
+    {
+        printf("Lookups FAILED, found %lu of %lu\n", found, 2UL * LOOKUP_ROUNDS * nrofIds);
+    }
+    printf("Lookup       : hash %.1f ns, list walk %.1f ns (%u subtables)\n",
+        (hashTime * 1000000000.0) / (LOOKUP_ROUNDS * nrofIds),
+        (listTime * 1000000000.0) / (LOOKUP_ROUNDS * nrofIds), nrofIds);
+    free(ids);
+}
+
+/*
+ * Replay the PID through a section cache, the first pass fills it and every
+ * section of the later passes is a repeat so should be dropped.
+ */
+static void BenchCache(const char *name, unsigned int maxSize, uint8_t *packets, unsigned long count, int passes)
+{
+    SectionCache_t cache;
+    dvbpsi_handle sections;
+    unsigned long long firstMisses, checked;
+    double start, elapsed;
+    int i;
+
+    SectionCacheInit(&cache, maxSize);
+    sections = dvbpsi_AttachSections(CacheSection, &cache);
+
+    Replay(sections, packets, count);
+    firstMisses = cache.misses;
+    cache.hits = 0;
+    cache.misses = 0;
+
+    start = Now();
+    for (i = 0; i < passes; i ++)
+    {
+        Replay(sections, packets, count);
+    }
+    elapsed = Now() - start;
+    checked = cache.hits + cache.misses;
+
+    printf("%-13s: %llu sections cached in %u entries (%u replaced), repeats %.1f%% hit, %.1f ns/section\n",
+        name, firstMisses, cache.entries ? (1U << cache.bits) : 0, (unsigned int)cache.replaced,
+        checked ? (cache.hits * 100.0) / checked : 0.0,
+        checked ? (elapsed * 1000000000.0) / checked : 0.0);
+
+    dvbpsi_DetachSections(sections);
+    SectionCacheDeinit(&cache);
+}
+
+static void CacheSection(void *arg, dvbpsi_handle handle, dvbpsi_psi_section_t *section)
+{
+    SectionCacheCheck(arg, section);
+    dvbpsi_ReleasePSISections(handle, section);
+}
+
+static double Now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + (ts.tv_nsec / 1000000000.0);
+}
@@ -0,0 +1,586 @@
+/*
+Copyright (C) 2006  Adam Charrett
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+
+dvbstreamerbench.c
+
+Headless throughput benchmark, replays a transport stream file through a file
+adapter as fast as possible and reports how quickly it is processed.
+
+*/
+#include "config.h"
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <getopt.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include "dbase.h"
+#include "epgtypes.h"
+#include "epgchannel.h"
+#include "multiplexes.h"
+#include "services.h"
+#include "dvbadapter.h"
+#include "ts.h"
+#include "main.h"
+#include "dispatchers.h"
+#include "servicefilter.h"
+#include "cache.h"
+#include "logging.h"
+#include "commands.h"
+#include "deliverymethod.h"
+#include "pluginmgr.h"
+#include "tuning.h"
+#include "deferredproc.h"
+#include "events.h"
+#include "objects.h"
+#include "properties.h"
+
+#include "standard/dvb.h"
+
+/*******************************************************************************
+* Defines                                                                      *
+*******************************************************************************/
+#define INIT(_func, _name) \
+    do {\
+        if (_func) \
+        { \
+            fprintf(stderr, "Failed to initialise %s.\n", _name); \
+            exit(1); \
+        } \
+    }while(0)
+
+/* Frequency the stream file is "tuned" to, any value will do. */
+#define BENCH_FREQUENCY 1
+/* Bit rate written to the frequency file, only used when not in fast mode. */
+#define BENCH_DEFAULT_RATE 40000000
+/* Size of paths built from the data directory, room for "/file0/<frequency>". */
+#define BENCH_PATH_MAX (sizeof(DataDirectory) + 32)
+
+#define MAX_SERVICE_FILTERS 256
+
+/*******************************************************************************
+* Typedefs                                                                     *
+*******************************************************************************/
+typedef struct BenchSample_s
+{
+    double wall;        /**< Monotonic time in seconds. */
+    double process;     /**< CPU time used by the whole process. */
+    double reader;      /**< CPU time used by the TSReader's reader thread. */
+    double input;       /**< CPU time used by the input dispatcher (processor 0). */
+    double workers;     /**< CPU time used by all the worker threads. */
+}BenchSample_t;
+
+/*******************************************************************************
+* Prototypes                                                                   *
+*******************************************************************************/
+static void usage(char *appname);
+static int CreateDataDirectory(const char *tsFile, unsigned long rate);
+static void RemoveDirectoryFiles(const char *dirPath);
+static void RemoveDataDirectory(void);
+static int WaitForServices(int wanted, int timeout);
+static int CreateServiceFilters(int count, char *mrl);
+static double ClockSeconds(clockid_t clock);
+static double ThreadSeconds(pthread_t thread);
+static void TakeSample(BenchSample_t *sample);
+static void Report(BenchSample_t *start, BenchSample_t *end, int nrofFilters);
+
+/*******************************************************************************
+* Global variables                                                             *
+*******************************************************************************/
+volatile bool ExitProgram = FALSE;
+bool DaemonMode = FALSE;
+
+const char PrimaryService[] = "<Primary>";
+char DataDirectory[PATH_MAX];
+
+static TSReader_t *TSReader;
+static DVBAdapter_t *DVBAdapter;
+static ServiceFilter_t ServiceFilters[MAX_SERVICE_FILTERS];
+static const char BENCH[] = "Bench";
+static bool KeepDataDirectory = FALSE;
+
+/*******************************************************************************
+* Global functions                                                             *
+*******************************************************************************/
+int main(int argc, char *argv[])
+{
+    char *tsFile = NULL;
+    char *mrl = "null://";
+    char *replayMode = "fast";
+    char *logFilename = "-";
+    char *workers = NULL;
+    unsigned long rate = BENCH_DEFAULT_RATE;
+    int duration = 10;
+    int warmup = 5;
+    int nrofFilters = 1;
+    int logLevel = 0;
+    int created;
+    char tuningParams[32];
+    Multiplex_t *multiplex;
+    BenchSample_t start, end;
+
+    while (TRUE)
+    {
+        int c = getopt(argc, argv, "i:n:o:t:W:w:m:b:L:vk");
+        if (c == -1)
+        {
+            break;
+        }
+        switch (c)
+        {
+            case 'i': tsFile = optarg;
+            break;
+            case 'n': nrofFilters = atoi(optarg);
+            break;
+            case 'o': mrl = optarg;
+            break;
+            case 't': duration = atoi(optarg);
+            break;
+            case 'W': warmup = atoi(optarg);
+            break;
+            case 'w': workers = optarg;
+            break;
+            case 'm': replayMode = optarg;
+            break;
+            case 'b': rate = strtoul(optarg, NULL, 10);
+            break;
+            case 'L': logFilename = optarg;
+            break;
+            case 'v': logLevel ++;
+            break;
+            case 'k': KeepDataDirectory = TRUE;
+            break;
+            default:
+            usage(argv[0]);
+            exit(1);
+        }
+    }
+
+    if ((tsFile == NULL) || (duration <= 0) || (nrofFilters < 0) || (nrofFilters > MAX_SERVICE_FILTERS) || (rate == 0))
+    {
+        usage(argv[0]);
+        exit(1);
+    }
+
+    if (CreateDataDirectory(tsFile, rate))
+    {
+        exit(1);
+    }
+
+    if (LoggingInitFile(logFilename, logLevel))
+    {
+        perror("Could not open log file:");
+        RemoveDataDirectory();
+        exit(1);
+    }
+    LogRegisterThread(pthread_self(), "Main");
+
+    INIT(ObjectInit(), "objects");
+    INIT(EventsInit(), "events");
+    INIT(PropertiesInit(), "properties");
+    INIT(DBaseInit(0), "database");
+    INIT(EPGTypesInit(), "EPG types");
+    INIT(EPGChannelInit(), "EPG channel");
+    INIT(MultiplexInit(), "multiplex");
+    INIT(ServiceInit(), "service");
+    INIT(DispatchersInit(), "dispatchers");
+    INIT(CacheInit(), "cache");
+    INIT(DeliveryMethodManagerInit(), "delivery method manager");
+    INIT(DeferredProcessingInit(), "deferred processing");
+
+    DVBAdapter = DVBInitType(DVBAdapterType_File, 0, FALSE, FALSE);
+    INIT(DVBAdapter == NULL, "file adapter");
+    INIT(PropertiesSetStr("adapter.replay", replayMode), "replay mode");
+
+    INIT(!(TSReader = TSReaderCreate(DVBAdapter)), "TS reader");
+    if (workers)
+    {
+        INIT(PropertiesSetStr("tsreader.threads", workers), "worker threads");
+    }
+    INIT(DVBStandardInit(TSReader), "DVB Filters");
+    INIT(ServiceFilterInit(), "service filter");
+    INIT(CommandInit(), "commands");
+    INIT(TuningInit(), "tuning");
+    /* Plugins provide the network outputs, ie udp:// */
+    INIT(PluginManagerInit(), "plugin manager");
+
+    sprintf(tuningParams, "Frequency: %d", BENCH_FREQUENCY);
+    INIT(MultiplexAdd(DELSYS_DVBT, tuningParams, &multiplex), "multiplex");
+    DispatchersStart(FALSE);
+    TuningCurrentMultiplexSet(multiplex);
+    MultiplexRefDec(multiplex);
+
+    /* Let the PSI processors find the services before starting the clock. */
+    created = CreateServiceFilters(WaitForServices(nrofFilters, warmup), mrl);
+    if (created < nrofFilters)
+    {
+        fprintf(stderr, "Only %d services found, using %d service filters\n", created, created);
+    }
+
+    TSReaderZeroStats(TSReader);
+    TakeSample(&start);
+    sleep(duration);
+    TakeSample(&end);
+
+    Report(&start, &end, created);
+
+    ExitProgram = TRUE;
+    DispatchersStop();
+    TSReaderEnable(TSReader, FALSE);
+    ServiceFilterDestroyAll(TSReader);
+    DeferredProcessingDeinit();
+    DeliveryMethodDestroyAll();
+    PluginManagerDeInit();
+    DeliveryMethodManagerDeInit();
+    TuningDeInit();
+    CommandDeInit();
+    ServiceFilterDeInit();
+    DVBStandardDeinit(TSReader);
+    TSReaderDestroy(TSReader);
+    DVBDispose(DVBAdapter);
+    CacheDeInit();
+    DispatchersDeInit();
+    ServiceDeInit();
+    MultiplexDeInit();
+    EPGChannelDeInit();
+    EPGTypesDeInit();
+    DBaseDeInit();
+    PropertiesDeInit();
+    EventsDeInit();
+    ObjectDeinit();
+    LoggingDeInit();
+
+    RemoveDataDirectory();
+    return 0;
+}
+
+void UpdateDatabase()
+{
+    TSReaderLock(TSReader);
+    CacheWriteback();
+    TSReaderUnLock(TSReader);
+}
+
+TSReader_t *MainTSReaderGet(void)
+{
+    return TSReader;
+}
+
+DVBAdapter_t *MainDVBAdapterGet(void)
+{
+    return DVBAdapter;
+}
+
+int MainAdapterCount(void)
+{
+    return 1;
+}
+
+TSReader_t *MainTSReaderGetByIndex(int index)
+{
+    return (index == 0) ? TSReader : NULL;
+}
+
+DVBAdapter_t *MainDVBAdapterGetByIndex(int index)
+{
+    return (index == 0) ? DVBAdapter : NULL;
+}
+
+ServiceFilter_t MainServiceFilterGetPrimary(void)
+{
+    return ServiceFilters[0];
+}
+
+bool MainIsDVB()
+{
+    return TRUE;
+}
+
+bool MainIsATSC()
+{
+    return FALSE;
+}
+
+bool MainIsISDB()
+{
+    return FALSE;
+}
+
+/*******************************************************************************
+* Local Functions                                                              *
+*******************************************************************************/
+static void usage(char *appname)
+{
+    fprintf(stderr,"Usage:%s <options>\n"
+                   "      Options:\n"
+                   "      -i <file> : Transport stream file to replay (DVB-T).\n"
+                   "      -n <n>    : Number of service filters to create (default 1).\n"
+                   "      -o <mrl>  : Output for the service filters (default null://).\n"
+                   "      -t <secs> : Time to measure for (default 10).\n"
+                   "      -W <secs> : Maximum time to wait for services to be found (default 5).\n"
+                   "      -w <n>    : Number of TSReader worker threads.\n"
+                   "      -m <mode> : Replay mode fast, bitrate or pcr (default fast).\n"
+                   "      -b <bps>  : Bit rate of the file for bitrate mode (default %d).\n"
+                   "      -L <file> : Log file (default - for stderr).\n"
+                   "      -v        : Increase the log level.\n"
+                   "      -k        : Keep the temporary data directory.\n",
+                   appname, BENCH_DEFAULT_RATE);
+}
+
+static int CreateDataDirectory(const char *tsFile, unsigned long rate)
+{
+    char path[BENCH_PATH_MAX];
+    char *absolute;
+    FILE *fp;
+
+    absolute = realpath(tsFile, NULL);
+    if (absolute == NULL)
+    {
+        perror(tsFile);
+        return -1;
+    }
+
+    strcpy(DataDirectory, "/tmp/dvbstreamerbench.XXXXXX");
+    if (mkdtemp(DataDirectory) == NULL)
+    {
+        perror("Failed to create data directory");
+        free(absolute);
+        return -1;
+    }
+
+    sprintf(path, "%s/file0", DataDirectory);
+    mkdir(path, S_IRWXU);
+
+    sprintf(path, "%s/file0/info", DataDirectory);
+    fp = fopen(path, "w");
+    if (fp)
+    {
+        fprintf(fp, "DVB-T\n");
+        fclose(fp);
+    }
+
+    sprintf(path, "%s/file0/%d", DataDirectory, BENCH_FREQUENCY);
+    fp = fopen(path, "w");
+    if (fp)
+    {
+        fprintf(fp, "%s\n%lu\n", absolute, rate);
+        fclose(fp);
+    }
+    free(absolute);
+    return fp ? 0 : -1;
+}
+
+static void RemoveDirectoryFiles(const char *dirPath)
+{
+    char path[PATH_MAX];
+    struct dirent *entry;
+    DIR *dir = opendir(dirPath);
+
+    if (dir == NULL)
+    {
+        return;
+    }
+    while ((entry = readdir(dir)) != NULL)
+    {
+        if (entry->d_name[0] != '.')
+        {
+            int len = snprintf(path, sizeof(path), "%s/%s", dirPath, entry->d_name);
+            if ((len > 0) && (len < (int)sizeof(path)))
+            {
+                unlink(path);
+            }
+        }
+    }
+    closedir(dir);
+}
+
+static void RemoveDataDirectory(void)
+{
+    char path[BENCH_PATH_MAX];
+
+    if (KeepDataDirectory)
+    {
+        fprintf(stderr, "Data directory kept in %s\n", DataDirectory);
+        return;
+    }
+    sprintf(path, "%s/file0", DataDirectory);
+    RemoveDirectoryFiles(path);
+    rmdir(path);
+    RemoveDirectoryFiles(DataDirectory);
+    rmdir(DataDirectory);
+}
+
+static int WaitForServices(int wanted, int timeout)
+{
+    int count = 0;
+    int waited;
+
+    /* Wait for the services to be found and their PMTs to be seen. */
+    for (waited = 0; waited < timeout * 10; waited ++)
+    {
+        Service_t **services;
+        int i;
+
+        services = CacheServicesGet(&count);
+        for (i = 0; i < count; i ++)
+        {
+            if (services[i]->pmtPID == 0)
+            {
+                break;
+            }
+        }
+        CacheServicesRelease();
+
+        if ((i == count) && (count >= wanted) && (count > 0))
+        {
+            break;
+        }
+        usleep(100000);
+    }
+    return (count < wanted) ? count : wanted;
+}
+
+static int CreateServiceFilters(int count, char *mrl)
+{
+    Service_t **services;
+    int nrofServices;
+    int i;
+
+    services = CacheServicesGet(&nrofServices);
+    for (i = 0; (i < count) && (i < nrofServices); i ++)
+    {
+        char name[20];
+        DeliveryMethodInstance_t *dmInstance;
+
+        sprintf(name, "bench%d", i);
+        ServiceFilters[i] = ServiceFilterCreate(TSReader, name);
+        if (ServiceFilters[i] == NULL)
+        {
+            break;
+        }
+        dmInstance = DeliveryMethodCreate(mrl);
+        if (dmInstance == NULL)
+        {
+            fprintf(stderr, "Failed to create output %s\n", mrl);
+            ServiceFilterDestroy(ServiceFilters[i]);
+            ServiceFilters[i] = NULL;
+            break;
+        }
+        ServiceFilterDeliveryMethodSet(ServiceFilters[i], dmInstance);
+        ServiceFilterServiceSet(ServiceFilters[i], services[i]);
+        LogModule(LOG_INFO, BENCH, "Filtering service 0x%04x on %s\n", services[i]->id, name);
+    }
+    CacheServicesRelease();
+    return i;
+}
+
+static double ClockSeconds(clockid_t clock)
+{
+    struct timespec ts;
+    if (clock_gettime(clock, &ts))
+    {
+        return 0.0;
+    }
+    return (double)ts.tv_sec + ((double)ts.tv_nsec / 1000000000.0);
+}
+
+static double ThreadSeconds(pthread_t thread)
+{
+    clockid_t clock;
+    if (pthread_getcpuclockid(thread, &clock))
+    {
+        return 0.0;
+    }
+    return ClockSeconds(clock);
+}
+
+static void TakeSample(BenchSample_t *sample)
+{
+    int i;
+
+    sample->wall = ClockSeconds(CLOCK_MONOTONIC);
+    sample->process = ClockSeconds(CLOCK_PROCESS_CPUTIME_ID);
+    sample->reader = ThreadSeconds(TSReader->readerThread);
+    sample->input = ThreadSeconds(TSReader->processors[0].thread);
+    sample->workers = 0.0;
+    for (i = 1; i <= TSReader->nrofWorkers; i ++)
+    {
+        sample->workers += ThreadSeconds(TSReader->processors[i].thread);
+    }
+}
+
+static void Report(BenchSample_t *start, BenchSample_t *end, int nrofFilters)
+{
+    TSReaderStats_t *stats;
+    TSFilterGroupTypeStats_t *type;
+    TSFilterGroupStats_t *group;
+    struct rusage usage;
+    double wall = end->wall - start->wall;
+    unsigned long long packets = TSReader->totalPackets;
+    unsigned long long sections = 0;
+    double nsPerPacket = packets ? 1000000000.0 / (double)packets : 0.0;
+
+    getrusage(RUSAGE_SELF, &usage);
+    stats = TSReaderExtractStats(TSReader);
+
+    printf("Duration          : %.2f s\n", wall);
+    printf("Service filters   : %d\n", nrofFilters);
+    printf("Worker threads    : %d\n", TSReader->nrofWorkers);
+    printf("Packets           : %llu (%.0f packets/s, %.2f Mbit/s)\n", packets,
+        packets / wall, (packets * TSPACKET_SIZE * 8) / (wall * 1000000.0));
+    printf("Ring drops        : %u\n", TSReader->ringDrops);
+
+    printf("\nFilter group type       Packets       Sections\n");
+    for (type = stats->types; type; type = type->next)
+    {
+        unsigned long long typePackets = 0;
+        unsigned long long typeSections = 0;
+        for (group = type->groups; group; group = group->next)
+        {
+            typePackets += group->packetsProcessed;
+            typeSections += group->sectionsProcessed;
+        }
+        sections += typeSections;
+        printf("  %-20s %10llu %14llu\n", type->type, typePackets, typeSections);
+    }
+    printf("Sections          : %llu (%.0f sections/s)\n", sections, sections / wall);
+
+    printf("\nStage                   CPU (s)      ns/packet\n");
+    printf("  %-20s %10.3f %14.1f\n", "reader thread", end->reader - start->reader,
+        (end->reader - start->reader) * nsPerPacket);
+    printf("  %-20s %10.3f %14.1f\n", "input dispatcher", end->input - start->input,
+        (end->input - start->input) * nsPerPacket);
+    printf("  %-20s %10.3f %14.1f\n", "worker threads", end->workers - start->workers,
+        (end->workers - start->workers) * nsPerPacket);
+    printf("  %-20s %10.3f %14.1f\n", "process total", end->process - start->process,
+        (end->process - start->process) * nsPerPacket);
+
+    printf("Peak RSS          : %ld KB\n", usage.ru_maxrss);
+
+    /* Single line summary for scripts comparing runs. */
+    printf("\nRESULT packets_per_sec=%.0f ns_per_packet=%.1f sections_per_sec=%.0f peak_rss_kb=%ld\n",
+        packets / wall, (end->process - start->process) * nsPerPacket, sections / wall, usage.ru_maxrss);
+
+    ObjectRefDec(stats);
+}
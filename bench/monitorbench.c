@@ -0,0 +1,287 @@
+/*
+Copyright (C) 2006  Adam Charrett
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+
+monitorbench.c
+
+Replays a transport stream file through the TR 101 290 monitor, in batches the
+size of a TS reader ring slot, and checks the time spent per packet is a small
+fraction of the time a packet takes to arrive at a given bitrate.
+
+*/
+#include "config.h"
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "types.h"
+#include "logging.h"
+#include "tsmonitor.h"
+
+/*******************************************************************************
+* Defines                                                                      *
+*******************************************************************************/
+#define TSPACKET_SIZE 188
+
+#define BATCH_SIZE 348
+
+/* Percentage of the time between packets the monitor may use. */
+#define MAX_OVERHEAD_PERCENT 1.0
+
+/*******************************************************************************
+* Prototypes                                                                   *
+*******************************************************************************/
+static void usage(char *appname);
+static uint8_t *LoadPackets(const char *filename, unsigned long *count);
+static void Replay(TSMonitor_t *monitor, uint8_t *packets, unsigned long count, double bitrate);
+static unsigned long long WalkPIDs(uint8_t *packets, unsigned long count);
+static void Report(void *userArg, TSMonitorIndicator_e indicator, uint16_t pid, unsigned int count);
+static double Now(void);
+
+/*******************************************************************************
+* Global variables                                                             *
+*******************************************************************************/
+char DataDirectory[PATH_MAX];
+
+static double streamTime = 0.0;
+
+/*******************************************************************************
+* Global functions                                                             *
+*******************************************************************************/
+int main(int argc, char *argv[])
+{
+    char *input = NULL;
+    double bitrate = 200.0;
+    double maxNs = 0.0;
+    int passes = 10;
+    uint8_t *packets;
+    unsigned long count;
+    TSMonitor_t monitor;
+    double packetNs;
+    double start, monitorTime, walkTime, monitorNs, walkNs;
+    unsigned long long walked = 0;
+    int i;
+
+    while (TRUE)
+    {
+        int c = getopt(argc, argv, "i:r:n:m:");
+        if (c == -1)
+        {
+            break;
+        }
+        switch (c)
+        {
+            case 'i': input = optarg;
+            break;
+            case 'r': bitrate = atof(optarg);
+            break;
+            case 'n': passes = atoi(optarg);
+            break;
+            case 'm': maxNs = atof(optarg);
+            break;
+            default:
+            usage(argv[0]);
+            exit(1);
+        }
+    }
+
+    if ((input == NULL) || (bitrate <= 0.0) || (passes < 1))
+    {
+        usage(argv[0]);
+        exit(1);
+    }
+    packetNs = (TSPACKET_SIZE * 8 * 1000.0) / bitrate;
+    if (maxNs == 0.0)
+    {
+        maxNs = (packetNs * MAX_OVERHEAD_PERCENT) / 100.0;
+    }
+
+    /* Errors are always written to stderr, so the log itself can be discarded. */
+    LoggingInitFile("/dev/null", 0);
+
+    packets = LoadPackets(input, &count);
+    if (packets == NULL)
+    {
+        exit(1);
+    }
+    if (count == 0)
+    {
+        fprintf(stderr, "No packets in %s\n", input);
+        exit(1);
+    }
+
+    if (!TSMonitorInit(&monitor))
+    {
+        fprintf(stderr, "Failed to initialise the monitor\n");
+        exit(1);
+    }
+    monitor.fullTS = TRUE;
+
+    /* First pass reports what the monitor found in the stream. */
+    Replay(&monitor, packets, count, bitrate);
+    TSMonitorSample(&monitor, streamTime, 0, Report, NULL);
+    printf("First pass   : %lu packets, %.3fs of stream at %.1f Mbit/s\n",
+        count, streamTime, bitrate);
+    for (i = 0; i < TSMonitorIndicator_Count; i ++)
+    {
+        printf("    %-24s: %u\n", TSMonitorIndicatorName(i), monitor.errors[i]);
+    }
+
+    /* The stream restarts on each pass, so reset to avoid counting the jump. */
+    start = Now();
+    for (i = 0; i < passes; i ++)
+    {
+        TSMonitorReset(&monitor);
+        streamTime = 0.0;
+        Replay(&monitor, packets, count, bitrate);
+    }
+    monitorTime = Now() - start;
+
+    start = Now();
+    for (i = 0; i < passes; i ++)
+    {
+        walked += WalkPIDs(packets, count);
+    }
+    walkTime = Now() - start;
+
+    monitorNs = (monitorTime * 1000000000.0) / ((double)passes * count);
+    walkNs = (walkTime * 1000000000.0) / ((double)passes * count);
+    printf("Monitor      : %.1f ns/packet (PID walk %.1f ns/packet, %llu)\n",
+        monitorNs, walkNs, walked);
+    printf("Budget       : %.1f ns/packet (%.1f%% of %.0f ns between packets)\n",
+        maxNs, MAX_OVERHEAD_PERCENT, packetNs);
+
+    TSMonitorDeinit(&monitor);
+    free(packets);
+
+    if (monitorNs > maxNs)
+    {
+        printf("Monitor FAILED, over budget\n");
+        return 1;
+    }
+    return 0;
+}
+
+/*******************************************************************************
+* Local Functions                                                              *
+*******************************************************************************/
+static void usage(char *appname)
+{
+    fprintf(stderr, "Usage:%s -i <file> [-r <mbit/s>] [-n <passes>] [-m <ns>]\n"
+                    "      -i <file>    : Transport stream file to replay (for example from tsgen).\n"
+                    "      -r <mbit/s>  : Bitrate the packets are timed as arriving at (default 200).\n"
+                    "      -n <passes>  : Number of timed passes over the file (default 10).\n"
+                    "      -m <ns>      : Maximum time per packet (default %.0f%% of the time between packets).\n",
+                    appname, MAX_OVERHEAD_PERCENT);
+}
+
+static uint8_t *LoadPackets(const char *filename, unsigned long *count)
+{
+    FILE *fp = fopen(filename, "rb");
+    uint8_t packet[TSPACKET_SIZE];
+    uint8_t *packets = NULL;
+    unsigned long allocated = 0;
+
+    if (fp == NULL)
+    {
+        perror(filename);
+        return NULL;
+    }
+
+    *count = 0;
+    while (fread(packet, TSPACKET_SIZE, 1, fp) == 1)
+    {
+        if (packet[0] != 0x47)
+        {
+            continue;
+        }
+        if (*count == allocated)
+        {
+            uint8_t *grown;
+            allocated = allocated ? allocated * 2 : 4096;
+            grown = realloc(packets, allocated * TSPACKET_SIZE);
+            if (grown == NULL)
+            {
+                fprintf(stderr, "Out of memory loading %s\n", filename);
+                free(packets);
+                fclose(fp);
+                return NULL;
+            }
+            packets = grown;
+        }
+        memcpy(packets + (*count * TSPACKET_SIZE), packet, TSPACKET_SIZE);
+        (*count) ++;
+    }
+    fclose(fp);
+    return packets;
+}
+
+/*
+ * Feed the packets to the monitor a batch at a time, each batch timed as
+ * arriving when its last packet would have at the given bitrate.
+ */
+static void Replay(TSMonitor_t *monitor, uint8_t *packets, unsigned long count, double bitrate)
+{
+    double packetTime = (TSPACKET_SIZE * 8) / (bitrate * 1000000.0);
+    unsigned long i;
+
+    for (i = 0; i < count; i += BATCH_SIZE)
+    {
+        int batch = (count - i) < BATCH_SIZE ? (count - i) : BATCH_SIZE;
+        streamTime += batch * packetTime;
+        TSMonitorProcessPackets(monitor, (struct TSPacket_t *)(packets + (i * TSPACKET_SIZE)), batch, streamTime);
+    }
+}
+
+/*
+ * The least any per packet check does, read the PID and continuity count, to
+ * compare the monitor against.
+ */
+static unsigned long long WalkPIDs(uint8_t *packets, unsigned long count)
+{
+    static uint8_t lastCC[8192];
+    unsigned long long changes = 0;
+    unsigned long i;
+
+    for (i = 0; i < count; i ++)
+    {
+        uint8_t *packet = packets + (i * TSPACKET_SIZE);
+        uint16_t pid = ((packet[1] & 0x1f) << 8) | packet[2];
+        uint8_t cc = packet[3] & 0x0f;
+        if (lastCC[pid] != cc)
+        {
+            changes ++;
+        }
+        lastCC[pid] = cc;
+    }
+    return changes;
+}
+
+static void Report(void *userArg, TSMonitorIndicator_e indicator, uint16_t pid, unsigned int count)
+{
+    printf("    %s on PID 0x%04x: %u\n", TSMonitorIndicatorName(indicator), pid, count);
+}
+
+static double Now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + (ts.tv_nsec / 1000000000.0);
+}
@@ -0,0 +1,1055 @@
+/*
+Copyright (C) 2006  Adam Charrett
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+
+tsgen.c
+
+Synthetic MPTS generator, produces a constant bit rate transport stream with
+PAT/PMT/SDT/NIT/EIT/TDT and dummy audio/video for load and regression testing.
+
+*/
+#include "config.h"
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+#include <getopt.h>
+#include <sys/stat.h>
+
+#include "types.h"
+#include "logging.h"
+
+#include <dvbpsi/dvbpsi.h>
+#include <dvbpsi/psi.h>
+#include <dvbpsi/descriptor.h>
+#include <dvbpsi/demux.h>
+#include <dvbpsi/pat.h>
+#include <dvbpsi/pmt.h>
+#include <dvbpsi/sdt.h>
+#include <dvbpsi/nit.h>
+#include <dvbpsi/eit.h>
+#include <dvbpsi/datetime.h>
+#include <dvbpsi/tdttot.h>
+
+/*******************************************************************************
+* Defines                                                                      *
+*******************************************************************************/
+#define TSPACKET_SIZE 188
+#define TSPACKET_PCR_HZ 27000000
+
+#define PID_PAT  0x0000
+#define PID_SDT  0x0011
+#define PID_MAX  0x1fff
+
+#define TABLE_ID_EIT_PF        0x4e
+#define TABLE_ID_EIT_SCHEDULE  0x50
+
+#define SECS_PER_DAY       (24 * 60 * 60)
+#define SECS_PER_SEGMENT   (3 * 60 * 60)
+#define SEGMENTS_PER_TABLE 32
+#define SECTIONS_PER_SEGMENT 8
+#define DAYS_PER_TABLE     4
+#define MAX_EIT_DAYS       64
+
+#define MAX_SERVICES       ((PID_MAX - 0x20) / 3)
+/* Services in each NIT service_list_descriptor and descriptors per transport
+ * loop entry, so that an entry always fits in a section. */
+#define SERVICES_PER_LIST   (255 / 3)
+#define LISTS_PER_TRANSPORT 3
+
+/* PCRs go out on the first video packet after they are due, so leave room
+ * under the 40ms TR 101 290 limit. */
+#define PCR_INTERVAL       0.03
+#define VIDEO_FRAME_TIME   0.04
+#define AUDIO_FRAME_TIME   0.024
+/* How far ahead of the PCR the PTS values are. */
+#define PTS_DELAY          0.1
+
+#define OUTPUT_BUFFER_SIZE (1024 * 1024)
+
+/*******************************************************************************
+* Typedefs                                                                     *
+*******************************************************************************/
+typedef enum Job_e
+{
+    Job_PAT = 0,
+    Job_PMT,
+    Job_SDT,
+    Job_NIT,
+    Job_EITPF,
+    Job_EITSchedule,
+    Job_TDT,
+    Job_Count,
+    /* Elementary streams are scheduled the same way as the tables. */
+    Job_Video = Job_Count,
+    Job_Audio
+}Job_e;
+
+typedef struct Schedulable_s
+{
+    double due;         /**< Stream time this job is next due at. */
+    double interval;    /**< Time between runs of this job. */
+    Job_e job;          /**< What to do when due. */
+    int service;        /**< Index of the service this job is for. */
+    uint16_t pid;       /**< PID the job outputs on. */
+    double nextPCR;     /**< Elementary streams only, when to insert the next PCR. */
+    double nextFrame;   /**< Elementary streams only, when to start the next PES. */
+}Schedulable_t;
+
+typedef struct Heap_s
+{
+    Schedulable_t **entries;
+    int count;
+}Heap_t;
+
+/*******************************************************************************
+* Prototypes                                                                   *
+*******************************************************************************/
+static void usage(char *appname);
+static int ParseRepetitionRates(char *rates);
+static int WriteDataDirectory(const char *dataDir, int adapter, const char *output, unsigned long muxRate);
+static void HeapPush(Heap_t *heap, Schedulable_t *entry);
+static Schedulable_t *HeapPop(Heap_t *heap);
+static void RunJob(Schedulable_t *job, double now);
+static void QueueSections(uint16_t pid, dvbpsi_psi_section_t *sections);
+static void FinaliseSections(dvbpsi_psi_section_t *sections);
+static dvbpsi_psi_section_t *GenerateEITSections(int service, uint8_t tableId,
+    uint8_t lastTableId, int firstEvent, int nrofEvents, int runningEvent,
+    uint8_t version, int firstNumber, int maxSections);
+static void GeneratePAT(void);
+static void GeneratePMT(int service);
+static void GenerateSDT(void);
+static void GenerateNIT(void);
+static void GenerateEITPF(int service, double now);
+static void GenerateEITSchedule(int service, double now);
+static void GenerateTDT(double now);
+static void WriteESPacket(Schedulable_t *stream, double now);
+static void WriteNullPacket(void);
+static void WritePacket(uint8_t *packet);
+
+/*******************************************************************************
+* Global variables                                                             *
+*******************************************************************************/
+/* Used by logging.c */
+char DataDirectory[PATH_MAX];
+
+static const char *jobNames[Job_Count] = {
+    "pat", "pmt", "sdt", "nit", "eitpf", "eitsched", "tdt"
+};
+
+/* Default repetition intervals in seconds. */
+static double repetitionRates[Job_Count] = {
+    0.1, /* PAT */
+    0.1, /* PMT */
+    2.0, /* SDT */
+    10.0,/* NIT */
+    2.0, /* EIT present/following */
+    10.0,/* EIT schedule */
+    5.0  /* TDT */
+};
+
+static int nrofServices = 10;
+static uint16_t tsId = 1;
+static uint16_t networkId = 0x233a;
+static uint16_t pmtPidBase = 0x100;
+static uint16_t esPidBase = 0x1000;
+static unsigned long frequency = 0;
+static int eitDays = 0;
+static int eventsPerDay = 24;
+static int eventDuration;
+static time_t startTime;
+static time_t startMidnight;
+static uint8_t version = 0;
+static unsigned long ccErrorInterval = 0;
+
+static FILE *outputFP;
+static uint8_t continuityCounters[PID_MAX + 1];
+static uint8_t (*psiQueue)[TSPACKET_SIZE];
+static int psiQueueHead = 0;
+static int psiQueueCount = 0;
+static int psiQueueSize = 0;
+
+static unsigned long long packetsWritten = 0;
+static unsigned long long psiPackets = 0;
+static unsigned long long nullPackets = 0;
+static unsigned long long esPackets = 0;
+static unsigned long long ccErrorsInjected = 0;
+static bool eitTruncated = FALSE;
+
+/*******************************************************************************
+* Global functions                                                             *
+*******************************************************************************/
+int main(int argc, char *argv[])
+{
+    char *output = NULL;
+    char *dataDir = NULL;
+    int adapter = 0;
+    unsigned long muxRate = 40000000;
+    unsigned long videoRate = 2000000;
+    unsigned long audioRate = 192000;
+    double duration = 60.0;
+    double versionInterval = 0.0;
+    double nextVersionBump;
+    double slotTime, now;
+    unsigned long long slot;
+    Schedulable_t *jobs;
+    Schedulable_t *streams;
+    Heap_t jobHeap = {NULL, 0};
+    Heap_t streamHeap = {NULL, 0};
+    int nrofJobs = 0;
+    int i;
+
+    startTime = time(NULL);
+
+    while (TRUE)
+    {
+        int c = getopt(argc, argv, "o:s:b:V:A:p:P:t:N:R:E:e:u:c:d:T:D:a:F:");
+        if (c == -1)
+        {
+            break;
+        }
+        switch (c)
+        {
+            case 'o': output = optarg;
+            break;
+            case 's': nrofServices = atoi(optarg);
+            break;
+            case 'b': muxRate = strtoul(optarg, NULL, 10);
+            break;
+            case 'V': videoRate = strtoul(optarg, NULL, 10);
+            break;
+            case 'A': audioRate = strtoul(optarg, NULL, 10);
+            break;
+            case 'p': pmtPidBase = (uint16_t)strtoul(optarg, NULL, 0);
+            break;
+            case 'P': esPidBase = (uint16_t)strtoul(optarg, NULL, 0);
+            break;
+            case 't': tsId = (uint16_t)strtoul(optarg, NULL, 0);
+            break;
+            case 'N': networkId = (uint16_t)strtoul(optarg, NULL, 0);
+            break;
+            case 'R':
+            if (ParseRepetitionRates(optarg))
+            {
+                usage(argv[0]);
+                exit(1);
+            }
+            break;
+            case 'E': eitDays = atoi(optarg);
+            break;
+            case 'e': eventsPerDay = atoi(optarg);
+            break;
+            case 'u': versionInterval = atof(optarg);
+            break;
+            case 'c': ccErrorInterval = strtoul(optarg, NULL, 10);
+            break;
+            case 'd': duration = atof(optarg);
+            break;
+            case 'T': startTime = (time_t)strtol(optarg, NULL, 10);
+            break;
+            case 'D': dataDir = optarg;
+            break;
+            case 'a': adapter = atoi(optarg);
+            break;
+            case 'F': frequency = strtoul(optarg, NULL, 10);
+            break;
+            default:
+            usage(argv[0]);
+            exit(1);
+        }
+    }
+
+    if ((output == NULL) || (nrofServices < 1) || (nrofServices > MAX_SERVICES) ||
+        (muxRate == 0) || (duration <= 0.0) || (eitDays < 0) || (eitDays > MAX_EIT_DAYS) ||
+        (eventsPerDay < 1) || (eventsPerDay > SECS_PER_DAY))
+    {
+        usage(argv[0]);
+        exit(1);
+    }
+
+    if ((pmtPidBase < 0x20) || (esPidBase < 0x20) ||
+        (pmtPidBase + nrofServices > PID_MAX) || (esPidBase + (nrofServices * 2) > PID_MAX) ||
+        ((pmtPidBase < esPidBase + (nrofServices * 2)) && (esPidBase < pmtPidBase + nrofServices)))
+    {
+        fprintf(stderr, "PMT PIDs (0x%04x+) and ES PIDs (0x%04x+) overlap or are out of range for %d services\n",
+            pmtPidBase, esPidBase, nrofServices);
+        exit(1);
+    }
+
+    if ((videoRate + audioRate) * nrofServices > muxRate)
+    {
+        fprintf(stderr, "Warning: %d services at %lu b/s do not fit in %lu b/s, elementary streams will be starved.\n",
+            nrofServices, videoRate + audioRate, muxRate);
+    }
+
+    if ((dataDir != NULL) && (strcmp(output, "-") == 0))
+    {
+        fprintf(stderr, "A data directory entry can only be written when outputting to a file.\n");
+        exit(1);
+    }
+
+    /* Errors are always written to stderr, so the log itself can be discarded. */
+    LoggingInitFile("/dev/null", 0);
+
+    if (strcmp(output, "-") == 0)
+    {
+        outputFP = stdout;
+    }
+    else
+    {
+        outputFP = fopen(output, "wb");
+        if (outputFP == NULL)
+        {
+            perror(output);
+            exit(1);
+        }
+    }
+    setvbuf(outputFP, NULL, _IOFBF, OUTPUT_BUFFER_SIZE);
+
+    eventDuration = SECS_PER_DAY / eventsPerDay;
+    startMidnight = startTime - (startTime % SECS_PER_DAY);
+
+    /* Build the table jobs, per service jobs are staggered across the interval
+     * so that the output doesn't burst.
+     */
+    jobs = calloc(4 + (nrofServices * 3), sizeof(Schedulable_t));
+    streams = calloc(nrofServices * 2, sizeof(Schedulable_t));
+    jobHeap.entries = calloc(4 + (nrofServices * 3), sizeof(Schedulable_t *));
+    streamHeap.entries = calloc(nrofServices * 2, sizeof(Schedulable_t *));
+
+    for (i = Job_PAT; i < Job_Count; i ++)
+    {
+        int s;
+        int count = 1;
+
+        if ((i == Job_PMT) || (i == Job_EITPF) || (i == Job_EITSchedule))
+        {
+            count = nrofServices;
+        }
+        if ((i == Job_EITSchedule) && (eitDays == 0))
+        {
+            continue;
+        }
+        for (s = 0; s < count; s ++)
+        {
+            Schedulable_t *job = &jobs[nrofJobs ++];
+            job->job = i;
+            job->service = s;
+            job->interval = repetitionRates[i];
+            job->due = (repetitionRates[i] * s) / count;
+            HeapPush(&jobHeap, job);
+        }
+    }
+
+    for (i = 0; i < nrofServices * 2; i ++)
+    {
+        Schedulable_t *stream = &streams[i];
+        bool video = (i & 1) == 0;
+        stream->job = video ? Job_Video : Job_Audio;
+        stream->service = i / 2;
+        stream->pid = esPidBase + i;
+        stream->interval = (TSPACKET_SIZE * 8.0) / (video ? videoRate : audioRate);
+        stream->due = 0.0;
+        stream->nextPCR = 0.0;
+        stream->nextFrame = 0.0;
+        if ((video && videoRate) || (!video && audioRate))
+        {
+            HeapPush(&streamHeap, stream);
+        }
+    }
+
+    slotTime = (TSPACKET_SIZE * 8.0) / muxRate;
+    nextVersionBump = versionInterval;
+
+    for (slot = 0; (now = slot * slotTime) < duration; slot ++)
+    {
+        if ((versionInterval > 0.0) && (now >= nextVersionBump))
+        {
+            version = (version + 1) & 0x1f;
+            nextVersionBump += versionInterval;
+        }
+
+        while (jobHeap.count && (jobHeap.entries[0]->due <= now))
+        {
+            Schedulable_t *job = HeapPop(&jobHeap);
+            RunJob(job, now);
+            job->due += job->interval;
+            HeapPush(&jobHeap, job);
+        }
+
+        if (psiQueueHead < psiQueueCount)
+        {
+            WritePacket(psiQueue[psiQueueHead ++]);
+            psiPackets ++;
+            if (psiQueueHead == psiQueueCount)
+            {
+                psiQueueHead = 0;
+                psiQueueCount = 0;
+            }
+        }
+        else if (streamHeap.count && (streamHeap.entries[0]->due <= now))
+        {
+            Schedulable_t *stream = HeapPop(&streamHeap);
+            WriteESPacket(stream, now);
+            stream->due += stream->interval;
+            HeapPush(&streamHeap, stream);
+        }
+        else
+        {
+            WriteNullPacket();
+        }
+    }
+
+    if (fflush(outputFP) || ((outputFP != stdout) && fclose(outputFP)))
+    {
+        perror("Failed to write output");
+        exit(1);
+    }
+
+    if (psiQueueCount > psiQueueHead)
+    {
+        fprintf(stderr, "Warning: %d PSI packets still queued, the tables need more bandwidth than is available.\n",
+            psiQueueCount - psiQueueHead);
+    }
+    if (eitTruncated)
+    {
+        fprintf(stderr, "Warning: some EIT schedule segments had more than %d sections and were truncated.\n",
+            SECTIONS_PER_SEGMENT);
+    }
+
+    fprintf(stderr, "%llu packets (%llu PSI, %llu ES, %llu null), %.1fs at %lu b/s, %llu continuity errors injected\n",
+        packetsWritten, psiPackets, esPackets, nullPackets, duration, muxRate, ccErrorsInjected);
+
+    if (dataDir && WriteDataDirectory(dataDir, adapter, output, muxRate))
+    {
+        exit(1);
+    }
+
+    free(jobs);
+    free(streams);
+    free(jobHeap.entries);
+    free(streamHeap.entries);
+    free(psiQueue);
+    return 0;
+}
+
+/*******************************************************************************
+* Local Functions                                                              *
+*******************************************************************************/
+static void usage(char *appname)
+{
+    fprintf(stderr, "Usage:%s -o <file> [options]\n"
+                    "      -o <file>    : File to write to, - for stdout or a named pipe.\n"
+                    "      -d <secs>    : Length of the stream in seconds (default 60).\n"
+                    "      -b <rate>    : Multiplex bit rate in bits/s (default 40000000).\n"
+                    "      -s <n>       : Number of services (default 10).\n"
+                    "      -V <rate>    : Video bit rate per service (default 2000000).\n"
+                    "      -A <rate>    : Audio bit rate per service (default 192000).\n"
+                    "      -p <pid>     : First PMT PID (default 0x100).\n"
+                    "      -P <pid>     : First elementary stream PID (default 0x1000).\n"
+                    "      -t <id>      : Transport stream id (default 1).\n"
+                    "      -N <id>      : Network/original network id (default 0x233a).\n"
+                    "      -R <rates>   : Table repetition intervals in ms, ie pat=100,tdt=5000\n"
+                    "                     Tables: pat, pmt, sdt, nit, eitpf, eitsched, tdt\n"
+                    "      -E <days>    : Days of EIT schedule to generate (default 0, none).\n"
+                    "      -e <n>       : EIT events per day (default 24).\n"
+                    "      -u <secs>    : Bump all table versions every <secs> seconds.\n"
+                    "      -c <n>       : Inject a continuity error every <n> elementary stream packets.\n"
+                    "      -T <time>    : UTC start time in seconds since the epoch (default now).\n"
+                    "      -D <dir>     : Data directory to add a file adapter frequency file to.\n"
+                    "      -a <adapter> : File adapter number to use with -D (default 0).\n"
+                    "      -F <freq>    : Frequency to use with -D and in the NIT (default 0).\n",
+                    appname);
+}
+
+static int ParseRepetitionRates(char *rates)
+{
+    char *copy = strdup(rates);
+    char *saveptr = NULL;
+    char *entry;
+    int result = 0;
+
+    for (entry = strtok_r(copy, ",", &saveptr); entry; entry = strtok_r(NULL, ",", &saveptr))
+    {
+        char *value = strchr(entry, '=');
+        int i;
+
+        if (value == NULL)
+        {
+            result = -1;
+            break;
+        }
+        *value = 0;
+        value ++;
+        for (i = 0; i < Job_Count; i ++)
+        {
+            if (strcmp(entry, jobNames[i]) == 0)
+            {
+                break;
+            }
+        }
+        if ((i == Job_Count) || (atoi(value) <= 0))
+        {
+            fprintf(stderr, "Unknown table or invalid interval \"%s=%s\"\n", entry, value);
+            result = -1;
+            break;
+        }
+        repetitionRates[i] = atoi(value) / 1000.0;
+    }
+    free(copy);
+    return result;
+}
+
+static int WriteDataDirectory(const char *dataDir, int adapter, const char *output, unsigned long muxRate)
+{
+    char path[PATH_MAX];
+    char *absolute;
+    FILE *fp;
+
+    absolute = realpath(output, NULL);
+    if (absolute == NULL)
+    {
+        perror(output);
+        return -1;
+    }
+
+    sprintf(path, "%s/file%d", dataDir, adapter);
+    if (mkdir(path, S_IRWXU) && (errno != EEXIST))
+    {
+        perror(path);
+        free(absolute);
+        return -1;
+    }
+
+    /* Don't change the delivery system of an existing adapter. */
+    sprintf(path, "%s/file%d/info", dataDir, adapter);
+    if (access(path, F_OK))
+    {
+        fp = fopen(path, "w");
+        if (fp)
+        {
+            fprintf(fp, "DVB-T\n");
+            fclose(fp);
+        }
+    }
+
+    sprintf(path, "%s/file%d/%lu", dataDir, adapter, frequency);
+    fp = fopen(path, "w");
+    if (fp == NULL)
+    {
+        perror(path);
+        free(absolute);
+        return -1;
+    }
+    fprintf(fp, "%s\n%lu\n", absolute, muxRate);
+    fclose(fp);
+    free(absolute);
+    return 0;
+}
+
+static void HeapPush(Heap_t *heap, Schedulable_t *entry)
+{
+    int i = heap->count ++;
+
+    while (i > 0)
+    {
+        int parent = (i - 1) / 2;
+        if (heap->entries[parent]->due <= entry->due)
+        {
+            break;
+        }
+        heap->entries[i] = heap->entries[parent];
+        i = parent;
+    }
+    heap->entries[i] = entry;
+}
+
+static Schedulable_t *HeapPop(Heap_t *heap)
+{
+    Schedulable_t *result = heap->entries[0];
+    Schedulable_t *last = heap->entries[-- heap->count];
+    int i = 0;
+
+    while (TRUE)
+    {
+        int child = (i * 2) + 1;
+        if (child >= heap->count)
+        {
+            break;
+        }
+        if ((child + 1 < heap->count) && (heap->entries[child + 1]->due < heap->entries[child]->due))
+        {
+            child ++;
+        }
+        if (last->due <= heap->entries[child]->due)
+        {
+            break;
+        }
+        heap->entries[i] = heap->entries[child];
+        i = child;
+    }
+    if (heap->count)
+    {
+        heap->entries[i] = last;
+    }
+    return result;
+}
+
+static void RunJob(Schedulable_t *job, double now)
+{
+    switch (job->job)
+    {
+        case Job_PAT: GeneratePAT();
+        break;
+        case Job_PMT: GeneratePMT(job->service);
+        break;
+        case Job_SDT: GenerateSDT();
+        break;
+        case Job_NIT: GenerateNIT();
+        break;
+        case Job_EITPF: GenerateEITPF(job->service, now);
+        break;
+        case Job_EITSchedule: GenerateEITSchedule(job->service, now);
+        break;
+        case Job_TDT: GenerateTDT(now);
+        break;
+        default:
+        break;
+    }
+}
+
+/*
+ * Packetise a chain of sections, packing them back to back and only stuffing
+ * the end of the last packet.
+ */
+static void QueueSections(uint16_t pid, dvbpsi_psi_section_t *sections)
+{
+    dvbpsi_psi_section_t *section;
+    uint8_t *data;
+    int *starts;
+    int nrofSections = 0;
+    int total = 0;
+    int pos = 0;
+    int next = 0;
+
+    for (section = sections; section; section = section->p_next)
+    {
+        total += section->i_length + 3;
+        nrofSections ++;
+    }
+    data = malloc(total);
+    starts = malloc(nrofSections * sizeof(int));
+    for (section = sections, total = 0, nrofSections = 0; section; section = section->p_next)
+    {
+        starts[nrofSections ++] = total;
+        memcpy(data + total, section->p_data, section->i_length + 3);
+        total += section->i_length + 3;
+    }
+
+    while (pos < total)
+    {
+        uint8_t *packet;
+        int offset = 4;
+        int len;
+
+        if (psiQueueCount == psiQueueSize)
+        {
+            psiQueueSize = psiQueueSize ? psiQueueSize * 2 : 1024;
+            psiQueue = realloc(psiQueue, psiQueueSize * TSPACKET_SIZE);
+        }
+        packet = psiQueue[psiQueueCount ++];
+
+        packet[0] = 0x47;
+        packet[1] = (pid >> 8) & 0x1f;
+        packet[2] = pid & 0xff;
+        packet[3] = 0x10 | continuityCounters[pid];
+        continuityCounters[pid] = (continuityCounters[pid] + 1) & 0xf;
+
+        while ((next < nrofSections) && (starts[next] < pos))
+        {
+            next ++;
+        }
+        if ((next < nrofSections) && (starts[next] - pos < TSPACKET_SIZE - 5))
+        {
+            packet[1] |= 0x40;
+            packet[offset ++] = starts[next] - pos;
+        }
+
+        len = TSPACKET_SIZE - offset;
+        if (len > total - pos)
+        {
+            len = total - pos;
+        }
+        memcpy(packet + offset, data + pos, len);
+        memset(packet + offset + len, 0xff, TSPACKET_SIZE - offset - len);
+        pos += len;
+    }
+    free(starts);
+    free(data);
+    dvbpsi_DeletePSISections(sections);
+}
+
+/*
+ * Set the last section number of a chain of sections that have been
+ * renumbered and recalculate their CRCs.
+ */
+static void FinaliseSections(dvbpsi_psi_section_t *sections)
+{
+    dvbpsi_psi_section_t *section;
+    uint8_t last = 0;
+
+    for (section = sections; section; section = section->p_next)
+    {
+        last = section->i_number;
+    }
+    for (section = sections; section; section = section->p_next)
+    {
+        section->i_last_number = last;
+        dvbpsi_BuildPSISection(section);
+    }
+}
+
+static dvbpsi_psi_section_t *GenerateEITSections(int service, uint8_t tableId,
+    uint8_t lastTableId, int firstEvent, int nrofEvents, int runningEvent,
+    uint8_t version, int firstNumber, int maxSections)
+{
+    dvbpsi_eit_t eit;
+    dvbpsi_psi_section_t *sections;
+    dvbpsi_psi_section_t *section;
+    int i;
+
+    dvbpsi_InitEIT(&eit, service + 1, version, 1, tsId, networkId, 0, lastTableId);
+    for (i = firstEvent; i < firstEvent + nrofEvents; i ++)
+    {
+        time_t start = startMidnight + ((time_t)i * eventDuration);
+        struct tm startTm;
+        dvbpsi_eit_event_t *event;
+        uint8_t descriptor[255];
+        int len;
+
+        gmtime_r(&start, &startTm);
+        event = dvbpsi_EITAddEvent(&eit, (i % 0xffff) + 1, &startTm, eventDuration,
+            (i == runningEvent) ? 4 : 1, 0);
+
+        /* short_event_descriptor */
+        memcpy(descriptor, "eng", 3);
+        len = sprintf((char *)descriptor + 4, "Event %d", i);
+        descriptor[3] = len;
+        len += 4;
+        descriptor[len] = sprintf((char *)descriptor + len + 1, "Service %d event %d", service + 1, i);
+        len += descriptor[len] + 1;
+        dvbpsi_EITEventAddDescriptor(event, 0x4d, len, descriptor);
+    }
+
+    sections = dvbpsi_GenEITSections(&eit, tableId);
+    dvbpsi_EmptyEIT(&eit);
+
+    for (section = sections, i = 0; section; section = section->p_next, i ++)
+    {
+        if (i == maxSections - 1)
+        {
+            if (section->p_next)
+            {
+                dvbpsi_DeletePSISections(section->p_next);
+                section->p_next = NULL;
+                eitTruncated = TRUE;
+            }
+        }
+        section->i_number = firstNumber + i;
+    }
+    for (section = sections; section; section = section->p_next)
+    {
+        section->p_data[12] = firstNumber + i - 1; /* segment_last_section_number */
+    }
+    return sections;
+}
+
+static void GeneratePAT(void)
+{
+    dvbpsi_pat_t pat;
+    int i;
+
+    dvbpsi_InitPAT(&pat, tsId, version, 1);
+    dvbpsi_PATAddProgram(&pat, 0, PID_NIT);
+    for (i = 0; i < nrofServices; i ++)
+    {
+        dvbpsi_PATAddProgram(&pat, i + 1, pmtPidBase + i);
+    }
+    QueueSections(PID_PAT, dvbpsi_GenPATSections(&pat, 253));
+    dvbpsi_EmptyPAT(&pat);
+}
+
+static void GeneratePMT(int service)
+{
+    dvbpsi_pmt_t pmt;
+    uint16_t videoPid = esPidBase + (service * 2);
+
+    dvbpsi_InitPMT(&pmt, service + 1, version, 1, videoPid);
+    dvbpsi_PMTAddES(&pmt, 0x02, videoPid);
+    dvbpsi_PMTAddES(&pmt, 0x03, videoPid + 1);
+    QueueSections(pmtPidBase + service, dvbpsi_GenPMTSections(&pmt));
+    dvbpsi_EmptyPMT(&pmt);
+}
+
+static void GenerateSDT(void)
+{
+    dvbpsi_sdt_t sdt;
+    int i;
+
+    dvbpsi_InitSDT(&sdt, tsId, version, 1, networkId);
+    for (i = 0; i < nrofServices; i ++)
+    {
+        dvbpsi_sdt_service_t *service;
+        uint8_t descriptor[64];
+        int len;
+
+        service = dvbpsi_SDTAddService(&sdt, i + 1, eitDays > 0, 1, 4, 0);
+
+        /* service_descriptor */
+        descriptor[0] = 0x01;
+        descriptor[1] = sprintf((char *)descriptor + 2, "tsgen");
+        len = descriptor[1] + 2;
+        descriptor[len] = sprintf((char *)descriptor + len + 1, "Service %d", i + 1);
+        len += descriptor[len] + 1;
+        dvbpsi_SDTServiceAddDescriptor(service, 0x48, len, descriptor);
+    }
+    QueueSections(PID_SDT, dvbpsi_GenSDTSections(&sdt));
+    dvbpsi_EmptySDT(&sdt);
+}
+
+static void GenerateNIT(void)
+{
+    dvbpsi_nit_t nit;
+    dvbpsi_nit_transport_t *transport = NULL;
+    uint8_t descriptor[255];
+    unsigned long centreFrequency = frequency / 10;
+    int i, j, count;
+
+    dvbpsi_InitNIT(&nit, TRUE, networkId, version, 1);
+
+    count = sprintf((char *)descriptor, "tsgen network");
+    dvbpsi_NITAddDescriptor(&nit, 0x40, count, descriptor);
+
+    /* A transport's descriptors have to fit in one section, so with a lot of
+     * services the service list is spread over several entries for the same
+     * transport stream.
+     */
+    for (i = 0; i < nrofServices; i += SERVICES_PER_LIST)
+    {
+        if ((i % (SERVICES_PER_LIST * LISTS_PER_TRANSPORT)) == 0)
+        {
+            transport = dvbpsi_NITAddTransport(&nit, tsId, networkId);
+        }
+        if (i == 0)
+        {
+            /* terrestrial_delivery_system_descriptor, 8MHz, 64QAM, 2/3, 1/32, 8k */
+            descriptor[0] = (centreFrequency >> 24) & 0xff;
+            descriptor[1] = (centreFrequency >> 16) & 0xff;
+            descriptor[2] = (centreFrequency >> 8) & 0xff;
+            descriptor[3] = centreFrequency & 0xff;
+            descriptor[4] = 0x1f;
+            descriptor[5] = 0x81;
+            descriptor[6] = 0xda;
+            memset(descriptor + 7, 0xff, 4);
+            dvbpsi_NITTransportAddDescriptor(transport, 0x5a, 11, descriptor);
+        }
+
+        /* service_list_descriptor */
+        count = nrofServices - i;
+        if (count > SERVICES_PER_LIST)
+        {
+            count = SERVICES_PER_LIST;
+        }
+        for (j = 0; j < count; j ++)
+        {
+            descriptor[(j * 3) + 0] = ((i + j + 1) >> 8) & 0xff;
+            descriptor[(j * 3) + 1] = (i + j + 1) & 0xff;
+            descriptor[(j * 3) + 2] = 0x01;
+        }
+        dvbpsi_NITTransportAddDescriptor(transport, 0x41, count * 3, descriptor);
+    }
+    QueueSections(PID_NIT, dvbpsi_GenNITSections(&nit));
+    dvbpsi_EmptyNIT(&nit);
+}
+
+static void GenerateEITPF(int service, double now)
+{
+    dvbpsi_psi_section_t *present;
+    dvbpsi_psi_section_t *following;
+    int current = (int)((startTime + (time_t)now - startMidnight) / eventDuration);
+    uint8_t pfVersion = (version + current) & 0x1f;
+
+    present = GenerateEITSections(service, TABLE_ID_EIT_PF, TABLE_ID_EIT_PF,
+        current, 1, current, pfVersion, 0, 1);
+    following = GenerateEITSections(service, TABLE_ID_EIT_PF, TABLE_ID_EIT_PF,
+        current + 1, 1, current, pfVersion, 1, 1);
+    present->p_next = following;
+    present->p_data[12] = 1;
+    following->p_data[12] = 1;
+    FinaliseSections(present);
+    QueueSections(PID_EIT, present);
+}
+
+static void GenerateEITSchedule(int service, double now)
+{
+    int today = (int)((startTime + (time_t)now - startMidnight) / SECS_PER_DAY);
+    int current = (int)((startTime + (time_t)now - startMidnight) / eventDuration);
+    uint8_t schedVersion = (version + today) & 0x1f;
+    int nrofTables = (eitDays + DAYS_PER_TABLE - 1) / DAYS_PER_TABLE;
+    uint8_t lastTableId = TABLE_ID_EIT_SCHEDULE + nrofTables - 1;
+    int table;
+
+    for (table = 0; table < nrofTables; table ++)
+    {
+        dvbpsi_psi_section_t *sections = NULL;
+        dvbpsi_psi_section_t *last = NULL;
+        int days = eitDays - (table * DAYS_PER_TABLE);
+        int nrofSegments;
+        int segment;
+
+        if (days > DAYS_PER_TABLE)
+        {
+            days = DAYS_PER_TABLE;
+        }
+        nrofSegments = days * (SECS_PER_DAY / SECS_PER_SEGMENT);
+
+        for (segment = 0; segment < nrofSegments; segment ++)
+        {
+            time_t segmentStart = ((today + (table * DAYS_PER_TABLE)) * SECS_PER_DAY) +
+                                  (segment * SECS_PER_SEGMENT);
+            int firstEvent = (segmentStart + eventDuration - 1) / eventDuration;
+            int endEvent = (segmentStart + SECS_PER_SEGMENT + eventDuration - 1) / eventDuration;
+            dvbpsi_psi_section_t *segmentSections;
+
+            /* Empty segments are sent as a single section with no events. */
+            segmentSections = GenerateEITSections(service, TABLE_ID_EIT_SCHEDULE + table,
+                lastTableId, firstEvent, endEvent - firstEvent, current, schedVersion,
+                segment * SECTIONS_PER_SEGMENT, SECTIONS_PER_SEGMENT);
+            if (last)
+            {
+                last->p_next = segmentSections;
+            }
+            else
+            {
+                sections = segmentSections;
+            }
+            for (last = segmentSections; last->p_next; last = last->p_next);
+        }
+        FinaliseSections(sections);
+        QueueSections(PID_EIT, sections);
+    }
+}
+
+static void GenerateTDT(double now)
+{
+    dvbpsi_tdt_tot_t tdt;
+    time_t utc = startTime + (time_t)now;
+
+    memset(&tdt, 0, sizeof(tdt));
+    gmtime_r(&utc, &tdt.t_date_time);
+    QueueSections(PID_TDT, dvbpsi_GenTDTSections(&tdt));
+}
+
+static void WriteESPacket(Schedulable_t *stream, double now)
+{
+    uint8_t packet[TSPACKET_SIZE];
+    int offset = 4;
+
+    packet[0] = 0x47;
+    packet[1] = (stream->pid >> 8) & 0x1f;
+    packet[2] = stream->pid & 0xff;
+    packet[3] = 0x10 | continuityCounters[stream->pid];
+
+    esPackets ++;
+    if (ccErrorInterval && ((esPackets % ccErrorInterval) == 0))
+    {
+        /* Skip a counter value to make a continuity error. */
+        continuityCounters[stream->pid] ++;
+        ccErrorsInjected ++;
+    }
+    continuityCounters[stream->pid] = (continuityCounters[stream->pid] + 1) & 0xf;
+
+    if ((stream->job == Job_Video) && (now >= stream->nextPCR))
+    {
+        uint64_t pcr = (uint64_t)(now * TSPACKET_PCR_HZ);
+        uint64_t base = pcr / 300;
+        unsigned int ext = pcr % 300;
+
+        packet[3] |= 0x20;
+        packet[4] = 7;
+        packet[5] = 0x10;
+        packet[6] = (base >> 25) & 0xff;
+        packet[7] = (base >> 17) & 0xff;
+        packet[8] = (base >> 9) & 0xff;
+        packet[9] = (base >> 1) & 0xff;
+        packet[10] = ((base & 1) << 7) | 0x7e | ((ext >> 8) & 1);
+        packet[11] = ext & 0xff;
+        offset = 12;
+        stream->nextPCR += PCR_INTERVAL;
+    }
+
+    if (now >= stream->nextFrame)
+    {
+        uint64_t pts = ((uint64_t)((now + PTS_DELAY) * 90000)) & 0x1ffffffffULL;
+
+        packet[1] |= 0x40;
+        packet[offset + 0] = 0x00;
+        packet[offset + 1] = 0x00;
+        packet[offset + 2] = 0x01;
+        packet[offset + 3] = (stream->job == Job_Video) ? 0xe0 : 0xc0;
+        packet[offset + 4] = 0x00;  /* Unbounded PES packet length */
+        packet[offset + 5] = 0x00;
+        packet[offset + 6] = 0x80;
+        packet[offset + 7] = 0x80;  /* PTS only */
+        packet[offset + 8] = 5;
+        packet[offset + 9] = 0x21 | ((pts >> 29) & 0x0e);
+        packet[offset + 10] = (pts >> 22) & 0xff;
+        packet[offset + 11] = ((pts >> 14) & 0xfe) | 1;
+        packet[offset + 12] = (pts >> 7) & 0xff;
+        packet[offset + 13] = ((pts << 1) & 0xfe) | 1;
+        offset += 14;
+        stream->nextFrame += (stream->job == Job_Video) ? VIDEO_FRAME_TIME : AUDIO_FRAME_TIME;
+    }
+
+    memset(packet + offset, stream->service & 0xff, TSPACKET_SIZE - offset);
+    WritePacket(packet);
+}
+
+static void WriteNullPacket(void)
+{
+    static uint8_t packet[TSPACKET_SIZE] = {0x47, 0x1f, 0xff, 0x10};
+
+    if (packet[4] == 0)
+    {
+        memset(packet + 4, 0xff, TSPACKET_SIZE - 4);
+    }
+    nullPackets ++;
+    WritePacket(packet);
+}
+
+static void WritePacket(uint8_t *packet)
+{
+    if (fwrite(packet, TSPACKET_SIZE, 1, outputFP) != 1)
+    {
+        perror("Failed to write output");
+        exit(1);
+    }
+    packetsWritten ++;
+}
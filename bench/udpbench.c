@@ -0,0 +1,271 @@
+/*
+Copyright (C) 2006  Adam Charrett
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+
+udpbench.c
+
+Sends datagrams the size the UDP output uses to a receiver on the loopback
+interface, one per sendto(), queued and sent with sendmmsg() and queued and
+sent with UDP GSO, and compares the CPU time the sender uses for each.
+
+*/
+#include "config.h"
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <time.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "types.h"
+#include "logging.h"
+#include "udp.h"
+
+/*******************************************************************************
+* Defines                                                                      *
+*******************************************************************************/
+#define TSPACKET_SIZE 188
+
+/* Size of a datagram of 7 TS packets, as sent by the UDP output. */
+#define DEFAULT_DATAGRAM_SIZE (7 * TSPACKET_SIZE)
+
+#define RECEIVE_BUFFER_SIZE (8 * 1024 * 1024)
+
+/*******************************************************************************
+* Typedefs                                                                     *
+*******************************************************************************/
+typedef struct Mode_t
+{
+    const char *name;
+    int depth;
+    bool gso;
+}Mode_t;
+
+/*******************************************************************************
+* Prototypes                                                                   *
+*******************************************************************************/
+static void usage(char *appname);
+static int CreateReceiver(struct sockaddr_in *address);
+static void *ReceiverThread(void *arg);
+static bool RunMode(Mode_t *mode, int receiver, struct sockaddr_in *address, int datagramSize, unsigned long count);
+static double Now(clockid_t clock);
+
+/*******************************************************************************
+* Global variables                                                             *
+*******************************************************************************/
+char DataDirectory[PATH_MAX];
+
+static volatile bool receiving;
+static volatile unsigned long long received;
+
+/*******************************************************************************
+* Global functions                                                             *
+*******************************************************************************/
+int main(int argc, char *argv[])
+{
+    unsigned long count = 200000;
+    int depth = 32;
+    int datagramSize = DEFAULT_DATAGRAM_SIZE;
+    struct sockaddr_in address;
+    int receiver;
+    int i;
+    Mode_t modes[3];
+
+    while (TRUE)
+    {
+        int c = getopt(argc, argv, "n:b:s:");
+        if (c == -1)
+        {
+            break;
+        }
+        switch (c)
+        {
+            case 'n': count = strtoul(optarg, NULL, 0);
+            break;
+            case 'b': depth = atoi(optarg);
+            break;
+            case 's': datagramSize = atoi(optarg);
+            break;
+            default:
+            usage(argv[0]);
+            exit(1);
+        }
+    }
+
+    if ((count == 0) || (depth < 2) || (datagramSize < 1) || (datagramSize > UDP_GSO_MAX_BYTES))
+    {
+        usage(argv[0]);
+        exit(1);
+    }
+
+    /* Errors are always written to stderr, so the log itself can be discarded. */
+    LoggingInitFile("/dev/null", 0);
+
+    receiver = CreateReceiver(&address);
+    if (receiver == -1)
+    {
+        exit(1);
+    }
+
+    modes[0].name = "sendto";
+    modes[0].depth = 1;
+    modes[0].gso = FALSE;
+    modes[1].name = "sendmmsg";
+    modes[1].depth = depth;
+    modes[1].gso = FALSE;
+    modes[2].name = "gso";
+    modes[2].depth = depth;
+    modes[2].gso = TRUE;
+
+    printf("%lu datagrams of %d bytes, queue depth %d\n", count, datagramSize, depth);
+    for (i = 0; i < 3; i ++)
+    {
+        if (!RunMode(&modes[i], receiver, &address, datagramSize, count))
+        {
+            exit(1);
+        }
+    }
+    close(receiver);
+    return 0;
+}
+
+/*******************************************************************************
+* Local Functions                                                              *
+*******************************************************************************/
+static void usage(char *appname)
+{
+    fprintf(stderr, "Usage:%s [-n <count>] [-b <depth>] [-s <size>]\n"
+                    "      -n <count>   : Number of datagrams to send in each mode (default 200000).\n"
+                    "      -b <depth>   : Number of datagrams to queue before sending (default 32).\n"
+                    "      -s <size>    : Size of each datagram (default %d).\n",
+                    appname, DEFAULT_DATAGRAM_SIZE);
+}
+
+static int CreateReceiver(struct sockaddr_in *address)
+{
+    int receiver = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    int size = RECEIVE_BUFFER_SIZE;
+    struct timeval timeout = {0, 200000};
+    socklen_t addressLen = sizeof(struct sockaddr_in);
+
+    if (receiver == -1)
+    {
+        perror("socket");
+        return -1;
+    }
+    setsockopt(receiver, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+    setsockopt(receiver, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    memset(address, 0, sizeof(struct sockaddr_in));
+    address->sin_family = AF_INET;
+    address->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if ((bind(receiver, (struct sockaddr *)address, addressLen) == -1) ||
+        (getsockname(receiver, (struct sockaddr *)address, &addressLen) == -1))
+    {
+        perror("bind");
+        close(receiver);
+        return -1;
+    }
+    return receiver;
+}
+
+static void *ReceiverThread(void *arg)
+{
+    int receiver = *(int *)arg;
+    uint8_t buffer[UDP_GSO_MAX_BYTES];
+
+    while (TRUE)
+    {
+        if (recv(receiver, buffer, sizeof(buffer), 0) < 0)
+        {
+            /* Only give up once the sender has finished and the socket is empty. */
+            if ((errno == EAGAIN) && !receiving)
+            {
+                break;
+            }
+            continue;
+        }
+        received ++;
+    }
+    return NULL;
+}
+
+static bool RunMode(Mode_t *mode, int receiver, struct sockaddr_in *address, int datagramSize, unsigned long count)
+{
+    UDPBatch_t batch;
+    pthread_t thread;
+    int sender;
+    unsigned long i;
+    double wallStart, cpuStart, wall, cpu;
+
+    sender = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (sender == -1)
+    {
+        perror("socket");
+        return FALSE;
+    }
+    if (!UDPBatchInit(&batch, sender, (struct sockaddr *)address, sizeof(struct sockaddr_in),
+                      datagramSize, mode->depth, mode->gso))
+    {
+        fprintf(stderr, "Failed to allocate datagram queue\n");
+        close(sender);
+        return FALSE;
+    }
+
+    received = 0;
+    receiving = TRUE;
+    pthread_create(&thread, NULL, ReceiverThread, &receiver);
+
+    wallStart = Now(CLOCK_MONOTONIC);
+    cpuStart = Now(CLOCK_THREAD_CPUTIME_ID);
+    for (i = 0; i < count; i ++)
+    {
+        uint8_t *datagram = UDPBatchNext(&batch);
+        datagram[0] = 0x47;
+        datagram[1] = (uint8_t)i;
+        UDPBatchCommit(&batch);
+    }
+    UDPBatchFlush(&batch);
+    cpu = Now(CLOCK_THREAD_CPUTIME_ID) - cpuStart;
+    wall = Now(CLOCK_MONOTONIC) - wallStart;
+
+    receiving = FALSE;
+    pthread_join(thread, NULL);
+
+    printf("%-9s: %8.1f ns/datagram CPU, %8.0f datagrams/s, %llu calls, %llu sent, %llu dropped, %llu received%s\n",
+        mode->name, (cpu * 1000000000.0) / count, count / wall,
+        batch.syscalls, batch.datagrams, batch.drops, received,
+        (mode->gso && !batch.gso) ? " (GSO not supported)" : "");
+
+    UDPBatchDeinit(&batch);
+    close(sender);
+    return TRUE;
+}
+
+static double Now(clockid_t clock)
+{
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return ts.tv_sec + (ts.tv_nsec / 1000000000.0);
+}
@@ -0,0 +1,68 @@
+/*
+Copyright (C) 2009  Adam Charrett
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+
+asyncoutput.h
+
+Delivery method that queues packets for another delivery method and outputs
+them on a separate thread.
+
+*/
+#ifndef _ASYNCOUTPUT_H
+#define _ASYNCOUTPUT_H
+#include "deliverymethod.h"
+
+/**
+ * @defgroup AsyncOutput Asynchronous Delivery Method
+ * Wraps any other delivery method so that packets are copied into a ring
+ * buffer on the calling thread and output by a writer thread, a slow
+ * destination then only holds up its own output.
+ *
+ * MRLs are in the form async://[\<options\>;]\<mrl\>, where options are comma
+ * separated and may be:
+ * - queue=\<packets\> Number of packets that can be queued (default 16384).
+ * - overflow=drop-oldest|drop-newest|block What to do when the queue is full
+ *   (default drop-oldest).
+ *
+ * For example async://queue=65536,overflow=block;file:///recordings/bbc1.ts
+ *
+ * The number of packets queued, the most that have been queued and the number
+ * dropped are available as the properties sys.async.\<n\>.
+ * @{
+ */
+
+/**
+ * Prefix of asynchronous MRLs.
+ */
+#define ASYNCOUTPUT_PREFIX "async://"
+
+/**
+ * Number of packets held in each slot of the queue.
+ */
+#define ASYNCOUTPUT_SLOT_PACKETS 64
+
+/**
+ * Default number of packets that can be queued.
+ */
+#define ASYNCOUTPUT_DEFAULT_QUEUE 16384
+
+/**
+ * Handler for async:// MRLs, registered by the delivery method manager.
+ */
+extern DeliveryMethodHandler_t AsyncOutputHandler;
+
+/** @} */
+#endif
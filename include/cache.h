@@ -17,7 +17,8 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
 
 cache.h
 
-Caches service and PID information from the database for the current multiplex.
+Caches service and PID information from the database for the multiplex each
+adapter is tuned to.
 
 */
 
@@ -28,6 +29,7 @@ Caches service and PID information from the database for the current multiplex.
 #include "multiplexes.h"
 #include "services.h"
 #include "pids.h"
+#include "events.h"
 
 /** 
  * @defgroup DatabaseCache Database Cache Management
@@ -35,12 +37,21 @@ Caches service and PID information from the database for the current multiplex.
  * in the TS Filter thread without having the thread halted while the database 
  * file is accessed.
  *
+ * Each adapter has its own cache, retrieved with CacheGet(), holding the
+ * services on the multiplex that adapter is tuned to. Changes from every cache
+ * are written back to the same database.
+ *
  * @note Functions in this module should only be used from within the TS Filter 
  * thread, all other threads should access the database through Services and 
  * Multiplexes modules
  * @{
  */
 
+/**
+ * Handle to the cache of an adapter.
+ */
+typedef struct Cache_s Cache_t;
+
 /**
  * @internal
  * Initialise the cache module.
@@ -53,168 +64,206 @@ int CacheInit();
  */
 void CacheDeInit();
 
+/**
+ * Retrieve the cache for an adapter.
+ * @param index Index of the adapter, 0 being the primary adapter.
+ * @return The cache or NULL if the index is out of range.
+ */
+Cache_t *CacheGet(int index);
+
+/**
+ * Retrieve the event fired when the PIDs of a service in the cache are updated.
+ * The primary adapter's cache fires Cache.PIDsUpdated, other caches fire
+ * Cache.PIDsUpdated<index>.
+ * @param cache The cache to use.
+ * @return The event, the payload of which is the updated service.
+ */
+Event_t CachePIDsUpdatedEventGet(Cache_t *cache);
+
 /**
  * Load the cache with all the service in the specfied multiplex.
+ * @param cache The cache to use.
  * @param multiplex The multiplex to load all the services for.
  * @return 0 on success or an SQLite error code.
  */
-int CacheLoad(Multiplex_t *multiplex);
+int CacheLoad(Cache_t *cache, Multiplex_t *multiplex);
 
 /**
  * Write any changes in the cache, back to the database.
+ * @param cache The cache to use.
  */
-void CacheWriteback();
+void CacheWriteback(Cache_t *cache);
 
 /**
  * Retrieve the Multiplex that the cache is currently managing the services of.
+ * @param cache The cache to use.
  * @return A Multiplex_t instance or NULL if the cache has not be loaded.
  */
-Multiplex_t *CacheMultiplexGet(void);
+Multiplex_t *CacheMultiplexGet(Cache_t *cache);
 
 /**
  * Find a service in the cache by either name or fully qualified id (i.e. 
  * \<network id\>.\<ts id\>.\<service id\> where ids are in hex).
  *
+ * @param cache The cache to use.
  * @param name Name of the service or fully qualified id 
  * @return A Service_t instance or NULL if not found.
  */
-Service_t *CacheServiceFind(char *name);
+Service_t *CacheServiceFind(Cache_t *cache, char *name);
 
 /**
  * Find a service in the cache with the specified id.
+ * @param cache The cache to use.
  * @param id The service/program id to search for.
  * @return A Service_t instance or NULL if not found.
  */
-Service_t *CacheServiceFindId(int id);
+Service_t *CacheServiceFindId(Cache_t *cache, int id);
 
 /**
  * Find a service with a given name in the cache.
+ * @param cache The cache to use.
  * @param name Name of the service to look for.
  * @return A Service_t instance or NULL if not found in the cache.
  */
-Service_t *CacheServiceFindName(char *name);
+Service_t *CacheServiceFindName(Cache_t *cache, char *name);
 
 /**
  * Retrieve all the services currently in the cache and locks the cache to
  * prevent updates to the list. CacheServicesRelease() should be called when the
  * list is no longer needed.
  *
+ * @param cache The cache to use.
  * @param count Used to store the number of services in the cache.
  * @return An array of pointers to Service_t instances.
  */
-Service_t **CacheServicesGet(int *count);
+Service_t **CacheServicesGet(Cache_t *cache, int *count);
 
 /**
  * Releases the services retieved by CacheServiesGet and allows updates to the
  * cache.
+ * @param cache The cache to use.
  */
-void CacheServicesRelease(void);
+void CacheServicesRelease(Cache_t *cache);
 
 /**
  * Retrieve the PIDs for a given service and locks the cache to prevent updates.
  * ObjectRefDec() should be called on the list when it is no longer needed.
  *
+ * @param cache The cache to use.
  * @param service Service to retrieve the PIDs for.
  * @return A ProgramInfo_t structure or NULL if no information is available.
  */
-ProgramInfo_t* CacheProgramInfoGet(Service_t *service);
+ProgramInfo_t* CacheProgramInfoGet(Cache_t *cache, Service_t *service);
 
 
 /**
  * Update the specified Multiplex's pat version and TS id.
+ * @param cache The cache to use.
  * @param multiplex The multiplex to update.
  * @param patversion The new pat version.
  * @param tsid The new TS ID.
  */
-void CacheUpdateMultiplex(Multiplex_t *multiplex, int patversion, int tsid);
+void CacheUpdateMultiplex(Cache_t *cache, Multiplex_t *multiplex, int patversion, int tsid);
 
 /**
  * Update the specified Multiplex's network id.
+ * @param cache The cache to use.
  * @param multiplex The multiplex to update.
  * @param netid The network id to set.
  */
-void CacheUpdateNetworkId(Multiplex_t *multiplex, int netid);
+void CacheUpdateNetworkId(Cache_t *cache, Multiplex_t *multiplex, int netid);
 
 /**
  * Update the cached service with a new PMT PID.
+ * @param cache The cache to use.
  * @param service The service to update.
  * @param pmtpid The new PMT PID.
  */
-void CacheUpdateServicePMTPID(Service_t *service, int pmtpid);
+void CacheUpdateServicePMTPID(Cache_t *cache, Service_t *service, int pmtpid);
 
 /**
  * Update the cached service with a new name.
+ * @param cache The cache to use.
  * @param service The service to update.
  * @param name The new name.
  */
-void CacheUpdateServiceName(Service_t *service, char *name);
+void CacheUpdateServiceName(Cache_t *cache, Service_t *service, char *name);
 
 /**
  * Update the cached service with a new provider.
+ * @param cache The cache to use.
  * @param service The service to update.
  * @param provider The new provider name.
  */
-void CacheUpdateServiceProvider(Service_t *service, char *provider);
+void CacheUpdateServiceProvider(Cache_t *cache, Service_t *service, char *provider);
 
 /**
  * Update the cached service with a new default authority, used by TVAnytime.
+ * @param cache The cache to use.
  * @param service The service to update.
  * @param defaultAuthority The new default authority.
  */
-void CacheUpdateServiceDefaultAuthority(Service_t *service, char *defaultAuthority);
+void CacheUpdateServiceDefaultAuthority(Cache_t *cache, Service_t *service, char *defaultAuthority);
 
 /**
  * Update the cached service with a new source id.
+ * @param cache The cache to use.
  * @param service The service to update.
  * @param source The new source id.
  */
-void CacheUpdateServiceSource(Service_t *service, uint16_t source);
+void CacheUpdateServiceSource(Cache_t *cache, Service_t *service, uint16_t source);
 
 /**
  * Update the cached service with the new CA state of the service.
+ * @param cache The cache to use.
  * @param service The service to update.
  * @param ca The new CA state.
  */
-void CacheUpdateServiceConditionalAccess(Service_t *service, bool ca);
+void CacheUpdateServiceConditionalAccess(Cache_t *cache, Service_t *service, bool ca);
 
 /**
  * Update the cached service with the new type of the service.
+ * @param cache The cache to use.
  * @param service The service to update.
  * @param type The new type of the service.
  */
-void CacheUpdateServiceType(Service_t *service, ServiceType type);
+void CacheUpdateServiceType(Cache_t *cache, Service_t *service, ServiceType type);
 
 /**
  * Update the Program Info for the specified service.
+ * @param cache The cache to use.
  * @param service The service to update.
  * @param info A ProgramInfo_t object containing the new information.
  */
-void CacheUpdateProgramInfo(Service_t *service, ProgramInfo_t *info);
+void CacheUpdateProgramInfo(Cache_t *cache, Service_t *service, ProgramInfo_t *info);
 
 /**
  * Add a new Service to the cache.
+ * @param cache The cache to use.
  * @param id The new service/program id.
  * @param source The source Id for EPG information.
  */
-Service_t *CacheServiceAdd(int id, int source);
+Service_t *CacheServiceAdd(Cache_t *cache, int id, int source);
 
 /**
  * Update the 'seen' state of the service. 
  * If a service is seen in the PAT but not in the SDT/VCT or vice versa the service
  * still exists, but if the service is no longer seen in the PAT and SDT/VCT, the
  * service no longer exists and should be deleted.
+ * @param cache The cache to use.
  * @param service The service to update the 'seen' status of.
  * @param seen Whether the service has been seen or not.
  * @param pat If the services was (not) seen in the PAT, but in the SDT/VCT.
  * @return True if the service still exists, False otherwise.
  */
-bool CacheServiceSeen(Service_t *service, bool seen, bool pat);
+bool CacheServiceSeen(Cache_t *cache, Service_t *service, bool seen, bool pat);
 
 /**
  * Delete a service from the cache.
+ * @param cache The cache to use.
  * @param service The service to be deleted when CacheWriteback() is called.
  */
-void CacheServiceDelete(Service_t *service);
+void CacheServiceDelete(Cache_t *cache, Service_t *service);
 
 /** @} */
 #endif
@@ -111,6 +111,28 @@ typedef struct DeliveryMethodInstanceOps_t
      */
      void (*SetHeader)(struct DeliveryMethodInstance_t *this, 
                         TSPacket_t *packets, int count);
+
+    /**
+     * Output a number of packets in one go.
+     * The packets are not guaranteed to be contiguous in memory and are only
+     * valid for the duration of the call, so must be copied if they are to
+     * be kept.
+     * If not implemented OutputPacket will be called for each packet.
+     * @param this The instance of the DeliveryMethodInstance_t to send the packets using.
+     * @param packets Array of pointers to the packets to send.
+     * @param count The number of packets to send.
+     */
+     void (*OutputPackets)(struct DeliveryMethodInstance_t *this,
+                        TSPacket_t **packets, int count);
+
+    /**
+     * Called at the end of each batch of input packets, instances that hold
+     * on to packets to send them together can use this to send what they
+     * have queued.
+     * If not implemented nothing is done.
+     * @param this The instance of the DeliveryMethodInstance_t to flush.
+     */
+     void (*Flush)(struct DeliveryMethodInstance_t *this);
 }DeliveryMethodInstanceOps_t;
 
 
@@ -163,6 +185,16 @@ void DeliveryMethodManagerUnRegister(DeliveryMethodHandler_t *handler);
  */
 DeliveryMethodInstance_t *DeliveryMethodCreate(char *mrl);
 
+/**
+ * Create a new DeliveryMethodInstance_t for a delivery method that wraps
+ * another one. Unlike DeliveryMethodCreate() the instance is not destroyed by
+ * DeliveryMethodDestroyAll(), the wrapping instance must destroy it by calling
+ * its DestroyInstance function.
+ * @param mrl The MRL the delivery method should handle.
+ * @return A DeliveryMethodInstance_t if the supplied MRL can be handled or NULL.
+ */
+DeliveryMethodInstance_t *DeliveryMethodCreateWrapped(char *mrl);
+
 /**
  * Retrieve the mrl used to setup the output on the specified filter.
  * @param filter The PIDFilter to retrieve the MRL from.
@@ -209,6 +241,21 @@ void DeliveryMethodSetHeader(DeliveryMethodInstance_t *instance, TSPacket_t *pac
  */
 void DeliveryMethodOutputPacket(DeliveryMethodInstance_t *instance, TSPacket_t* packet);
 
+/**
+ * Output a number of packets using the specified delivery method.
+ * @param instance The delievery method instance to use.
+ * @param packets Array of pointers to the packets to output.
+ * @param count The number of packets to output.
+ */
+void DeliveryMethodOutputPackets(DeliveryMethodInstance_t *instance, TSPacket_t **packets, int count);
+
+/**
+ * Inform the specified delivery method that the current batch of input packets
+ * has been output.
+ * @param instance The delievery method instance to use.
+ */
+void DeliveryMethodFlush(DeliveryMethodInstance_t *instance);
+
 /**
  * Output a block of data using the specified delivery method.
  * @param instance The delievery method instance to use.
@@ -73,6 +73,11 @@ Opens/Closes and setups dvb adapter for use in the rest of the application.
  */
 #define DVB_MAX_PID_FILTERS 256
 
+/**
+ * Maximum number of adapters that can be open at once in a single process.
+ */
+#define DVB_MAX_ADAPTERS 16
+
 /**
  * Structure used to keep track of hardware pid filters.
  */
@@ -118,9 +123,17 @@ typedef enum DVBFrontEndStatus_e {
  */
 typedef struct DVBAdapter_s DVBAdapter_t;
 
+/**
+ * Types of adapter that can be opened.
+ */
+typedef enum DVBAdapterType_e {
+    DVBAdapterType_Default,     /**< The default type for this executable. */
+    DVBAdapterType_LinuxDVB,    /**< A LinuxDVB adapter (/dev/dvb/adapter<#>). */
+    DVBAdapterType_File,        /**< A file adapter, streams TS files listed in adapter<#>.yaml. */
+} DVBAdapterType_e;
     
 /**
- * Open a DVB Adapter.
+ * Open a DVB Adapter of the default type for this executable.
  * This will open the frontend, demux and dvr devices.
  * @param adapter The adapter number of the devices to open.
  * @param hwRestricted Whether the adapter can only stream a portion of the 
@@ -130,6 +143,59 @@ typedef struct DVBAdapter_s DVBAdapter_t;
  */
 DVBAdapter_t *DVBInit(int adapter, bool hwRestricted, bool forceISDB);
 
+/**
+ * Open an adapter of the specified type.
+ * Each adapter open at the same time is assigned an index, the first adapter
+ * opened (index 0) registers its properties under "adapter", subsequent
+ * adapters under "adapter<index>".
+ * @param type The type of adapter to open.
+ * @param adapter The adapter number of the devices to open.
+ * @param hwRestricted Whether the adapter can only stream a portion of the 
+ *                     transport stream.
+ * @param forceISDB Force only ISDB to be supported.
+ * @return a DVBAdapter_t structure or NULL if the adapter could not be opened.
+ */
+DVBAdapter_t *DVBInitType(DVBAdapterType_e type, int adapter, bool hwRestricted, bool forceISDB);
+
+/**
+ * Parse an adapter specification of the form [<type>:]<number>, where type is
+ * either "dvb" or "file", for example "1" or "file:0".
+ * @param spec The string to parse.
+ * @param type Used to return the type of adapter (DVBAdapterType_Default if no
+ *             type was specified).
+ * @param adapter Used to return the adapter number.
+ * @return TRUE if the specification was valid, FALSE otherwise.
+ */
+bool DVBAdapterSpecParse(const char *spec, DVBAdapterType_e *type, int *adapter);
+
+/**
+ * Retrieve the index of the adapter within this process.
+ * @param adapter The adapter to query.
+ * @return The index of the adapter, 0 for the first adapter opened.
+ */
+int DVBAdapterIndexGet(DVBAdapter_t *adapter);
+
+/**
+ * Retrieve the adapter number the adapter was opened with.
+ * @param adapter The adapter to query.
+ * @return The adapter number.
+ */
+int DVBAdapterNumberGet(DVBAdapter_t *adapter);
+
+/**
+ * Retrieve the name of the adapter type, ie "DVB" or "File".
+ * @param adapter The adapter to query.
+ * @return The name of the type of adapter.
+ */
+char *DVBAdapterTypeNameGet(DVBAdapter_t *adapter);
+
+/**
+ * Retrieve an open adapter by its index.
+ * @param index The index of the adapter.
+ * @return The adapter or NULL if no adapter is open at that index.
+ */
+DVBAdapter_t *DVBAdapterGet(int index);
+
 /**
  * Close a DVPAdapter.
  * Close the frontend,demux and dvr devices and free the DVBAdapter_t structure.
@@ -198,6 +264,14 @@ int DVBFrontEndStatus(DVBAdapter_t *adapter, DVBFrontEndStatus_e *status,
  */
 bool DVBFrontEndIsLocked(DVBAdapter_t *adapter);
 
+/**
+ * Enable or disable the frontend of the adapter.
+ * @param adapter The adapter to (de)activate.
+ * @param active Whether the frontend should be active.
+ * @return 0 on success, non-zero otherwise.
+ */
+int DVBFrontEndSetActive(DVBAdapter_t *adapter, bool active);
+
 /**
  * Check whether the frontend supports the parameter and value specified.
  * @param adapter The adapter to query.
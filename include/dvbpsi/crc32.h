@@ -0,0 +1,131 @@
+/*****************************************************************************
+ * crc32.h
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ *****************************************************************************/
+
+/*!
+ * \file <crc32.h>
+ * \brief MPEG-2 CRC_32 calculation.
+ *
+ * CRC_32 (polynomial 0x04c11db7, MSB first, no final XOR) as used by PSI
+ * sections. Several implementations are available, the fastest one the CPU
+ * supports is picked the first time a CRC is calculated.
+ */
+
+#ifndef _DVBPSI_CRC32_H_
+#define _DVBPSI_CRC32_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/*****************************************************************************
+ * dvbpsi_crc32_engine_t
+ *****************************************************************************/
+/*!
+ * \enum dvbpsi_crc32_engine_e
+ * \brief CRC_32 implementations.
+ */
+/*!
+ * \typedef enum dvbpsi_crc32_engine_e dvbpsi_crc32_engine_t
+ * \brief dvbpsi_crc32_engine_t type definition.
+ */
+typedef enum dvbpsi_crc32_engine_e
+{
+  DVBPSI_CRC32_BYTEWISE = 0,    /*!< One table lookup per byte. */
+  DVBPSI_CRC32_SLICE8,          /*!< Slicing-by-8, 8 bytes per iteration. */
+  DVBPSI_CRC32_PCLMUL,          /*!< x86 carry-less multiply folding. */
+  DVBPSI_CRC32_ENGINES          /*!< Number of engines. */
+} dvbpsi_crc32_engine_t;
+
+
+/*****************************************************************************
+ * dvbpsi_Crc32
+ *****************************************************************************/
+/*!
+ * \fn uint32_t dvbpsi_Crc32(uint32_t i_crc, const uint8_t *p_data,
+                             size_t i_length)
+ * \brief Update a CRC_32 with the fastest engine available.
+ * \param i_crc CRC so far, 0xffffffff to start a new CRC.
+ * \param p_data data to add to the CRC.
+ * \param i_length number of bytes at p_data.
+ * \return the updated CRC, 0 when checking data that ends with its CRC_32
+ *         means the data is valid.
+ */
+uint32_t dvbpsi_Crc32(uint32_t i_crc, const uint8_t *p_data, size_t i_length);
+
+
+/*****************************************************************************
+ * dvbpsi_Crc32Engine
+ *****************************************************************************/
+/*!
+ * \fn uint32_t dvbpsi_Crc32Engine(dvbpsi_crc32_engine_t i_engine,
+                                   uint32_t i_crc, const uint8_t *p_data,
+                                   size_t i_length)
+ * \brief Update a CRC_32 using a specific engine, for testing/benchmarking.
+ * The engine must be supported by the CPU (see dvbpsi_Crc32EngineSupported).
+ * \param i_engine engine to use.
+ * \param i_crc CRC so far, 0xffffffff to start a new CRC.
+ * \param p_data data to add to the CRC.
+ * \param i_length number of bytes at p_data.
+ * \return the updated CRC.
+ */
+uint32_t dvbpsi_Crc32Engine(dvbpsi_crc32_engine_t i_engine, uint32_t i_crc,
+                            const uint8_t *p_data, size_t i_length);
+
+
+/*****************************************************************************
+ * dvbpsi_Crc32EngineSupported
+ *****************************************************************************/
+/*!
+ * \fn int dvbpsi_Crc32EngineSupported(dvbpsi_crc32_engine_t i_engine)
+ * \brief Check whether an engine can be used on this CPU.
+ * \param i_engine engine to check.
+ * \return 1 if the engine can be used, 0 otherwise.
+ */
+int dvbpsi_Crc32EngineSupported(dvbpsi_crc32_engine_t i_engine);
+
+
+/*****************************************************************************
+ * dvbpsi_Crc32EngineName
+ *****************************************************************************/
+/*!
+ * \fn const char *dvbpsi_Crc32EngineName(dvbpsi_crc32_engine_t i_engine)
+ * \brief Get the name of an engine.
+ * \param i_engine engine to get the name of.
+ * \return the name of the engine.
+ */
+const char *dvbpsi_Crc32EngineName(dvbpsi_crc32_engine_t i_engine);
+
+
+/*****************************************************************************
+ * dvbpsi_Crc32SelectedEngine
+ *****************************************************************************/
+/*!
+ * \fn dvbpsi_crc32_engine_t dvbpsi_Crc32SelectedEngine(void)
+ * \brief Get the engine used by dvbpsi_Crc32.
+ * \return the engine used by dvbpsi_Crc32.
+ */
+dvbpsi_crc32_engine_t dvbpsi_Crc32SelectedEngine(void);
+
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif
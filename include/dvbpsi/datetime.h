@@ -36,4 +36,16 @@ Date and Time decoding functions.
  */
 void dvbpsi_DecodeMJDUTC(uint8_t *p_mjdutc, struct tm *p_date_time);
 
+/*****************************************************************************
+ * dvbpsi_EncodeMJDUTC
+ *****************************************************************************/
+/*!
+ * \fn void dvbpsi_EncodeMJDUTC(struct tm *p_date_time,
+                                uint8_t *p_mjdutc)
+ * \brief Encode date/time in MJD UTC format (2 bytes MJD, 3 bytes BCD time).
+ * \param p_date_time pointer to a tm structure holding the UTC date to encode.
+ * \param p_mjdutc pointer to 5 bytes to store the encoded date time in.
+ */
+void dvbpsi_EncodeMJDUTC(struct tm *p_date_time, uint8_t *p_mjdutc);
+
 #endif /*_DATETIME_H*/
@@ -88,6 +88,7 @@ typedef struct dvbpsi_demux_subdec_s
   dvbpsi_demux_subdec_cb_t        pf_callback;
   void *                          p_cb_data;
   struct dvbpsi_demux_subdec_s *  p_next;
+  struct dvbpsi_demux_subdec_s *  p_prev;
 
   void (*pf_detach)(struct dvbpsi_demux_s *, uint8_t, uint16_t);
 
@@ -111,6 +112,12 @@ typedef struct dvbpsi_demux_s
 {
   dvbpsi_handle             p_decoder;          /*!< Parent PSI Decoder */
   dvbpsi_demux_subdec_t *   p_first_subdec;     /*!< First subtable decoder */
+  dvbpsi_demux_subdec_t **  pp_subdec_hash;     /*!< Open addressing hash of
+                                                     the subtable decoders,
+                                                     indexed on i_id */
+  unsigned int              i_subdec_hash_bits; /*!< log2 of the hash size */
+  unsigned int              i_subdec_count;     /*!< Number of subtable
+                                                     decoders */
   /* New subtable callback */
   dvbpsi_demux_new_cb_t     pf_new_callback;    /*!< New subtable callback */
   void *                    p_new_cb_data;      /*!< Data provided to the
@@ -158,6 +165,31 @@ void dvbpsi_DetachDemux(dvbpsi_handle h_dvbpsi);
 dvbpsi_demux_subdec_t * dvbpsi_demuxGetSubDec(dvbpsi_demux_t * p_demux,
                                               uint8_t          i_table_id,
                                               uint16_t         i_extension);
+
+/*****************************************************************************
+ * dvbpsi_demuxAddSubDec
+ *****************************************************************************/
+/*!
+ * \fn int dvbpsi_demuxAddSubDec(dvbpsi_demux_t *, dvbpsi_demux_subdec_t *)
+ * \brief Adds a subtable decoder to the demux, i_id must already be set.
+ * \param p_demux Pointer to the demux structure.
+ * \param p_subdec Subtable decoder to add.
+ * \return 0 if the decoder was added, 1 if memory could not be allocated.
+ */
+int dvbpsi_demuxAddSubDec(dvbpsi_demux_t *        p_demux,
+                          dvbpsi_demux_subdec_t * p_subdec);
+
+/*****************************************************************************
+ * dvbpsi_demuxRemoveSubDec
+ *****************************************************************************/
+/*!
+ * \fn void dvbpsi_demuxRemoveSubDec(dvbpsi_demux_t *, dvbpsi_demux_subdec_t *)
+ * \brief Removes a subtable decoder from the demux, the decoder is not freed.
+ * \param p_demux Pointer to the demux structure.
+ * \param p_subdec Subtable decoder to remove.
+ */
+void dvbpsi_demuxRemoveSubDec(dvbpsi_demux_t *        p_demux,
+                              dvbpsi_demux_subdec_t * p_subdec);
 /*****************************************************************************
  * dvbpsi_Demux
  *****************************************************************************/
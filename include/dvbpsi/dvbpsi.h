@@ -66,6 +66,47 @@ typedef struct dvbpsi_decoder_s * dvbpsi_handle;
 void dvbpsi_PushPacket(dvbpsi_handle h_dvbpsi, uint8_t* p_data);
 
 
+/*****************************************************************************
+ * dvbpsi_header_filter_cb
+ *****************************************************************************/
+/*!
+ * \typedef int (* dvbpsi_header_filter_cb)(void* p_cb_data,
+                                            const uint8_t* p_header,
+                                            int i_size)
+ * \brief Header filter callback type definition.
+ *
+ * Called as soon as the start of a section has been received. p_header is
+ * the start of the section including the table_id and section_length,
+ * i_size is the number of bytes available, which is less than asked for if
+ * the whole section is shorter. Return 0 to skip the section.
+ */
+typedef int (* dvbpsi_header_filter_cb)(void* p_cb_data,
+                                        const uint8_t* p_header, int i_size);
+
+
+/*****************************************************************************
+ * dvbpsi_SetHeaderFilter
+ *****************************************************************************/
+/*!
+ * \fn void dvbpsi_SetHeaderFilter(dvbpsi_handle h_dvbpsi,
+                                   dvbpsi_header_filter_cb pf_filter,
+                                   void* p_cb_data, int i_size)
+ * \brief Set a filter to run on the start of each section.
+ * \param h_dvbpsi handle to the decoder
+ * \param pf_filter filter callback, NULL to pass every section
+ * \param p_cb_data private data given to the filter callback
+ * \param i_size number of bytes from the start of the section the filter
+ *        needs (at least 3)
+ * \return nothing.
+ *
+ * Sections rejected by the filter are skipped without being copied or
+ * CRC checked. Any section being reassembled is dropped.
+ */
+void dvbpsi_SetHeaderFilter(dvbpsi_handle h_dvbpsi,
+                            dvbpsi_header_filter_cb pf_filter,
+                            void* p_cb_data, int i_size);
+
+
 /*****************************************************************************
  * The following definitions are just here to allow external decoders but
  * shouldn't be used for any other purpose.
@@ -121,13 +162,28 @@ typedef struct dvbpsi_decoder_s
   int                           b_discontinuity;        /*!< Discontinuity
                                                              flag */
 
-  dvbpsi_psi_section_t *        p_free_sections;        /*!< Available sections */
+  dvbpsi_psi_section_t *        p_free_sections;        /*!< Unused, released sections go back to the section pool */
                                                              
   dvbpsi_psi_section_t *        p_current_section;      /*!< Current section */
   int                           i_need;                 /*!< Bytes needed */
   int                           b_complete_header;      /*!< Flag for header
                                                              completion */
 
+  dvbpsi_header_filter_cb       pf_header_filter;       /*!< Section header
+                                                             filter */
+  void *                        p_header_filter_data;   /*!< Data given to
+                                                             the header
+                                                             filter */
+  int                           i_header_filter_size;   /*!< Bytes needed by
+                                                             the header
+                                                             filter */
+  int                           b_filter_header;        /*!< Waiting for the
+                                                             bytes needed by
+                                                             the filter */
+  int                           b_skip_section;         /*!< Skipping a
+                                                             filtered out
+                                                             section */
+
 } dvbpsi_decoder_t;
 
 
@@ -241,6 +241,35 @@ dvbpsi_eit_event_t* dvbpsi_EITAddEvent(dvbpsi_eit_t* p_eit,
     uint32_t i_duration, uint8_t i_running_status, 
     int b_free_ca);
 
+/*****************************************************************************
+ * dvbpsi_EITEventAddDescriptor
+ *****************************************************************************/
+/*!
+ * \fn dvbpsi_descriptor_t* dvbpsi_EITEventAddDescriptor(
+                                        dvbpsi_eit_event_t* p_event,
+                                        uint8_t i_tag, uint8_t i_length,
+                                        uint8_t* p_data)
+ * \brief Add a descriptor in the EIT event description.
+ * \param p_event pointer to the event structure
+ * \param i_tag descriptor's tag
+ * \param i_length descriptor's length
+ * \param p_data descriptor's data
+ * \return a pointer to the added descriptor.
+ */
+dvbpsi_descriptor_t* dvbpsi_EITEventAddDescriptor(
+                                        dvbpsi_eit_event_t* p_event,
+                                        uint8_t i_tag, uint8_t i_length,
+                                        uint8_t* p_data);
+
+/*****************************************************************************
+ * dvbpsi_GenEITSections
+ *****************************************************************************
+ * Generate EIT sections with the given table id based on the dvbpsi_eit_t
+ * structure. All the sections are treated as a single segment, callers
+ * generating schedule tables should renumber the sections of each segment.
+ *****************************************************************************/
+dvbpsi_psi_section_t *dvbpsi_GenEITSections(dvbpsi_eit_t *p_eit, uint8_t i_table_id);
+
 #ifdef __cplusplus
 };
 #endif
@@ -173,4 +173,67 @@ do {                                                                    \
  */
 void dvbpsi_EmptyNIT(dvbpsi_nit_t *p_nit);
 
+/*****************************************************************************
+ * dvbpsi_NITAddDescriptor
+ *****************************************************************************/
+/*!
+ * \fn dvbpsi_descriptor_t *dvbpsi_NITAddDescriptor(dvbpsi_nit_t *p_nit,
+                                                   uint8_t i_tag,
+                                                   uint8_t i_length,
+                                                   uint8_t *p_data)
+ * \brief Add a network descriptor to the NIT.
+ * \param p_nit pointer to the NIT structure
+ * \param i_tag descriptor's tag
+ * \param i_length descriptor's length
+ * \param p_data descriptor's data
+ * \return a pointer to the added descriptor.
+ */
+dvbpsi_descriptor_t *dvbpsi_NITAddDescriptor(dvbpsi_nit_t *p_nit,
+                                             uint8_t i_tag, uint8_t i_length,
+                                             uint8_t *p_data);
+
+/*****************************************************************************
+ * dvbpsi_NITAddTransport
+ *****************************************************************************/
+/*!
+ * \fn dvbpsi_nit_transport_t *dvbpsi_NITAddTransport(dvbpsi_nit_t* p_nit,
+                                                     uint16_t i_ts_id,
+                                                     uint16_t i_orignal_network_id)
+ * \brief Add a transport stream at the end of the NIT.
+ * \param p_nit pointer to the NIT structure
+ * \param i_ts_id transport_stream_id
+ * \param i_orignal_network_id original_network_id
+ * \return a pointer to the added transport.
+ */
+dvbpsi_nit_transport_t *dvbpsi_NITAddTransport(dvbpsi_nit_t* p_nit,
+                                               uint16_t i_ts_id,
+                                               uint16_t i_orignal_network_id);
+
+/*****************************************************************************
+ * dvbpsi_NITTransportAddDescriptor
+ *****************************************************************************/
+/*!
+ * \fn dvbpsi_descriptor_t *dvbpsi_NITTransportAddDescriptor(
+                                               dvbpsi_nit_transport_t *p_transport,
+                                               uint8_t i_tag, uint8_t i_length,
+                                               uint8_t *p_data)
+ * \brief Add a descriptor to a transport stream in the NIT.
+ * \param p_transport pointer to the transport structure
+ * \param i_tag descriptor's tag
+ * \param i_length descriptor's length
+ * \param p_data descriptor's data
+ * \return a pointer to the added descriptor.
+ */
+dvbpsi_descriptor_t *dvbpsi_NITTransportAddDescriptor(
+                                               dvbpsi_nit_transport_t *p_transport,
+                                               uint8_t i_tag, uint8_t i_length,
+                                               uint8_t *p_data);
+
+/*****************************************************************************
+ * dvbpsi_GenNITSections
+ *****************************************************************************
+ * Generate NIT sections based on the dvbpsi_nit_t structure.
+ *****************************************************************************/
+dvbpsi_psi_section_t *dvbpsi_GenNITSections(dvbpsi_nit_t *p_nit);
+
 #endif
@@ -0,0 +1,156 @@
+/*****************************************************************************
+ * pool.h
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ *****************************************************************************/
+
+/*!
+ * \file <pool.h>
+ * \brief Process wide pool of PSI section memory.
+ *
+ * Section structures and section data buffers are taken from and returned to
+ * a pool shared by all decoders. Data buffers come in two size classes, 1 KB
+ * for PSI/SI tables and 4 KB for private sections, anything larger is
+ * allocated directly. Each thread keeps a small cache of each class so the
+ * pool lock is only taken once per batch of sections. The memory kept for
+ * reuse by the shared part of the pool is capped.
+ */
+
+#ifndef _DVBPSI_POOL_H_
+#define _DVBPSI_POOL_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/*****************************************************************************
+ * dvbpsi_pool_class_t
+ *****************************************************************************/
+/*!
+ * \enum dvbpsi_pool_class_e
+ * \brief Classes of memory in the pool.
+ */
+/*!
+ * \typedef enum dvbpsi_pool_class_e dvbpsi_pool_class_t
+ * \brief dvbpsi_pool_class_t type definition.
+ */
+typedef enum dvbpsi_pool_class_e
+{
+  DVBPSI_POOL_SECTION = 0,      /*!< dvbpsi_psi_section_t structures. */
+  DVBPSI_POOL_DATA_1K,          /*!< Data buffers of up to 1024 bytes. */
+  DVBPSI_POOL_DATA_4K,          /*!< Data buffers of up to 4096 bytes. */
+  DVBPSI_POOL_CLASSES,          /*!< Number of classes. */
+  DVBPSI_POOL_NONE = -1         /*!< Too large for the pool. */
+} dvbpsi_pool_class_t;
+
+
+/*****************************************************************************
+ * dvbpsi_pool_stats_t
+ *****************************************************************************/
+/*!
+ * \struct dvbpsi_pool_stats_s
+ * \brief Section data buffer statistics, both size classes together.
+ */
+/*!
+ * \typedef struct dvbpsi_pool_stats_s dvbpsi_pool_stats_t
+ * \brief dvbpsi_pool_stats_t type definition.
+ */
+typedef struct dvbpsi_pool_stats_s
+{
+  unsigned int  i_outstanding;  /*!< Data buffers in use. */
+  unsigned int  i_free;         /*!< Data buffers kept for reuse. */
+  unsigned int  i_peak;         /*!< Highest i_outstanding seen. */
+  size_t        i_free_bytes;   /*!< Memory kept for reuse, all classes. */
+  size_t        i_limit;        /*!< Cap on i_free_bytes of the shared pool. */
+} dvbpsi_pool_stats_t;
+
+
+/*****************************************************************************
+ * dvbpsi_PoolClass
+ *****************************************************************************/
+/*!
+ * \fn dvbpsi_pool_class_t dvbpsi_PoolClass(size_t i_size)
+ * \brief Find the data buffer class a buffer of a given size comes from.
+ * \param i_size number of data bytes needed.
+ * \return the class or DVBPSI_POOL_NONE if the buffer is too large.
+ */
+dvbpsi_pool_class_t dvbpsi_PoolClass(size_t i_size);
+
+
+/*****************************************************************************
+ * dvbpsi_PoolAlloc
+ *****************************************************************************/
+/*!
+ * \fn void *dvbpsi_PoolAlloc(dvbpsi_pool_class_t i_class)
+ * \brief Take an item of the given class from the pool.
+ * \param i_class class of item to take.
+ * \return the item, or NULL if memory could not be allocated.
+ */
+void *dvbpsi_PoolAlloc(dvbpsi_pool_class_t i_class);
+
+
+/*****************************************************************************
+ * dvbpsi_PoolFree
+ *****************************************************************************/
+/*!
+ * \fn void dvbpsi_PoolFree(dvbpsi_pool_class_t i_class, void *p_item)
+ * \brief Return an item to the pool.
+ * \param i_class class the item was taken from.
+ * \param p_item the item.
+ */
+void dvbpsi_PoolFree(dvbpsi_pool_class_t i_class, void *p_item);
+
+
+/*****************************************************************************
+ * dvbpsi_PoolTrim
+ *****************************************************************************/
+/*!
+ * \fn void dvbpsi_PoolTrim(void)
+ * \brief Free all the memory kept for reuse by the shared pool and the
+ * calling thread's cache.
+ */
+void dvbpsi_PoolTrim(void);
+
+
+/*****************************************************************************
+ * dvbpsi_PoolSetLimit
+ *****************************************************************************/
+/*!
+ * \fn void dvbpsi_PoolSetLimit(size_t i_limit)
+ * \brief Set the most memory the shared pool keeps for reuse, anything
+ * released beyond that is freed.
+ * \param i_limit limit in bytes.
+ */
+void dvbpsi_PoolSetLimit(size_t i_limit);
+
+
+/*****************************************************************************
+ * dvbpsi_PoolGetStats
+ *****************************************************************************/
+/*!
+ * \fn void dvbpsi_PoolGetStats(dvbpsi_pool_stats_t *p_stats)
+ * \brief Get the current pool statistics.
+ * \param p_stats structure to fill in.
+ */
+void dvbpsi_PoolGetStats(dvbpsi_pool_stats_t *p_stats);
+
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif
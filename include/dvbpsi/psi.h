@@ -37,6 +37,29 @@ extern "C" {
 #endif
 
 
+/*****************************************************************************
+ * dvbpsi_psi_data_t
+ *****************************************************************************/
+/*!
+ * \struct dvbpsi_psi_data_s
+ * \brief Reference counted storage for the bytes of a section.
+ *
+ * Cloning a section shares its storage rather than copying it, so the bytes
+ * of a received section must be treated as read only. Call
+ * dvbpsi_WritablePSISection before modifying them.
+ */
+/*!
+ * \typedef struct dvbpsi_psi_data_s dvbpsi_psi_data_t
+ * \brief dvbpsi_psi_data_t type definition.
+ */
+typedef struct dvbpsi_psi_data_s
+{
+  volatile uint32_t             i_refcount;     /*!< Number of sections
+                                                     using this storage */
+  uint32_t                      i_size;         /*!< Size of p_bytes */
+  uint8_t                       p_bytes[];      /*!< The section bytes */
+} dvbpsi_psi_data_t;
+
 /*****************************************************************************
  * dvbpsi_psi_section_t
  *****************************************************************************/
@@ -94,6 +117,8 @@ struct dvbpsi_psi_section_s
 
   /* for reusing this section */
   uint32_t      i_max_size;             /*!< maximum size of p_data */
+  dvbpsi_psi_data_t *   p_storage;      /*!< buffer p_data points into,
+                                             shared with any clones */
   
   /* list handling */
   struct dvbpsi_psi_section_s *         p_next;         /*!< next element of
@@ -105,8 +130,8 @@ struct dvbpsi_psi_section_s
  *****************************************************************************/
 /*!
  * \fn dvbpsi_psi_section_t * dvbpsi_ClaimPSISection(int i_max_size)
- * \brief Return a previously released section if one is available or create a new one.
- * \param h_dvbpsi Handle to retrieve the currently unused section from.
+ * \brief Take a section from the process wide section pool (see pool.h).
+ * \param h_dvbpsi Handle of the decoder the section is for, not used.
  * \param i_max_size max size in bytes of the section
  * \return a pointer to the new PSI section structure.
  */
@@ -117,8 +142,8 @@ dvbpsi_psi_section_t * dvbpsi_ClaimPSISection(dvbpsi_handle h_dvbpsi, int i_max_
  *****************************************************************************/
  /*!
  * \fn void dvbpsi_ReleasePSISections(dvbpsi_psi_section_t * p_section)
- * \brief Release a section so it can be reused.
- * \param h_dvbpsi Handle to store the unused sections in.
+ * \brief Return a list of sections to the section pool so they can be reused.
+ * \param h_dvbpsi Handle of the decoder the sections were for, not used.
  * \param p_section pointer to the first PSI section structure
  * \return nothing.
  */
@@ -129,13 +154,26 @@ void dvbpsi_ReleasePSISections(dvbpsi_handle h_dvbpsi, dvbpsi_psi_section_t * p_
  *****************************************************************************/
  /*!
  * \fn void dvbpsi_ClonePSISection(dvbpsi_handle h_dvbpsi, dvbpsi_psi_section_t * p_section)
- * \brief Release a section so it can be reused.
- * \param h_dvbpsi Handle to retrieve the currently unused section from.
+ * \brief Clone a section without copying its data, the clone shares the
+ * storage of the original until dvbpsi_WritablePSISection is called on it.
+ * \param h_dvbpsi Handle of the decoder the clone is for, not used.
  * \param p_section pointer to the PSI section structure to clone.
  * \return a pointer to the new PSI section structure.
  */
 dvbpsi_psi_section_t * dvbpsi_ClonePSISection(dvbpsi_handle h_dvbpsi, dvbpsi_psi_section_t * p_section);
 
+/*****************************************************************************
+ * dvbpsi_WritablePSISection
+ *****************************************************************************/
+ /*!
+ * \fn int dvbpsi_WritablePSISection(dvbpsi_psi_section_t * p_section)
+ * \brief Make sure the data of a section is not shared with any other
+ * section, copying it if it is, so that it can be modified.
+ * \param p_section pointer to the PSI section structure.
+ * \return 0 on success, 1 if a copy could not be allocated.
+ */
+int dvbpsi_WritablePSISection(dvbpsi_psi_section_t * p_section);
+
 /*****************************************************************************
  * dvbpsi_NewPSISection
  *****************************************************************************/
@@ -149,4 +149,12 @@ dvbpsi_descriptor_t* dvbpsi_TOTAddDescriptor(dvbpsi_tdt_tot_t *p_tot,
                                              uint8_t i_tag, uint8_t i_length,
                                              uint8_t* p_data);
 
+/*****************************************************************************
+ * dvbpsi_GenTDTSections
+ *****************************************************************************
+ * Generate a TDT section based on the date/time in the dvbpsi_tdt_tot_t
+ * structure, any descriptors are ignored.
+ *****************************************************************************/
+dvbpsi_psi_section_t *dvbpsi_GenTDTSections(dvbpsi_tdt_tot_t *p_tdt);
+
 #endif
@@ -68,6 +68,26 @@ TSReader_t *MainTSReaderGet(void);
  */
 DVBAdapter_t *MainDVBAdapterGet(void);
 
+/**
+ * Retrieve the number of adapters in use by this instance.
+ * @return The number of adapters, the first (index 0) being the primary adapter.
+ */
+int MainAdapterCount(void);
+
+/**
+ * Retrieve the TSReader_t object reading from the specified adapter.
+ * @param index Index of the adapter (0 to MainAdapterCount() - 1).
+ * @return The TSReader_t object or NULL if index is out of range.
+ */
+TSReader_t *MainTSReaderGetByIndex(int index);
+
+/**
+ * Retrieve an adapter in use by this instance.
+ * @param index Index of the adapter (0 to MainAdapterCount() - 1).
+ * @return The DVBAdapter_t object or NULL if index is out of range.
+ */
+DVBAdapter_t *MainDVBAdapterGetByIndex(int index);
+
 /**
  * Retrieve the Primary Service Filter object.
  * @return A ServiceFilter_t object representing the primary filter.
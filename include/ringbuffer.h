@@ -0,0 +1,115 @@
+/*
+Copyright (C) 2006  Adam Charrett
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+
+ringbuffer.h
+
+Lock-free single producer/single consumer ring buffer.
+
+*/
+
+#ifndef _DVBSTREAMER_RINGBUFFER_H
+#define _DVBSTREAMER_RINGBUFFER_H
+
+#include "types.h"
+
+/**
+ * @defgroup RingBuffer Lock-free single producer/single consumer ring buffer
+ * The ring buffer only manages slot indices, the storage for each slot is
+ * owned by the user. Exactly one thread may write to the ring and exactly one
+ * (other) thread may read from it, no locking is required between the two.
+ *@{
+ */
+
+/**
+ * Assumed size of a cache line, used to keep the producer and consumer
+ * indices apart.
+ */
+#define RINGBUFFER_CACHELINE 64
+
+/**
+ * Structure describing a ring buffer.
+ */
+typedef struct RingBuffer_t
+{
+    unsigned int size;          /**< Number of slots, always a power of 2. */
+    unsigned int highWaterMark; /**< Maximum number of slots that have been in use at once. */
+    volatile unsigned int head __attribute__((aligned(RINGBUFFER_CACHELINE))); /**< Count of slots committed by the producer. */
+    volatile unsigned int tail __attribute__((aligned(RINGBUFFER_CACHELINE))); /**< Count of slots released by the consumer. */
+}RingBuffer_t;
+
+/**
+ * Initialise a ring buffer.
+ * @param ring The ring buffer to initialise.
+ * @param size The number of slots, must be a power of 2.
+ */
+void RingBufferInit(RingBuffer_t *ring, unsigned int size);
+
+/**
+ * Discard all slots in the ring buffer. Only safe to call while neither the
+ * producer nor the consumer are accessing the ring.
+ * @param ring The ring buffer to reset.
+ */
+void RingBufferReset(RingBuffer_t *ring);
+
+/**
+ * Retrieve the index of the next slot to fill (producer only).
+ * @param ring The ring buffer.
+ * @return The slot index or -1 if the ring is full.
+ */
+int RingBufferWriteSlot(RingBuffer_t *ring);
+
+/**
+ * Make the slot returned by RingBufferWriteSlot available to the consumer
+ * (producer only).
+ * @param ring The ring buffer.
+ */
+void RingBufferCommit(RingBuffer_t *ring);
+
+/**
+ * Retrieve the index of the oldest committed slot (consumer only).
+ * @param ring The ring buffer.
+ * @return The slot index or -1 if the ring is empty.
+ */
+int RingBufferReadSlot(RingBuffer_t *ring);
+
+/**
+ * Retrieve the index of the slot with the specified sequence number. Allows
+ * several threads to each work through the committed slots at their own pace,
+ * the slots are then released with RingBufferRelease once all of them have
+ * finished.
+ * @param ring The ring buffer.
+ * @param sequence Number of slots committed before the one required.
+ * @return The slot index or -1 if the slot has not been committed yet.
+ */
+int RingBufferPeekSlot(RingBuffer_t *ring, unsigned int sequence);
+
+/**
+ * Return the oldest slot to the producer. May be called from different
+ * threads as long as each slot is released exactly once.
+ * @param ring The ring buffer.
+ */
+void RingBufferRelease(RingBuffer_t *ring);
+
+/**
+ * Retrieve the number of slots currently waiting to be consumed.
+ * @param ring The ring buffer.
+ * @return The number of slots in use.
+ */
+unsigned int RingBufferUsed(RingBuffer_t *ring);
+
+/** @} */
+#endif
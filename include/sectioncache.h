@@ -0,0 +1,113 @@
+/*
+Copyright (C) 2006  Adam Charrett
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+
+sectioncache.h
+
+Cache of the PSI/SI sections already seen on a PID, used to drop repeats.
+
+*/
+
+#ifndef _DVBSTREAMER_SECTIONCACHE_H
+#define _DVBSTREAMER_SECTIONCACHE_H
+
+#include <stdint.h>
+#include "types.h"
+#include "dvbpsi/dvbpsi.h"
+#include "dvbpsi/psi.h"
+
+/**
+ * @defgroup SectionCache Section Cache
+ * Remembers the version and CRC_32 last seen for each (table_id, extension,
+ * section_number) on a PID so byte-identical repeats can be dropped before
+ * they are cloned for every filter and decoded again.
+ *
+ * The cache is an open addressing hash with linear probing. It starts small,
+ * doubles whenever it becomes half full and stops growing at
+ * SECTIONCACHE_MAX_SIZE entries, after which a new section replaces the entry
+ * it hashes to when that is in use and is otherwise passed on uncached. An EIT PID carrying a week of schedule for a whole multiplex
+ * therefore fits, while PIDs carrying a handful of sections only use a few
+ * hundred bytes.
+ *@{
+ */
+
+/**
+ * Number of entries allocated when the first section is cached, a power of 2.
+ */
+#define SECTIONCACHE_INITIAL_SIZE 64
+
+/**
+ * Largest number of entries the cache grows to, a power of 2.
+ */
+#define SECTIONCACHE_MAX_SIZE (256 * 1024)
+
+/**
+ * Last version/CRC seen for a (table_id, extension, section_number).
+ */
+typedef struct SectionCacheEntry_t
+{
+    uint32_t key;           /**< table_id << 24 | extension << 8 | section_number. */
+    uint32_t crc;           /**< CRC_32 of the section. */
+    uint8_t version;        /**< Version number. */
+    bool valid;             /**< Whether this entry is in use. */
+}SectionCacheEntry_t;
+
+/**
+ * Structure holding the state of a section cache.
+ */
+typedef struct SectionCache_t
+{
+    SectionCacheEntry_t *entries;       /**< Hash of the sections seen, NULL until the first one. */
+    unsigned int bits;                  /**< log2 of the number of entries. */
+    unsigned int count;                 /**< Number of entries in use. */
+    unsigned int maxSize;               /**< Largest number of entries to grow to. */
+    unsigned long long hits;            /**< Number of repeated sections dropped. */
+    unsigned long long misses;          /**< Number of sections passed on. */
+    unsigned long long flushes;         /**< Number of times the cache has been invalidated. */
+    unsigned long long replaced;        /**< Number of entries replaced once the cache stopped growing. */
+}SectionCache_t;
+
+/**
+ * Initialise a cache, no memory is allocated until the first section arrives.
+ * @param cache The cache to initialise.
+ * @param maxSize Largest number of entries the cache may grow to, a power of 2.
+ */
+void SectionCacheInit(SectionCache_t *cache, unsigned int maxSize);
+
+/**
+ * Release the memory used by a cache.
+ * @param cache The cache to release.
+ */
+void SectionCacheDeinit(SectionCache_t *cache);
+
+/**
+ * Check whether a section should be passed on and remember it if so.
+ * Sections without the long header and DSM-CC sections are always passed on.
+ * @param cache The cache to check.
+ * @param section The section to check.
+ * @return TRUE if the section should be passed on, FALSE if it is an exact
+ *         repeat of a section that has already been passed on.
+ */
+bool SectionCacheCheck(SectionCache_t *cache, dvbpsi_psi_section_t *section);
+
+/**
+ * Forget all the sections seen, the memory is kept for reuse.
+ * @param cache The cache to flush.
+ */
+void SectionCacheFlush(SectionCache_t *cache);
+
+/** @} */
+#endif
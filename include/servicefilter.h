@@ -79,6 +79,13 @@ void ServiceFilterDestroyAll(TSReader_t *reader);
 
 char *ServiceFilterNameGet(ServiceFilter_t filter);
 
+/**
+ * Get the TS Reader the specified service filter is attached to.
+ * @param filter The service filter to interrogate.
+ * @return The TSReader_t the service filter is processing packets from.
+ */
+TSReader_t *ServiceFilterTSReaderGet(ServiceFilter_t filter);
+
 /**
  * Set the service filtered by the specified service filter.
  * @param filter The service filter to set the service being filtered on or 
@@ -30,6 +30,10 @@ Transport stream processing and filter management.
 #include "dvbpsi/dvbpsi.h"
 #include "types.h"
 #include "dvbadapter.h"
+#include "tsframer.h"
+#include "tsmonitor.h"
+#include "sectioncache.h"
+#include "ringbuffer.h"
 #include "services.h"
 #include "multiplexes.h"
 #include "list.h"
@@ -126,6 +130,14 @@ TSPacket_t;
 #define TSPACKET_SETPRIORITY(packet, priority) \
     ((packet).header[1] = ((packet).header[1] & 0xdf) | (((priority) << 4) & 0x20))
 
+/**
+ * Boolean test to determine whether the payload of the packet is scrambled.
+ * @param packet The packet to check.
+ * @return True if the transport_scrambling_control field is not 0.
+ */
+#define TSPACKET_ISSCRAMBLED(packet) \
+    (((packet).header[3] & 0xc0) != 0)
+
 /**
  * Retrieve whether the packet has an adaptation field.
  * @param packet The packet to check.
@@ -150,6 +162,42 @@ TSPacket_t;
 #define TSPACKET_GETADAPTATION_LEN(packet) \
     ((packet).payload[0])
 
+/**
+ * Frequency of the Program Clock Reference (27MHz).
+ */
+#define TSPACKET_PCR_HZ 27000000
+
+/**
+ * Boolean test to determine whether the packet carries a PCR.
+ * @param packet The packet to check.
+ * @return True if the adaptation field contains a PCR.
+ */
+#define TSPACKET_HASPCR(packet) \
+    ((TSPACKET_GETADAPTATION(packet) & 0x2) && \
+     (TSPACKET_GETADAPTATION_LEN(packet) >= 7) && \
+     ((packet).payload[1] & 0x10))
+
+/**
+ * Boolean test to determine whether the discontinuity indicator is set.
+ * @param packet The packet to check.
+ * @return True if the adaptation field has the discontinuity indicator set.
+ */
+#define TSPACKET_ISDISCONTINUITY(packet) \
+    ((TSPACKET_GETADAPTATION(packet) & 0x2) && \
+     (TSPACKET_GETADAPTATION_LEN(packet) >= 1) && \
+     ((packet).payload[1] & 0x80))
+
+/**
+ * Retrieves the PCR from the packet, only valid if TSPACKET_HASPCR is true.
+ * @param packet The packet to extract the PCR from.
+ * @return The PCR as a 64bit integer in units of 1/TSPACKET_PCR_HZ seconds.
+ */
+#define TSPACKET_GETPCR(packet) \
+    (((((uint64_t)(packet).payload[2] << 25) | ((packet).payload[3] << 17) | \
+       ((packet).payload[4] << 9) | ((packet).payload[5] << 1) | \
+       ((packet).payload[6] >> 7)) * 300) + \
+     ((((packet).payload[6] & 0x01) << 8) | (packet).payload[7]))
+
 
 /**@}*/
 
@@ -160,9 +208,38 @@ TSPacket_t;
  * @{
  */
  /**
- * Maximum number of packets to read from the DVB adapter in one go,
+ * Default size (in bytes) of the input buffer packets are read into from the
+ * DVB adapter, also used to size the adapter's DVR buffer.
  */
-#define TSREADER_MAX_PACKETS 20
+#define TSREADER_DEFAULT_BUFFER_SIZE (4 * 1024 * 1024)
+
+/**
+ * Minimum size (in bytes) of the input buffer.
+ */
+#define TSREADER_MIN_BUFFER_SIZE (256 * 1024)
+
+/**
+ * Maximum size (in bytes) of the input buffer.
+ */
+#define TSREADER_MAX_BUFFER_SIZE (256 * 1024 * 1024)
+
+/**
+ * Number of slots the input buffer is split into to form the ring between the
+ * reader thread and the processing thread (must be a power of 2). An extra
+ * slot is reserved for reading into when the ring is full.
+ */
+#define TSREADER_RING_SLOTS 32
+
+/**
+ * Maximum number of worker threads filter groups can be spread across.
+ */
+#define TSREADER_MAX_WORKERS 16
+
+/**
+ * Maximum number of packets collected for a batch packet filter before the
+ * batch is delivered.
+ */
+#define TSREADER_BATCH_MAX_PACKETS 256
 
 typedef enum TSFilterEventType_e
 {
@@ -175,6 +252,94 @@ struct TSFilterGroup_t;
 typedef void (*TSFilterGroupEventCallback_t)(void *userArg, struct TSFilterGroup_t *group, TSFilterEventType_e event, void *details);
 
 typedef void (*TSPacketFilterCallback_t)(void *userArg, struct TSFilterGroup_t *group, TSPacket_t *packet);
+
+/**
+ * Callback used to deliver a batch of packets to a filter group.
+ * The packets are only valid for the duration of the call.
+ * @param userArg The user argument supplied when the filter was added.
+ * @param group The filter group the filter belongs to.
+ * @param packets Array of pointers to the packets, in the order they were received.
+ * @param count The number of packets in the array.
+ */
+typedef void (*TSPacketBatchFilterCallback_t)(void *userArg, struct TSFilterGroup_t *group, TSPacket_t **packets, int count);
+
+/**
+ * Collection of packets waiting to be delivered to a batch packet filter.
+ * Shared by all the batch filters in a group with the same callback and user
+ * argument.
+ */
+typedef struct TSPacketBatch_t
+{
+    TSPacketBatchFilterCallback_t callback; /**< Function to deliver the batch to. */
+    void *userArg;                          /**< User argument to pass to the callback. */
+    struct TSFilterGroup_t *group;          /**< Group the batch belongs to. */
+    int filterCount;                        /**< Number of packet filters sharing this batch. */
+    bool pending;                           /**< Whether this batch is on the reader's pending list. */
+    struct TSPacketBatch_t *pendingNext;    /**< Next batch on the reader's pending list. */
+    int count;                              /**< Number of packets collected. */
+    TSPacket_t *packets[TSREADER_BATCH_MAX_PACKETS]; /**< The packets collected. */
+}TSPacketBatch_t;
+
+/**
+ * Slot in the ring between the reader thread and the processing thread.
+ */
+typedef struct TSReaderRingSlot_t
+{
+    TSPacket_t *packets;    /**< Start of the slot in the input buffer. */
+    int count;              /**< Number of packets in the slot. */
+    ev_tstamp received;     /**< Time the packets were read from the adapter. */
+    int pending;            /**< Number of processors yet to finish with the slot. */
+}TSReaderRingSlot_t;
+
+/**
+ * Number of windows per PID packet rates are calculated over (1, 10 and 60
+ * seconds).
+ */
+#define TSREADER_PIDRATE_WINDOWS 3
+
+/**
+ * Number of one second samples of each PID's packet count that are kept,
+ * enough to cover the longest window.
+ */
+#define TSREADER_PIDRATE_HISTORY 61
+
+/**
+ * Per PID packet counters. Only the input dispatcher updates the counters and
+ * each PID has a cache line of its own, so counting a packet touches a single
+ * line and needs no locking.
+ */
+typedef struct TSPIDCounters_t
+{
+    volatile unsigned long long packets;   /**< Number of packets received. */
+    volatile unsigned long long ccErrors;  /**< Number of continuity counter errors. */
+    volatile unsigned long long scrambled; /**< Number of packets with a scrambled payload. */
+    volatile unsigned long long pcrs;      /**< Number of packets carrying a PCR. */
+    int lastCC;                            /**< Continuity counter of the last packet with a payload, -1 if none yet. */
+}__attribute__((aligned(RINGBUFFER_CACHELINE))) TSPIDCounters_t;
+
+/**
+ * Packet rates of a PID, calculated once a second from the PID's counters.
+ */
+typedef struct TSPIDRates_t
+{
+    volatile unsigned int rates[TSREADER_PIDRATE_WINDOWS]; /**< Packets per second over each window. */
+    unsigned int nrofSamples;           /**< Number of valid entries in history. */
+    unsigned int next;                  /**< Entry in history the next sample is stored in. */
+    unsigned int history[TSREADER_PIDRATE_HISTORY]; /**< Packet count (modulo 2^32) at each sample. */
+}TSPIDRates_t;
+
+/**
+ * Snapshot of the statistics of a PID, see TSReaderPIDStatsGet().
+ */
+typedef struct TSReaderPIDStats_t
+{
+    unsigned long long packets;         /**< Number of packets received. */
+    unsigned long long ccErrors;        /**< Number of continuity counter errors. */
+    unsigned long long scrambled;       /**< Number of packets with a scrambled payload. */
+    unsigned long long pcrs;            /**< Number of packets carrying a PCR. */
+    unsigned int rates[TSREADER_PIDRATE_WINDOWS]; /**< Packets per second over the last 1, 10 and 60 seconds. */
+}TSReaderPIDStats_t;
+
 typedef struct TSPacketFilter_t
 {
     uint16_t pid;
@@ -182,24 +347,74 @@ typedef struct TSPacketFilter_t
     TSPacketFilterCallback_t callback;
     void *userArg;
     struct TSFilterGroup_t *group;
+    TSPacketBatch_t *batch;             /**< Batch packets are collected in, NULL for per packet filters. */
     
     struct TSPacketFilter_t *next;
-
-    struct TSPacketFilter_t *flNext;
 }TSPacketFilter_t;
 
+/**
+ * Entry in a PID's packet dispatch list, a copy of the fields of a
+ * TSPacketFilter_t needed to deliver a packet.
+ */
+typedef struct TSPacketDispatchEntry_t
+{
+    TSPacketFilterCallback_t callback;  /**< Callback to invoke, NULL if the filter was removed while dispatching. */
+    void *userArg;                      /**< User argument to pass to the callback. */
+    struct TSFilterGroup_t *group;      /**< Group the filter belongs to, NULL for section filters. */
+    TSPacketFilter_t *filter;           /**< The filter this entry was created from. */
+}TSPacketDispatchEntry_t;
+
+/**
+ * Compact array of all the packet filters for a PID. Lists are never modified
+ * once published, instead a new list is built whenever a filter is added or
+ * removed and swapped in place of the old one.
+ */
+typedef struct TSPacketDispatchList_t
+{
+    int count;                                  /**< Number of entries. */
+    struct TSPacketDispatchList_t *retiredNext; /**< Next list waiting to be freed once dispatching has finished. */
+    TSPacketDispatchEntry_t entries[];          /**< The entries, in dispatch order. */
+}TSPacketDispatchList_t;
+
+/**
+ * Number of bytes at the start of a section a section filter can match on.
+ */
+#define TSSECTIONMATCH_SIZE 8
+
+/**
+ * Match/mask applied to the start of each section before it is reassembled,
+ * laid out like dmx_sct_filter_params in the Linux DVB API. Byte 0 is the
+ * table_id and byte n (n > 0) is byte n + 2 of the section, skipping the
+ * section_length, so bytes 1-2 are the table_id_extension, byte 3 holds the
+ * version_number/current_next_indicator and byte 4 is the section_number.
+ *
+ * Bits set in mask but not in mode must be the same as in filter. Bits set in
+ * both mask and mode are a negative match, at least one of them must differ
+ * from filter (for example to only get sections with a new version).
+ */
+typedef struct TSSectionMatch_t
+{
+    uint8_t filter[TSSECTIONMATCH_SIZE]; /**< Values to match. */
+    uint8_t mask[TSSECTIONMATCH_SIZE];   /**< Bits of filter to compare. */
+    uint8_t mode[TSSECTIONMATCH_SIZE];   /**< Masked bits that must differ. */
+}TSSectionMatch_t;
+
 typedef struct TSSectionFilter_t
 {
     uint16_t pid;
     int priority;
     dvbpsi_handle sectionHandle;
     struct TSFilterGroup_t *group;
+    TSSectionMatch_t match;     /**< Sections to pass to sectionHandle. */
+    int matchDepth;             /**< Number of bytes of match used, 0 to pass every section. */
     
     struct TSSectionFilter_t *next;
 }TSSectionFilter_t;
 
 #define TSSectFilterListFlags_PAYLOAD_START     1
 #define TSSectFilterListFlags_PRIORITY_OVERRIDE 2
+#define TSSectFilterListFlags_CC_VALID          4
+#define TSSectFilterListFlags_CYCLE_DONE        8
 
 typedef struct TSSectionFilterList_t
 {
@@ -210,6 +425,22 @@ typedef struct TSSectionFilterList_t
     dvbpsi_handle sectionHandle;
     TSPacketFilter_t *packetFilter;
     struct TSReader_t *tsReader;
+
+    int matchDepth;                     /**< Bytes of the section header checked before reassembly, 0 for none. */
+    unsigned long long filteredSections;/**< Number of sections skipped as no filter matched them. */
+
+    ev_tstamp acquireStart;             /**< When the list was created or the multiplex last changed. */
+    double firstSectionTime;            /**< Seconds from acquireStart to the first section, < 0 until one arrives. */
+    ev_tstamp waitingSince;             /**< When the list was last descheduled. */
+    ev_tstamp slotStart;                /**< When the list was last scheduled. */
+    ev_tstamp slotFirstTime;            /**< When the first section of the current slot arrived. */
+    uint32_t slotFirstKey;              /**< table_id/extension/section_number of the first section of the slot. */
+    unsigned int slotSections;          /**< Number of sections received in the current slot. */
+    double cycleTime;                   /**< Estimated time (seconds) for the sections on the PID to repeat, 0 if unknown. */
+    unsigned long long slots;           /**< Number of times the list has been scheduled. */
+
+    uint8_t lastCC;                     /**< Continuity counter of the last packet with a payload. */
+    SectionCache_t cache;               /**< Sections already passed on to the filters. */
 }TSSectionFilterList_t;
 
 typedef struct TSFilterGroup_t
@@ -227,8 +458,27 @@ typedef struct TSFilterGroup_t
     volatile unsigned long long packetsProcessed;
     volatile unsigned long long sectionsProcessed;
 
+    int processor;                         /**< Index of the processor this group's packet filters are run on. */
 }TSFilterGroup_t;
 
+/**
+ * A thread taking packets from the ring and passing them to filters. Processor
+ * 0 is the input dispatcher thread which runs the section filters and any
+ * filter groups not assigned to a worker thread.
+ */
+typedef struct TSReaderProcessor_t
+{
+    struct TSReader_t *reader;          /**< The reader this processor belongs to. */
+    int index;                          /**< Index of this processor, 0 for the input dispatcher. */
+    pthread_t thread;                   /**< Thread running this processor. */
+    bool quit;                          /**< Whether the worker thread should finish. */
+    bool active;                        /**< Whether a ring slot is currently being processed. */
+    unsigned int sequence;              /**< Ring sequence number of the next slot to process. */
+    uint16_t currentlyProcessingPid;    /**< PID whose dispatch list is currently being processed. */
+    TSPacketDispatchList_t *dispatching;/**< Dispatch list currently being processed. */
+    TSPacketBatch_t *pendingBatches;    /**< Batches with packets waiting to be delivered. */
+}TSReaderProcessor_t;
+
 #define TSREADER_PID_ALL 8192
 #define TSREADER_NROF_FILTERS 8193
 #define TSREADER_PIDFILTER_BUCKETS 8
@@ -238,8 +488,9 @@ typedef struct TSFilterGroup_t
  */
 typedef struct TSReader_t
 {
-    bool quit;                          /**< Whether the filters thread should finish. */
+    bool quit;                          /**< Whether the reader thread should finish. */
     DVBAdapter_t *adapter;              /**< DVBAdapter packets should be read from */
+    char propertyPath[16];              /**< Where properties are registered, "tsreader" or "tsreader<adapter index>". */
     bool enabled;                       /**< Whether packets should be read/processed */
     pthread_mutex_t mutex;              /**< Mutex used to protect access to this structure */
     bool multiplexChanged;              /**< Whether the multiplex has been changed. */
@@ -251,23 +502,79 @@ typedef struct TSReader_t
 
     bool promiscuousMode;               /**< Whether no filtering is applied at the adapter level all packets are available to PID filters. */
     List_t *groups;                     /**< List of TS Filter groups. */
-    uint16_t currentlyProcessingPid;
 
-    TSPacketFilter_t *packetFilters[TSREADER_NROF_FILTERS];
+    TSPacketDispatchList_t *packetDispatch[TSREADER_NROF_FILTERS]; /**< Per PID dispatch lists, NULL if there are no filters on a PID. */
+    TSPacketDispatchList_t *retiredDispatch;  /**< Dispatch lists replaced while being processed. */
+    bool rescheduleSectionFilters;      /**< Whether section filters should be scheduled once dispatching has finished. */
+
+    TSReaderProcessor_t processors[TSREADER_MAX_WORKERS + 1]; /**< Event loop thread (0) and worker threads. */
+    int nrofWorkers;                    /**< Number of worker threads running. */
+    unsigned int nextWorker;            /**< Used to assign filter groups to workers in turn. */
+    pthread_mutex_t processingMutex;    /**< Protects the processor state below. */
+    pthread_cond_t processingCond;      /**< Signalled when slots are available/processed or processing may resume. */
+    int activeProcessors;               /**< Number of processors currently processing a slot. */
+    bool stopProcessing;                /**< Whether processors should wait before starting a new slot. */
+    pthread_t lockOwner;                /**< Thread holding the reader lock. */
+    int lockDepth;                      /**< Number of times the lock owner has locked the reader. */
 
     List_t *sectionFilters;             /**< List of section filters that are awaiting scheduling */
     List_t *activeSectionFilters;       /**< List of active section filters. */
+    int sectionMaxDwell;                /**< Longest time (ms) a section filter is scheduled for while others are waiting. */
+    ev_timer sectionScheduleWatcher;    /**< Time slices section filters when there aren't enough PID filters. */
+
+    pthread_t readerThread;             /**< Thread reading packets from the adapter into the ring. */
+    bool readerRunning;                 /**< Whether the reader thread has been started. */
+    RingBuffer_t ring;                  /**< Ring of slots waiting to be processed. */
+    TSReaderRingSlot_t ringSlots[TSREADER_RING_SLOTS]; /**< Packets in each slot of the ring. */
+    unsigned int ringSlotSize;          /**< Size of each ring slot in bytes. */
+    unsigned int ringDrops;             /**< Number of packets dropped because the ring was full. */
+    unsigned int ringLatency;           /**< Average time (in microseconds) between reading packets and processing them. */
+    unsigned int ringLatencyMax;        /**< Maximum time (in microseconds) between reading packets and processing them. */
+    ev_async ringWatcher;
+
+    struct ev_loop *loop;               /**< Event loop processor 0 and the timers below run on. */
+    pthread_t loopThread;               /**< Thread running loop when it is not the input dispatcher's. */
+    bool loopRunning;                   /**< Whether loopThread has been started. */
+    ev_async loopExitWatcher;           /**< Used to stop loopThread. */
 
-    ev_io dvrWatcher;
     ev_timer bitrateWatcher;
     ev_async notificationWatcher;
     
     unsigned long long prevTotalPackets;
     ev_tstamp prevTime;
-    TSPacket_t buffer[TSREADER_MAX_PACKETS];
+
+    int pidStatsUsers;                  /**< Number of users that have enabled per PID statistics. */
+    bool pidStatsReset;                 /**< Whether per PID statistics should be zeroed at the next sample. */
+    TSPIDCounters_t *pidCounters;       /**< Per PID counters, NULL until per PID statistics are first enabled. */
+    TSPIDRates_t **pidRates;            /**< Per PID rates, entries are NULL until the PID carries a packet. */
+
+    uint8_t *buffer;                    /**< Input buffer packets are read into from the adapter. */
+    unsigned int bufferSize;            /**< Usable size of the input buffer in bytes. */
+    size_t bufferAllocSize;             /**< Size of the mapping backing the input buffer. */
+    bool bufferHugePages;               /**< Whether the input buffer is backed by huge pages. */
+    unsigned int bufferOverflows;       /**< Number of times the adapter reported its DVR buffer overflowed. */
+    unsigned int shortReads;            /**< Number of batches that ended with a partial packet. */
+    TSFramer_t framer;                  /**< Locates packets in the data read from the adapter. */
+
+    TSMonitor_t monitor;                /**< Checks the health of the transport stream. */
+    bool monitorEnabled;                /**< Whether packets are passed to the monitor. */
+    bool monitorReset;                  /**< Whether the monitor should be reset before it next checks packets. */
 }
 TSReader_t;
 
+/**
+ * Payload of the TSMonitor events, fired at most once a second for each
+ * indicator (and PID for continuity errors) with new errors.
+ */
+typedef struct TSMonitorEvent_t
+{
+    TSReader_t *reader;                 /**< Reader the errors were found by. */
+    TSMonitorIndicator_e indicator;     /**< Indicator the errors are for. */
+    uint16_t pid;                       /**< PID of the (last) error, TSREADER_PID_ALL if not specific to a PID. */
+    unsigned int count;                 /**< Number of errors in the last second. */
+    unsigned int total;                 /**< Number of errors since the statistics were zeroed. */
+}TSMonitorEvent_t;
+
 typedef struct TSFilterGroupStats_t
 {
     char *name;
@@ -334,24 +641,76 @@ void TSReaderZeroStats(TSReader_t *reader);
 void TSReaderMultiplexChanged(TSReader_t *reader, Multiplex_t *newmultiplex);
 
 /**
- * Lock access to the TSReader_t structure to this thread.
+ * Lock access to the TSReader_t structure to this thread. The input dispatcher
+ * and any worker threads are paused at the end of the ring slot they are
+ * processing until the reader is unlocked. The lock may be taken recursively.
  * @param reader The instance to lock access to.
  */
-#define TSReaderLock(reader)   pthread_mutex_lock(&(reader)->mutex)
+void TSReaderLock(TSReader_t *reader);
 
 /**
  * Unlock access to the TSReader_t structure.
  * @param reader The instance to unlock access to.
  */
-#define TSReaderUnLock(reader) pthread_mutex_unlock(&(reader)->mutex)
+void TSReaderUnLock(TSReader_t *reader);
+
+/**
+ * Enable/Disable per PID statistics (packets, continuity errors, scrambled
+ * packets, PCRs and packet rates). Statistics are only collected while at least
+ * one user has enabled them.
+ * @param reader The instance to enable/disable statistics on.
+ * @param enable TRUE to enable, FALSE to release a previous enable.
+ */
+void TSReaderPIDStatsEnable(TSReader_t *reader, bool enable);
+
+/**
+ * Retrieve the statistics for a PID.
+ * @param reader The instance to retrieve the statistics from.
+ * @param pid The PID to retrieve the statistics of.
+ * @param stats Structure to fill in.
+ * @return TRUE if the PID has carried packets since the statistics were last
+ *         zeroed, FALSE otherwise (or if statistics are not enabled).
+ */
+bool TSReaderPIDStatsGet(TSReader_t *reader, uint16_t pid, TSReaderPIDStats_t *stats);
 
 TSFilterGroup_t* TSReaderCreateFilterGroup(TSReader_t *reader, const char *name, const char *type, TSFilterGroupEventCallback_t callback, void *userArg );
 TSFilterGroup_t* TSReaderFindFilterGroup(TSReader_t *reader, const char *name, const char *type);
 void TSFilterGroupDestroy(TSFilterGroup_t* group);
 void TSFilterGroupRemoveAllFilters(TSFilterGroup_t* group);
 void TSFilterGroupAddSectionFilter(TSFilterGroup_t *group, uint16_t pid, int priority, dvbpsi_handle handle);
+
+/**
+ * Add a section filter that only receives sections whose first bytes match
+ * match. The check is done as soon as the start of a section has been
+ * received, sections that no filter on the PID wants are skipped without
+ * being reassembled or CRC checked.
+ * Filters are removed using TSFilterGroupRemoveSectionFilter().
+ * @param group The group to add the filter to.
+ * @param pid The PID to filter.
+ * @param priority Priority of the filter, lower values are scheduled first.
+ * @param handle Section handle to push matching sections to.
+ * @param match Sections to pass on, NULL for all sections.
+ */
+void TSFilterGroupAddSectionFilterMatch(TSFilterGroup_t *group, uint16_t pid, int priority, dvbpsi_handle handle, const TSSectionMatch_t *match);
 void TSFilterGroupRemoveSectionFilter(TSFilterGroup_t *group, uint16_t pid);
 bool TSFilterGroupAddPacketFilter(TSFilterGroup_t *group, uint16_t pid, TSPacketFilterCallback_t callback, void *userArg);
+
+/**
+ * Add a packet filter that receives packets in batches rather than one at a
+ * time. Packets matching the PID are collected while a block of data read
+ * from the adapter is processed and delivered together once processing of the
+ * block has finished (or the batch is full).
+ * All batch filters in a group with the same callback and user argument share
+ * a single batch, so the callback receives the packets for the whole set of
+ * PIDs in the order they appeared in the transport stream.
+ * Batch filters are removed using TSFilterGroupRemovePacketFilter().
+ * @param group The group to add the filter to.
+ * @param pid The PID to filter.
+ * @param callback Function to call with each batch of packets.
+ * @param userArg User argument to pass to the callback.
+ * @return TRUE if the filter was added, FALSE otherwise.
+ */
+bool TSFilterGroupAddPacketBatchFilter(TSFilterGroup_t *group, uint16_t pid, TSPacketBatchFilterCallback_t callback, void *userArg);
 void TSFilterGroupRemovePacketFilter(TSFilterGroup_t *group, uint16_t pid);
 
 /**@}*/
@@ -0,0 +1,123 @@
+/*
+Copyright (C) 2006  Adam Charrett
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+
+tsframer.h
+
+Transport stream packet framing/resynchronisation of a byte stream.
+
+*/
+
+#ifndef _DVBSTREAMER_TSFRAMER_H
+#define _DVBSTREAMER_TSFRAMER_H
+
+#include <stdint.h>
+#include "types.h"
+
+/**
+ * @defgroup TSFramer Transport Stream Framer
+ * The framer takes an arbitrary byte stream and locates the transport stream
+ * packets within it, carrying incomplete packets over between calls.
+ * Plain 188 byte packets, 192 byte M2TS packets (4 byte timestamp prefix) and
+ * 204 byte packets (16 bytes of Reed-Solomon parity) are supported.
+ *@{
+ */
+
+/**
+ * Sync byte that starts every transport stream packet.
+ */
+#define TSFRAMER_SYNC_BYTE 0x47
+
+/**
+ * Number of consecutive sync bytes at the same spacing required before the
+ * framer will lock on to a stream.
+ */
+#define TSFRAMER_SYNC_CONFIRM 5
+
+/**
+ * Largest packet size supported by the framer.
+ */
+#define TSFRAMER_MAX_PACKET_SIZE 204
+
+/**
+ * Maximum number of bytes that may be carried over from one call of
+ * TSFramerFrame to the next. Callers must leave at least this much space at
+ * the start of their buffer for TSFramerCarryOver.
+ */
+#define TSFRAMER_MAX_CARRY (TSFRAMER_SYNC_CONFIRM * TSFRAMER_MAX_PACKET_SIZE)
+
+/**
+ * Structure holding the state of a framer.
+ */
+typedef struct TSFramer_t
+{
+    bool locked;                /**< Whether the framer has found the packet boundaries. */
+    unsigned int packetSize;    /**< Size of packets in the stream (188, 192 or 204), 0 when not locked. */
+    unsigned int carryLength;   /**< Number of bytes waiting to be prepended to the next buffer. */
+    unsigned int skip;          /**< Number of bytes at the start of the next buffer before its first packet. */
+    uint8_t carry[TSFRAMER_MAX_CARRY]; /**< Bytes carried over from the previous buffer. */
+
+    unsigned int syncLosses;    /**< Number of times the framer has lost lock. */
+    unsigned int bytesDiscarded;/**< Number of bytes thrown away while hunting for sync. */
+}TSFramer_t;
+
+/**
+ * Reset the framer, any carried over bytes are discarded and the framer will
+ * hunt for sync again. Statistics are preserved.
+ * @param framer The framer to reset.
+ */
+void TSFramerReset(TSFramer_t *framer);
+
+/**
+ * Copy any bytes carried over from the previous call to TSFramerFrame to the
+ * start of buffer. New data should then be appended after the returned number
+ * of bytes and the combined buffer passed to TSFramerFrame.
+ * @param framer The framer to retrieve the carried over bytes from.
+ * @param buffer Buffer to copy the bytes to, must be at least TSFRAMER_MAX_CARRY bytes.
+ * @return The number of bytes copied to buffer.
+ */
+unsigned int TSFramerCarryOver(TSFramer_t *framer, uint8_t *buffer);
+
+/**
+ * Locate the transport stream packets in buffer. On return the start of buffer
+ * contains the located packets stripped of any timestamp/parity bytes as
+ * contiguous 188 byte packets. Any trailing incomplete packet is retained by
+ * the framer for the next call.
+ * @param framer The framer to use.
+ * @param buffer The buffer containing the data to frame, modified in place.
+ * @param length The number of bytes in buffer.
+ * @return The number of 188 byte packets at the start of buffer.
+ */
+int TSFramerFrame(TSFramer_t *framer, uint8_t *buffer, unsigned int length);
+
+/**
+ * Search buffer for the start of a run of transport stream packets without
+ * modifying it, for callers that have the whole stream available (ie a memory
+ * mapped file) and so do not need the framer to carry bytes over.
+ * @param buffer The data to search.
+ * @param length The number of bytes in buffer.
+ * @param packetSize Used to return the size of the packets found (188, 192 or
+ *                   204) or 0 if no packets were found.
+ * @param needMore Set to TRUE if the search stopped at a possible packet
+ *                 start that could not be confirmed as buffer is too short.
+ * @return The offset of the first packet if packetSize is non-zero, otherwise
+ *         the offset at which the search stopped.
+ */
+unsigned int TSFramerFindSync(const uint8_t *buffer, unsigned int length, unsigned int *packetSize, bool *needMore);
+
+/** @} */
+#endif
+
@@ -0,0 +1,191 @@
+/*
+Copyright (C) 2006  Adam Charrett
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+
+tsmonitor.h
+
+Transport stream health monitoring (ETSI TR 101 290 priority 1 and 2 checks).
+
+*/
+
+#ifndef _DVBSTREAMER_TSMONITOR_H
+#define _DVBSTREAMER_TSMONITOR_H
+
+#include <stdint.h>
+#include "types.h"
+#include "dvbpsi/dvbpsi.h"
+
+/**
+ * @defgroup TSMonitor Transport Stream Monitor
+ * The monitor checks every packet of a transport stream for the following
+ * ETSI TR 101 290 indicators:
+ * - 1.1 TS_sync_loss (counted by the framer, passed in when sampling)
+ * - 1.3 PAT_error (PAT not repeated every 0.5s, wrong table_id or scrambled)
+ * - 1.4 Continuity_count_error (per PID)
+ * - 1.5 PMT_error (PMT not repeated every 0.5s or scrambled)
+ * - 2.1 Transport_error (transport_error_indicator set)
+ * - 2.3 PCR_repetition_error and PCR_discontinuity_indicator_error
+ * - 2.4 PCR_accuracy_error, only when every packet of the mux is seen.
+ *
+ * Packets are checked in batches on a single thread, errors are only counted
+ * there. TSMonitorSample() reports new errors and is expected to be called
+ * about once a second.
+ *@{
+ */
+
+/**
+ * Longest interval (in seconds) allowed between sections of a PAT or PMT.
+ */
+#define TSMONITOR_PSI_INTERVAL 0.5
+
+/**
+ * Longest interval (in seconds) allowed between PCRs on a PID.
+ */
+#define TSMONITOR_PCR_INTERVAL 0.04
+
+/**
+ * Largest jump (in seconds) between PCRs that is not a discontinuity.
+ */
+#define TSMONITOR_PCR_DISCONTINUITY 0.1
+
+/**
+ * Largest deviation (in nanoseconds) of a PCR from the value expected from its
+ * position in the stream.
+ */
+#define TSMONITOR_PCR_ACCURACY 500
+
+/**
+ * Maximum number of PMT PIDs the monitor checks.
+ */
+#define TSMONITOR_MAX_PMTS 256
+
+/**
+ * TR 101 290 indicators checked by the monitor.
+ */
+typedef enum TSMonitorIndicator_e
+{
+    TSMonitorIndicator_SyncLoss = 0,        /**< 1.1 TS_sync_loss */
+    TSMonitorIndicator_PAT,                 /**< 1.3 PAT_error */
+    TSMonitorIndicator_Continuity,          /**< 1.4 Continuity_count_error */
+    TSMonitorIndicator_PMT,                 /**< 1.5 PMT_error */
+    TSMonitorIndicator_Transport,           /**< 2.1 Transport_error */
+    TSMonitorIndicator_PCRRepetition,       /**< 2.3a PCR_repetition_error */
+    TSMonitorIndicator_PCRDiscontinuity,    /**< 2.3b PCR_discontinuity_indicator_error */
+    TSMonitorIndicator_PCRAccuracy,         /**< 2.4 PCR_accuracy_error */
+    TSMonitorIndicator_Count                /**< Number of indicators. */
+}TSMonitorIndicator_e;
+
+/**
+ * State kept for each PID, one cache line per PID.
+ */
+typedef struct TSMonitorPID_t
+{
+    uint64_t lastPCR;                   /**< Last PCR received. */
+    uint64_t lastPCRPacket;             /**< Packet index of the last PCR. */
+    uint64_t basePCR;                   /**< PCR the PCR rate is measured from. */
+    uint64_t basePCRPacket;             /**< Packet index of basePCR. */
+    double ticksPerPacket;              /**< PCR ticks per packet of the mux, 0 until measured. */
+    double lastTable;                   /**< Time the last PAT/PMT section started, 0 if none. */
+    unsigned int ccErrors;              /**< Number of continuity count errors. */
+    unsigned int ccReported;            /**< Value of ccErrors at the last sample. */
+    int8_t lastCC;                      /**< Continuity count of the last packet with a payload, -1 if none yet. */
+    uint8_t flags;                      /**< TSMONITOR_PID_ flags. */
+}__attribute__((aligned(64))) TSMonitorPID_t;
+
+/**
+ * Structure holding the state of a monitor.
+ */
+typedef struct TSMonitor_t
+{
+    TSMonitorPID_t *pids;               /**< State for each PID. */
+    unsigned long long packets;         /**< Number of packets checked, used as the position of a packet in the mux. */
+    double now;                         /**< Time the current batch of packets was received. */
+    bool fullTS;                        /**< Whether every packet of the mux is being checked. */
+    dvbpsi_handle patHandle;            /**< Decodes the PAT to find the PMT PIDs. */
+    int nrofPMTs;                       /**< Number of PIDs in pmtPIDs. */
+    uint16_t pmtPIDs[TSMONITOR_MAX_PMTS]; /**< PIDs carrying PMTs. */
+    unsigned int syncLosses;            /**< Sync losses reported by the framer at the last sample. */
+
+    volatile unsigned int errors[TSMonitorIndicator_Count]; /**< Number of errors of each indicator. */
+    unsigned int reported[TSMonitorIndicator_Count]; /**< Value of errors at the last sample. */
+    uint16_t errorPID[TSMonitorIndicator_Count];    /**< PID the last error of each indicator occurred on. */
+    unsigned int pcrJitterMax;          /**< Largest PCR deviation (in nanoseconds) since the last sample. */
+    volatile unsigned int pcrJitter;    /**< Largest PCR deviation (in nanoseconds) in the last sample period. */
+}TSMonitor_t;
+
+struct TSPacket_t;
+
+/**
+ * Callback used by TSMonitorSample() to report new errors.
+ * @param userArg The user argument passed to TSMonitorSample().
+ * @param indicator The indicator the errors are for.
+ * @param pid PID the errors occurred on, for continuity errors one call is made
+ *            for each PID, otherwise the PID of the most recent error (8192 if
+ *            the error is not specific to a PID).
+ * @param count Number of new errors.
+ */
+typedef void (*TSMonitorReport_t)(void *userArg, TSMonitorIndicator_e indicator, uint16_t pid, unsigned int count);
+
+/**
+ * Initialise a monitor.
+ * @param monitor The monitor to initialise.
+ * @return TRUE on success, FALSE if memory could not be allocated.
+ */
+bool TSMonitorInit(TSMonitor_t *monitor);
+
+/**
+ * Release the resources used by a monitor.
+ * @param monitor The monitor to release.
+ */
+void TSMonitorDeinit(TSMonitor_t *monitor);
+
+/**
+ * Forget everything known about the stream and zero the error counts, for
+ * example when the multiplex has changed.
+ * @param monitor The monitor to reset.
+ */
+void TSMonitorReset(TSMonitor_t *monitor);
+
+/**
+ * Check a batch of packets.
+ * @param monitor The monitor to use.
+ * @param packets The packets to check.
+ * @param count Number of packets.
+ * @param received Time (in seconds) the packets were received.
+ */
+void TSMonitorProcessPackets(TSMonitor_t *monitor, struct TSPacket_t *packets, int count, double received);
+
+/**
+ * Check for PATs/PMTs that have not been received in time and report all
+ * errors since the last sample. Must be called on the thread packets are
+ * checked on.
+ * @param monitor The monitor to sample.
+ * @param now The current time (in seconds).
+ * @param syncLosses Number of times sync has been lost with the stream.
+ * @param report Function to call for each indicator with new errors, may be NULL.
+ * @param userArg User argument to pass to report.
+ */
+void TSMonitorSample(TSMonitor_t *monitor, double now, unsigned int syncLosses, TSMonitorReport_t report, void *userArg);
+
+/**
+ * Retrieve the name of an indicator, for example "PATError".
+ * @param indicator The indicator to retrieve the name of.
+ * @return The name of the indicator.
+ */
+const char *TSMonitorIndicatorName(TSMonitorIndicator_e indicator);
+
+/** @} */
+#endif
@@ -120,5 +120,25 @@ Multiplex_t *TuningCurrentMultiplexGet(void);
  */
 void TuningCurrentMultiplexSet(Multiplex_t *multiplex);
 
+/**
+ * Tune a secondary adapter (index > 0) to the specified multiplex.
+ * The adapter's service cache is written back and reloaded for the new
+ * multiplex, PSI/SI is processed but changes are not announced via the
+ * Tuning.MultiplexChanged event.
+ * @param index Index of the adapter to tune.
+ * @param multiplex The multiplex to tune to.
+ * @return TRUE if the adapter was tuned, FALSE if the index is not a secondary
+ *         adapter or the frontend failed to tune.
+ */
+bool TuningAdapterMultiplexSet(int index, Multiplex_t *multiplex);
+
+/**
+ * Retrieve the multiplex an adapter is tuned to.
+ * @param index Index of the adapter, 0 being the primary adapter.
+ * @return The multiplex or NULL if the adapter has not been tuned.
+ * Multiplex should be released when no longer needed with a call to MultiplexRefDec.
+ */
+Multiplex_t *TuningAdapterMultiplexGet(int index);
+
 /** @} */
 #endif
@@ -22,7 +22,12 @@ Simplify UDP socket creation and packet sending.
 */
 #ifndef _UDP_H
 #define _UDP_H
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
 #include <netinet/in.h>
+#include "types.h"
 
 /**
  * @defgroup UDP UDP Socket functions
@@ -51,6 +56,93 @@ Simplify UDP socket creation and packet sending.
  */
 #define UDP_PAYLOAD_SIZE (MTU - (IP_HEADER + UDP_HEADER))
 
+/**
+ * Maximum number of datagrams the kernel will split a single UDP GSO send
+ * into.
+ */
+#define UDP_GSO_MAX_SEGMENTS 64
+
+/**
+ * Maximum number of bytes passed to the kernel in a single UDP GSO send, the
+ * whole lot has to fit in one (64KB) IP packet before it is split.
+ */
+#define UDP_GSO_MAX_BYTES 65000
+
+/**
+ * Queue of equal sized datagrams to a single destination that are sent with
+ * as few system calls as possible.
+ * Datagrams are built in place in a contiguous buffer and sent either with a
+ * single sendmsg() per UDP_GSO_MAX_SEGMENTS datagrams using UDP generic
+ * segmentation offload, or with sendmmsg() where GSO is not available.
+ */
+typedef struct UDPBatch_t
+{
+    int socket;                     /**< Socket to send the datagrams on. */
+    struct sockaddr *address;       /**< Address to send the datagrams to. */
+    socklen_t addressLen;           /**< Length of address. */
+    int datagramSize;               /**< Size of every datagram in bytes. */
+    int depth;                      /**< Number of datagrams that can be queued. */
+    int queued;                     /**< Number of complete datagrams waiting to be sent. */
+    int lastLength;                 /**< Length of the last queued datagram if shorter than datagramSize, 0 otherwise. */
+    bool gso;                       /**< Whether to use UDP generic segmentation offload. */
+    uint8_t *buffer;                /**< depth datagrams, one after the other. */
+    struct mmsghdr *msgs;           /**< One message per datagram for sendmmsg(). */
+    struct iovec *iovs;             /**< One iovec per datagram for sendmmsg(). */
+    unsigned long long datagrams;   /**< Number of datagrams sent. */
+    unsigned long long syscalls;    /**< Number of system calls used to send them. */
+    unsigned long long drops;       /**< Number of datagrams that could not be sent. */
+}UDPBatch_t;
+
+/**
+ * Initialise a datagram queue.
+ * @param batch The queue to initialise.
+ * @param socket Socket to send the datagrams on.
+ * @param address Address to send the datagrams to, must remain valid while the queue is in use.
+ * @param addressLen Length of address.
+ * @param datagramSize Size of every datagram in bytes.
+ * @param depth Number of datagrams to queue before they are sent, 1 to send each one as it is completed.
+ * @param gso Whether to try UDP generic segmentation offload, the queue falls
+ *            back to sendmmsg() if the kernel rejects it.
+ * @return TRUE on success, FALSE if memory could not be allocated.
+ */
+bool UDPBatchInit(UDPBatch_t *batch, int socket, struct sockaddr *address, socklen_t addressLen,
+                  int datagramSize, int depth, bool gso);
+
+/**
+ * Release the memory used by a datagram queue, any queued datagrams are discarded.
+ * @param batch The queue to release.
+ */
+void UDPBatchDeinit(UDPBatch_t *batch);
+
+/**
+ * Macro to retrieve the buffer the next datagram should be built in.
+ * @param _batch The queue.
+ */
+#define UDPBatchNext(_batch) \
+    ((_batch)->buffer + ((_batch)->queued * (_batch)->datagramSize))
+
+/**
+ * Add the datagram built in the buffer returned by UDPBatchNext() to the
+ * queue, sending the queue if it is now full.
+ * @param batch The queue.
+ */
+void UDPBatchCommit(UDPBatch_t *batch);
+
+/**
+ * Add a datagram shorter than the queue's datagram size, built in the buffer
+ * returned by UDPBatchNext(), to the queue and send the queue. Only the last
+ * datagram of a send may be short.
+ * @param batch The queue.
+ * @param length Length of the datagram in bytes.
+ */
+void UDPBatchCommitShort(UDPBatch_t *batch, int length);
+
+/**
+ * Send all queued datagrams.
+ * @param batch The queue to send.
+ */
+void UDPBatchFlush(UDPBatch_t *batch);
+
 /**
  * Creates a UDP socket for the given family.
  * The socket family is intended to be either PF_INET or PF_INET6.
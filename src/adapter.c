@@ -0,0 +1,297 @@
+/*
+Copyright (C) 2006  Adam Charrett
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+
+adapter.c
+
+Generic adapter functions, dispatches calls to the adapter implementations and
+keeps track of all the adapters open in this process.
+
+*/
+#include "config.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <yaml.h>
+
+#include "types.h"
+#include "dvbadapter.h"
+#include "logging.h"
+#include "events.h"
+#include "yamlutils.h"
+#include "adapter_private.h"
+
+/*******************************************************************************
+* Defines                                                                      *
+*******************************************************************************/
+#define COMMON(_adapter) ((DVBAdapterCommon_t *)(_adapter))
+
+/*******************************************************************************
+* Prototypes                                                                   *
+*******************************************************************************/
+static void DVBAdapterEventsInit(void);
+static int DVBEventToString(yaml_document_t *document, Event_t event, void *payload);
+
+/*******************************************************************************
+* Global variables                                                             *
+*******************************************************************************/
+Event_t DVBAdapterLockedEvent;
+Event_t DVBAdapterUnlockedEvent;
+Event_t DVBAdapterTuningFailedEvent;
+Event_t DVBAdapterFEActiveEvent;
+Event_t DVBAdapterFEIdleEvent;
+
+static const char ADAPTER[] = "Adapter";
+static EventSource_t dvbSource = NULL;
+static DVBAdapter_t *adapters[DVB_MAX_ADAPTERS];
+
+/*******************************************************************************
+* Global functions                                                             *
+*******************************************************************************/
+DVBAdapter_t *DVBInit(int adapter, bool hwRestricted, bool forceISDB)
+{
+    return DVBInitType(DVBAdapterType_Default, adapter, hwRestricted, forceISDB);
+}
+
+DVBAdapter_t *DVBInitType(DVBAdapterType_e type, int adapter, bool hwRestricted, bool forceISDB)
+{
+    DVBAdapterCommon_t common;
+    DVBAdapter_t *result;
+    int i;
+
+    if (type == DVBAdapterType_Default)
+    {
+#if defined(DVBADAPTER_DEFAULT_FILE)
+        type = DVBAdapterType_File;
+#else
+        type = DVBAdapterType_LinuxDVB;
+#endif
+    }
+
+    DVBAdapterEventsInit();
+
+    memset(&common, 0, sizeof(common));
+    common.ops = (type == DVBAdapterType_File) ? &FileAdapterOps : &LinuxDVBAdapterOps;
+    common.number = adapter;
+    common.index = -1;
+    for (i = 0; i < DVB_MAX_ADAPTERS; i ++)
+    {
+        if (adapters[i] == NULL)
+        {
+            common.index = i;
+            break;
+        }
+    }
+    if (common.index == -1)
+    {
+        LogModule(LOG_ERROR, ADAPTER, "Too many adapters open, maximum is %d\n", DVB_MAX_ADAPTERS);
+        return NULL;
+    }
+
+    if (common.index == 0)
+    {
+        strcpy(common.propertyPath, "adapter");
+    }
+    else
+    {
+        sprintf(common.propertyPath, "adapter%d", common.index);
+    }
+
+    result = common.ops->Init(&common, adapter, hwRestricted, forceISDB);
+    if (result)
+    {
+        adapters[common.index] = result;
+        LogModule(LOG_INFO, ADAPTER, "Opened %s adapter %d as index %d (properties %s)\n",
+            common.ops->name, adapter, common.index, common.propertyPath);
+    }
+    return result;
+}
+
+void DVBDispose(DVBAdapter_t *adapter)
+{
+    int index = COMMON(adapter)->index;
+    COMMON(adapter)->ops->Dispose(adapter);
+    adapters[index] = NULL;
+}
+
+bool DVBAdapterSpecParse(const char *spec, DVBAdapterType_e *type, int *adapter)
+{
+    const char *number = spec;
+    char *end;
+
+    *type = DVBAdapterType_Default;
+    if (strncmp(spec, "dvb:", 4) == 0)
+    {
+        *type = DVBAdapterType_LinuxDVB;
+        number = spec + 4;
+    }
+    else if (strncmp(spec, "file:", 5) == 0)
+    {
+        *type = DVBAdapterType_File;
+        number = spec + 5;
+    }
+
+    if (*number == 0)
+    {
+        return FALSE;
+    }
+    *adapter = (int)strtol(number, &end, 10);
+    return (*end == 0) && (*adapter >= 0);
+}
+
+int DVBAdapterIndexGet(DVBAdapter_t *adapter)
+{
+    return COMMON(adapter)->index;
+}
+
+int DVBAdapterNumberGet(DVBAdapter_t *adapter)
+{
+    return COMMON(adapter)->number;
+}
+
+char *DVBAdapterTypeNameGet(DVBAdapter_t *adapter)
+{
+    return COMMON(adapter)->ops->name;
+}
+
+DVBAdapter_t *DVBAdapterGet(int index)
+{
+    if ((index < 0) || (index >= DVB_MAX_ADAPTERS))
+    {
+        return NULL;
+    }
+    return adapters[index];
+}
+
+DVBSupportedDeliverySys_t *DVBFrontEndGetDeliverySystems(DVBAdapter_t *adapter)
+{
+    return COMMON(adapter)->ops->FrontEndGetDeliverySystems(adapter);
+}
+
+bool DVBFrontEndDeliverySystemSupported(DVBAdapter_t *adapter, DVBDeliverySystem_e system)
+{
+    return COMMON(adapter)->ops->FrontEndDeliverySystemSupported(adapter, system);
+}
+
+int DVBFrontEndTune(DVBAdapter_t *adapter, DVBDeliverySystem_e system, char *params)
+{
+    return COMMON(adapter)->ops->FrontEndTune(adapter, system, params);
+}
+
+char* DVBFrontEndParametersGet(DVBAdapter_t *adapter, DVBDeliverySystem_e *system)
+{
+    return COMMON(adapter)->ops->FrontEndParametersGet(adapter, system);
+}
+
+bool DVBFrontEndParameterSupported(DVBAdapter_t *adapter, DVBDeliverySystem_e system, char *param, char *value)
+{
+    return COMMON(adapter)->ops->FrontEndParameterSupported(adapter, system, param, value);
+}
+
+void DVBFrontEndLNBInfoSet(DVBAdapter_t *adapter, LNBInfo_t *lnbInfo)
+{
+    COMMON(adapter)->ops->FrontEndLNBInfoSet(adapter, lnbInfo);
+}
+
+void DVBFrontEndLNBInfoGet(DVBAdapter_t *adapter, LNBInfo_t *lnbInfo)
+{
+    COMMON(adapter)->ops->FrontEndLNBInfoGet(adapter, lnbInfo);
+}
+
+int DVBFrontEndStatus(DVBAdapter_t *adapter, DVBFrontEndStatus_e *status,
+                            unsigned int *ber, unsigned int *strength,
+                            unsigned int *snr, unsigned int *ucblocks)
+{
+    return COMMON(adapter)->ops->FrontEndStatus(adapter, status, ber, strength, snr, ucblocks);
+}
+
+bool DVBFrontEndIsLocked(DVBAdapter_t *adapter)
+{
+    return COMMON(adapter)->ops->FrontEndIsLocked(adapter);
+}
+
+int DVBFrontEndSetActive(DVBAdapter_t *adapter, bool active)
+{
+    return COMMON(adapter)->ops->FrontEndSetActive(adapter, active);
+}
+
+int DVBDemuxSetBufferSize(DVBAdapter_t *adapter, unsigned long size)
+{
+    return COMMON(adapter)->ops->DemuxSetBufferSize(adapter, size);
+}
+
+bool DVBDemuxIsHardwareRestricted(DVBAdapter_t *adapter)
+{
+    return COMMON(adapter)->ops->DemuxIsHardwareRestricted(adapter);
+}
+
+int DVBDemuxGetMaxFilters(DVBAdapter_t *adapter)
+{
+    return COMMON(adapter)->ops->DemuxGetMaxFilters(adapter);
+}
+
+int DVBDemuxGetAvailableFilters(DVBAdapter_t *adapter)
+{
+    return COMMON(adapter)->ops->DemuxGetAvailableFilters(adapter);
+}
+
+int DVBDemuxAllocateFilter(DVBAdapter_t *adapter, uint16_t pid)
+{
+    return COMMON(adapter)->ops->DemuxAllocateFilter(adapter, pid);
+}
+
+int DVBDemuxReleaseFilter(DVBAdapter_t *adapter, uint16_t pid)
+{
+    return COMMON(adapter)->ops->DemuxReleaseFilter(adapter, pid);
+}
+
+int DVBDemuxReleaseAllFilters(DVBAdapter_t *adapter)
+{
+    return COMMON(adapter)->ops->DemuxReleaseAllFilters(adapter);
+}
+
+int DVBDVRGetFD(DVBAdapter_t *adapter)
+{
+    return COMMON(adapter)->ops->DVRGetFD(adapter);
+}
+
+/*******************************************************************************
+* Local Functions                                                              *
+*******************************************************************************/
+static void DVBAdapterEventsInit(void)
+{
+    if (dvbSource == NULL)
+    {
+        dvbSource = EventsRegisterSource("DVBAdapter");
+        DVBAdapterLockedEvent = EventsRegisterEvent(dvbSource, "Locked", DVBEventToString);
+        DVBAdapterUnlockedEvent = EventsRegisterEvent(dvbSource, "Unlocked", DVBEventToString);
+        DVBAdapterTuningFailedEvent = EventsRegisterEvent(dvbSource, "TuneFailed", DVBEventToString);
+        DVBAdapterFEActiveEvent  = EventsRegisterEvent(dvbSource, "FrontEndActive", DVBEventToString);
+        DVBAdapterFEIdleEvent  = EventsRegisterEvent(dvbSource, "FrontEndIdle", DVBEventToString);
+    }
+}
+
+static int DVBEventToString(yaml_document_t *document, Event_t event, void *payload)
+{
+    DVBAdapterCommon_t *common = payload;
+    char adapterStr[12];
+    int mappingId = yaml_document_add_mapping(document, (yaml_char_t*)YAML_MAP_TAG, YAML_ANY_MAPPING_STYLE);
+    sprintf(adapterStr, "%d", common->number);
+    YamlUtils_MappingAdd(document, mappingId, "Adapter", adapterStr);
+    sprintf(adapterStr, "%d", common->index);
+    YamlUtils_MappingAdd(document, mappingId, "Index", adapterStr);
+    return mappingId;
+}
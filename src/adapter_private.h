@@ -0,0 +1,99 @@
+/*
+Copyright (C) 2006  Adam Charrett
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+
+adapter_private.h
+
+Interface between the generic adapter code and the adapter implementations.
+
+*/
+#ifndef _ADAPTER_PRIVATE_H
+#define _ADAPTER_PRIVATE_H
+
+#include "dvbadapter.h"
+#include "events.h"
+
+/*******************************************************************************
+* Defines                                                                      *
+*******************************************************************************/
+/**
+ * Maximum length of the property path of an adapter, ie "adapter15".
+ */
+#define DVBADAPTER_MAX_PROPERTY_PATH 16
+
+/*******************************************************************************
+* Typedefs                                                                     *
+*******************************************************************************/
+struct DVBAdapterCommon_s;
+
+/**
+ * Table of functions implementing an adapter type.
+ * See dvbadapter.h for a description of each function.
+ */
+typedef struct DVBAdapterOps_s
+{
+    char *name;
+    DVBAdapter_t *(*Init)(struct DVBAdapterCommon_s *common, int adapter, bool hwRestricted, bool forceISDB);
+    void (*Dispose)(DVBAdapter_t *adapter);
+    DVBSupportedDeliverySys_t *(*FrontEndGetDeliverySystems)(DVBAdapter_t *adapter);
+    bool (*FrontEndDeliverySystemSupported)(DVBAdapter_t *adapter, DVBDeliverySystem_e system);
+    int (*FrontEndTune)(DVBAdapter_t *adapter, DVBDeliverySystem_e system, char *params);
+    char *(*FrontEndParametersGet)(DVBAdapter_t *adapter, DVBDeliverySystem_e *system);
+    bool (*FrontEndParameterSupported)(DVBAdapter_t *adapter, DVBDeliverySystem_e system, char *param, char *value);
+    void (*FrontEndLNBInfoSet)(DVBAdapter_t *adapter, LNBInfo_t *lnbInfo);
+    void (*FrontEndLNBInfoGet)(DVBAdapter_t *adapter, LNBInfo_t *lnbInfo);
+    int (*FrontEndStatus)(DVBAdapter_t *adapter, DVBFrontEndStatus_e *status,
+                          unsigned int *ber, unsigned int *strength, unsigned int *snr, unsigned int *ucblocks);
+    bool (*FrontEndIsLocked)(DVBAdapter_t *adapter);
+    int (*FrontEndSetActive)(DVBAdapter_t *adapter, bool active);
+    int (*DemuxSetBufferSize)(DVBAdapter_t *adapter, unsigned long size);
+    bool (*DemuxIsHardwareRestricted)(DVBAdapter_t *adapter);
+    int (*DemuxGetMaxFilters)(DVBAdapter_t *adapter);
+    int (*DemuxGetAvailableFilters)(DVBAdapter_t *adapter);
+    int (*DemuxAllocateFilter)(DVBAdapter_t *adapter, uint16_t pid);
+    int (*DemuxReleaseFilter)(DVBAdapter_t *adapter, uint16_t pid);
+    int (*DemuxReleaseAllFilters)(DVBAdapter_t *adapter);
+    int (*DVRGetFD)(DVBAdapter_t *adapter);
+}DVBAdapterOps_t;
+
+/**
+ * State shared by all adapter types.
+ * Each implementation completes struct DVBAdapter_s privately and MUST make
+ * this structure its first field, the generic code only ever accesses an
+ * adapter through it.
+ */
+typedef struct DVBAdapterCommon_s
+{
+    DVBAdapterOps_t *ops;   /**< Functions implementing this adapter. */
+    int index;              /**< Position of the adapter in this process, 0 is the primary adapter. */
+    int number;             /**< Adapter number passed to DVBInit. */
+    char propertyPath[DVBADAPTER_MAX_PROPERTY_PATH]; /**< Where this adapter's properties are registered. */
+}DVBAdapterCommon_t;
+
+/*******************************************************************************
+* Global variables                                                             *
+*******************************************************************************/
+/* Events shared by all adapter types, payload is the adapter. */
+extern Event_t DVBAdapterLockedEvent;
+extern Event_t DVBAdapterUnlockedEvent;
+extern Event_t DVBAdapterTuningFailedEvent;
+extern Event_t DVBAdapterFEActiveEvent;
+extern Event_t DVBAdapterFEIdleEvent;
+
+extern DVBAdapterOps_t LinuxDVBAdapterOps;
+extern DVBAdapterOps_t FileAdapterOps;
+
+#endif
@@ -0,0 +1,818 @@
+/*
+Copyright (C) 2009  Adam Charrett
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+
+asyncoutput.c
+
+Delivery method that queues packets for another delivery method and outputs
+them on a separate thread.
+
+The calling thread copies packets into the slots of a single producer/single
+consumer ring buffer, a slot is only committed once it is full, before a block
+or header (to keep them in order) or at the end of an input batch if the
+writer is idle. This lets the writer hand large batches of packets to the
+wrapped delivery method when it falls behind.
+
+The writer swaps the buffer of each slot it takes with a spare one and releases
+the slot before outputting it. The only lock taken by both threads protects
+this against the producer dropping the oldest slot when the ring is full.
+Headers and header reservations are never dropped, when one is the oldest slot
+it is moved to a list the writer outputs before taking the next slot.
+
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "logging.h"
+#include "properties.h"
+#include "ringbuffer.h"
+#include "deliverymethod.h"
+#include "asyncoutput.h"
+
+/*******************************************************************************
+* Defines                                                                      *
+*******************************************************************************/
+#define SLOT_BYTES (ASYNCOUTPUT_SLOT_PACKETS * TSPACKET_SIZE)
+
+/* Smallest number of slots in the ring. */
+#define MIN_SLOTS 4
+
+/* Longest time (in milliseconds) the writer or a blocked producer waits
+ * before checking the ring again. */
+#define WAIT_TIMEOUT 100
+
+#define PROPERTIES_PARENT "sys.async"
+
+/*******************************************************************************
+* Typedefs                                                                     *
+*******************************************************************************/
+typedef enum AsyncRecord_e
+{
+    AsyncRecord_Packets = 0,    /* length bytes of packets. */
+    AsyncRecord_Block,          /* length bytes for OutputBlock. */
+    AsyncRecord_Header,         /* length bytes of packets for SetHeader. */
+    AsyncRecord_Reserve         /* length is the number of packets to reserve. */
+}AsyncRecord_e;
+
+typedef enum AsyncOverflow_e
+{
+    AsyncOverflow_DropOldest = 0,
+    AsyncOverflow_DropNewest,
+    AsyncOverflow_Block
+}AsyncOverflow_e;
+
+typedef struct AsyncSlot_t
+{
+    AsyncRecord_e type;
+    unsigned int length;
+    uint8_t *data;              /* SLOT_BYTES buffer. */
+    uint8_t *largeBlock;        /* Blocks/headers too big for data, NULL otherwise. */
+}AsyncSlot_t;
+
+typedef struct AsyncControl_t
+{
+    AsyncSlot_t slot;           /* Header or reservation, any data is in largeBlock. */
+    struct AsyncControl_t *next;
+}AsyncControl_t;
+
+typedef struct AsyncOutputState_t
+{
+    /* !!! MUST BE THE FIRST FIELD IN THE STRUCTURE !!!
+     * As the address of this field will be passed to all delivery method
+     * functions and a 0 offset is assumed!
+     */
+    DeliveryMethodInstance_t instance;
+    DeliveryMethodInstance_t *output;
+    AsyncOverflow_e overflow;
+    char propertyPath[PROPERTIES_PATH_MAX];
+
+    RingBuffer_t ring;
+    AsyncSlot_t *slots;
+    int fillSlot;               /* Slot packets are being added to, -1 if none. */
+    uint8_t *spare;             /* Buffer swapped with the slot being output. */
+    AsyncControl_t *controlHead; /* Records moved out of the ring to make room, */
+    AsyncControl_t *controlTail; /* protected by mutex. */
+
+    pthread_mutex_t producerMutex; /* Serialises callers of the instance. */
+    pthread_mutex_t mutex;      /* Protects taking the oldest slot and waiting. */
+    pthread_cond_t cond;
+    volatile bool writerWaiting;
+    volatile bool producerWaiting;
+    volatile bool quit;
+    pthread_t thread;
+
+    volatile unsigned int queued; /* Packets (and blocks) committed but not yet taken by the writer. */
+    unsigned int queuedPeak;
+    volatile unsigned int drops;
+    volatile unsigned int written;
+}AsyncOutputState_t;
+
+/*******************************************************************************
+* Prototypes                                                                   *
+*******************************************************************************/
+static bool AsyncOutputCanHandle(char *mrl);
+static DeliveryMethodInstance_t *AsyncOutputCreate(char *arg);
+static void AsyncOutputDestroy(DeliveryMethodInstance_t *this);
+static void AsyncOutputSendPacket(DeliveryMethodInstance_t *this, TSPacket_t *packet);
+static void AsyncOutputSendPackets(DeliveryMethodInstance_t *this, TSPacket_t **packets, int count);
+static void AsyncOutputSendBlock(DeliveryMethodInstance_t *this, void *block, unsigned long blockLen);
+static void AsyncOutputReserveHeaderSpace(DeliveryMethodInstance_t *this, int packets);
+static void AsyncOutputSetHeader(DeliveryMethodInstance_t *this, TSPacket_t *packets, int count);
+static void AsyncOutputFlush(DeliveryMethodInstance_t *this);
+
+static char *ParseOptions(char *mrl, unsigned int *queue, AsyncOverflow_e *overflow);
+static void AddRecord(AsyncOutputState_t *state, AsyncRecord_e type, void *data, unsigned int length);
+static int GetSlot(AsyncOutputState_t *state, AsyncOverflow_e overflow);
+static void CommitSlot(AsyncOutputState_t *state);
+static void DropOldestSlot(AsyncOutputState_t *state);
+static void KeepControl(AsyncOutputState_t *state, AsyncSlot_t *slot);
+static bool TakeRecord(AsyncOutputState_t *state, AsyncSlot_t *taken);
+static unsigned int SlotItems(AsyncSlot_t *slot);
+static void *WriterThread(void *arg);
+static void Wait(AsyncOutputState_t *state);
+static void FreeState(AsyncOutputState_t *state);
+
+/*******************************************************************************
+* Global variables                                                             *
+*******************************************************************************/
+static char ASYNCOUTPUT[] = "AsyncOutput";
+
+DeliveryMethodHandler_t AsyncOutputHandler = {
+    AsyncOutputCanHandle,
+    AsyncOutputCreate
+};
+
+static DeliveryMethodInstanceOps_t asyncInstanceOps = {
+    AsyncOutputSendPacket,
+    AsyncOutputSendBlock,
+    AsyncOutputDestroy,
+    AsyncOutputReserveHeaderSpace,
+    AsyncOutputSetHeader,
+    AsyncOutputSendPackets,
+    AsyncOutputFlush
+};
+
+static const char *overflowNames[] = {"drop-oldest", "drop-newest", "block"};
+
+static volatile int nextId = 0;
+
+/*******************************************************************************
+* Delivery Method Functions                                                    *
+*******************************************************************************/
+static bool AsyncOutputCanHandle(char *mrl)
+{
+    return (strncmp(ASYNCOUTPUT_PREFIX, mrl, sizeof(ASYNCOUTPUT_PREFIX) - 1) == 0);
+}
+
+static DeliveryMethodInstance_t *AsyncOutputCreate(char *arg)
+{
+    AsyncOutputState_t *state;
+    unsigned int queue = ASYNCOUTPUT_DEFAULT_QUEUE;
+    unsigned int nrofSlots;
+    AsyncOverflow_e overflow = AsyncOverflow_DropOldest;
+    char *mrl;
+    int i;
+
+    mrl = ParseOptions(arg + sizeof(ASYNCOUTPUT_PREFIX) - 1, &queue, &overflow);
+    if (mrl == NULL)
+    {
+        return NULL;
+    }
+
+    /* The ring buffer needs a power of 2 slots */
+    for (nrofSlots = MIN_SLOTS; nrofSlots * ASYNCOUTPUT_SLOT_PACKETS < queue; nrofSlots <<= 1);
+
+    state = calloc(1, sizeof(AsyncOutputState_t));
+    if (state == NULL)
+    {
+        LogModule(LOG_DEBUG, ASYNCOUTPUT, "Failed to allocate state\n");
+        return NULL;
+    }
+    state->overflow = overflow;
+    state->fillSlot = -1;
+    RingBufferInit(&state->ring, nrofSlots);
+    state->slots = calloc(nrofSlots, sizeof(AsyncSlot_t));
+    state->spare = malloc(SLOT_BYTES);
+    if ((state->slots == NULL) || (state->spare == NULL))
+    {
+        LogModule(LOG_DEBUG, ASYNCOUTPUT, "Failed to allocate queue\n");
+        FreeState(state);
+        return NULL;
+    }
+    for (i = 0; i < nrofSlots; i ++)
+    {
+        state->slots[i].data = malloc(SLOT_BYTES);
+        if (state->slots[i].data == NULL)
+        {
+            LogModule(LOG_DEBUG, ASYNCOUTPUT, "Failed to allocate queue\n");
+            FreeState(state);
+            return NULL;
+        }
+    }
+
+    state->output = DeliveryMethodCreateWrapped(mrl);
+    if (state->output == NULL)
+    {
+        LogModule(LOG_DEBUG, ASYNCOUTPUT, "Failed to create output for %s\n", mrl);
+        FreeState(state);
+        return NULL;
+    }
+
+    pthread_mutex_init(&state->producerMutex, NULL);
+    pthread_mutex_init(&state->mutex, NULL);
+    pthread_cond_init(&state->cond, NULL);
+    if (pthread_create(&state->thread, NULL, WriterThread, state))
+    {
+        LogModule(LOG_DEBUG, ASYNCOUTPUT, "Failed to start writer thread\n");
+        state->output->ops->DestroyInstance(state->output);
+        pthread_cond_destroy(&state->cond);
+        pthread_mutex_destroy(&state->mutex);
+        pthread_mutex_destroy(&state->producerMutex);
+        FreeState(state);
+        return NULL;
+    }
+
+    state->instance.ops = &asyncInstanceOps;
+    state->instance.mrl = strdup(arg);
+
+    sprintf(state->propertyPath, "%s.%d", PROPERTIES_PARENT, __sync_add_and_fetch(&nextId, 1));
+    PropertiesAddSimpleProperty(state->propertyPath, "mrl", "MRL of the output the packets are queued for.",
+                                PropertyType_String, &state->instance.mrl, SIMPLEPROPERTY_R);
+    PropertiesAddSimpleProperty(state->propertyPath, "queued", "Number of packets waiting to be output.",
+                                PropertyType_Int, (void *)&state->queued, SIMPLEPROPERTY_R);
+    PropertiesAddSimpleProperty(state->propertyPath, "peak", "Most packets that have been waiting to be output.",
+                                PropertyType_Int, &state->queuedPeak, SIMPLEPROPERTY_R);
+    PropertiesAddSimpleProperty(state->propertyPath, "drops", "Number of packets (and blocks) dropped because the queue was full.",
+                                PropertyType_Int, (void *)&state->drops, SIMPLEPROPERTY_R);
+    PropertiesAddSimpleProperty(state->propertyPath, "written", "Number of packets output.",
+                                PropertyType_Int, (void *)&state->written, SIMPLEPROPERTY_R);
+
+    LogModule(LOG_DEBUG, ASYNCOUTPUT, "%s: %u slots of %d packets, overflow %s\n", state->instance.mrl,
+        nrofSlots, ASYNCOUTPUT_SLOT_PACKETS, overflowNames[overflow]);
+    return &state->instance;
+}
+
+static void AsyncOutputDestroy(DeliveryMethodInstance_t *this)
+{
+    AsyncOutputState_t *state = (AsyncOutputState_t *)this;
+
+    /* Whatever is queued is output before the writer exits. */
+    pthread_mutex_lock(&state->producerMutex);
+    if (state->fillSlot != -1)
+    {
+        CommitSlot(state);
+    }
+    pthread_mutex_unlock(&state->producerMutex);
+
+    pthread_mutex_lock(&state->mutex);
+    state->quit = TRUE;
+    pthread_cond_broadcast(&state->cond);
+    pthread_mutex_unlock(&state->mutex);
+    pthread_join(state->thread, NULL);
+
+    LogModule(LOG_DEBUG, ASYNCOUTPUT, "%s: %u packets written, %u dropped, at most %u queued\n",
+        this->mrl, state->written, state->drops, state->queuedPeak);
+
+    PropertiesRemoveAllProperties(state->propertyPath);
+    state->output->ops->DestroyInstance(state->output);
+    pthread_cond_destroy(&state->cond);
+    pthread_mutex_destroy(&state->mutex);
+    pthread_mutex_destroy(&state->producerMutex);
+    free(this->mrl);
+    FreeState(state);
+}
+
+static void AsyncOutputSendPacket(DeliveryMethodInstance_t *this, TSPacket_t *packet)
+{
+    AsyncOutputSendPackets(this, &packet, 1);
+}
+
+static void AsyncOutputSendPackets(DeliveryMethodInstance_t *this, TSPacket_t **packets, int count)
+{
+    AsyncOutputState_t *state = (AsyncOutputState_t *)this;
+    AsyncSlot_t *slot = NULL;
+    int i;
+
+    pthread_mutex_lock(&state->producerMutex);
+    if (state->fillSlot != -1)
+    {
+        slot = &state->slots[state->fillSlot];
+    }
+    for (i = 0; i < count; i ++)
+    {
+        if (slot == NULL)
+        {
+            state->fillSlot = GetSlot(state, state->overflow);
+            if (state->fillSlot == -1)
+            {
+                state->drops ++;
+                continue;
+            }
+            slot = &state->slots[state->fillSlot];
+            slot->type = AsyncRecord_Packets;
+            slot->length = 0;
+            slot->largeBlock = NULL;
+        }
+        memcpy(slot->data + slot->length, packets[i], TSPACKET_SIZE);
+        slot->length += TSPACKET_SIZE;
+        if (slot->length == SLOT_BYTES)
+        {
+            CommitSlot(state);
+            slot = NULL;
+        }
+    }
+    pthread_mutex_unlock(&state->producerMutex);
+}
+
+static void AsyncOutputSendBlock(DeliveryMethodInstance_t *this, void *block, unsigned long blockLen)
+{
+    AddRecord((AsyncOutputState_t *)this, AsyncRecord_Block, block, blockLen);
+}
+
+static void AsyncOutputReserveHeaderSpace(DeliveryMethodInstance_t *this, int packets)
+{
+    AddRecord((AsyncOutputState_t *)this, AsyncRecord_Reserve, NULL, packets);
+}
+
+static void AsyncOutputSetHeader(DeliveryMethodInstance_t *this, TSPacket_t *packets, int count)
+{
+    AddRecord((AsyncOutputState_t *)this, AsyncRecord_Header, packets, count * TSPACKET_SIZE);
+}
+
+static void AsyncOutputFlush(DeliveryMethodInstance_t *this)
+{
+    AsyncOutputState_t *state = (AsyncOutputState_t *)this;
+
+    /* Only hand over a partly filled slot if the writer has nothing else to
+     * do, otherwise keep filling it so the writer gets bigger batches. */
+    pthread_mutex_lock(&state->producerMutex);
+    if ((state->fillSlot != -1) && state->writerWaiting)
+    {
+        CommitSlot(state);
+    }
+    pthread_mutex_unlock(&state->producerMutex);
+}
+
+/*******************************************************************************
+* Local Functions                                                              *
+*******************************************************************************/
+/*
+ * Parse any options at the start of mrl, returning the MRL of the output to
+ * wrap or NULL if the options are invalid.
+ */
+static char *ParseOptions(char *mrl, unsigned int *queue, AsyncOverflow_e *overflow)
+{
+    char *end = strchr(mrl, ';');
+    char *scheme = strstr(mrl, "://");
+    char option[32];
+    int i;
+
+    /* No options if the output MRL comes first. */
+    if ((end == NULL) || ((scheme != NULL) && (scheme < end)))
+    {
+        return mrl;
+    }
+
+    while (mrl < end)
+    {
+        char *value;
+        for (i = 0; (mrl + i < end) && (mrl[i] != ',') && (i < sizeof(option) - 1); i ++)
+        {
+            option[i] = mrl[i];
+        }
+        option[i] = 0;
+        mrl += i;
+        if (*mrl == ',')
+        {
+            mrl ++;
+        }
+
+        value = strchr(option, '=');
+        if (value == NULL)
+        {
+            LogModule(LOG_ERROR, ASYNCOUTPUT, "Option \"%s\" has no value\n", option);
+            return NULL;
+        }
+        *value = 0;
+        value ++;
+
+        if (strcmp(option, "queue") == 0)
+        {
+            int packets = atoi(value);
+            if (packets < 1)
+            {
+                LogModule(LOG_ERROR, ASYNCOUTPUT, "queue must be at least 1 packet\n");
+                return NULL;
+            }
+            *queue = packets;
+        }
+        else if (strcmp(option, "overflow") == 0)
+        {
+            for (i = 0; i < sizeof(overflowNames) / sizeof(overflowNames[0]); i ++)
+            {
+                if (strcmp(value, overflowNames[i]) == 0)
+                {
+                    *overflow = (AsyncOverflow_e)i;
+                    break;
+                }
+            }
+            if (i == sizeof(overflowNames) / sizeof(overflowNames[0]))
+            {
+                LogModule(LOG_ERROR, ASYNCOUTPUT, "overflow must be drop-oldest, drop-newest or block\n");
+                return NULL;
+            }
+        }
+        else
+        {
+            LogModule(LOG_ERROR, ASYNCOUTPUT, "Unknown option \"%s\"\n", option);
+            return NULL;
+        }
+    }
+    return end + 1;
+}
+
+/*
+ * Queue a block, header or header reservation in a slot of its own, after any
+ * packets already queued.
+ */
+static void AddRecord(AsyncOutputState_t *state, AsyncRecord_e type, void *data, unsigned int length)
+{
+    AsyncOverflow_e overflow = state->overflow;
+    AsyncSlot_t *slot;
+    int index;
+
+    /* Headers and reservations make room rather than being dropped. */
+    if ((type != AsyncRecord_Block) && (overflow == AsyncOverflow_DropNewest))
+    {
+        overflow = AsyncOverflow_DropOldest;
+    }
+
+    pthread_mutex_lock(&state->producerMutex);
+    if (state->fillSlot != -1)
+    {
+        CommitSlot(state);
+    }
+    index = GetSlot(state, overflow);
+    if (index == -1)
+    {
+        state->drops ++;
+        pthread_mutex_unlock(&state->producerMutex);
+        return;
+    }
+    slot = &state->slots[index];
+    slot->type = type;
+    slot->length = length;
+    slot->largeBlock = NULL;
+    if (data)
+    {
+        uint8_t *buffer = slot->data;
+        if (length > SLOT_BYTES)
+        {
+            slot->largeBlock = malloc(length);
+            buffer = slot->largeBlock;
+        }
+        if (buffer == NULL)
+        {
+            state->drops ++;
+            pthread_mutex_unlock(&state->producerMutex);
+            return;
+        }
+        memcpy(buffer, data, length);
+    }
+    state->fillSlot = index;
+    CommitSlot(state);
+    pthread_mutex_unlock(&state->producerMutex);
+}
+
+/*
+ * Find a free slot, dealing with a full ring according to the overflow policy.
+ * Returns -1 if the new data should be dropped.
+ * Must be called with the producer mutex held.
+ */
+static int GetSlot(AsyncOutputState_t *state, AsyncOverflow_e overflow)
+{
+    int index;
+
+    for (index = RingBufferWriteSlot(&state->ring);
+         (index == -1) && !state->quit;
+         index = RingBufferWriteSlot(&state->ring))
+    {
+        switch (overflow)
+        {
+            case AsyncOverflow_DropNewest:
+                return -1;
+
+            case AsyncOverflow_DropOldest:
+                DropOldestSlot(state);
+                break;
+
+            case AsyncOverflow_Block:
+                pthread_mutex_lock(&state->mutex);
+                state->producerWaiting = TRUE;
+                __sync_synchronize();
+                if (RingBufferWriteSlot(&state->ring) == -1)
+                {
+                    Wait(state);
+                }
+                state->producerWaiting = FALSE;
+                pthread_mutex_unlock(&state->mutex);
+                break;
+        }
+    }
+    return index;
+}
+
+/*
+ * Make the slot being filled available to the writer.
+ * Must be called with the producer mutex held.
+ */
+static void CommitSlot(AsyncOutputState_t *state)
+{
+    unsigned int queued;
+
+    queued = __sync_add_and_fetch(&state->queued, SlotItems(&state->slots[state->fillSlot]));
+    if (queued > state->queuedPeak)
+    {
+        state->queuedPeak = queued;
+    }
+    RingBufferCommit(&state->ring);
+    state->fillSlot = -1;
+
+    /* The writer sets writerWaiting before checking the ring, so one of us
+     * will see the other. */
+    __sync_synchronize();
+    if (state->writerWaiting)
+    {
+        pthread_mutex_lock(&state->mutex);
+        pthread_cond_broadcast(&state->cond);
+        pthread_mutex_unlock(&state->mutex);
+    }
+}
+
+/*
+ * Drop the oldest packets or block, moving any headers or reservations in
+ * front of them out of the ring.
+ */
+static void DropOldestSlot(AsyncOutputState_t *state)
+{
+    int index;
+
+    pthread_mutex_lock(&state->mutex);
+    for (index = RingBufferReadSlot(&state->ring);
+         index != -1;
+         index = RingBufferReadSlot(&state->ring))
+    {
+        AsyncSlot_t *slot = &state->slots[index];
+        if ((slot->type == AsyncRecord_Packets) || (slot->type == AsyncRecord_Block))
+        {
+            unsigned int items = SlotItems(slot);
+            if (slot->largeBlock)
+            {
+                free(slot->largeBlock);
+                slot->largeBlock = NULL;
+            }
+            RingBufferRelease(&state->ring);
+            __sync_sub_and_fetch(&state->queued, items);
+            state->drops += items;
+            break;
+        }
+        KeepControl(state, slot);
+        RingBufferRelease(&state->ring);
+    }
+    pthread_mutex_unlock(&state->mutex);
+}
+
+/*
+ * Move a header or reservation from the ring to the end of the control list.
+ * Must be called with the mutex held.
+ */
+static void KeepControl(AsyncOutputState_t *state, AsyncSlot_t *slot)
+{
+    AsyncControl_t *control = malloc(sizeof(AsyncControl_t));
+
+    if (control == NULL)
+    {
+        LogModule(LOG_ERROR, ASYNCOUTPUT, "Out of memory, header dropped\n");
+        free(slot->largeBlock);
+        slot->largeBlock = NULL;
+        __sync_sub_and_fetch(&state->queued, SlotItems(slot));
+        return;
+    }
+    control->slot = *slot;
+    control->slot.data = NULL;
+    control->next = NULL;
+    if ((slot->type == AsyncRecord_Header) && (slot->largeBlock == NULL))
+    {
+        control->slot.largeBlock = malloc(slot->length);
+        if (control->slot.largeBlock == NULL)
+        {
+            LogModule(LOG_ERROR, ASYNCOUTPUT, "Out of memory, header dropped\n");
+            __sync_sub_and_fetch(&state->queued, SlotItems(slot));
+            free(control);
+            return;
+        }
+        memcpy(control->slot.largeBlock, slot->data, slot->length);
+    }
+    slot->largeBlock = NULL;
+
+    if (state->controlTail)
+    {
+        state->controlTail->next = control;
+    }
+    else
+    {
+        state->controlHead = control;
+    }
+    state->controlTail = control;
+}
+
+/*
+ * Take the next record for the writer, records moved out of the ring are older
+ * than anything still in it so are taken first. Returns FALSE if there is
+ * nothing queued.
+ * Must be called with the mutex held.
+ */
+static bool TakeRecord(AsyncOutputState_t *state, AsyncSlot_t *taken)
+{
+    AsyncControl_t *control = state->controlHead;
+    int index;
+
+    if (control)
+    {
+        state->controlHead = control->next;
+        if (state->controlHead == NULL)
+        {
+            state->controlTail = NULL;
+        }
+        *taken = control->slot;
+        free(control);
+    }
+    else
+    {
+        index = RingBufferReadSlot(&state->ring);
+        if (index == -1)
+        {
+            return FALSE;
+        }
+        /* Take the contents of the slot and hand it straight back, so the
+         * producer can carry on (or drop it) while this thread is writing. */
+        *taken = state->slots[index];
+        state->slots[index].data = state->spare;
+        state->slots[index].largeBlock = NULL;
+        state->spare = taken->data;
+        RingBufferRelease(&state->ring);
+        if (state->producerWaiting)
+        {
+            pthread_cond_broadcast(&state->cond);
+        }
+    }
+    __sync_sub_and_fetch(&state->queued, SlotItems(taken));
+    return TRUE;
+}
+
+/* Number of packets in a slot for the statistics, blocks count as 1. */
+static unsigned int SlotItems(AsyncSlot_t *slot)
+{
+    switch (slot->type)
+    {
+        case AsyncRecord_Packets:
+        case AsyncRecord_Header:
+            return slot->length / TSPACKET_SIZE;
+        case AsyncRecord_Block:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+static void *WriterThread(void *arg)
+{
+    AsyncOutputState_t *state = arg;
+    TSPacket_t *packets[ASYNCOUTPUT_SLOT_PACKETS];
+    bool flush = FALSE;
+
+    while (TRUE)
+    {
+        AsyncSlot_t taken;
+        unsigned int i, count;
+
+        pthread_mutex_lock(&state->mutex);
+        if (!TakeRecord(state, &taken))
+        {
+            pthread_mutex_unlock(&state->mutex);
+            /* Let the output know the batch has finished before waiting. */
+            if (flush)
+            {
+                DeliveryMethodFlush(state->output);
+                flush = FALSE;
+                continue;
+            }
+            pthread_mutex_lock(&state->mutex);
+            state->writerWaiting = TRUE;
+            __sync_synchronize();
+            if (state->quit && (RingBufferUsed(&state->ring) == 0) && (state->controlHead == NULL))
+            {
+                state->writerWaiting = FALSE;
+                pthread_mutex_unlock(&state->mutex);
+                break;
+            }
+            if ((RingBufferUsed(&state->ring) == 0) && (state->controlHead == NULL))
+            {
+                Wait(state);
+            }
+            state->writerWaiting = FALSE;
+            pthread_mutex_unlock(&state->mutex);
+            continue;
+        }
+        pthread_mutex_unlock(&state->mutex);
+
+        switch (taken.type)
+        {
+            case AsyncRecord_Packets:
+                count = taken.length / TSPACKET_SIZE;
+                for (i = 0; i < count; i ++)
+                {
+                    packets[i] = (TSPacket_t *)(taken.data + (i * TSPACKET_SIZE));
+                }
+                DeliveryMethodOutputPackets(state->output, packets, count);
+                __sync_add_and_fetch(&state->written, count);
+                break;
+
+            case AsyncRecord_Block:
+                DeliveryMethodOutputBlock(state->output,
+                    taken.largeBlock ? taken.largeBlock : taken.data, taken.length);
+                break;
+
+            case AsyncRecord_Header:
+                DeliveryMethodSetHeader(state->output,
+                    (TSPacket_t *)(taken.largeBlock ? taken.largeBlock : taken.data),
+                    taken.length / TSPACKET_SIZE);
+                break;
+
+            case AsyncRecord_Reserve:
+                DeliveryMethodReserveHeaderSpace(state->output, taken.length);
+                break;
+        }
+        if (taken.largeBlock)
+        {
+            free(taken.largeBlock);
+        }
+        flush = TRUE;
+    }
+    return NULL;
+}
+
+/* Must be called with the mutex held. */
+static void Wait(AsyncOutputState_t *state)
+{
+    struct timespec until;
+
+    clock_gettime(CLOCK_REALTIME, &until);
+    until.tv_nsec += WAIT_TIMEOUT * 1000000;
+    if (until.tv_nsec >= 1000000000)
+    {
+        until.tv_sec ++;
+        until.tv_nsec -= 1000000000;
+    }
+    pthread_cond_timedwait(&state->cond, &state->mutex, &until);
+}
+
+static void FreeState(AsyncOutputState_t *state)
+{
+    int i;
+
+    if (state->slots)
+    {
+        for (i = 0; i < state->ring.size; i ++)
+        {
+            free(state->slots[i].data);
+            free(state->slots[i].largeBlock);
+        }
+        free(state->slots);
+    }
+    while (state->controlHead)
+    {
+        AsyncControl_t *control = state->controlHead;
+        state->controlHead = control->next;
+        free(control->slot.largeBlock);
+        free(control);
+    }
+    free(state->spare);
+    free(state);
+}
@@ -17,7 +17,8 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
 
 cache.c
 
-Caches service and PID information from the database for the current multiplex.
+Caches service and PID information from the database for the multiplex each
+adapter is tuned to.
 
 */
 
@@ -26,6 +27,7 @@ Caches service and PID information from the database for the current multiplex.
 #include <string.h>
 #include <pthread.h>
 #include "ts.h"
+#include "dvbadapter.h"
 #include "multiplexes.h"
 #include "services.h"
 #include "pids.h"
@@ -159,10 +161,21 @@ typedef struct CacheUpdateMessage_s
     }details;
 }CacheUpdateMessage_t;
 
+struct Cache_s
+{
+    Multiplex_t *multiplex;
+    int servicesCount;
+    pthread_mutex_t updateMutex;
+    Event_t pidsUpdatedEvent;
+    enum CacheFlags flags[SERVICES_MAX];
+    Service_t*      services[SERVICES_MAX];
+    ProgramInfo_t*  pids[SERVICES_MAX];
+};
+
 /*******************************************************************************
 * Prototypes                                                                   *
 *******************************************************************************/
-static void CacheServicesFree(void);
+static void CacheServicesFree(Cache_t *cache);
 static void CacheProcessUpdateMessage(void *ptr);
 
 /*******************************************************************************
@@ -170,14 +183,7 @@ static void CacheProcessUpdateMessage(void *ptr);
 *******************************************************************************/
 static char CACHE[] = "Cache";
 static EventSource_t eventSource;
-static Event_t pidsUpdatedEvent;
-static Multiplex_t *cachedServicesMultiplex = NULL;
-static int cachedServicesCount = 0;
-
-static pthread_mutex_t cacheUpdateMutex;
-static enum CacheFlags cacheFlags[SERVICES_MAX];
-static Service_t*      cachedServices[SERVICES_MAX];
-static ProgramInfo_t*  cachedPIDs[SERVICES_MAX];
+static Cache_t caches[DVB_MAX_ADAPTERS];
 
 /*******************************************************************************
 * Global functions                                                             *
@@ -186,15 +192,30 @@ static ProgramInfo_t*  cachedPIDs[SERVICES_MAX];
 int CacheInit()
 {
     pthread_mutexattr_t mutexAttr;    
+    int i;
 
     pthread_mutexattr_init(&mutexAttr);
     pthread_mutexattr_settype(&mutexAttr, PTHREAD_MUTEX_RECURSIVE);
-    pthread_mutex_init(&cacheUpdateMutex, &mutexAttr);
+    for (i = 0; i < DVB_MAX_ADAPTERS; i ++)
+    {
+        pthread_mutex_init(&caches[i].updateMutex, &mutexAttr);
+    }
     pthread_mutexattr_destroy(&mutexAttr);
 
 
     eventSource = EventsRegisterSource("Cache");
-    pidsUpdatedEvent = EventsRegisterEvent(eventSource, "PIDsUpdated", NULL);
+    /* 
+     * Each cache has its own event so listeners are only called on the thread
+     * of the adapter they are interested in, the primary's keeps the original
+     * name.
+     */
+    caches[0].pidsUpdatedEvent = EventsRegisterEvent(eventSource, "PIDsUpdated", NULL);
+    for (i = 1; i < DVB_MAX_ADAPTERS; i ++)
+    {
+        char name[20];
+        sprintf(name, "PIDsUpdated%d", i);
+        caches[i].pidsUpdatedEvent = EventsRegisterEvent(eventSource, name, NULL);
+    }
     
     ObjectRegisterType(CacheUpdateMessage_t);
     return 0;
@@ -202,25 +223,43 @@ int CacheInit()
 
 void CacheDeInit()
 {
-    CacheServicesFree();
-    pthread_mutex_destroy(&cacheUpdateMutex);
+    int i;
+    for (i = 0; i < DVB_MAX_ADAPTERS; i ++)
+    {
+        CacheServicesFree(&caches[i]);
+        pthread_mutex_destroy(&caches[i].updateMutex);
+    }
+}
+
+Cache_t *CacheGet(int index)
+{
+    if ((index < 0) || (index >= DVB_MAX_ADAPTERS))
+    {
+        return NULL;
+    }
+    return &caches[index];
+}
+
+Event_t CachePIDsUpdatedEventGet(Cache_t *cache)
+{
+    return cache->pidsUpdatedEvent;
 }
 
-int CacheLoad(Multiplex_t *multiplex)
+int CacheLoad(Cache_t *cache, Multiplex_t *multiplex)
 {
     int result = 1;
     List_t *list = NULL;
 
-    pthread_mutex_lock(&cacheUpdateMutex);
+    pthread_mutex_lock(&cache->updateMutex);
     LogModule(LOG_DEBUG, CACHE, "Freeing services\n");
 
     /* Free the services and PIDs from the previous multiplex */
-    CacheServicesFree();
+    CacheServicesFree(cache);
 
     list = ServiceListForMultiplex(multiplex);
     
     LogModule(LOG_DEBUG, CACHE, "Loading %d services for %d\n", ListCount(list), multiplex->uid);
-    cachedServicesCount = ListCount(list);
+    cache->servicesCount = ListCount(list);
     if (ListCount(list) > 0)
     {
         ListIterator_t iterator;
@@ -230,10 +269,10 @@ int CacheLoad(Multiplex_t *multiplex)
              ListIterator_MoreEntries(iterator);
              ListIterator_Next(iterator), i++)
         {
-            cachedServices[i] = (Service_t*)ListIterator_Current(iterator);
-            LogModule(LOG_DEBUG,CACHE, "Loaded 0x%04x %s\n", cachedServices[i]->id, cachedServices[i]->name);
-            cachedPIDs[i] = ProgramInfoGet(cachedServices[i]);
-            cacheFlags[i] = CacheFlag_Clean;
+            cache->services[i] = (Service_t*)ListIterator_Current(iterator);
+            LogModule(LOG_DEBUG,CACHE, "Loaded 0x%04x %s\n", cache->services[i]->id, cache->services[i]->name);
+            cache->pids[i] = ProgramInfoGet(cache->services[i]);
+            cache->flags[i] = CacheFlag_Clean;
         }
         /* Use ListFree with no destructor as we don't want to free the objects 
          * only the list.
@@ -242,51 +281,51 @@ int CacheLoad(Multiplex_t *multiplex)
     }
 
     MultiplexRefInc(multiplex);
-    cachedServicesMultiplex = multiplex;
+    cache->multiplex = multiplex;
     result = 0;
 
-    pthread_mutex_unlock(&cacheUpdateMutex);
+    pthread_mutex_unlock(&cache->updateMutex);
 
     return result;
 }
 
-Multiplex_t *CacheMultiplexGet(void)
+Multiplex_t *CacheMultiplexGet(Cache_t *cache)
 {
-     return cachedServicesMultiplex;
+     return cache->multiplex;
 }
 
-Service_t *CacheServiceFind(char *name)
+Service_t *CacheServiceFind(Cache_t *cache, char *name)
 {
     Service_t *result = NULL;
     int netId;
     int tsId;
     int serviceId;
 
-    result = CacheServiceFindName(name);
+    result = CacheServiceFindName(cache, name);
     if (!result)
     {
         if (sscanf(name,"%x.%x.%x", &netId, &tsId, &serviceId) == 3)
         {
-            if ((cachedServicesMultiplex->networkId == netId) &&
-                (cachedServicesMultiplex->tsId== tsId))
+            if (cache->multiplex && (cache->multiplex->networkId == netId) &&
+                (cache->multiplex->tsId== tsId))
             {
-                result = CacheServiceFindId(serviceId);
+                result = CacheServiceFindId(cache, serviceId);
             }
         }
     }
     return result;
 }
 
-Service_t *CacheServiceFindId(int id)
+Service_t *CacheServiceFindId(Cache_t *cache, int id)
 {
     Service_t *result = NULL;
     int i;
 
-    for (i = 0; i < cachedServicesCount; i ++)
+    for (i = 0; i < cache->servicesCount; i ++)
     {
-        if (cachedServices[i]->id == id)
+        if (cache->services[i]->id == id)
         {
-            result = cachedServices[i];
+            result = cache->services[i];
             ServiceRefInc(result);
             break;
         }
@@ -295,17 +334,17 @@ Service_t *CacheServiceFindId(int id)
     return result;
 }
 
-Service_t *CacheServiceFindName(char *name)
+Service_t *CacheServiceFindName(Cache_t *cache, char *name)
 {
     Service_t *result = NULL;
     int i;
     LogModule(LOG_DEBUGV,CACHE, "Checking cached services for \"%s\"\n", name);
-    for (i = 0; i < cachedServicesCount; i ++)
+    for (i = 0; i < cache->servicesCount; i ++)
     {
-        LogModule(LOG_DEBUGV, CACHE, "cachedServices[%d]->name = %s\n", i, cachedServices[i]->name);
-        if (strcmp(cachedServices[i]->name, name) == 0)
+        LogModule(LOG_DEBUGV, CACHE, "cache->services[%d]->name = %s\n", i, cache->services[i]->name);
+        if (strcmp(cache->services[i]->name, name) == 0)
         {
-            result = cachedServices[i];
+            result = cache->services[i];
             ServiceRefInc(result);
             LogModule(LOG_DEBUGV, CACHE, "Found in cached services!\n");
             break;
@@ -319,28 +358,28 @@ Service_t *CacheServiceFindName(char *name)
     return result;
 }
 
-Service_t **CacheServicesGet(int *count)
+Service_t **CacheServicesGet(Cache_t *cache, int *count)
 {
-    pthread_mutex_lock(&cacheUpdateMutex);
-    *count = cachedServicesCount;
-    return cachedServices;
+    pthread_mutex_lock(&cache->updateMutex);
+    *count = cache->servicesCount;
+    return cache->services;
 }
 
-void CacheServicesRelease(void)
+void CacheServicesRelease(Cache_t *cache)
 {
-    pthread_mutex_unlock(&cacheUpdateMutex);
+    pthread_mutex_unlock(&cache->updateMutex);
 }
 
-ProgramInfo_t *CacheProgramInfoGet(Service_t *service)
+ProgramInfo_t *CacheProgramInfoGet(Cache_t *cache, Service_t *service)
 {
     ProgramInfo_t *result = NULL;
     int i;
-    pthread_mutex_lock(&cacheUpdateMutex);
-    for (i = 0; i < cachedServicesCount; i ++)
+    pthread_mutex_lock(&cache->updateMutex);
+    for (i = 0; i < cache->servicesCount; i ++)
     {
-        if ((cachedServices[i]) && ServiceAreEqual(service, cachedServices[i]))
+        if ((cache->services[i]) && ServiceAreEqual(service, cache->services[i]))
         {
-            result = cachedPIDs[i];
+            result = cache->pids[i];
             if (result)
             {
                 ObjectRefInc(result);
@@ -348,23 +387,23 @@ ProgramInfo_t *CacheProgramInfoGet(Service_t *service)
             break;
         }
     }
-    pthread_mutex_unlock(&cacheUpdateMutex);
+    pthread_mutex_unlock(&cache->updateMutex);
     return result;
 }
 
-void CacheUpdateMultiplex(Multiplex_t *multiplex, int patversion, int tsid)
+void CacheUpdateMultiplex(Cache_t *cache, Multiplex_t *multiplex, int patversion, int tsid)
 {
     CacheUpdateMessage_t *msg;
     int i;
-    pthread_mutex_lock(&cacheUpdateMutex);
+    pthread_mutex_lock(&cache->updateMutex);
 
-    if (cachedServicesMultiplex && MultiplexAreEqual(multiplex, cachedServicesMultiplex))
+    if (cache->multiplex && MultiplexAreEqual(multiplex, cache->multiplex))
     {
-        cachedServicesMultiplex->patVersion = patversion;
-        cachedServicesMultiplex->tsId = tsid;
-        for (i = 0; i < cachedServicesCount; i ++)
+        cache->multiplex->patVersion = patversion;
+        cache->multiplex->tsId = tsid;
+        for (i = 0; i < cache->servicesCount; i ++)
         {
-            cachedServices[i]->tsId = tsid;
+            cache->services[i]->tsId = tsid;
         }
 
         msg = ObjectCreateType(CacheUpdateMessage_t);
@@ -379,21 +418,21 @@ void CacheUpdateMultiplex(Multiplex_t *multiplex, int patversion, int tsid)
         }
     }
 
-    pthread_mutex_unlock(&cacheUpdateMutex);
+    pthread_mutex_unlock(&cache->updateMutex);
 }
 
-void CacheUpdateNetworkId(Multiplex_t *multiplex, int netid)
+void CacheUpdateNetworkId(Cache_t *cache, Multiplex_t *multiplex, int netid)
 {
     CacheUpdateMessage_t *msg;
     int i;
-    pthread_mutex_lock(&cacheUpdateMutex);
+    pthread_mutex_lock(&cache->updateMutex);
 
-    if (cachedServicesMultiplex && MultiplexAreEqual(multiplex, cachedServicesMultiplex))
+    if (cache->multiplex && MultiplexAreEqual(multiplex, cache->multiplex))
     {
-        cachedServicesMultiplex->networkId = netid;
-        for (i = 0; i < cachedServicesCount; i ++)
+        cache->multiplex->networkId = netid;
+        for (i = 0; i < cache->servicesCount; i ++)
         {
-            cachedServices[i]->networkId = netid;
+            cache->services[i]->networkId = netid;
         }
         msg = ObjectCreateType(CacheUpdateMessage_t);
         if (msg)
@@ -407,20 +446,20 @@ void CacheUpdateNetworkId(Multiplex_t *multiplex, int netid)
         }
     }
 
-    pthread_mutex_unlock(&cacheUpdateMutex);
+    pthread_mutex_unlock(&cache->updateMutex);
 }
 
-void CacheUpdateServicePMTPID(Service_t *service, int pmtpid)
+void CacheUpdateServicePMTPID(Cache_t *cache, Service_t *service, int pmtpid)
 {
     CacheUpdateMessage_t *msg;
     int i;
-    pthread_mutex_lock(&cacheUpdateMutex);
+    pthread_mutex_lock(&cache->updateMutex);
 
-    for (i = 0; i < cachedServicesCount; i ++)
+    for (i = 0; i < cache->servicesCount; i ++)
     {
-        if ((cachedServices[i]) && ServiceAreEqual(service, cachedServices[i]))
+        if ((cache->services[i]) && ServiceAreEqual(service, cache->services[i]))
         {
-            cachedServices[i]->pmtPID = pmtpid;
+            cache->services[i]->pmtPID = pmtpid;
             msg = ObjectCreateType(CacheUpdateMessage_t);
             if (msg)
             {
@@ -435,30 +474,30 @@ void CacheUpdateServicePMTPID(Service_t *service, int pmtpid)
         }
     }
 
-    pthread_mutex_unlock(&cacheUpdateMutex);
+    pthread_mutex_unlock(&cache->updateMutex);
 }
 
-void CacheUpdateServiceName(Service_t *service, char *name)
+void CacheUpdateServiceName(Cache_t *cache, Service_t *service, char *name)
 {
     CacheUpdateMessage_t *msg;
     int i;
-    pthread_mutex_lock(&cacheUpdateMutex);
+    pthread_mutex_lock(&cache->updateMutex);
 
-    for (i = 0; i < cachedServicesCount; i ++)
+    for (i = 0; i < cache->servicesCount; i ++)
     {
-        if ((cachedServices[i]) && ServiceAreEqual(service, cachedServices[i]))
+        if ((cache->services[i]) && ServiceAreEqual(service, cache->services[i]))
         {
-            if (cachedServices[i]->name)
+            if (cache->services[i]->name)
             {
-                free(cachedServices[i]->name);
+                free(cache->services[i]->name);
             }
             if (name)
             {
-                cachedServices[i]->name = strdup(name);
+                cache->services[i]->name = strdup(name);
             }
             else
             {
-                cachedServices[i]->name = NULL;
+                cache->services[i]->name = NULL;
             }
             msg = ObjectCreateType(CacheUpdateMessage_t);
             if (msg)
@@ -477,30 +516,30 @@ void CacheUpdateServiceName(Service_t *service, char *name)
         }
     }
 
-    pthread_mutex_unlock(&cacheUpdateMutex);
+    pthread_mutex_unlock(&cache->updateMutex);
 }
 
-void CacheUpdateServiceProvider(Service_t *service, char *provider)
+void CacheUpdateServiceProvider(Cache_t *cache, Service_t *service, char *provider)
 {
     CacheUpdateMessage_t *msg;
     int i;
-    pthread_mutex_lock(&cacheUpdateMutex);
+    pthread_mutex_lock(&cache->updateMutex);
 
-    for (i = 0; i < cachedServicesCount; i ++)
+    for (i = 0; i < cache->servicesCount; i ++)
     {
-        if ((cachedServices[i]) && ServiceAreEqual(service, cachedServices[i]))
+        if ((cache->services[i]) && ServiceAreEqual(service, cache->services[i]))
         {
-            if (cachedServices[i]->provider)
+            if (cache->services[i]->provider)
             {
-                free(cachedServices[i]->provider);
+                free(cache->services[i]->provider);
             }
             if (provider)
             {
-                cachedServices[i]->provider = strdup(provider);
+                cache->services[i]->provider = strdup(provider);
             }
             else
             {
-                cachedServices[i]->provider = NULL;
+                cache->services[i]->provider = NULL;
             }
             msg = ObjectCreateType(CacheUpdateMessage_t);
             if (msg)
@@ -519,30 +558,30 @@ void CacheUpdateServiceProvider(Service_t *service, char *provider)
         }
     }
 
-    pthread_mutex_unlock(&cacheUpdateMutex);
+    pthread_mutex_unlock(&cache->updateMutex);
 }
 
-void CacheUpdateServiceDefaultAuthority(Service_t *service, char *defaultAuthority)
+void CacheUpdateServiceDefaultAuthority(Cache_t *cache, Service_t *service, char *defaultAuthority)
 {
     CacheUpdateMessage_t *msg;
     int i;
-    pthread_mutex_lock(&cacheUpdateMutex);
+    pthread_mutex_lock(&cache->updateMutex);
 
-    for (i = 0; i < cachedServicesCount; i ++)
+    for (i = 0; i < cache->servicesCount; i ++)
     {
-        if ((cachedServices[i]) && ServiceAreEqual(service, cachedServices[i]))
+        if ((cache->services[i]) && ServiceAreEqual(service, cache->services[i]))
         {
-            if (cachedServices[i]->defaultAuthority)
+            if (cache->services[i]->defaultAuthority)
             {
-                free(cachedServices[i]->defaultAuthority);
+                free(cache->services[i]->defaultAuthority);
             }
             if (defaultAuthority)
             {
-                cachedServices[i]->defaultAuthority = strdup(defaultAuthority);
+                cache->services[i]->defaultAuthority = strdup(defaultAuthority);
             }
             else
             {
-                cachedServices[i]->defaultAuthority = NULL;
+                cache->services[i]->defaultAuthority = NULL;
             }
             msg = ObjectCreateType(CacheUpdateMessage_t);
             if (msg)
@@ -561,20 +600,20 @@ void CacheUpdateServiceDefaultAuthority(Service_t *service, char *defaultAuthori
         }
     }
 
-    pthread_mutex_unlock(&cacheUpdateMutex);
+    pthread_mutex_unlock(&cache->updateMutex);
 }
 
-void CacheUpdateServiceSource(Service_t *service, uint16_t source)
+void CacheUpdateServiceSource(Cache_t *cache, Service_t *service, uint16_t source)
 {
     CacheUpdateMessage_t *msg;
     int i;
-    pthread_mutex_lock(&cacheUpdateMutex);
+    pthread_mutex_lock(&cache->updateMutex);
 
-    for (i = 0; i < cachedServicesCount; i ++)
+    for (i = 0; i < cache->servicesCount; i ++)
     {
-        if ((cachedServices[i]) && ServiceAreEqual(service, cachedServices[i]))
+        if ((cache->services[i]) && ServiceAreEqual(service, cache->services[i]))
         {
-            cachedServices[i]->source = source;
+            cache->services[i]->source = source;
             msg = ObjectCreateType(CacheUpdateMessage_t);
             if (msg)
             {
@@ -589,20 +628,20 @@ void CacheUpdateServiceSource(Service_t *service, uint16_t source)
         }
     }
 
-    pthread_mutex_unlock(&cacheUpdateMutex);
+    pthread_mutex_unlock(&cache->updateMutex);
 }
 
-void CacheUpdateServiceConditionalAccess(Service_t *service, bool ca)
+void CacheUpdateServiceConditionalAccess(Cache_t *cache, Service_t *service, bool ca)
 {
     CacheUpdateMessage_t *msg;
     int i;
-    pthread_mutex_lock(&cacheUpdateMutex);
+    pthread_mutex_lock(&cache->updateMutex);
 
-    for (i = 0; i < cachedServicesCount; i ++)
+    for (i = 0; i < cache->servicesCount; i ++)
     {
-        if ((cachedServices[i]) && ServiceAreEqual(service, cachedServices[i]))
+        if ((cache->services[i]) && ServiceAreEqual(service, cache->services[i]))
         {
-            cachedServices[i]->conditionalAccess = ca;
+            cache->services[i]->conditionalAccess = ca;
             msg = ObjectCreateType(CacheUpdateMessage_t);
             if (msg)
             {
@@ -617,20 +656,20 @@ void CacheUpdateServiceConditionalAccess(Service_t *service, bool ca)
         }
     }
 
-    pthread_mutex_unlock(&cacheUpdateMutex);
+    pthread_mutex_unlock(&cache->updateMutex);
 }
 
-void CacheUpdateServiceType(Service_t *service, ServiceType type)
+void CacheUpdateServiceType(Cache_t *cache, Service_t *service, ServiceType type)
 {
     CacheUpdateMessage_t *msg;
     int i;
-    pthread_mutex_lock(&cacheUpdateMutex);
+    pthread_mutex_lock(&cache->updateMutex);
 
-    for (i = 0; i < cachedServicesCount; i ++)
+    for (i = 0; i < cache->servicesCount; i ++)
     {
-        if ((cachedServices[i]) && ServiceAreEqual(service, cachedServices[i]))
+        if ((cache->services[i]) && ServiceAreEqual(service, cache->services[i]))
         {
-            cachedServices[i]->type = type;
+            cache->services[i]->type = type;
             msg = ObjectCreateType(CacheUpdateMessage_t);
             if (msg)
             {
@@ -645,25 +684,25 @@ void CacheUpdateServiceType(Service_t *service, ServiceType type)
         }
     }
 
-    pthread_mutex_unlock(&cacheUpdateMutex);
+    pthread_mutex_unlock(&cache->updateMutex);
 }
 
-void CacheUpdateProgramInfo(Service_t *service, ProgramInfo_t *info)
+void CacheUpdateProgramInfo(Cache_t *cache, Service_t *service, ProgramInfo_t *info)
 {
     CacheUpdateMessage_t *msg;
     int i;
-    pthread_mutex_lock(&cacheUpdateMutex);
+    pthread_mutex_lock(&cache->updateMutex);
 
-    for (i = 0; i < cachedServicesCount; i ++)
+    for (i = 0; i < cache->servicesCount; i ++)
     {
-        if ((cachedServices[i]) && ServiceAreEqual(service, cachedServices[i]))
+        if ((cache->services[i]) && ServiceAreEqual(service, cache->services[i]))
         {
-            if (cachedPIDs[i])
+            if (cache->pids[i])
             {
-                ObjectRefDec(cachedPIDs[i]);
+                ObjectRefDec(cache->pids[i]);
             }
 
-            cachedPIDs[i] = info;
+            cache->pids[i] = info;
 
             msg = ObjectCreateType(CacheUpdateMessage_t);
             if (msg)
@@ -676,15 +715,15 @@ void CacheUpdateProgramInfo(Service_t *service, ProgramInfo_t *info)
                 DeferredProcessingAddJob(CacheProcessUpdateMessage, msg);
                 ObjectRefDec(msg);
             }
-            EventsFireEventListeners(pidsUpdatedEvent, cachedServices[i]);
+            EventsFireEventListeners(cache->pidsUpdatedEvent, cache->services[i]);
             break;
         }
     }
 
-    pthread_mutex_unlock(&cacheUpdateMutex);
+    pthread_mutex_unlock(&cache->updateMutex);
 }
 
-Service_t *CacheServiceAdd(int id, int source)
+Service_t *CacheServiceAdd(Cache_t *cache, int id, int source)
 {
     CacheUpdateMessage_t *msg;
     Service_t *result = ServiceNew();
@@ -698,43 +737,43 @@ Service_t *CacheServiceAdd(int id, int source)
             LogModule(LOG_ERROR, CACHE, "Failed to allocate memory for default service name (0x%04x).\n", result->id);
             result->name = NULL;
         }
-        result->multiplexUID = cachedServicesMultiplex->uid;
+        result->multiplexUID = cache->multiplex->uid;
 
-        pthread_mutex_lock(&cacheUpdateMutex);
+        pthread_mutex_lock(&cache->updateMutex);
 
-        LogModule(LOG_DEBUG, CACHE, "Added service %04x at %d\n", result->id, cachedServicesCount);
+        LogModule(LOG_DEBUG, CACHE, "Added service %04x at %d\n", result->id, cache->servicesCount);
         ServiceRefInc(result);
-        cachedServices[cachedServicesCount] = result;
-        cachedPIDs[cachedServicesCount] = NULL;
-        cacheFlags[cachedServicesCount] = CacheFlag_Clean;
-        cachedServicesCount ++;
+        cache->services[cache->servicesCount] = result;
+        cache->pids[cache->servicesCount] = NULL;
+        cache->flags[cache->servicesCount] = CacheFlag_Clean;
+        cache->servicesCount ++;
 
         msg = ObjectCreateType(CacheUpdateMessage_t);
         if (msg)
         {
             msg->type = CacheUpdate_Service_Added;
             msg->details.serviceAdd.id = id;
-            msg->details.serviceAdd.multiplexUID = cachedServicesMultiplex->uid;
+            msg->details.serviceAdd.multiplexUID = cache->multiplex->uid;
             msg->details.serviceAdd.source = result->source;
             msg->details.serviceAdd.name = strdup(result->name);
             DeferredProcessingAddJob(CacheProcessUpdateMessage, msg);
             ObjectRefDec(msg);
         }
 
-        pthread_mutex_unlock(&cacheUpdateMutex);
+        pthread_mutex_unlock(&cache->updateMutex);
     }
     return result;
 }
 
-bool CacheServiceSeen(Service_t *service, bool seen, bool pat)
+bool CacheServiceSeen(Cache_t *cache, Service_t *service, bool seen, bool pat)
 {
     bool exists = FALSE;
     int seenIndex = -1;
     int i;
 
-    for (i = 0; i < cachedServicesCount; i ++)
+    for (i = 0; i < cache->servicesCount; i ++)
     {
-        if ((cachedServices[i]) && ServiceAreEqual(service, cachedServices[i]))
+        if ((cache->services[i]) && ServiceAreEqual(service, cache->services[i]))
         {
             seenIndex = i;
             break;
@@ -745,15 +784,15 @@ bool CacheServiceSeen(Service_t *service, bool seen, bool pat)
         int flag = pat ? CacheFlag_Not_Seen_In_PAT : CacheFlag_Not_Seen_In_SDT;
         if (seen)
         {
-            cacheFlags[seenIndex] &= ~flag;
+            cache->flags[seenIndex] &= ~flag;
         }
         else
         {
-            cacheFlags[seenIndex] |= flag;
+            cache->flags[seenIndex] |= flag;
         }
 
-        if ((cacheFlags[seenIndex] & CacheFlag_Not_Seen_In_PAT) &&
-            (cacheFlags[seenIndex] & CacheFlag_Not_Seen_In_SDT))
+        if ((cache->flags[seenIndex] & CacheFlag_Not_Seen_In_PAT) &&
+            (cache->flags[seenIndex] & CacheFlag_Not_Seen_In_SDT))
         {
             exists = FALSE;
         }
@@ -765,16 +804,16 @@ bool CacheServiceSeen(Service_t *service, bool seen, bool pat)
     return exists;
 }
 
-void CacheServiceDelete(Service_t *service)
+void CacheServiceDelete(Cache_t *cache, Service_t *service)
 {
     CacheUpdateMessage_t *msg;
     int deletedIndex = -1;
     int i;
-    pthread_mutex_lock(&cacheUpdateMutex);
+    pthread_mutex_lock(&cache->updateMutex);
 
-    for (i = 0; i < cachedServicesCount; i ++)
+    for (i = 0; i < cache->servicesCount; i ++)
     {
-        if ((cachedServices[i]) && ServiceAreEqual(service, cachedServices[i]))
+        if ((cache->services[i]) && ServiceAreEqual(service, cache->services[i]))
         {
             deletedIndex = i;
             break;
@@ -784,21 +823,21 @@ void CacheServiceDelete(Service_t *service)
     if (deletedIndex != -1)
     {
         LogModule(LOG_DEBUG, CACHE, "Removing service at index %d\n", deletedIndex);
-        if (cachedPIDs[deletedIndex])
+        if (cache->pids[deletedIndex])
         {
             /* Get rid of the pids as we don't need them any more! */
-            ObjectRefDec(cachedPIDs[deletedIndex]);
+            ObjectRefDec(cache->pids[deletedIndex]);
         }
 
         
-        cachedServicesCount --;
+        cache->servicesCount --;
         /* Remove the deleted service from the list */
-        for (i = deletedIndex; i < cachedServicesCount; i ++)
+        for (i = deletedIndex; i < cache->servicesCount; i ++)
         {
-            LogModule(LOG_DEBUG, CACHE, "Moving %s (%x) to %d\n", cachedServices[i + 1]->name, cachedServices[i + 1]->id, i);
-            cachedPIDs[i] = cachedPIDs[i + 1];
-            cachedServices[i] = cachedServices[i + 1];
-            cacheFlags[i] = cacheFlags [i + 1];
+            LogModule(LOG_DEBUG, CACHE, "Moving %s (%x) to %d\n", cache->services[i + 1]->name, cache->services[i + 1]->id, i);
+            cache->pids[i] = cache->pids[i + 1];
+            cache->services[i] = cache->services[i + 1];
+            cache->flags[i] = cache->flags[i + 1];
         }
 
         msg = ObjectCreateType(CacheUpdateMessage_t);
@@ -812,33 +851,33 @@ void CacheServiceDelete(Service_t *service)
         }
     }
 
-    pthread_mutex_unlock(&cacheUpdateMutex);
+    pthread_mutex_unlock(&cache->updateMutex);
 }
 
-void CacheWriteback()
+void CacheWriteback(Cache_t *cache)
 {
   /* Do nothing, move to CacheUpdateProcessor. */
 }
 
-static void CacheServicesFree()
+static void CacheServicesFree(Cache_t *cache)
 {
     int i;
-    for (i = 0; i < cachedServicesCount; i ++)
+    for (i = 0; i < cache->servicesCount; i ++)
     {
-        if (cachedServices[i])
+        if (cache->services[i])
         {
-            ServiceRefDec(cachedServices[i]);
-            cachedServices[i] = NULL;
+            ServiceRefDec(cache->services[i]);
+            cache->services[i] = NULL;
         }
-        if (cachedPIDs[i])
+        if (cache->pids[i])
         {
-            ObjectRefDec(cachedPIDs[i]);
-            cachedPIDs[i] = NULL;
+            ObjectRefDec(cache->pids[i]);
+            cache->pids[i] = NULL;
         }
     }
-    cachedServicesCount = 0;
-    MultiplexRefDec(cachedServicesMultiplex);
-    cachedServicesMultiplex = NULL;
+    cache->servicesCount = 0;
+    MultiplexRefDec(cache->multiplex);
+    cache->multiplex = NULL;
 }
 
 static void CacheProcessUpdateMessage(void *ptr)
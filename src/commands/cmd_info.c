@@ -79,8 +79,13 @@ static void CommandGetProperty(int argc, char **argv);
 static void CommandSetProperty(int argc, char **argv);
 static void CommandPropertyInfo(int argc, char **argv);
 static void CommandDumpTSReader(int argc, char **argv);
+static void PrintSectionFilterList(TSSectionFilterList_t *sfList);
+static void PrintSectionFilter(TSSectionFilter_t *filter);
 static void CommandListLNBs(int argc, char **argv);
+static void CommandListAdapters(int argc, char **argv);
+static void CommandTuneAdapter(int argc, char **argv);
 static char* GetPropertyTypeString(PropertyType_e type);
+static int ParseAdapterIndex(char *argument);
 
 /*******************************************************************************
 * Global variables                                                             *
@@ -162,10 +167,11 @@ Command_t CommandDetailsInfo[] =
     },
     {
         "festatus",
-        0, 0,
+        0, 1,
         "Displays the status of the tuner.",
+        "festatus [adapter index]\n"
         "Displays whether the front end is locked, the bit error rate and signal to noise"
-        "ratio and the signal strength",
+        "ratio and the signal strength of the primary or specified adapter.",
         CommandFEStatus
     },
     {
@@ -222,6 +228,24 @@ Command_t CommandDetailsInfo[] =
         "List the LNBs that dvbstreamer knows about and the name used to select them",
         CommandListLNBs 
     },
+    {
+        "lsadapters",
+        0,0,
+        "List adapters in use",
+        "List the adapters in use by this instance, their type and the multiplex they are tuned to.\n"
+        "Adapter 0 is the primary adapter.",
+        CommandListAdapters
+    },
+    {
+        "tuneadapter",
+        2,2,
+        "Tune a secondary adapter to a multiplex",
+        "tuneadapter <adapter index> <multiplex>\n"
+        "Tune a secondary adapter to the specified multiplex (uid, netid.tsid or frequency).\n"
+        "Services on the multiplex can then be streamed with service filters added to "
+        "the adapter, the primary adapter is tuned by selecting a service.",
+        CommandTuneAdapter
+    },
     COMMANDS_SENTINEL
 };
 
@@ -571,8 +595,19 @@ static void CommandFEStatus(int argc, char **argv)
 {
     DVBFrontEndStatus_e status;
     unsigned int ber, strength, snr, ucblocks;
+    DVBAdapter_t *adapter = MainDVBAdapterGet();
+
+    if (argc == 1)
+    {
+        adapter = MainDVBAdapterGetByIndex(ParseAdapterIndex(argv[0]));
+        if (!adapter)
+        {
+            CommandError(COMMAND_ERROR_GENERIC, "Unknown adapter index!");
+            return;
+        }
+    }
 
-    if (DVBFrontEndStatus(MainDVBAdapterGet(), &status, &ber, &strength, &snr, &ucblocks))
+    if (DVBFrontEndStatus(adapter, &status, &ber, &strength, &snr, &ucblocks))
     {
         CommandPrintf("Failed to get frontend status!\n");
         return;
@@ -598,6 +633,54 @@ static void CommandFEParams(int argc, char **argv)
     free(params);
 }
 
+static void CommandListAdapters(int argc, char **argv)
+{
+    int i;
+    for (i = 0; i < MainAdapterCount(); i ++)
+    {
+        DVBAdapter_t *adapter = MainDVBAdapterGetByIndex(i);
+        Multiplex_t *multiplex = TuningAdapterMultiplexGet(i);
+        if (multiplex)
+        {
+            CommandPrintf("%d : %s adapter %d (multiplex %d%s)\n", i, DVBAdapterTypeNameGet(adapter),
+                DVBAdapterNumberGet(adapter), multiplex->uid, DVBFrontEndIsLocked(adapter) ? ", locked" : "");
+            MultiplexRefDec(multiplex);
+        }
+        else
+        {
+            CommandPrintf("%d : %s adapter %d\n", i, DVBAdapterTypeNameGet(adapter), DVBAdapterNumberGet(adapter));
+        }
+    }
+}
+
+static void CommandTuneAdapter(int argc, char **argv)
+{
+    int index;
+    Multiplex_t *multiplex;
+
+    CommandCheckAuthenticated();
+
+    index = ParseAdapterIndex(argv[0]);
+    if ((index <= 0) || (index >= MainAdapterCount()))
+    {
+        CommandError(COMMAND_ERROR_GENERIC, "Not a secondary adapter index!");
+        return;
+    }
+
+    multiplex = MultiplexFind(argv[1]);
+    if (!multiplex)
+    {
+        CommandError(COMMAND_ERROR_GENERIC, "Multiplex not found!");
+        return;
+    }
+
+    if (!TuningAdapterMultiplexSet(index, multiplex))
+    {
+        CommandError(COMMAND_ERROR_GENERIC, "Failed to tune adapter!");
+    }
+    MultiplexRefDec(multiplex);
+}
+
 static void CommandListPids(int argc, char **argv)
 {
     Service_t *service;
@@ -607,7 +690,7 @@ static void CommandListPids(int argc, char **argv)
     {
         bool cached = TRUE;
         int i;
-        ProgramInfo_t *info;
+        ProgramInfo_t *info = NULL;
         bool numericOutput = FALSE;
             
         if ((argc == 2) && (strcmp(argv[1], "-n") == 0))
@@ -615,7 +698,10 @@ static void CommandListPids(int argc, char **argv)
             numericOutput =TRUE;
         }
         
-        info = CacheProgramInfoGet(service);
+        for (i = 0; (i < MainAdapterCount()) && (info == NULL); i ++)
+        {
+            info = CacheProgramInfoGet(CacheGet(i), service);
+        }
         if (info == NULL)
         {
             info = ProgramInfoGet(service);
@@ -835,29 +921,30 @@ static void CommandDumpTSReader(int argc, char **argv)
 
     for (p = 0; p < TSREADER_NROF_FILTERS; p ++)
     {
-        count += reader->packetFilters[p] == NULL ? 0:1;
+        count += reader->packetDispatch[p] == NULL ? 0:1;
     }
     
     CommandPrintf("PID Filters (%d)\n",count);
     for (p = 0; p < TSREADER_NROF_FILTERS; p ++)
     {
-        TSPacketFilter_t *filter;
-        if (reader->packetFilters[p] == NULL)
+        TSPacketDispatchList_t *list = reader->packetDispatch[p];
+        int e;
+        if (list == NULL)
         {
             continue;
         }
         CommandPrintf("    0x%04x : ", p);
-        for (filter = reader->packetFilters[p]; filter; filter = filter->flNext)
+        for (e = 0; e < list->count; e ++)
         {
-            if (filter->group)
+            if (list->entries[e].group)
             {
-                CommandPrintf("\"%s\"", filter->group->name);
+                CommandPrintf("\"%s\"", list->entries[e].group->name);
             }
             else
             {
                 CommandPrintf("<Section Filter>");
             }
-            if (filter->flNext)
+            if (e + 1 < list->count)
             {
                 CommandPrintf(", ");
             }
@@ -871,30 +958,58 @@ static void CommandDumpTSReader(int argc, char **argv)
     CommandPrintf("Section filters - Active (%d)\n", ListCount(reader->activeSectionFilters));
     ListIterator_ForEach(iterator, reader->activeSectionFilters)
     {
-        ListIterator_t iterator_sf;
-        TSSectionFilterList_t *sfList = ListIterator_Current(iterator);
-        TSSectionFilter_t *sf;
-        CommandPrintf("    0x%04x\n", sfList->pid);
-        ListIterator_ForEach(iterator_sf, sfList->filters)
-        {
-            sf = ListIterator_Current(iterator_sf);
-            CommandPrintf("        %s\n", sf->group->name);
-        }
+        PrintSectionFilterList(ListIterator_Current(iterator));
     }
     CommandPrintf("Section filters - Awaiting scheduling (%d)\n", ListCount(reader->sectionFilters));
     ListIterator_ForEach(iterator, reader->sectionFilters)
     {
-        ListIterator_t iterator_sf;
-        TSSectionFilterList_t *sfList = ListIterator_Current(iterator);
-        TSSectionFilter_t *sf;
-        CommandPrintf("    0x%04x\n", sfList->pid);
-        ListIterator_ForEach(iterator_sf, sfList->filters)
+        PrintSectionFilterList(ListIterator_Current(iterator));
+    }
+    TSReaderUnLock(reader);
+}
+
+static void PrintSectionFilterList(TSSectionFilterList_t *sfList)
+{
+    ListIterator_t iterator;
+
+    SectionCache_t *cache = &sfList->cache;
+    unsigned long long cached = cache->hits + cache->misses;
+
+    CommandPrintf("    0x%04x (cache hits %llu misses %llu (%.1f%% hit) flushes %llu, %u/%u entries, %llu replaced, filtered %llu)\n",
+        sfList->pid, cache->hits, cache->misses, cached ? (cache->hits * 100.0) / cached : 0.0,
+        cache->flushes, cache->count, cache->entries ? (1U << cache->bits) : 0, cache->replaced,
+        sfList->filteredSections);
+    if (sfList->firstSectionTime < 0.0)
+    {
+        CommandPrintf("        First section : waiting (%dms)\n", (int)((ev_time() - sfList->acquireStart) * 1000));
+    }
+    else
+    {
+        CommandPrintf("        First section : %dms\n", (int)(sfList->firstSectionTime * 1000));
+    }
+    CommandPrintf("        Cycle time    : %dms\n", (int)(sfList->cycleTime * 1000));
+    CommandPrintf("        Slots         : %llu\n", sfList->slots);
+    ListIterator_ForEach(iterator, sfList->filters)
+    {
+        PrintSectionFilter(ListIterator_Current(iterator));
+    }
+}
+
+static void PrintSectionFilter(TSSectionFilter_t *filter)
+{
+    int i;
+    CommandPrintf("        %s", filter->group->name);
+    if (filter->matchDepth)
+    {
+        CommandPrintf(" (match");
+        for (i = 0; i < filter->matchDepth; i ++)
         {
-            sf = ListIterator_Current(iterator_sf);
-            CommandPrintf("        %s\n", sf->group->name);
+            CommandPrintf(" %02x/%02x%s", filter->match.filter[i], filter->match.mask[i], 
+                filter->match.mode[i] ? "!" : "");
         }
+        CommandPrintf(")");
     }
-    TSReaderUnLock(reader);
+    CommandPrintf("\n");
 }
 
 static void CommandListLNBs(int argc, char **argv)
@@ -950,4 +1065,13 @@ static char* GetPropertyTypeString(PropertyType_e type)
     return typeStr;
 }
 
-
+static int ParseAdapterIndex(char *argument)
+{
+    char *end;
+    int index = (int)strtol(argument, &end, 10);
+    if ((*argument == 0) || (*end != 0))
+    {
+        return -1;
+    }
+    return index;
+}
@@ -1427,6 +1427,11 @@ static void VCTEventListener(void *arg, Event_t event, void *payload)
 
 static void FELockedEventListener(void *arg, Event_t event, void *payload)
 {
+    /* Only the primary adapter is used for scanning, ignore the others. */
+    if (payload != MainDVBAdapterGet())
+    {
+        return;
+    }
     if (currentScanState == ScanState_NextMux)
     {
         ScanStateMachine(ScanEvent_FELocked);
@@ -55,8 +55,7 @@ Command functions for service filter related tasks
 
 #define FIND_SERVICE_FILTER(_name) \
     {\
-        TSReader_t *reader = MainTSReaderGet();\
-        filter = ServiceFilterFindFilter(reader, _name); \
+        filter = FindServiceFilter(_name); \
         if (filter == NULL) \
         {\
             CommandError(COMMAND_ERROR_GENERIC, "Service filter not found!"); \
@@ -84,6 +83,8 @@ static void CommandGetSFService(int argc, char **argv);
 static void CommandSetSFMRL(int argc, char **argv);
 static void CommandGetSFMRL(int argc, char **argv);
 
+static ServiceFilter_t FindServiceFilter(const char *name);
+
 /*******************************************************************************
 * Global variables                                                             *
 *******************************************************************************/
@@ -119,10 +120,12 @@ Command_t CommandDetailsServiceFilter[] =
     },    
     {
         "addsf",
-        2, 2,
+        2, 3,
         "Add a service filter.",
-        "addsf <service filter name> <mrl>\n"
-        "Adds a new destination for sending a secondary service to.",
+        "addsf <service filter name> <mrl> [adapter index]\n"
+        "Adds a new destination for sending a secondary service to.\n"
+        "If an adapter index is given the service filter is added to that adapter "
+        "instead of the primary adapter.",
         CommandAddSF
     },
     {
@@ -137,7 +140,8 @@ Command_t CommandDetailsServiceFilter[] =
         "lssfs",
         0, 1,
         "List all service filters.",
-        "List all service filters their names, destinations and currently selected service.",
+        "List all service filters their names, destinations and currently selected service.\n"
+        "Service filters on secondary adapters are listed with the adapter index.",
         CommandListSF
     },
     {
@@ -146,6 +150,8 @@ Command_t CommandDetailsServiceFilter[] =
         "Set the service to be filtered by a service filter.",
         "setsf <service filter name> <service name>\n"
         "Selects the service to be filtered by the service filter.\n"
+        "If the service filter is on a secondary adapter and the service is on a "
+        "different multiplex, the adapter is tuned to the service's multiplex.\n"
         "Cannot be used for the primary service filter (<Primary>), use \'select\' instead",
         CommandSetSFService
     },
@@ -257,7 +263,20 @@ static void CommandAddSF(int argc, char **argv)
     ServiceFilter_t filter;
     
     CommandCheckAuthenticated();
-    filter = ServiceFilterFindFilter(tsReader, argv[0]);
+
+    if (argc == 3)
+    {
+        char *end;
+        int index = (int)strtol(argv[2], &end, 10);
+        tsReader = (*end == 0) ? MainTSReaderGetByIndex(index) : NULL;
+        if (!tsReader)
+        {
+            CommandError(COMMAND_ERROR_GENERIC, "Unknown adapter index!");
+            return;
+        }
+    }
+
+    filter = FindServiceFilter(argv[0]);
     if (filter)
     {
         CommandError(COMMAND_ERROR_GENERIC, "Service Filter of that name already exists!");
@@ -295,8 +314,8 @@ static void CommandRemoveSF(int argc, char **argv)
 static void CommandListSF(int argc, char **argv)
 {
     ListIterator_t iterator;
-    TSReader_t *reader = MainTSReaderGet();
     bool fullListing = FALSE;
+    int i;
     
     if (argc == 1)
     {
@@ -305,33 +324,41 @@ static void CommandListSF(int argc, char **argv)
             fullListing = TRUE;
         }
     }
-    ListIterator_ForEach(iterator, reader->groups)
+    for (i = 0; i < MainAdapterCount(); i ++)
     {
-        TSFilterGroup_t *group = ListIterator_Current(iterator);
-        if (strcmp(group->type, ServiceFilterGroupType) == 0)
+        TSReader_t *reader = MainTSReaderGetByIndex(i);
+        ListIterator_ForEach(iterator, reader->groups)
         {
-            ServiceFilter_t filter = group->userArg;
-            char *name = ServiceFilterNameGet(filter);
-            if (fullListing)
+            TSFilterGroup_t *group = ListIterator_Current(iterator);
+            if (strcmp(group->type, ServiceFilterGroupType) == 0)
             {
-                Service_t *service = ServiceFilterServiceGet(filter);
-                char *serviceIdName = NULL;
-                if (service)
+                ServiceFilter_t filter = group->userArg;
+                char *name = ServiceFilterNameGet(filter);
+                if (fullListing)
                 {
-                    serviceIdName = ServiceGetIDNameStr(service, NULL);
+                    Service_t *service = ServiceFilterServiceGet(filter);
+                    char *serviceIdName = NULL;
+                    if (service)
+                    {
+                        serviceIdName = ServiceGetIDNameStr(service, NULL);
+                    }
+                    DeliveryMethodInstance_t *dmInstance = ServiceFilterDeliveryMethodGet(filter);
+                    CommandPrintf("%-10s : { mrl: \"%s\", service: { %s }, adapter: %d }\n", name,
+                            DeliveryMethodGetMRL(dmInstance),
+                            serviceIdName ? serviceIdName:"", i);
+                    if (serviceIdName)
+                    {
+                        free(serviceIdName);
+                    }
                 }
-                DeliveryMethodInstance_t *dmInstance = ServiceFilterDeliveryMethodGet(filter);
-                CommandPrintf("%-10s : { mrl: \"%s\", service: { %s } }\n", name,
-                        DeliveryMethodGetMRL(dmInstance),
-                        serviceIdName ? serviceIdName:"");
-                if (serviceIdName)
+                else if (i == 0)
                 {
-                    free(serviceIdName);
+                    CommandPrintf("%s\n", name);
+                }
+                else
+                {
+                    CommandPrintf("%s (adapter %d)\n", name, i);
                 }
-            }
-            else
-            {
-                CommandPrintf("%s\n", name);
             }
         }
     }
@@ -344,6 +371,7 @@ static void CommandSetSFService(int argc, char **argv)
     char *serviceName = argv[1];
     Service_t *service;
     char *idName;
+    int index;
     
     CommandCheckAuthenticated();
 
@@ -368,6 +396,27 @@ static void CommandSetSFService(int argc, char **argv)
         return;
     }
 
+    index = DVBAdapterIndexGet(ServiceFilterTSReaderGet(filter)->adapter);
+    if (index > 0)
+    {
+        /* Secondary adapters are tuned to the multiplex of the service. */
+        Multiplex_t *current = TuningAdapterMultiplexGet(index);
+        if ((current == NULL) || (current->uid != service->multiplexUID))
+        {
+            Multiplex_t *multiplex = MultiplexFindUID(service->multiplexUID);
+            bool tuned = multiplex && TuningAdapterMultiplexSet(index, multiplex);
+            MultiplexRefDec(multiplex);
+            if (!tuned)
+            {
+                MultiplexRefDec(current);
+                ServiceRefDec(service);
+                CommandError(COMMAND_ERROR_GENERIC, "Failed to tune adapter!");
+                return;
+            }
+        }
+        MultiplexRefDec(current);
+    }
+
     ServiceFilterServiceSet(filter,service);
     idName = ServiceGetIDNameStr(service, NULL);   
     CommandPrintf("%s\n",idName);
@@ -456,3 +505,14 @@ static void CommandGetSFAVSOnly(int argc, char **argv)
     CommandPrintf("%s : A/V/S Only = %s\n", argv[0], avsOnly ? "On":"Off");
 }
 
+
+static ServiceFilter_t FindServiceFilter(const char *name)
+{
+    ServiceFilter_t filter = NULL;
+    int i;
+    for (i = 0; (i < MainAdapterCount()) && !filter; i ++)
+    {
+        filter = ServiceFilterFindFilter(MainTSReaderGetByIndex(i), name);
+    }
+    return filter;
+}
@@ -26,6 +26,7 @@ Delivery Method management functions.
 #include "logging.h"
 #include "list.h"
 #include "deliverymethod.h"
+#include "asyncoutput.h"
 /*******************************************************************************
 * Prototypes                                                                   *
 *******************************************************************************/
@@ -33,6 +34,7 @@ Delivery Method management functions.
 bool NullOutputCanHandle(char *mrl);
 DeliveryMethodInstance_t *NullOutputCreate(char *arg);
 void NullOutputDestroy(DeliveryMethodInstance_t *this);
+static DeliveryMethodInstance_t *CreateInstance(char *mrl);
 /*******************************************************************************
 * Global variables                                                             *
 *******************************************************************************/
@@ -55,6 +57,7 @@ static DeliveryMethodInstanceOps_t nullInstanceOps = {
     NULL,
     NullOutputDestroy,
     NULL,
+    NULL,
     NULL
 };
 
@@ -81,6 +84,7 @@ int DeliveryMethodManagerInit(void)
         return -1;
     }
     DeliveryMethodManagerRegister(&NullOutputHandler);
+    DeliveryMethodManagerRegister(&AsyncOutputHandler);
     return 0;
 }
 
@@ -106,31 +110,19 @@ void DeliveryMethodManagerUnRegister(DeliveryMethodHandler_t *handler)
 
 DeliveryMethodInstance_t *DeliveryMethodCreate(char *mrl)
 {
-    ListIterator_t iterator;
-    DeliveryMethodInstance_t *instance = NULL;
-    LogModule(LOG_DEBUG, DELIVERYMETHOD, "Looking for handler for %s", mrl);
-    for ( ListIterator_Init(iterator, DeliveryMethodsList); ListIterator_MoreEntries(iterator); ListIterator_Next(iterator))
+    DeliveryMethodInstance_t *instance = CreateInstance(mrl);
+    if (instance)
     {
-        DeliveryMethodHandler_t *handler = ListIterator_Current(iterator);
-        LogModule(LOG_DEBUG, DELIVERYMETHOD, "Checking handler %p", handler);
-        if (handler->CanHandle(mrl))
-        {
-            instance = handler->CreateInstance(mrl);
-            if (instance)
-            {
-                if (instance->mrl == NULL)
-                {
-                    LogModule(LOG_DEBUG, DELIVERYMETHOD, "MRL field not set when creating instance for %s", mrl);
-                }
-                ListAdd(InstancesList, instance);
-                LogModule(LOG_DEBUG, DELIVERYMETHOD, "Created DeliveryMethodInstance(%p) for %s\n",instance, instance->mrl);
-                break;
-            }
-        }
+        ListAdd(InstancesList, instance);
     }
     return instance;
 }
 
+DeliveryMethodInstance_t *DeliveryMethodCreateWrapped(char *mrl)
+{
+    return CreateInstance(mrl);
+}
+
 void DeliveryMethodDestroy(DeliveryMethodInstance_t *instance)
 {
     LogModule(LOG_DEBUG, DELIVERYMETHOD, "Released DeliveryMethodInstance(%p) for %s\n" ,instance, instance->mrl);
@@ -179,6 +171,30 @@ void DeliveryMethodOutputPacket(DeliveryMethodInstance_t *instance, TSPacket_t*
     }
 }
 
+void DeliveryMethodOutputPackets(DeliveryMethodInstance_t *instance, TSPacket_t **packets, int count)
+{
+    if (instance->ops->OutputPackets)
+    {
+        instance->ops->OutputPackets(instance, packets, count);
+    }
+    else if (instance->ops->OutputPacket)
+    {
+        int i;
+        for (i = 0; i < count; i ++)
+        {
+            instance->ops->OutputPacket(instance, packets[i]);
+        }
+    }
+}
+
+void DeliveryMethodFlush(DeliveryMethodInstance_t *instance)
+{
+    if (instance->ops->Flush)
+    {
+        instance->ops->Flush(instance);
+    }
+}
+
 void DeliveryMethodOutputBlock(DeliveryMethodInstance_t *instance, void *block, unsigned long blockLen)
 {
     if (instance->ops->OutputBlock)
@@ -187,6 +203,35 @@ void DeliveryMethodOutputBlock(DeliveryMethodInstance_t *instance, void *block,
     }
 }
 
+/*******************************************************************************
+* Local Functions                                                              *
+*******************************************************************************/
+static DeliveryMethodInstance_t *CreateInstance(char *mrl)
+{
+    ListIterator_t iterator;
+    DeliveryMethodInstance_t *instance = NULL;
+    LogModule(LOG_DEBUG, DELIVERYMETHOD, "Looking for handler for %s", mrl);
+    for ( ListIterator_Init(iterator, DeliveryMethodsList); ListIterator_MoreEntries(iterator); ListIterator_Next(iterator))
+    {
+        DeliveryMethodHandler_t *handler = ListIterator_Current(iterator);
+        LogModule(LOG_DEBUG, DELIVERYMETHOD, "Checking handler %p", handler);
+        if (handler->CanHandle(mrl))
+        {
+            instance = handler->CreateInstance(mrl);
+            if (instance)
+            {
+                if (instance->mrl == NULL)
+                {
+                    LogModule(LOG_DEBUG, DELIVERYMETHOD, "MRL field not set when creating instance for %s", mrl);
+                }
+                LogModule(LOG_DEBUG, DELIVERYMETHOD, "Created DeliveryMethodInstance(%p) for %s\n",instance, instance->mrl);
+                break;
+            }
+        }
+    }
+    return instance;
+}
+
 /*******************************************************************************
 * NULL Delivery Method Functions                                                    *
 *******************************************************************************/
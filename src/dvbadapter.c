@@ -47,6 +47,7 @@ Opens/Closes and setups dvb adapter for use in the rest of the application.
 #include "properties.h"
 #include "dispatchers.h"
 #include "yamlutils.h"
+#include "adapter_private.h"
 
 /*******************************************************************************
 * Defines                                                                      *
@@ -153,6 +154,7 @@ typedef struct DVBSatelliteSettings_s
 
 struct DVBAdapter_s
 {
+    DVBAdapterCommon_t common;        /**< MUST BE FIRST FIELD */
     int adapter;                      /**< The adapter number ie /dev/dvb/adapter<#adapter> */
 
     struct dvb_frontend_info info;    /**< Information about the front end */
@@ -206,6 +208,29 @@ typedef struct StringToParamMapping_s
 /*******************************************************************************
 * Prototypes                                                                   *
 *******************************************************************************/
+static DVBAdapter_t *LinuxDVBInit(DVBAdapterCommon_t *common, int adapter, bool hwRestricted, bool forceISDB);
+static void LinuxDVBDispose(DVBAdapter_t *adapter);
+static DVBSupportedDeliverySys_t *LinuxDVBFrontEndGetDeliverySystems(DVBAdapter_t *adapter);
+static bool LinuxDVBFrontEndDeliverySystemSupported(DVBAdapter_t * adapter,DVBDeliverySystem_e system);
+static int LinuxDVBFrontEndTune(DVBAdapter_t *adapter, DVBDeliverySystem_e system, char *params);
+static char* LinuxDVBFrontEndParametersGet(DVBAdapter_t *adapter, DVBDeliverySystem_e *system);
+static bool LinuxDVBFrontEndParameterSupported(DVBAdapter_t *adapter, DVBDeliverySystem_e system, char *param, char *value);
+static void LinuxDVBFrontEndLNBInfoSet(DVBAdapter_t *adapter, LNBInfo_t *lnbInfo);
+static void LinuxDVBFrontEndLNBInfoGet(DVBAdapter_t *adapter, LNBInfo_t *lnbInfo);
+static int LinuxDVBFrontEndStatus(DVBAdapter_t *adapter, DVBFrontEndStatus_e *status,
+                            unsigned int *ber, unsigned int *strength,
+                            unsigned int *snr, unsigned int *ucblock);
+static bool LinuxDVBFrontEndIsLocked(DVBAdapter_t *adapter);
+static int LinuxDVBFrontEndSetActive(DVBAdapter_t *adapter, bool active);
+static int LinuxDVBDemuxSetBufferSize(DVBAdapter_t *adapter, unsigned long size);
+static int LinuxDVBDemuxGetMaxFilters(DVBAdapter_t *adapter);
+static int LinuxDVBDemuxGetAvailableFilters(DVBAdapter_t *adapter);
+static bool LinuxDVBDemuxIsHardwareRestricted(DVBAdapter_t *adapter);
+static int LinuxDVBDemuxAllocateFilter(DVBAdapter_t *adapter, uint16_t pid);
+static int LinuxDVBDemuxReleaseFilter(DVBAdapter_t *adapter, uint16_t pid);
+static int LinuxDVBDemuxReleaseAllFilters(DVBAdapter_t *adapter);
+static int LinuxDVBDVRGetFD(DVBAdapter_t *adapter);
+
 static int DVBFrontEndSatelliteSetup(DVBAdapter_t *adapter);
 static int DVBDemuxStartFilter(DVBAdapter_t *adapter, DVBAdapterPIDFilter_t *filter);
 static int DVBDemuxStopFilter(DVBAdapter_t *adapter, DVBAdapterPIDFilter_t *filter);
@@ -218,8 +243,6 @@ static void DVBFrontendCallback(struct ev_loop *loop, ev_io *w, int revents);
 static void DVBCommandSend(DVBAdapter_t *adapter, char cmd);
 
 
-static int DVBEventToString(yaml_document_t *document, Event_t event, void *payload);
-
 static int DVBPropertyActiveGet(void *userArg, PropertyValue_t *value);
 static int DVBPropertyActiveSet(void *userArg, PropertyValue_t *value);
 static int DVBPropertyDeliverySystemsGet(void *userArg, PropertyValue_t *value);
@@ -255,15 +278,30 @@ static void ConvertDTVPropertiesToYaml(DVBDeliverySystem_e delSys, struct dtv_pr
 * Global variables                                                             *
 *******************************************************************************/
 static const char DVBADAPTER[] = "DVBAdapter";
-static const char propertyParent[] = "adapter";
-static const char lnbPropertyParent[] = "adapter.lnb";
 
-static EventSource_t dvbSource = NULL;
-static Event_t lockedEvent;
-static Event_t unlockedEvent;
-static Event_t tuningFailedEvent;
-static Event_t feActiveEvent;
-static Event_t feIdleEvent;
+DVBAdapterOps_t LinuxDVBAdapterOps = {
+    "DVB",
+    LinuxDVBInit,
+    LinuxDVBDispose,
+    LinuxDVBFrontEndGetDeliverySystems,
+    LinuxDVBFrontEndDeliverySystemSupported,
+    LinuxDVBFrontEndTune,
+    LinuxDVBFrontEndParametersGet,
+    LinuxDVBFrontEndParameterSupported,
+    LinuxDVBFrontEndLNBInfoSet,
+    LinuxDVBFrontEndLNBInfoGet,
+    LinuxDVBFrontEndStatus,
+    LinuxDVBFrontEndIsLocked,
+    LinuxDVBFrontEndSetActive,
+    LinuxDVBDemuxSetBufferSize,
+    LinuxDVBDemuxIsHardwareRestricted,
+    LinuxDVBDemuxGetMaxFilters,
+    LinuxDVBDemuxGetAvailableFilters,
+    LinuxDVBDemuxAllocateFilter,
+    LinuxDVBDemuxReleaseFilter,
+    LinuxDVBDemuxReleaseAllFilters,
+    LinuxDVBDVRGetFD
+};
 
 static const char TAG_FREQUENCY[]        = "Frequency";
 static const char TAG_INVERSION[]        = "Inversion";
@@ -397,22 +435,14 @@ static struct dtv_properties ClearFrontEndProperties = {
 /*******************************************************************************
 * Global functions                                                             *
 *******************************************************************************/
-DVBAdapter_t *DVBInit(int adapter, bool hwRestricted, bool forceISDB)
+static DVBAdapter_t *LinuxDVBInit(DVBAdapterCommon_t *common, int adapter, bool hwRestricted, bool forceISDB)
 {
     DVBAdapter_t *result = NULL;
     int monitorFds[2];
     struct ev_loop *inputLoop;
     bool lnbInput = FALSE;
+    char lnbPropertyParent[DVBADAPTER_MAX_PROPERTY_PATH + 4];
 
-    if (dvbSource == NULL)
-    {
-        dvbSource = EventsRegisterSource("DVBAdapter");
-        lockedEvent = EventsRegisterEvent(dvbSource, "Locked", DVBEventToString);
-        unlockedEvent = EventsRegisterEvent(dvbSource, "Unlocked", DVBEventToString);
-        tuningFailedEvent = EventsRegisterEvent(dvbSource, "TuneFailed", DVBEventToString);
-        feActiveEvent  = EventsRegisterEvent(dvbSource, "FrontEndActive", DVBEventToString);
-        feIdleEvent  = EventsRegisterEvent(dvbSource, "FrontEndIdle", DVBEventToString);
-    }
     ObjectRegisterType(DVBAdapter_t);
     ObjectRegisterCollection(TOSTRING(DVBSupportedDeliverySys_t), sizeof(DVBDeliverySystem_e), NULL);
     result = (DVBAdapter_t*)ObjectCreateType(DVBAdapter_t);
@@ -420,6 +450,7 @@ DVBAdapter_t *DVBInit(int adapter, bool hwRestricted, bool forceISDB)
     {
         int i;
 
+        result->common = *common;
         result->frontEndFd = -1;
         result->dvrFd = -1;
         result->adapter = adapter;
@@ -606,21 +637,22 @@ DVBAdapter_t *DVBInit(int adapter, bool hwRestricted, bool forceISDB)
         ev_io_start(inputLoop, &result->commandWatcher);
 
         /* Add properties */
-        PropertiesAddSimpleProperty(propertyParent, "number", "The number of the adapter being used",
+        PropertiesAddSimpleProperty(result->common.propertyPath, "number", "The number of the adapter being used",
             PropertyType_Int, &result->adapter, SIMPLEPROPERTY_R);
-        PropertiesAddSimpleProperty(propertyParent, "name", "Hardware driver name",
+        PropertiesAddSimpleProperty(result->common.propertyPath, "name", "Hardware driver name",
             PropertyType_String, result->info.name, SIMPLEPROPERTY_R);
-        PropertiesAddSimpleProperty(propertyParent, "hwrestricted", "Whether the hardware is not capable of supplying the entire TS.",
+        PropertiesAddSimpleProperty(result->common.propertyPath, "hwrestricted", "Whether the hardware is not capable of supplying the entire TS.",
             PropertyType_Boolean, &result->hardwareRestricted, SIMPLEPROPERTY_R);
-        PropertiesAddSimpleProperty(propertyParent, "maxfilters", "The maximum number of PID filters available.",
+        PropertiesAddSimpleProperty(result->common.propertyPath, "maxfilters", "The maximum number of PID filters available.",
             PropertyType_Boolean, &result->maxFilters, SIMPLEPROPERTY_R);
-        PropertiesAddProperty(propertyParent, "systems", "The broadcast systems the frontend is capable of receiving",
+        PropertiesAddProperty(result->common.propertyPath, "systems", "The broadcast systems the frontend is capable of receiving",
             PropertyType_String, result, DVBPropertyDeliverySystemsGet, NULL);
-        PropertiesAddProperty(propertyParent, "active","Whether the frontend is currently in use.",
+        PropertiesAddProperty(result->common.propertyPath, "active","Whether the frontend is currently in use.",
             PropertyType_Boolean, result,DVBPropertyActiveGet,DVBPropertyActiveSet);
         if (lnbInput)
         {
-            PropertiesAddProperty(propertyParent, "lnb",
+            sprintf(lnbPropertyParent, "%s.lnb", result->common.propertyPath);
+            PropertiesAddProperty(result->common.propertyPath, "lnb",
                 "LNB Name",
                 PropertyType_String, result, DVBPropertyLNBNameGet, DVBPropertyLNBNameSet);
             PropertiesAddProperty(lnbPropertyParent, "sharing",
@@ -640,7 +672,7 @@ DVBAdapter_t *DVBInit(int adapter, bool hwRestricted, bool forceISDB)
     return result;
 }
 
-void DVBDispose(DVBAdapter_t *adapter)
+static void LinuxDVBDispose(DVBAdapter_t *adapter)
 {
     struct ev_loop *inputLoop = DispatchersGetInput();
     if (adapter->dvrFd > -1)
@@ -650,7 +682,7 @@ void DVBDispose(DVBAdapter_t *adapter)
     }
 
     LogModule(LOG_DEBUGV, DVBADAPTER, "Closing Demux file descriptors\n");
-    DVBDemuxReleaseAllFilters(adapter);
+    LinuxDVBDemuxReleaseAllFilters(adapter);
     ev_io_stop(inputLoop, &adapter->frontendWatcher);
     ev_io_stop(inputLoop, &adapter->commandWatcher);
 
@@ -665,17 +697,17 @@ void DVBDispose(DVBAdapter_t *adapter)
     close(adapter->cmdRecvFd);
     close(adapter->cmdSendFd);
 
-    PropertiesRemoveAllProperties(propertyParent);
+    PropertiesRemoveAllProperties(adapter->common.propertyPath);
     ObjectRefDec(adapter->supportedDelSystems);
     ObjectRefDec(adapter);
 }
 
-DVBSupportedDeliverySys_t *DVBFrontEndGetDeliverySystems(DVBAdapter_t *adapter)
+static DVBSupportedDeliverySys_t *LinuxDVBFrontEndGetDeliverySystems(DVBAdapter_t *adapter)
 {
     return adapter->supportedDelSystems;
 }
 
-bool DVBFrontEndDeliverySystemSupported(DVBAdapter_t * adapter,DVBDeliverySystem_e system)
+static bool LinuxDVBFrontEndDeliverySystemSupported(DVBAdapter_t * adapter,DVBDeliverySystem_e system)
 {
     int i;
     for (i = 0; i < adapter->supportedDelSystems->nrofSystems; i ++)
@@ -688,7 +720,7 @@ bool DVBFrontEndDeliverySystemSupported(DVBAdapter_t * adapter,DVBDeliverySystem
     return FALSE;
 }
 
-int DVBFrontEndTune(DVBAdapter_t *adapter, DVBDeliverySystem_e system, char *params)
+static int LinuxDVBFrontEndTune(DVBAdapter_t *adapter, DVBDeliverySystem_e system, char *params)
 {
     yaml_document_t document;
     memset(&document, 0, sizeof(document));
@@ -709,7 +741,7 @@ int DVBFrontEndTune(DVBAdapter_t *adapter, DVBDeliverySystem_e system, char *par
    return 0;
 }
 
-char* DVBFrontEndParametersGet(DVBAdapter_t *adapter, DVBDeliverySystem_e *system)
+static char* LinuxDVBFrontEndParametersGet(DVBAdapter_t *adapter, DVBDeliverySystem_e *system)
 {
     char *output;
     yaml_document_t document;
@@ -738,10 +770,10 @@ char* DVBFrontEndParametersGet(DVBAdapter_t *adapter, DVBDeliverySystem_e *syste
     return output;
 }
 
-bool DVBFrontEndParameterSupported(DVBAdapter_t *adapter, DVBDeliverySystem_e system, char *param, char *value)
+static bool LinuxDVBFrontEndParameterSupported(DVBAdapter_t *adapter, DVBDeliverySystem_e system, char *param, char *value)
 {
     char *AUTO = "AUTO";
-    if (DVBFrontEndDeliverySystemSupported(adapter, system))
+    if (LinuxDVBFrontEndDeliverySystemSupported(adapter, system))
     {
         if (strcmp(param, "Inversion") == 0)
         {
@@ -885,12 +917,12 @@ bool DVBFrontEndParameterSupported(DVBAdapter_t *adapter, DVBDeliverySystem_e sy
 }
 
 
-void DVBFrontEndLNBInfoSet(DVBAdapter_t *adapter, LNBInfo_t *lnbInfo)
+static void LinuxDVBFrontEndLNBInfoSet(DVBAdapter_t *adapter, LNBInfo_t *lnbInfo)
 {
     adapter->lnbInfo = *lnbInfo;
 }
 
-void DVBFrontEndLNBInfoGet(DVBAdapter_t *adapter, LNBInfo_t *lnbInfo)
+static void LinuxDVBFrontEndLNBInfoGet(DVBAdapter_t *adapter, LNBInfo_t *lnbInfo)
 {
     *lnbInfo = adapter->lnbInfo;
 }
@@ -957,7 +989,7 @@ static int DVBFrontEndSatelliteSetup(DVBAdapter_t *adapter)
 }
 
 
-int DVBFrontEndStatus(DVBAdapter_t *adapter, DVBFrontEndStatus_e *status,
+static int LinuxDVBFrontEndStatus(DVBAdapter_t *adapter, DVBFrontEndStatus_e *status,
                             unsigned int *ber, unsigned int *strength,
                             unsigned int *snr, unsigned int *ucblock)
 {
@@ -1025,54 +1057,41 @@ int DVBFrontEndStatus(DVBAdapter_t *adapter, DVBFrontEndStatus_e *status,
     return 0;
 }
 
-bool DVBFrontEndIsLocked(DVBAdapter_t *adapter)
+static bool LinuxDVBFrontEndIsLocked(DVBAdapter_t *adapter)
 {
     return adapter->frontEndLocked;
 }
 
-int DVBFrontEndSetActive(DVBAdapter_t *adapter, bool active)
+static int LinuxDVBFrontEndSetActive(DVBAdapter_t *adapter, bool active)
 {
     DVBCommandSend(adapter, active ? DVB_CMD_FE_ACTIVE:DVB_CMD_FE_INACTIVE);
     return 0;
 }
 
-int DVBDemuxSetBufferSize(DVBAdapter_t *adapter, unsigned long size)
+static int LinuxDVBDemuxSetBufferSize(DVBAdapter_t *adapter, unsigned long size)
 {
-    int i;
-    for (i = 0; i < adapter->maxFilters; i++)
+    /* All PID filters are routed to the DVR device (DMX_OUT_TS_TAP) so it is
+     * the DVR ring buffer that needs to be able to absorb input stalls.
+     */
+    if (adapter->dvrFd == -1)
     {
-        int demuxFd = adapter->filters[0].demuxFd;
-
-        if (demuxFd == -1)
-        {
-            continue;
-        }
-
-        if (ioctl(demuxFd, DMX_STOP, 0)< 0)
-        {
-            LogModule(LOG_ERROR, DVBADAPTER,"DMX_STOP: %s\n", strerror(errno));
-            return -1;
-        }
-        if (ioctl(demuxFd, DMX_SET_BUFFER_SIZE, size) < 0)
-        {
-            LogModule(LOG_ERROR, DVBADAPTER,"DMX_SET_BUFFER_SIZE: %s\n", strerror(errno));
-            return -1;
-        }
-        if (ioctl(demuxFd, DMX_START, 0)< 0)
-        {
-            LogModule(LOG_ERROR, DVBADAPTER,"DMX_STOP: %s\n", strerror(errno));
-            return -1;
-        }
+        return -1;
     }
+    if (ioctl(adapter->dvrFd, DMX_SET_BUFFER_SIZE, size) < 0)
+    {
+        LogModule(LOG_ERROR, DVBADAPTER,"DMX_SET_BUFFER_SIZE (%lu): %s\n", size, strerror(errno));
+        return -1;
+    }
+    LogModule(LOG_DEBUG, DVBADAPTER, "DVR buffer size set to %lu bytes\n", size);
     return 0;
 }
 
-int DVBDemuxGetMaxFilters(DVBAdapter_t *adapter)
+static int LinuxDVBDemuxGetMaxFilters(DVBAdapter_t *adapter)
 {
     return adapter->maxFilters;
 }
 
-int DVBDemuxGetAvailableFilters(DVBAdapter_t *adapter)
+static int LinuxDVBDemuxGetAvailableFilters(DVBAdapter_t *adapter)
 {
     int count = 0;
     int i;
@@ -1086,12 +1105,12 @@ int DVBDemuxGetAvailableFilters(DVBAdapter_t *adapter)
     return count;
 }
 
-bool DVBDemuxIsHardwareRestricted(DVBAdapter_t *adapter)
+static bool LinuxDVBDemuxIsHardwareRestricted(DVBAdapter_t *adapter)
 {
     return adapter->hardwareRestricted;
 }
 
-int DVBDemuxAllocateFilter(DVBAdapter_t *adapter, uint16_t pid)
+static int LinuxDVBDemuxAllocateFilter(DVBAdapter_t *adapter, uint16_t pid)
 {
     int result = -1;
     int i;
@@ -1158,7 +1177,7 @@ int DVBDemuxAllocateFilter(DVBAdapter_t *adapter, uint16_t pid)
     return result;
 }
 
-int DVBDemuxReleaseFilter(DVBAdapter_t *adapter, uint16_t pid)
+static int LinuxDVBDemuxReleaseFilter(DVBAdapter_t *adapter, uint16_t pid)
 {
     int result = -1;
     if (adapter->hardwareRestricted || (pid == 8192))
@@ -1179,7 +1198,7 @@ int DVBDemuxReleaseFilter(DVBAdapter_t *adapter, uint16_t pid)
     return result;
 }
 
-int DVBDemuxReleaseAllFilters(DVBAdapter_t *adapter)
+static int LinuxDVBDemuxReleaseAllFilters(DVBAdapter_t *adapter)
 {
     int result = -1;
     int i;
@@ -1253,7 +1272,7 @@ static void DVBDemuxStopAllFilters(DVBAdapter_t *adapter)
     }
 }
 
-int DVBDVRGetFD(DVBAdapter_t *adapter)
+static int LinuxDVBDVRGetFD(DVBAdapter_t *adapter)
 {
     return adapter->dvrFd;
 }
@@ -1293,7 +1312,7 @@ static void DVBCommandCallback(struct ev_loop *loop, ev_io *w, int revents)
                         return;
                     }
                     /* Fire frontend active event */
-                    EventsFireEventListeners(feActiveEvent, adapter);
+                    EventsFireEventListeners(DVBAdapterFEActiveEvent, adapter);
                     ev_io_set(&adapter->frontendWatcher, adapter->frontEndFd, EV_READ);
                     ev_io_start(loop, &adapter->frontendWatcher);
                 }
@@ -1308,7 +1327,7 @@ static void DVBCommandCallback(struct ev_loop *loop, ev_io *w, int revents)
                     close(adapter->frontEndFd);
                     adapter->frontEndFd = -1;
                     /* Fire frontend idle event */
-                    EventsFireEventListeners(feIdleEvent, adapter);
+                    EventsFireEventListeners(DVBAdapterFEIdleEvent, adapter);
                 }
                 break;
         }
@@ -1397,33 +1416,23 @@ static void DVBFrontendCallback(struct ev_loop *loop, ev_io *w, int revents)
                 }
                 adapter->frontEndProperties.num ++; /* Put back the tune command at the end of the array */
 #endif
-                EventsFireEventListeners(lockedEvent, adapter);
+                EventsFireEventListeners(DVBAdapterLockedEvent, adapter);
 
             }
             else
             {
                 DVBDemuxStopAllFilters(adapter);
-                EventsFireEventListeners(unlockedEvent, adapter);
+                EventsFireEventListeners(DVBAdapterUnlockedEvent, adapter);
             }
         }
 
         if (event.parameters.frequency <= 0)
         {
-            EventsFireEventListeners(tuningFailedEvent, adapter);
+            EventsFireEventListeners(DVBAdapterTuningFailedEvent, adapter);
         }
     }
 }
 
-static int DVBEventToString(yaml_document_t *document, Event_t event, void *payload)
-{
-    DVBAdapter_t *adapter = payload;
-    char adapterStr[4];
-    int mappingId = yaml_document_add_mapping(document, (yaml_char_t*)YAML_MAP_TAG, YAML_ANY_MAPPING_STYLE);
-    sprintf(adapterStr, "%d", adapter->adapter);
-    YamlUtils_MappingAdd(document, mappingId, "Adapter", adapterStr);
-    return mappingId;
-}
-
 static int DVBPropertyActiveGet(void *userArg, PropertyValue_t *value)
 {
     DVBAdapter_t *adapter = userArg;
@@ -1434,7 +1443,7 @@ static int DVBPropertyActiveGet(void *userArg, PropertyValue_t *value)
 static int DVBPropertyActiveSet(void *userArg, PropertyValue_t *value)
 {
     DVBAdapter_t *adapter = userArg;
-    return DVBFrontEndSetActive(adapter,value->u.boolean);
+    return LinuxDVBFrontEndSetActive(adapter,value->u.boolean);
 }
 
 static int DVBPropertyDeliverySystemsGet(void *userArg, PropertyValue_t *value)
@@ -0,0 +1,462 @@
+/*****************************************************************************
+ * crc32.c: MPEG-2 CRC_32 calculation
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ *----------------------------------------------------------------------------
+ * Three implementations of the same CRC:
+ *  - bytewise, the original one table lookup per byte.
+ *  - slicing-by-8, 8 tables so that 8 bytes are handled per iteration with
+ *    independent lookups.
+ *  - PCLMULQDQ, the data is folded 64 bytes at a time with carry-less
+ *    multiplies by x^n mod P until it is down to 16 bytes, which are then
+ *    reduced with the tables (see Intel's "Fast CRC Computation for Generic
+ *    Polynomials Using PCLMULQDQ Instruction").
+ *
+ * ARMv8 has CRC32 instructions but they only implement the bit reflected
+ * polynomial so they are no use for the MSB first MPEG-2 CRC, ARM uses the
+ * slicing-by-8 engine.
+ *****************************************************************************/
+
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#if defined(HAVE_INTTYPES_H)
+#include <inttypes.h>
+#elif defined(HAVE_STDINT_H)
+#include <stdint.h>
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_CRC32_PCLMUL
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+#include "dvbpsi.h"
+#include "crc32.h"
+
+
+/*****************************************************************************
+ * Local prototypes
+ *****************************************************************************/
+typedef uint32_t (*dvbpsi_crc32_func_t)(uint32_t i_crc, const uint8_t *p_data,
+                                        size_t i_length);
+
+static void dvbpsi_Crc32Init(void);
+static uint32_t dvbpsi_Crc32XPowModP(int i_power);
+static uint32_t dvbpsi_Crc32Bytewise(uint32_t i_crc, const uint8_t *p_data,
+                                     size_t i_length);
+static uint32_t dvbpsi_Crc32Slice8(uint32_t i_crc, const uint8_t *p_data,
+                                   size_t i_length);
+#ifdef HAVE_CRC32_PCLMUL
+static int dvbpsi_Crc32CPUHasPclmul(void);
+static uint32_t dvbpsi_Crc32Pclmul(uint32_t i_crc, const uint8_t *p_data,
+                                   size_t i_length);
+#endif
+
+
+/*****************************************************************************
+ * s_crc32_table
+ *****************************************************************************
+ * This table is used to compute a PSI CRC byte per byte instead of bit per
+ * bit. It's been generated by 'gen_crc' in the 'misc' directory:
+ * 
+ *   uint32_t table[256];
+ *   uint32_t i, j, k;
+ *
+ *   for(i = 0; i < 256; i++)
+ *   {
+ *     k = 0;
+ *     for (j = (i << 24) | 0x800000; j != 0x80000000; j <<= 1)
+ *       k = (k << 1) ^ (((k ^ j) & 0x80000000) ? 0x04c11db7 : 0);
+ *     table[i] = k;
+ *   }
+ *
+ * A CRC is computed like this:
+ *
+ *   initialization
+ *   --------------
+ *   uint32_t i_crc = 0xffffffff;
+ *
+ *   for each data byte do
+ *   ---------------------
+ *   i_crc = (i_crc << 8) ^ s_crc32_table[(i_crc >> 24) ^ (data_byte)];
+ *****************************************************************************/
+static const uint32_t s_crc32_table[256] =
+{
+  0x00000000, 0x04c11db7, 0x09823b6e, 0x0d4326d9,
+  0x130476dc, 0x17c56b6b, 0x1a864db2, 0x1e475005,
+  0x2608edb8, 0x22c9f00f, 0x2f8ad6d6, 0x2b4bcb61,
+  0x350c9b64, 0x31cd86d3, 0x3c8ea00a, 0x384fbdbd,
+  0x4c11db70, 0x48d0c6c7, 0x4593e01e, 0x4152fda9,
+  0x5f15adac, 0x5bd4b01b, 0x569796c2, 0x52568b75,
+  0x6a1936c8, 0x6ed82b7f, 0x639b0da6, 0x675a1011,
+  0x791d4014, 0x7ddc5da3, 0x709f7b7a, 0x745e66cd,
+  0x9823b6e0, 0x9ce2ab57, 0x91a18d8e, 0x95609039,
+  0x8b27c03c, 0x8fe6dd8b, 0x82a5fb52, 0x8664e6e5,
+  0xbe2b5b58, 0xbaea46ef, 0xb7a96036, 0xb3687d81,
+  0xad2f2d84, 0xa9ee3033, 0xa4ad16ea, 0xa06c0b5d,
+  0xd4326d90, 0xd0f37027, 0xddb056fe, 0xd9714b49,
+  0xc7361b4c, 0xc3f706fb, 0xceb42022, 0xca753d95,
+  0xf23a8028, 0xf6fb9d9f, 0xfbb8bb46, 0xff79a6f1,
+  0xe13ef6f4, 0xe5ffeb43, 0xe8bccd9a, 0xec7dd02d,
+  0x34867077, 0x30476dc0, 0x3d044b19, 0x39c556ae,
+  0x278206ab, 0x23431b1c, 0x2e003dc5, 0x2ac12072,
+  0x128e9dcf, 0x164f8078, 0x1b0ca6a1, 0x1fcdbb16,
+  0x018aeb13, 0x054bf6a4, 0x0808d07d, 0x0cc9cdca,
+  0x7897ab07, 0x7c56b6b0, 0x71159069, 0x75d48dde,
+  0x6b93dddb, 0x6f52c06c, 0x6211e6b5, 0x66d0fb02,
+  0x5e9f46bf, 0x5a5e5b08, 0x571d7dd1, 0x53dc6066,
+  0x4d9b3063, 0x495a2dd4, 0x44190b0d, 0x40d816ba,
+  0xaca5c697, 0xa864db20, 0xa527fdf9, 0xa1e6e04e,
+  0xbfa1b04b, 0xbb60adfc, 0xb6238b25, 0xb2e29692,
+  0x8aad2b2f, 0x8e6c3698, 0x832f1041, 0x87ee0df6,
+  0x99a95df3, 0x9d684044, 0x902b669d, 0x94ea7b2a,
+  0xe0b41de7, 0xe4750050, 0xe9362689, 0xedf73b3e,
+  0xf3b06b3b, 0xf771768c, 0xfa325055, 0xfef34de2,
+  0xc6bcf05f, 0xc27dede8, 0xcf3ecb31, 0xcbffd686,
+  0xd5b88683, 0xd1799b34, 0xdc3abded, 0xd8fba05a,
+  0x690ce0ee, 0x6dcdfd59, 0x608edb80, 0x644fc637,
+  0x7a089632, 0x7ec98b85, 0x738aad5c, 0x774bb0eb,
+  0x4f040d56, 0x4bc510e1, 0x46863638, 0x42472b8f,
+  0x5c007b8a, 0x58c1663d, 0x558240e4, 0x51435d53,
+  0x251d3b9e, 0x21dc2629, 0x2c9f00f0, 0x285e1d47,
+  0x36194d42, 0x32d850f5, 0x3f9b762c, 0x3b5a6b9b,
+  0x0315d626, 0x07d4cb91, 0x0a97ed48, 0x0e56f0ff,
+  0x1011a0fa, 0x14d0bd4d, 0x19939b94, 0x1d528623,
+  0xf12f560e, 0xf5ee4bb9, 0xf8ad6d60, 0xfc6c70d7,
+  0xe22b20d2, 0xe6ea3d65, 0xeba91bbc, 0xef68060b,
+  0xd727bbb6, 0xd3e6a601, 0xdea580d8, 0xda649d6f,
+  0xc423cd6a, 0xc0e2d0dd, 0xcda1f604, 0xc960ebb3,
+  0xbd3e8d7e, 0xb9ff90c9, 0xb4bcb610, 0xb07daba7,
+  0xae3afba2, 0xaafbe615, 0xa7b8c0cc, 0xa379dd7b,
+  0x9b3660c6, 0x9ff77d71, 0x92b45ba8, 0x9675461f,
+  0x8832161a, 0x8cf30bad, 0x81b02d74, 0x857130c3,
+  0x5d8a9099, 0x594b8d2e, 0x5408abf7, 0x50c9b640,
+  0x4e8ee645, 0x4a4ffbf2, 0x470cdd2b, 0x43cdc09c,
+  0x7b827d21, 0x7f436096, 0x7200464f, 0x76c15bf8,
+  0x68860bfd, 0x6c47164a, 0x61043093, 0x65c52d24,
+  0x119b4be9, 0x155a565e, 0x18197087, 0x1cd86d30,
+  0x029f3d35, 0x065e2082, 0x0b1d065b, 0x0fdc1bec,
+  0x3793a651, 0x3352bbe6, 0x3e119d3f, 0x3ad08088,
+  0x2497d08d, 0x2056cd3a, 0x2d15ebe3, 0x29d4f654,
+  0xc5a92679, 0xc1683bce, 0xcc2b1d17, 0xc8ea00a0,
+  0xd6ad50a5, 0xd26c4d12, 0xdf2f6bcb, 0xdbee767c,
+  0xe3a1cbc1, 0xe760d676, 0xea23f0af, 0xeee2ed18,
+  0xf0a5bd1d, 0xf464a0aa, 0xf9278673, 0xfde69bc4,
+  0x89b8fd09, 0x8d79e0be, 0x803ac667, 0x84fbdbd0,
+  0x9abc8bd5, 0x9e7d9662, 0x933eb0bb, 0x97ffad0c,
+  0xafb010b1, 0xab710d06, 0xa6322bdf, 0xa2f33668,
+  0xbcb4666d, 0xb8757bda, 0xb5365d03, 0xb1f740b4
+};
+
+
+/*****************************************************************************
+ * s_crc32_slice
+ *****************************************************************************
+ * Slicing-by-8 tables, s_crc32_slice[k][i] is the CRC of byte i followed by
+ * k zero bytes. s_crc32_slice[0] is a copy of s_crc32_table.
+ *****************************************************************************/
+static uint32_t s_crc32_slice[8][256];
+
+#ifdef HAVE_CRC32_PCLMUL
+/* Folding constants, x^(d + 64) mod P and x^d mod P for a distance of d bits. */
+static uint32_t s_crc32_fold_512[2];
+static uint32_t s_crc32_fold_128[2];
+#endif
+
+static const char *s_crc32_engine_names[DVBPSI_CRC32_ENGINES] =
+{
+  "bytewise", "slice-by-8", "pclmul"
+};
+
+static pthread_once_t s_crc32_once = PTHREAD_ONCE_INIT;
+static dvbpsi_crc32_engine_t s_crc32_engine = DVBPSI_CRC32_BYTEWISE;
+static dvbpsi_crc32_func_t s_crc32_func = dvbpsi_Crc32Bytewise;
+static int s_crc32_supported[DVBPSI_CRC32_ENGINES];
+
+
+/*****************************************************************************
+ * dvbpsi_Crc32
+ *****************************************************************************
+ * Update a CRC_32 using the fastest engine available.
+ *****************************************************************************/
+uint32_t dvbpsi_Crc32(uint32_t i_crc, const uint8_t *p_data, size_t i_length)
+{
+  pthread_once(&s_crc32_once, dvbpsi_Crc32Init);
+  return s_crc32_func(i_crc, p_data, i_length);
+}
+
+
+/*****************************************************************************
+ * dvbpsi_Crc32Engine
+ *****************************************************************************
+ * Update a CRC_32 using a specific engine.
+ *****************************************************************************/
+uint32_t dvbpsi_Crc32Engine(dvbpsi_crc32_engine_t i_engine, uint32_t i_crc,
+                            const uint8_t *p_data, size_t i_length)
+{
+  pthread_once(&s_crc32_once, dvbpsi_Crc32Init);
+  switch(i_engine)
+  {
+    case DVBPSI_CRC32_SLICE8:
+      return dvbpsi_Crc32Slice8(i_crc, p_data, i_length);
+#ifdef HAVE_CRC32_PCLMUL
+    case DVBPSI_CRC32_PCLMUL:
+      if(s_crc32_supported[DVBPSI_CRC32_PCLMUL])
+        return dvbpsi_Crc32Pclmul(i_crc, p_data, i_length);
+      break;
+#endif
+    default:
+      break;
+  }
+  return dvbpsi_Crc32Bytewise(i_crc, p_data, i_length);
+}
+
+
+/*****************************************************************************
+ * dvbpsi_Crc32EngineSupported
+ *****************************************************************************
+ * Check whether an engine can be used on this CPU.
+ *****************************************************************************/
+int dvbpsi_Crc32EngineSupported(dvbpsi_crc32_engine_t i_engine)
+{
+  pthread_once(&s_crc32_once, dvbpsi_Crc32Init);
+  if(i_engine >= DVBPSI_CRC32_ENGINES)
+    return 0;
+  return s_crc32_supported[i_engine];
+}
+
+
+/*****************************************************************************
+ * dvbpsi_Crc32EngineName
+ *****************************************************************************
+ * Get the name of an engine.
+ *****************************************************************************/
+const char *dvbpsi_Crc32EngineName(dvbpsi_crc32_engine_t i_engine)
+{
+  if(i_engine >= DVBPSI_CRC32_ENGINES)
+    return "unknown";
+  return s_crc32_engine_names[i_engine];
+}
+
+
+/*****************************************************************************
+ * dvbpsi_Crc32SelectedEngine
+ *****************************************************************************
+ * Get the engine used by dvbpsi_Crc32.
+ *****************************************************************************/
+dvbpsi_crc32_engine_t dvbpsi_Crc32SelectedEngine(void)
+{
+  pthread_once(&s_crc32_once, dvbpsi_Crc32Init);
+  return s_crc32_engine;
+}
+
+
+/*****************************************************************************
+ * dvbpsi_Crc32Init
+ *****************************************************************************
+ * Build the slicing tables and folding constants and pick the engine.
+ *****************************************************************************/
+static void dvbpsi_Crc32Init(void)
+{
+  int i, k;
+
+  memcpy(s_crc32_slice[0], s_crc32_table, sizeof(s_crc32_table));
+  for(k = 1; k < 8; k++)
+  {
+    for(i = 0; i < 256; i++)
+    {
+      uint32_t i_prev = s_crc32_slice[k - 1][i];
+      s_crc32_slice[k][i] = (i_prev << 8) ^ s_crc32_table[i_prev >> 24];
+    }
+  }
+
+  s_crc32_supported[DVBPSI_CRC32_BYTEWISE] = 1;
+  s_crc32_supported[DVBPSI_CRC32_SLICE8] = 1;
+  s_crc32_engine = DVBPSI_CRC32_SLICE8;
+  s_crc32_func = dvbpsi_Crc32Slice8;
+
+#ifdef HAVE_CRC32_PCLMUL
+  s_crc32_fold_512[0] = dvbpsi_Crc32XPowModP(512);
+  s_crc32_fold_512[1] = dvbpsi_Crc32XPowModP(512 + 64);
+  s_crc32_fold_128[0] = dvbpsi_Crc32XPowModP(128);
+  s_crc32_fold_128[1] = dvbpsi_Crc32XPowModP(128 + 64);
+
+  if(dvbpsi_Crc32CPUHasPclmul())
+  {
+    s_crc32_supported[DVBPSI_CRC32_PCLMUL] = 1;
+    s_crc32_engine = DVBPSI_CRC32_PCLMUL;
+    s_crc32_func = dvbpsi_Crc32Pclmul;
+  }
+#endif
+}
+
+
+/*****************************************************************************
+ * dvbpsi_Crc32XPowModP
+ *****************************************************************************
+ * Calculate x^i_power mod P, P being the CRC_32 polynomial.
+ *****************************************************************************/
+static uint32_t dvbpsi_Crc32XPowModP(int i_power)
+{
+  uint32_t i_result = 1;
+
+  while(i_power--)
+    i_result = (i_result & 0x80000000) ? (i_result << 1) ^ 0x04c11db7
+                                       : (i_result << 1);
+  return i_result;
+}
+
+
+/*****************************************************************************
+ * dvbpsi_Crc32Bytewise
+ *****************************************************************************/
+static uint32_t dvbpsi_Crc32Bytewise(uint32_t i_crc, const uint8_t *p_data,
+                                     size_t i_length)
+{
+  while(i_length--)
+  {
+    i_crc = (i_crc << 8) ^ s_crc32_table[(i_crc >> 24) ^ (*p_data)];
+    p_data++;
+  }
+  return i_crc;
+}
+
+
+/*****************************************************************************
+ * dvbpsi_Crc32Slice8
+ *****************************************************************************/
+static uint32_t dvbpsi_Crc32Slice8(uint32_t i_crc, const uint8_t *p_data,
+                                   size_t i_length)
+{
+  while(i_length >= 8)
+  {
+    uint32_t i_first = i_crc ^ (  ((uint32_t)p_data[0] << 24)
+                                | ((uint32_t)p_data[1] << 16)
+                                | ((uint32_t)p_data[2] << 8)
+                                |  (uint32_t)p_data[3]);
+
+    i_crc =   s_crc32_slice[7][i_first >> 24]
+            ^ s_crc32_slice[6][(i_first >> 16) & 0xff]
+            ^ s_crc32_slice[5][(i_first >> 8) & 0xff]
+            ^ s_crc32_slice[4][i_first & 0xff]
+            ^ s_crc32_slice[3][p_data[4]]
+            ^ s_crc32_slice[2][p_data[5]]
+            ^ s_crc32_slice[1][p_data[6]]
+            ^ s_crc32_slice[0][p_data[7]];
+    p_data += 8;
+    i_length -= 8;
+  }
+
+  while(i_length--)
+  {
+    i_crc = (i_crc << 8) ^ s_crc32_slice[0][(i_crc >> 24) ^ (*p_data)];
+    p_data++;
+  }
+  return i_crc;
+}
+
+
+#ifdef HAVE_CRC32_PCLMUL
+/*****************************************************************************
+ * dvbpsi_Crc32CPUHasPclmul
+ *****************************************************************************/
+static int dvbpsi_Crc32CPUHasPclmul(void)
+{
+  unsigned int i_eax, i_ebx, i_ecx, i_edx;
+
+  if(!__get_cpuid(1, &i_eax, &i_ebx, &i_ecx, &i_edx))
+    return 0;
+  return (i_ecx & bit_PCLMUL) && (i_ecx & bit_SSSE3);
+}
+
+
+/*****************************************************************************
+ * dvbpsi_Crc32Pclmul
+ *****************************************************************************
+ * Blocks are loaded byte swapped so that the first bit of the data is the
+ * highest power of x. A 128 bit block X = H.x^64 + L that is d bits ahead of
+ * the next block is folded into it as H.(x^(d+64) mod P) + L.(x^d mod P),
+ * which is congruent to X.x^d and at most 96 bits long.
+ *****************************************************************************/
+#define CRC32_FOLD(x, k) \
+  _mm_xor_si128(_mm_clmulepi64_si128((x), (k), 0x11), \
+                _mm_clmulepi64_si128((x), (k), 0x00))
+
+__attribute__((target("pclmul,ssse3")))
+static uint32_t dvbpsi_Crc32Pclmul(uint32_t i_crc, const uint8_t *p_data,
+                                   size_t i_length)
+{
+  const __m128i bswap = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7,
+                                     8, 9, 10, 11, 12, 13, 14, 15);
+  __m128i k512, k128;
+  __m128i x0, x1, x2, x3;
+  uint8_t p_block[16];
+
+  if(i_length < 64)
+    return dvbpsi_Crc32Slice8(i_crc, p_data, i_length);
+
+  k512 = _mm_set_epi64x(s_crc32_fold_512[1], s_crc32_fold_512[0]);
+  k128 = _mm_set_epi64x(s_crc32_fold_128[1], s_crc32_fold_128[0]);
+
+  x0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(p_data + 0)), bswap);
+  x1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(p_data + 16)), bswap);
+  x2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(p_data + 32)), bswap);
+  x3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(p_data + 48)), bswap);
+  /* Starting from i_crc is the same as starting from 0 with i_crc XORed
+     into the first 32 bits of the data. */
+  x0 = _mm_xor_si128(x0, _mm_set_epi32(i_crc, 0, 0, 0));
+  p_data += 64;
+  i_length -= 64;
+
+  while(i_length >= 64)
+  {
+    x0 = _mm_xor_si128(CRC32_FOLD(x0, k512),
+           _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(p_data + 0)), bswap));
+    x1 = _mm_xor_si128(CRC32_FOLD(x1, k512),
+           _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(p_data + 16)), bswap));
+    x2 = _mm_xor_si128(CRC32_FOLD(x2, k512),
+           _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(p_data + 32)), bswap));
+    x3 = _mm_xor_si128(CRC32_FOLD(x3, k512),
+           _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(p_data + 48)), bswap));
+    p_data += 64;
+    i_length -= 64;
+  }
+
+  x0 = _mm_xor_si128(CRC32_FOLD(x0, k128), x1);
+  x0 = _mm_xor_si128(CRC32_FOLD(x0, k128), x2);
+  x0 = _mm_xor_si128(CRC32_FOLD(x0, k128), x3);
+
+  while(i_length >= 16)
+  {
+    x0 = _mm_xor_si128(CRC32_FOLD(x0, k128),
+           _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)p_data), bswap));
+    p_data += 16;
+    i_length -= 16;
+  }
+
+  /* The CRC of the remaining 128 bits (X.x^32 mod P), then the tail. */
+  _mm_storeu_si128((__m128i *)p_block, _mm_shuffle_epi8(x0, bswap));
+  i_crc = dvbpsi_Crc32Slice8(0, p_block, sizeof(p_block));
+  return dvbpsi_Crc32Slice8(i_crc, p_data, i_length);
+}
+#endif
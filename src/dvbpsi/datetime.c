@@ -59,3 +59,21 @@ void dvbpsi_DecodeMJDUTC(uint8_t *p_mjdutc, struct tm *p_date_time)
     
 }
 
+void dvbpsi_EncodeMJDUTC(struct tm *p_date_time, uint8_t *p_mjdutc)
+{
+    #define INT_TO_BCD_CHAR(_int) (((((_int) / 10) % 10) << 4) | ((_int) % 10))
+    /* See EN 300 468 Annex C for the date to MJD conversion. */
+    int i_year = p_date_time->tm_year;
+    int i_month = p_date_time->tm_mon + 1;
+    int i_leap = ((i_month == 1) || (i_month == 2)) ? 1 : 0;
+    uint16_t i_mjd = 14956 + p_date_time->tm_mday +
+                    (int)((i_year - i_leap) * 365.25) +
+                    (int)((i_month + 1 + i_leap * 12) * 30.6001);
+
+    p_mjdutc[0] = i_mjd >> 8;
+    p_mjdutc[1] = i_mjd & 0xff;
+    p_mjdutc[2] = INT_TO_BCD_CHAR(p_date_time->tm_hour);
+    p_mjdutc[3] = INT_TO_BCD_CHAR(p_date_time->tm_min);
+    p_mjdutc[4] = INT_TO_BCD_CHAR(p_date_time->tm_sec);
+}
+
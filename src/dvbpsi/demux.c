@@ -41,6 +41,12 @@
 #include "psi.h"
 #include "demux.h"
 
+/* Smallest hash allocated, the hash is kept at most half full. */
+#define DVBPSI_DEMUX_HASH_MIN_BITS 4
+
+static unsigned int dvbpsi_demuxHash(dvbpsi_demux_t * p_demux, uint32_t i_id);
+static int dvbpsi_demuxGrowHash(dvbpsi_demux_t * p_demux);
+
 /*****************************************************************************
  * dvbpsi_AttachDemux
  *****************************************************************************
@@ -71,11 +77,15 @@ dvbpsi_handle dvbpsi_AttachDemux(dvbpsi_demux_new_cb_t pf_new_cb,
   h_dvbpsi->i_continuity_counter = 31;
   h_dvbpsi->b_discontinuity = 1;
   h_dvbpsi->p_current_section = NULL;
+  h_dvbpsi->pf_header_filter = NULL;
   h_dvbpsi->p_free_sections = NULL;
 
   /* Sutables demux configuration */
   p_demux->p_decoder = h_dvbpsi;
   p_demux->p_first_subdec = NULL;
+  p_demux->pp_subdec_hash = NULL;
+  p_demux->i_subdec_hash_bits = 0;
+  p_demux->i_subdec_count = 0;
   p_demux->pf_new_callback = pf_new_cb;
   p_demux->p_new_cb_data = p_new_cb_data;
 
@@ -92,17 +102,102 @@ dvbpsi_demux_subdec_t * dvbpsi_demuxGetSubDec(dvbpsi_demux_t * p_demux,
                                               uint16_t i_extension)
 {
   uint32_t i_id = (uint32_t)i_table_id << 16 |(uint32_t)i_extension;
-  dvbpsi_demux_subdec_t * p_subdec = p_demux->p_first_subdec;
+  unsigned int i_mask = (1 << p_demux->i_subdec_hash_bits) - 1;
+  unsigned int i;
+  dvbpsi_demux_subdec_t * p_subdec;
 
-  while(p_subdec)
+  if(p_demux->pp_subdec_hash == NULL)
+    return NULL;
+
+  for(i = dvbpsi_demuxHash(p_demux, i_id);
+      (p_subdec = p_demux->pp_subdec_hash[i]) != NULL;
+      i = (i + 1) & i_mask)
   {
     if(p_subdec->i_id == i_id)
-      break;
+      return p_subdec;
+  }
 
-    p_subdec = p_subdec->p_next;
+  return NULL;
+}
+
+/*****************************************************************************
+ * dvbpsi_demuxAddSubDec
+ *****************************************************************************
+ * Links a subtable decoder into the demux list and hash
+ *****************************************************************************/
+int dvbpsi_demuxAddSubDec(dvbpsi_demux_t * p_demux,
+                          dvbpsi_demux_subdec_t * p_subdec)
+{
+  unsigned int i_mask;
+  unsigned int i;
+
+  if(((p_demux->i_subdec_count + 1) * 2 > (1U << p_demux->i_subdec_hash_bits))
+     || (p_demux->pp_subdec_hash == NULL))
+  {
+    if(dvbpsi_demuxGrowHash(p_demux))
+      return 1;
+  }
+
+  i_mask = (1 << p_demux->i_subdec_hash_bits) - 1;
+  for(i = dvbpsi_demuxHash(p_demux, p_subdec->i_id);
+      p_demux->pp_subdec_hash[i] != NULL;
+      i = (i + 1) & i_mask);
+  p_demux->pp_subdec_hash[i] = p_subdec;
+  p_demux->i_subdec_count++;
+
+  p_subdec->p_prev = NULL;
+  p_subdec->p_next = p_demux->p_first_subdec;
+  if(p_subdec->p_next)
+    p_subdec->p_next->p_prev = p_subdec;
+  p_demux->p_first_subdec = p_subdec;
+
+  return 0;
+}
+
+/*****************************************************************************
+ * dvbpsi_demuxRemoveSubDec
+ *****************************************************************************
+ * Unlinks a subtable decoder from the demux list and hash
+ *****************************************************************************/
+void dvbpsi_demuxRemoveSubDec(dvbpsi_demux_t * p_demux,
+                              dvbpsi_demux_subdec_t * p_subdec)
+{
+  unsigned int i_mask = (1 << p_demux->i_subdec_hash_bits) - 1;
+  unsigned int i, j, k;
+
+  if(p_demux->pp_subdec_hash == NULL)
+    return;
+
+  for(i = dvbpsi_demuxHash(p_demux, p_subdec->i_id);
+      p_demux->pp_subdec_hash[i] != p_subdec;
+      i = (i + 1) & i_mask)
+  {
+    if(p_demux->pp_subdec_hash[i] == NULL)
+      return;
   }
 
-  return p_subdec;
+  /* Shift back any following entries that would no longer be found across
+   * the hole, so lookups can keep stopping at the first empty slot. */
+  p_demux->pp_subdec_hash[i] = NULL;
+  for(j = (i + 1) & i_mask;
+      p_demux->pp_subdec_hash[j] != NULL;
+      j = (j + 1) & i_mask)
+  {
+    k = dvbpsi_demuxHash(p_demux, p_demux->pp_subdec_hash[j]->i_id);
+    if((i <= j) ? ((i < k) && (k <= j)) : ((i < k) || (k <= j)))
+      continue;
+    p_demux->pp_subdec_hash[i] = p_demux->pp_subdec_hash[j];
+    p_demux->pp_subdec_hash[j] = NULL;
+    i = j;
+  }
+  p_demux->i_subdec_count--;
+
+  if(p_subdec->p_prev)
+    p_subdec->p_prev->p_next = p_subdec->p_next;
+  else
+    p_demux->p_first_subdec = p_subdec->p_next;
+  if(p_subdec->p_next)
+    p_subdec->p_next->p_prev = p_subdec->p_prev;
 }
 
 /*****************************************************************************
@@ -166,6 +261,7 @@ void dvbpsi_DetachDemux(dvbpsi_handle h_dvbpsi)
     else free(p_subdec_temp);
   }
 
+  free(p_demux->pp_subdec_hash);
   free(p_demux);
   if(h_dvbpsi->p_current_section)
     dvbpsi_DeletePSISections(h_dvbpsi->p_current_section);
@@ -175,3 +271,48 @@ void dvbpsi_DetachDemux(dvbpsi_handle h_dvbpsi)
 
   free(h_dvbpsi);
 }
+
+/*****************************************************************************
+ * dvbpsi_demuxHash
+ *****************************************************************************
+ * Multiplicative hash of a subtable id, EIT ids only differ in a few bits of
+ * the table id and extension so a plain mask would cluster badly.
+ *****************************************************************************/
+static unsigned int dvbpsi_demuxHash(dvbpsi_demux_t * p_demux, uint32_t i_id)
+{
+  return (uint32_t)(i_id * 2654435761U) >> (32 - p_demux->i_subdec_hash_bits);
+}
+
+/*****************************************************************************
+ * dvbpsi_demuxGrowHash
+ *****************************************************************************
+ * Doubles the size of the hash and reinserts all the subtable decoders
+ *****************************************************************************/
+static int dvbpsi_demuxGrowHash(dvbpsi_demux_t * p_demux)
+{
+  unsigned int i_bits = p_demux->pp_subdec_hash ? p_demux->i_subdec_hash_bits + 1
+                                                : DVBPSI_DEMUX_HASH_MIN_BITS;
+  dvbpsi_demux_subdec_t ** pp_hash;
+  dvbpsi_demux_subdec_t * p_subdec;
+  unsigned int i_mask = (1 << i_bits) - 1;
+  unsigned int i;
+
+  pp_hash = (dvbpsi_demux_subdec_t **)calloc(1 << i_bits,
+                                             sizeof(dvbpsi_demux_subdec_t *));
+  if(pp_hash == NULL)
+    return 1;
+
+  free(p_demux->pp_subdec_hash);
+  p_demux->pp_subdec_hash = pp_hash;
+  p_demux->i_subdec_hash_bits = i_bits;
+
+  for(p_subdec = p_demux->p_first_subdec; p_subdec; p_subdec = p_subdec->p_next)
+  {
+    for(i = dvbpsi_demuxHash(p_demux, p_subdec->i_id);
+        pp_hash[i] != NULL;
+        i = (i + 1) & i_mask);
+    pp_hash[i] = p_subdec;
+  }
+
+  return 0;
+}
@@ -41,6 +41,12 @@
 #include "psi.h"
 
 
+/*****************************************************************************
+ * Local prototypes
+ *****************************************************************************/
+static dvbpsi_psi_section_t* dvbpsi_NewSection(dvbpsi_handle h_dvbpsi);
+
+
 /*****************************************************************************
  * dvbpsi_PushPacket
  *****************************************************************************
@@ -122,14 +128,11 @@ void dvbpsi_PushPacket(dvbpsi_handle h_dvbpsi, uint8_t* p_data)
       /* Allocation of the structure */
       h_dvbpsi->p_current_section
                         = p_section
-                        = dvbpsi_ClaimPSISection(h_dvbpsi, h_dvbpsi->i_section_max_size);
+                        = dvbpsi_NewSection(h_dvbpsi);
       /* Update the position in the packet */
       p_payload_pos = p_new_pos;
       /* New section is being handled */
       p_new_pos = NULL;
-      /* Just need the header to know how long is the section */
-      h_dvbpsi->i_need = 3;
-      h_dvbpsi->b_complete_header = 0;
     }
     else
     {
@@ -146,11 +149,16 @@ void dvbpsi_PushPacket(dvbpsi_handle h_dvbpsi, uint8_t* p_data)
     if(i_available >= h_dvbpsi->i_need)
     {
       /* There are enough bytes in this packet to complete the
-         header/section */
-      memcpy(p_section->p_payload_end, p_payload_pos, h_dvbpsi->i_need);
+         header/section. Sections rejected by the header filter are
+         skipped without being copied. */
+      if(!h_dvbpsi->b_skip_section)
+      {
+        memcpy(p_section->p_payload_end, p_payload_pos, h_dvbpsi->i_need);
+        p_section->p_payload_end += h_dvbpsi->i_need;
+      }
       p_payload_pos += h_dvbpsi->i_need;
-      p_section->p_payload_end += h_dvbpsi->i_need;
       i_available -= h_dvbpsi->i_need;
+      h_dvbpsi->i_need = 0;
 
       if(!h_dvbpsi->b_complete_header)
       {
@@ -172,19 +180,46 @@ void dvbpsi_PushPacket(dvbpsi_handle h_dvbpsi, uint8_t* p_data)
           {
             h_dvbpsi->p_current_section
                         = p_section
-                        = dvbpsi_ClaimPSISection(h_dvbpsi, h_dvbpsi->i_section_max_size);
+                        = dvbpsi_NewSection(h_dvbpsi);
             p_payload_pos = p_new_pos;
             p_new_pos = NULL;
-            h_dvbpsi->i_need = 3;
-            h_dvbpsi->b_complete_header = 0;
             i_available = 188 + p_data - p_payload_pos;
           }
           else
           {
             i_available = 0;
           }
+          continue;
+        }
+        if(h_dvbpsi->pf_header_filter)
+        {
+          /* Only get what the header filter needs for now */
+          h_dvbpsi->b_filter_header = 1;
+          if(h_dvbpsi->i_need > h_dvbpsi->i_header_filter_size - 3)
+            h_dvbpsi->i_need = h_dvbpsi->i_header_filter_size - 3;
         }
       }
+
+      if(h_dvbpsi->b_filter_header && (h_dvbpsi->i_need == 0))
+      {
+        /* Enough of the section to run the header filter on */
+        int i_header = p_section->p_payload_end - p_section->p_data;
+        h_dvbpsi->b_filter_header = 0;
+        h_dvbpsi->i_need = p_section->i_length + 3 - i_header;
+        if(!h_dvbpsi->pf_header_filter(h_dvbpsi->p_header_filter_data,
+                                       p_section->p_data, i_header))
+          h_dvbpsi->b_skip_section = 1;
+      }
+
+      /* Wait for the rest of the section */
+      if(h_dvbpsi->i_need)
+        continue;
+
+      if(h_dvbpsi->b_skip_section)
+      {
+        dvbpsi_ReleasePSISections(h_dvbpsi, p_section);
+        h_dvbpsi->p_current_section = NULL;
+      }
       else
       {
         /* PSI section is complete */
@@ -227,41 +262,80 @@ void dvbpsi_PushPacket(dvbpsi_handle h_dvbpsi, uint8_t* p_data)
           dvbpsi_ReleasePSISections(h_dvbpsi, p_section);
           h_dvbpsi->p_current_section = NULL;
         }
+      }
 
-        /* A TS packet may contain any number of sections, only the first
-         * new one is flagged by the pointer_field. If the next payload
-         * byte isn't 0xff then a new section starts. */
-        if(p_new_pos == NULL && i_available && *p_payload_pos != 0xff)
-          p_new_pos = p_payload_pos;
+      /* A TS packet may contain any number of sections, only the first
+       * new one is flagged by the pointer_field. If the next payload
+       * byte isn't 0xff then a new section starts. */
+      if(p_new_pos == NULL && i_available && *p_payload_pos != 0xff)
+        p_new_pos = p_payload_pos;
 
-        /* If there is a new section not being handled then go forward
-           in the packet */
-        if(p_new_pos)
-        {
-          h_dvbpsi->p_current_section
-                        = p_section
-                        = dvbpsi_ClaimPSISection(h_dvbpsi, h_dvbpsi->i_section_max_size);
-          p_payload_pos = p_new_pos;
-          p_new_pos = NULL;
-          h_dvbpsi->i_need = 3;
-          h_dvbpsi->b_complete_header = 0;
-          i_available = 188 + p_data - p_payload_pos;
-        }
-        else
-        {
-          i_available = 0;
-        }
+      /* If there is a new section not being handled then go forward
+         in the packet */
+      if(p_new_pos)
+      {
+        h_dvbpsi->p_current_section
+                      = p_section
+                      = dvbpsi_NewSection(h_dvbpsi);
+        p_payload_pos = p_new_pos;
+        p_new_pos = NULL;
+        i_available = 188 + p_data - p_payload_pos;
+      }
+      else
+      {
+        i_available = 0;
       }
     }
     else
     {
       /* There aren't enough bytes in this packet to complete the
          header/section */
-      memcpy(p_section->p_payload_end, p_payload_pos, i_available);
-      p_section->p_payload_end += i_available;
+      if(!h_dvbpsi->b_skip_section)
+      {
+        memcpy(p_section->p_payload_end, p_payload_pos, i_available);
+        p_section->p_payload_end += i_available;
+      }
       h_dvbpsi->i_need -= i_available;
       i_available = 0;
     }
   }
 }
 
+
+/*****************************************************************************
+ * dvbpsi_SetHeaderFilter
+ *****************************************************************************
+ * Set or clear the filter run on the start of each section.
+ *****************************************************************************/
+void dvbpsi_SetHeaderFilter(dvbpsi_handle h_dvbpsi,
+                            dvbpsi_header_filter_cb pf_filter,
+                            void* p_cb_data, int i_size)
+{
+  /* The section being reassembled may be part way through filtering */
+  if(h_dvbpsi->p_current_section)
+  {
+    dvbpsi_ReleasePSISections(h_dvbpsi, h_dvbpsi->p_current_section);
+    h_dvbpsi->p_current_section = NULL;
+  }
+
+  h_dvbpsi->pf_header_filter = pf_filter;
+  h_dvbpsi->p_header_filter_data = p_cb_data;
+  h_dvbpsi->i_header_filter_size = (i_size < 3) ? 3 : i_size;
+}
+
+
+/*****************************************************************************
+ * dvbpsi_NewSection
+ *****************************************************************************
+ * Claim a section and reset the reassembly state to wait for its header.
+ *****************************************************************************/
+static dvbpsi_psi_section_t* dvbpsi_NewSection(dvbpsi_handle h_dvbpsi)
+{
+  /* Just need the header to know how long is the section */
+  h_dvbpsi->i_need = 3;
+  h_dvbpsi->b_complete_header = 0;
+  h_dvbpsi->b_filter_header = 0;
+  h_dvbpsi->b_skip_section = 0;
+  return dvbpsi_ClaimPSISection(h_dvbpsi, h_dvbpsi->i_section_max_size);
+}
+
@@ -0,0 +1,313 @@
+/*****************************************************************************
+ * pool.c: process wide pool of PSI section memory
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ *----------------------------------------------------------------------------
+ * Each class has a shared free list, protected by a mutex, and every thread
+ * that uses the pool has a cache of up to DVBPSI_POOL_CACHE_MAX items of each
+ * class. Items move between a thread's cache and the shared list
+ * DVBPSI_POOL_BATCH at a time. Only the shared lists are capped, the thread
+ * caches are small enough not to matter.
+ *****************************************************************************/
+
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#if defined(HAVE_INTTYPES_H)
+#include <inttypes.h>
+#elif defined(HAVE_STDINT_H)
+#include <stdint.h>
+#endif
+
+#include "dvbpsi.h"
+#include "psi.h"
+#include "pool.h"
+
+
+/*****************************************************************************
+ * Local definitions
+ *****************************************************************************/
+#define DVBPSI_POOL_CACHE_MAX 32
+#define DVBPSI_POOL_BATCH     16
+
+/* Default cap on the memory kept by the shared lists. */
+#define DVBPSI_POOL_DEFAULT_LIMIT (4 * 1024 * 1024)
+
+typedef struct dvbpsi_pool_item_s
+{
+  struct dvbpsi_pool_item_s * p_next;
+} dvbpsi_pool_item_t;
+
+typedef struct dvbpsi_pool_cache_s
+{
+  dvbpsi_pool_item_t *  p_items[DVBPSI_POOL_CLASSES];
+  unsigned int          i_count[DVBPSI_POOL_CLASSES];
+} dvbpsi_pool_cache_t;
+
+static void dvbpsi_PoolCacheKeyInit(void);
+static dvbpsi_pool_cache_t * dvbpsi_PoolGetCache(void);
+static void dvbpsi_PoolCacheDestroy(void *p_arg);
+static void dvbpsi_PoolRefill(dvbpsi_pool_cache_t *p_cache,
+                              dvbpsi_pool_class_t i_class);
+static void dvbpsi_PoolFlush(dvbpsi_pool_cache_t *p_cache,
+                             dvbpsi_pool_class_t i_class, unsigned int i_count);
+static void dvbpsi_PoolReturn(dvbpsi_pool_class_t i_class,
+                              dvbpsi_pool_item_t *p_item);
+
+static const size_t s_class_size[DVBPSI_POOL_CLASSES] =
+{
+  sizeof(dvbpsi_psi_section_t),
+  sizeof(dvbpsi_psi_data_t) + 1024,
+  sizeof(dvbpsi_psi_data_t) + 4096
+};
+
+static pthread_mutex_t s_pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+static dvbpsi_pool_item_t * s_shared[DVBPSI_POOL_CLASSES];
+static size_t s_shared_bytes = 0;
+static size_t s_limit = DVBPSI_POOL_DEFAULT_LIMIT;
+
+static volatile unsigned int s_outstanding[DVBPSI_POOL_CLASSES];
+static volatile unsigned int s_free[DVBPSI_POOL_CLASSES];
+static volatile unsigned int s_data_outstanding = 0;
+static volatile unsigned int s_peak = 0;
+
+static pthread_once_t s_cache_once = PTHREAD_ONCE_INIT;
+static pthread_key_t s_cache_key;
+static __thread dvbpsi_pool_cache_t * tp_cache = NULL;
+
+
+/*****************************************************************************
+ * dvbpsi_PoolClass
+ *****************************************************************************/
+dvbpsi_pool_class_t dvbpsi_PoolClass(size_t i_size)
+{
+  if(i_size <= 1024)
+    return DVBPSI_POOL_DATA_1K;
+  if(i_size <= 4096)
+    return DVBPSI_POOL_DATA_4K;
+  return DVBPSI_POOL_NONE;
+}
+
+/*****************************************************************************
+ * dvbpsi_PoolAlloc
+ *****************************************************************************/
+void *dvbpsi_PoolAlloc(dvbpsi_pool_class_t i_class)
+{
+  dvbpsi_pool_cache_t * p_cache = dvbpsi_PoolGetCache();
+  dvbpsi_pool_item_t * p_item = NULL;
+  unsigned int i_outstanding, i_peak;
+
+  if(p_cache)
+  {
+    if(p_cache->i_count[i_class] == 0)
+      dvbpsi_PoolRefill(p_cache, i_class);
+
+    p_item = p_cache->p_items[i_class];
+    if(p_item)
+    {
+      p_cache->p_items[i_class] = p_item->p_next;
+      p_cache->i_count[i_class]--;
+      __sync_sub_and_fetch(&s_free[i_class], 1);
+    }
+  }
+
+  if(p_item == NULL)
+  {
+    p_item = (dvbpsi_pool_item_t*)malloc(s_class_size[i_class]);
+    if(p_item == NULL)
+      return NULL;
+  }
+
+  __sync_add_and_fetch(&s_outstanding[i_class], 1);
+  if(i_class != DVBPSI_POOL_SECTION)
+  {
+    i_outstanding = __sync_add_and_fetch(&s_data_outstanding, 1);
+    while(i_outstanding > (i_peak = s_peak))
+    {
+      if(__sync_bool_compare_and_swap(&s_peak, i_peak, i_outstanding))
+        break;
+    }
+  }
+  return p_item;
+}
+
+/*****************************************************************************
+ * dvbpsi_PoolFree
+ *****************************************************************************/
+void dvbpsi_PoolFree(dvbpsi_pool_class_t i_class, void *p_item)
+{
+  dvbpsi_pool_cache_t * p_cache = dvbpsi_PoolGetCache();
+  dvbpsi_pool_item_t * p_pool_item = (dvbpsi_pool_item_t*)p_item;
+
+  __sync_sub_and_fetch(&s_outstanding[i_class], 1);
+  if(i_class != DVBPSI_POOL_SECTION)
+    __sync_sub_and_fetch(&s_data_outstanding, 1);
+  __sync_add_and_fetch(&s_free[i_class], 1);
+
+  if(p_cache == NULL)
+  {
+    pthread_mutex_lock(&s_pool_mutex);
+    dvbpsi_PoolReturn(i_class, p_pool_item);
+    pthread_mutex_unlock(&s_pool_mutex);
+    return;
+  }
+
+  p_pool_item->p_next = p_cache->p_items[i_class];
+  p_cache->p_items[i_class] = p_pool_item;
+  p_cache->i_count[i_class]++;
+  if(p_cache->i_count[i_class] > DVBPSI_POOL_CACHE_MAX)
+    dvbpsi_PoolFlush(p_cache, i_class, DVBPSI_POOL_BATCH);
+}
+
+/*****************************************************************************
+ * dvbpsi_PoolTrim
+ *****************************************************************************/
+void dvbpsi_PoolTrim(void)
+{
+  dvbpsi_pool_cache_t * p_cache = tp_cache;
+  int i;
+
+  for(i = 0; i < DVBPSI_POOL_CLASSES; i++)
+  {
+    if(p_cache)
+      dvbpsi_PoolFlush(p_cache, i, p_cache->i_count[i]);
+
+    pthread_mutex_lock(&s_pool_mutex);
+    while(s_shared[i])
+    {
+      dvbpsi_pool_item_t * p_item = s_shared[i];
+      s_shared[i] = p_item->p_next;
+      s_shared_bytes -= s_class_size[i];
+      __sync_sub_and_fetch(&s_free[i], 1);
+      free(p_item);
+    }
+    pthread_mutex_unlock(&s_pool_mutex);
+  }
+}
+
+/*****************************************************************************
+ * dvbpsi_PoolSetLimit
+ *****************************************************************************/
+void dvbpsi_PoolSetLimit(size_t i_limit)
+{
+  pthread_mutex_lock(&s_pool_mutex);
+  s_limit = i_limit;
+  pthread_mutex_unlock(&s_pool_mutex);
+}
+
+/*****************************************************************************
+ * dvbpsi_PoolGetStats
+ *****************************************************************************/
+void dvbpsi_PoolGetStats(dvbpsi_pool_stats_t *p_stats)
+{
+  int i;
+
+  p_stats->i_outstanding = s_data_outstanding;
+  p_stats->i_free = s_free[DVBPSI_POOL_DATA_1K] + s_free[DVBPSI_POOL_DATA_4K];
+  p_stats->i_peak = s_peak;
+  p_stats->i_free_bytes = 0;
+  for(i = 0; i < DVBPSI_POOL_CLASSES; i++)
+    p_stats->i_free_bytes += s_free[i] * s_class_size[i];
+  p_stats->i_limit = s_limit;
+}
+
+/*****************************************************************************
+ * Local functions
+ *****************************************************************************/
+static void dvbpsi_PoolCacheKeyInit(void)
+{
+  pthread_key_create(&s_cache_key, dvbpsi_PoolCacheDestroy);
+}
+
+static dvbpsi_pool_cache_t * dvbpsi_PoolGetCache(void)
+{
+  if(tp_cache == NULL)
+  {
+    pthread_once(&s_cache_once, dvbpsi_PoolCacheKeyInit);
+    tp_cache = (dvbpsi_pool_cache_t*)calloc(1, sizeof(dvbpsi_pool_cache_t));
+    if(tp_cache)
+      pthread_setspecific(s_cache_key, tp_cache);
+  }
+  return tp_cache;
+}
+
+/* Called when a thread exits, hands its cache back to the shared lists. */
+static void dvbpsi_PoolCacheDestroy(void *p_arg)
+{
+  dvbpsi_pool_cache_t * p_cache = (dvbpsi_pool_cache_t*)p_arg;
+  int i;
+
+  for(i = 0; i < DVBPSI_POOL_CLASSES; i++)
+    dvbpsi_PoolFlush(p_cache, i, p_cache->i_count[i]);
+
+  tp_cache = NULL;
+  free(p_cache);
+}
+
+static void dvbpsi_PoolRefill(dvbpsi_pool_cache_t *p_cache,
+                              dvbpsi_pool_class_t i_class)
+{
+  unsigned int i;
+
+  pthread_mutex_lock(&s_pool_mutex);
+  for(i = 0; (i < DVBPSI_POOL_BATCH) && s_shared[i_class]; i++)
+  {
+    dvbpsi_pool_item_t * p_item = s_shared[i_class];
+    s_shared[i_class] = p_item->p_next;
+    s_shared_bytes -= s_class_size[i_class];
+
+    p_item->p_next = p_cache->p_items[i_class];
+    p_cache->p_items[i_class] = p_item;
+    p_cache->i_count[i_class]++;
+  }
+  pthread_mutex_unlock(&s_pool_mutex);
+}
+
+static void dvbpsi_PoolFlush(dvbpsi_pool_cache_t *p_cache,
+                             dvbpsi_pool_class_t i_class, unsigned int i_count)
+{
+  unsigned int i;
+
+  pthread_mutex_lock(&s_pool_mutex);
+  for(i = 0; (i < i_count) && p_cache->p_items[i_class]; i++)
+  {
+    dvbpsi_pool_item_t * p_item = p_cache->p_items[i_class];
+    p_cache->p_items[i_class] = p_item->p_next;
+    p_cache->i_count[i_class]--;
+    dvbpsi_PoolReturn(i_class, p_item);
+  }
+  pthread_mutex_unlock(&s_pool_mutex);
+}
+
+/* Must be called with s_pool_mutex held. */
+static void dvbpsi_PoolReturn(dvbpsi_pool_class_t i_class,
+                              dvbpsi_pool_item_t *p_item)
+{
+  if(s_shared_bytes + s_class_size[i_class] > s_limit)
+  {
+    __sync_sub_and_fetch(&s_free[i_class], 1);
+    free(p_item);
+    return;
+  }
+  p_item->p_next = s_shared[i_class];
+  s_shared[i_class] = p_item;
+  s_shared_bytes += s_class_size[i_class];
+}
@@ -47,6 +47,7 @@ dvbpsi_handle dvbpsi_AttachSections(dvbpsi_sections_new_cb_t pf_new_cb,
   h_dvbpsi->i_continuity_counter = 31;
   h_dvbpsi->b_discontinuity = 1;
   h_dvbpsi->p_current_section = NULL;
+  h_dvbpsi->pf_header_filter = NULL;
   h_dvbpsi->p_free_sections = NULL;
 
   /* Sutables demux configuration */
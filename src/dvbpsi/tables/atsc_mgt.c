@@ -117,8 +117,12 @@ int dvbpsi_atsc_AttachMGT(dvbpsi_decoder_t * p_psi_decoder, uint8_t i_table_id,
   p_subdec->pf_detach = dvbpsi_atsc_DetachMGT;
 
   /* Attach the subtable decoder to the demux */
-  p_subdec->p_next = p_demux->p_first_subdec;
-  p_demux->p_first_subdec = p_subdec;
+  if(dvbpsi_demuxAddSubDec(p_demux, p_subdec))
+  {
+    free(p_mgt_decoder);
+    free(p_subdec);
+    return 1;
+  }
 
   /* MGT decoder information */
   p_mgt_decoder->pf_callback = pf_callback;
@@ -141,7 +145,6 @@ int dvbpsi_atsc_AttachMGT(dvbpsi_decoder_t * p_psi_decoder, uint8_t i_table_id,
 void dvbpsi_atsc_DetachMGT(dvbpsi_demux_t * p_demux, uint8_t i_table_id, uint16_t i_extension)
 {
   dvbpsi_demux_subdec_t* p_subdec;
-  dvbpsi_demux_subdec_t** pp_prev_subdec;
   dvbpsi_atsc_mgt_decoder_t* p_mgt_decoder;
 
   unsigned int i;
@@ -172,11 +175,7 @@ void dvbpsi_atsc_DetachMGT(dvbpsi_demux_t * p_demux, uint8_t i_table_id, uint16_
 
   free(p_subdec->p_cb_data);
 
-  pp_prev_subdec = &p_demux->p_first_subdec;
-  while(*pp_prev_subdec != p_subdec)
-    pp_prev_subdec = &(*pp_prev_subdec)->p_next;
-
-  *pp_prev_subdec = p_subdec->p_next;
+  dvbpsi_demuxRemoveSubDec(p_demux, p_subdec);
   free(p_subdec);
 }
 
@@ -97,8 +97,12 @@ int dvbpsi_atsc_AttachSTT(dvbpsi_decoder_t * p_psi_decoder, uint8_t i_table_id,
   p_subdec->pf_detach = dvbpsi_atsc_DetachSTT;
 
   /* Attach the subtable decoder to the demux */
-  p_subdec->p_next = p_demux->p_first_subdec;
-  p_demux->p_first_subdec = p_subdec;
+  if(dvbpsi_demuxAddSubDec(p_demux, p_subdec))
+  {
+    free(p_stt_decoder);
+    free(p_subdec);
+    return 1;
+  }
 
   /* STT decoder information */
   p_stt_decoder->pf_callback = pf_callback;
@@ -116,7 +120,6 @@ int dvbpsi_atsc_AttachSTT(dvbpsi_decoder_t * p_psi_decoder, uint8_t i_table_id,
 void dvbpsi_atsc_DetachSTT(dvbpsi_demux_t * p_demux, uint8_t i_table_id, uint16_t i_extension)
 {
   dvbpsi_demux_subdec_t* p_subdec;
-  dvbpsi_demux_subdec_t** pp_prev_subdec;
   dvbpsi_atsc_stt_decoder_t* p_stt_decoder;
 
   p_subdec = dvbpsi_demuxGetSubDec(p_demux, i_table_id, 0);
@@ -134,11 +137,7 @@ void dvbpsi_atsc_DetachSTT(dvbpsi_demux_t * p_demux, uint8_t i_table_id, uint16_
 
   free(p_subdec->p_cb_data);
 
-  pp_prev_subdec = &p_demux->p_first_subdec;
-  while(*pp_prev_subdec != p_subdec)
-    pp_prev_subdec = &(*pp_prev_subdec)->p_next;
-
-  *pp_prev_subdec = p_subdec->p_next;
+  dvbpsi_demuxRemoveSubDec(p_demux, p_subdec);
   free(p_subdec);
 }
 
@@ -128,8 +128,12 @@ int dvbpsi_atsc_AttachVCT(dvbpsi_decoder_t * p_psi_decoder, uint8_t i_table_id,
   p_subdec->pf_detach = dvbpsi_atsc_DetachVCT;
 
   /* Attach the subtable decoder to the demux */
-  p_subdec->p_next = p_demux->p_first_subdec;
-  p_demux->p_first_subdec = p_subdec;
+  if(dvbpsi_demuxAddSubDec(p_demux, p_subdec))
+  {
+    free(p_vct_decoder);
+    free(p_subdec);
+    return 1;
+  }
 
   /* VCT decoder information */
   p_vct_decoder->pf_callback = pf_callback;
@@ -152,7 +156,6 @@ int dvbpsi_atsc_AttachVCT(dvbpsi_decoder_t * p_psi_decoder, uint8_t i_table_id,
 void dvbpsi_atsc_DetachVCT(dvbpsi_demux_t * p_demux, uint8_t i_table_id, uint16_t i_extension)
 {
   dvbpsi_demux_subdec_t* p_subdec;
-  dvbpsi_demux_subdec_t** pp_prev_subdec;
   dvbpsi_atsc_vct_decoder_t* p_vct_decoder;
 
   unsigned int i;
@@ -182,11 +185,7 @@ void dvbpsi_atsc_DetachVCT(dvbpsi_demux_t * p_demux, uint8_t i_table_id, uint16_
 
   free(p_subdec->p_cb_data);
 
-  pp_prev_subdec = &p_demux->p_first_subdec;
-  while(*pp_prev_subdec != p_subdec)
-    pp_prev_subdec = &(*pp_prev_subdec)->p_next;
-
-  *pp_prev_subdec = p_subdec->p_next;
+  dvbpsi_demuxRemoveSubDec(p_demux, p_subdec);
   free(p_subdec);
 }
 
@@ -96,8 +96,12 @@ int dvbpsi_AttachEIT(dvbpsi_decoder_t * p_psi_decoder, uint8_t i_table_id,
   p_subdec->pf_detach = dvbpsi_DetachEIT;
 
   /* Attach the subtable decoder to the demux */
-  p_subdec->p_next = p_demux->p_first_subdec;
-  p_demux->p_first_subdec = p_subdec;
+  if(dvbpsi_demuxAddSubDec(p_demux, p_subdec))
+  {
+    free(p_eit_decoder);
+    free(p_subdec);
+    return 1;
+  }
 
   /* EIT decoder information */
   p_eit_decoder->pf_callback = pf_callback;
@@ -121,7 +125,6 @@ void dvbpsi_DetachEIT(dvbpsi_demux_t * p_demux, uint8_t i_table_id,
           uint16_t i_extension)
 {
   dvbpsi_demux_subdec_t* p_subdec;
-  dvbpsi_demux_subdec_t** pp_prev_subdec;
   dvbpsi_eit_decoder_t* p_eit_decoder;
 
   unsigned int i;
@@ -152,11 +155,7 @@ void dvbpsi_DetachEIT(dvbpsi_demux_t * p_demux, uint8_t i_table_id,
 
   free(p_subdec->p_cb_data);
 
-  pp_prev_subdec = &p_demux->p_first_subdec;
-  while(*pp_prev_subdec != p_subdec)
-    pp_prev_subdec = &(*pp_prev_subdec)->p_next;
-
-  *pp_prev_subdec = p_subdec->p_next;
+  dvbpsi_demuxRemoveSubDec(p_demux, p_subdec);
   free(p_subdec);
 }
 
@@ -606,3 +605,119 @@ void dvbpsi_DecodeEITSections(dvbpsi_eit_t* p_eit,
     p_section = p_section->p_next;
   }
 }
+
+/*****************************************************************************
+ * dvbpsi_GenEITSections
+ *****************************************************************************
+ * Generate EIT sections based on the dvbpsi_eit_t structure.
+ *****************************************************************************/
+dvbpsi_psi_section_t *dvbpsi_GenEITSections(dvbpsi_eit_t *p_eit, uint8_t i_table_id)
+{
+  #define INT_TO_BCD(_int) ((((_int) / 10) << 4) | ((_int) % 10))
+  dvbpsi_psi_section_t *p_result = dvbpsi_NewPSISection(1024);
+  dvbpsi_psi_section_t *p_current = p_result;
+  dvbpsi_psi_section_t *p_prev;
+  dvbpsi_eit_event_t *p_event = p_eit->p_first_event;
+
+  p_current->i_table_id = i_table_id;
+  p_current->b_syntax_indicator = 1;
+  p_current->b_private_indicator = 1;
+  p_current->i_length = 15;                     /* header + CRC_32 */
+  p_current->i_extension = p_eit->i_service_id;
+  p_current->i_version = p_eit->i_version;
+  p_current->b_current_next = p_eit->b_current_next;
+  p_current->i_number = 0;
+  p_current->p_payload_end += 14;               /* just after the header */
+  p_current->p_payload_start = p_current->p_data + 8;
+
+  p_current->p_data[8] = p_eit->i_ts_id >> 8;
+  p_current->p_data[9] = p_eit->i_ts_id;
+  p_current->p_data[10] = p_eit->i_network_id >> 8;
+  p_current->p_data[11] = p_eit->i_network_id;
+  p_current->p_data[13] = p_eit->i_last_table_id;
+
+  /* EIT events */
+  while(p_event != NULL)
+  {
+    uint8_t *p_event_start = p_current->p_payload_end;
+    uint16_t i_event_length = 12;
+    dvbpsi_descriptor_t *p_descriptor = p_event->p_first_descriptor;
+
+    while(p_descriptor != NULL)
+    {
+      i_event_length += p_descriptor->i_length + 2;
+      p_descriptor = p_descriptor->p_next;
+    }
+
+    if(((p_event_start - p_current->p_data) + i_event_length + 4 > 1024) &&
+       (p_event_start - p_current->p_data != 14))
+    {
+      /* will put the event in an empty section */
+      DVBPSI_DEBUG("EIT generator","create a new section to carry more events");
+      p_prev = p_current;
+      p_current = dvbpsi_NewPSISection(1024);
+      p_prev->p_next = p_current;
+
+      p_current->i_table_id = i_table_id;
+      p_current->b_syntax_indicator = 1;
+      p_current->b_private_indicator = 1;
+      p_current->i_length = 15;                 /* header + CRC_32 */
+      p_current->i_extension = p_eit->i_service_id;
+      p_current->i_version = p_eit->i_version;
+      p_current->b_current_next = p_eit->b_current_next;
+      p_current->i_number = p_prev->i_number + 1;
+      p_current->p_payload_end += 14;           /* just after the header */
+      p_current->p_payload_start = p_current->p_data + 8;
+
+      memcpy(p_current->p_data + 8, p_prev->p_data + 8, 6);
+
+      p_event_start = p_current->p_payload_end;
+    }
+
+    p_event_start[0] = p_event->i_event_id >> 8;
+    p_event_start[1] = p_event->i_event_id;
+    dvbpsi_EncodeMJDUTC(&p_event->t_start_time, p_event_start + 2);
+    p_event_start[7] = INT_TO_BCD((p_event->i_duration / (60 * 60)) % 100);
+    p_event_start[8] = INT_TO_BCD((p_event->i_duration / 60) % 60);
+    p_event_start[9] = INT_TO_BCD(p_event->i_duration % 60);
+    p_event_start[10] = ((p_event->i_running_status & 0x07) << 5) |
+                        ((p_event->b_free_ca & 0x1) << 4);
+
+    p_current->p_payload_end += 12;
+    p_current->i_length += 12;
+
+    /* Event descriptors */
+    p_descriptor = p_event->p_first_descriptor;
+    while((p_descriptor != NULL) &&
+          ((p_current->p_payload_end - p_current->p_data) + p_descriptor->i_length + 2 + 4 <= 1024))
+    {
+      p_current->p_payload_end[0] = p_descriptor->i_tag;
+      p_current->p_payload_end[1] = p_descriptor->i_length;
+      memcpy(p_current->p_payload_end + 2, p_descriptor->p_data, p_descriptor->i_length);
+      p_current->p_payload_end += p_descriptor->i_length + 2;
+      p_current->i_length += p_descriptor->i_length + 2;
+      p_descriptor = p_descriptor->p_next;
+    }
+
+    if(p_descriptor != NULL)
+      DVBPSI_ERROR("EIT generator", "unable to carry all the descriptors");
+
+    /* descriptors_loop_length */
+    i_event_length = p_current->p_payload_end - p_event_start - 12;
+    p_event_start[10] |= (i_event_length >> 8) & 0x0f;
+    p_event_start[11] = i_event_length;
+
+    p_event = p_event->p_next;
+  }
+
+  /* Finalization */
+  p_prev = p_result;
+  while(p_prev != NULL)
+  {
+    p_prev->i_last_number = p_current->i_number;
+    p_prev->p_data[12] = p_current->i_number;   /* segment_last_section_number */
+    dvbpsi_BuildPSISection(p_prev);
+    p_prev = p_prev->p_next;
+  }
+  return p_result;
+}
@@ -75,17 +75,9 @@ void dvbpsi_GatherNITSections(dvbpsi_decoder_t* p_psi_decoder,
 void dvbpsi_DecodeNITSections(dvbpsi_nit_t* p_nit,
                               dvbpsi_psi_section_t* p_section);
 
-dvbpsi_descriptor_t *dvbpsi_NITAddDescriptor(
-                                               dvbpsi_nit_t *p_nit,
-                                               uint8_t i_tag, uint8_t i_length,
-                                               uint8_t *p_data);
-dvbpsi_nit_transport_t *dvbpsi_NITAddTransport(dvbpsi_nit_t* p_nit,
-                                           uint16_t i_ts_id,
-                                           uint16_t i_orignal_network_id);
-dvbpsi_descriptor_t *dvbpsi_NITTransportAddDescriptor(
-                                               dvbpsi_nit_transport_t *p_transport,
-                                               uint8_t i_tag, uint8_t i_length,
-                                               uint8_t *p_data);
+static dvbpsi_psi_section_t *dvbpsi_NewNITSection(dvbpsi_nit_t *p_nit,
+                                                  uint8_t i_number);
+
 /*****************************************************************************
  * dvbpsi_AttachNIT
  *****************************************************************************
@@ -131,8 +123,12 @@ int dvbpsi_AttachNIT(dvbpsi_decoder_t * p_psi_decoder, uint8_t i_table_id,
   p_subdec->pf_detach = dvbpsi_DetachNIT;
 
   /* Attach the subtable decoder to the demux */
-  p_subdec->p_next = p_demux->p_first_subdec;
-  p_demux->p_first_subdec = p_subdec;
+  if(dvbpsi_demuxAddSubDec(p_demux, p_subdec))
+  {
+    free(p_nit_decoder);
+    free(p_subdec);
+    return 1;
+  }
 
   /* NIT decoder information */
   p_nit_decoder->pf_callback = pf_callback;
@@ -156,7 +152,6 @@ void dvbpsi_DetachNIT(dvbpsi_demux_t * p_demux, uint8_t i_table_id,
           uint16_t i_extension)
 {
   dvbpsi_demux_subdec_t* p_subdec;
-  dvbpsi_demux_subdec_t** pp_prev_subdec;
   dvbpsi_nit_decoder_t* p_nit_decoder;
 
   unsigned int i;
@@ -186,11 +181,7 @@ void dvbpsi_DetachNIT(dvbpsi_demux_t * p_demux, uint8_t i_table_id,
 
   free(p_subdec->p_cb_data);
 
-  pp_prev_subdec = &p_demux->p_first_subdec;
-  while(*pp_prev_subdec != p_subdec)
-    pp_prev_subdec = &(*pp_prev_subdec)->p_next;
-
-  *pp_prev_subdec = p_subdec->p_next;
+  dvbpsi_demuxRemoveSubDec(p_demux, p_subdec);
   free(p_subdec);
 }
 
@@ -581,3 +572,136 @@ dvbpsi_descriptor_t *dvbpsi_NITTransportAddDescriptor(
 
   return p_descriptor;
 }
+
+/*****************************************************************************
+ * dvbpsi_GenNITSections
+ *****************************************************************************
+ * Generate NIT sections based on the dvbpsi_nit_t structure.
+ *****************************************************************************/
+dvbpsi_psi_section_t *dvbpsi_GenNITSections(dvbpsi_nit_t *p_nit)
+{
+  dvbpsi_psi_section_t *p_result = NULL;
+  dvbpsi_psi_section_t *p_current = NULL;
+  dvbpsi_psi_section_t *p_prev;
+  dvbpsi_descriptor_t *p_descriptor = p_nit->p_first_descriptor;
+  dvbpsi_nit_transport_t *p_transport = p_nit->p_first_transport;
+  uint8_t *p_length;
+  uint16_t i_loop_length;
+
+  do
+  {
+    p_prev = p_current;
+    p_current = dvbpsi_NewNITSection(p_nit, p_prev ? p_prev->i_number + 1 : 0);
+    if(p_prev)
+      p_prev->p_next = p_current;
+    else
+      p_result = p_current;
+
+    /* Network descriptors, leave room for the transport loop length and
+       CRC_32 */
+    p_length = p_current->p_payload_end;
+    p_current->p_payload_end += 2;
+    while((p_descriptor != NULL) &&
+          ((p_current->p_payload_end - p_current->p_data) + p_descriptor->i_length + 2 + 2 + 4 <= 1024))
+    {
+      p_current->p_payload_end[0] = p_descriptor->i_tag;
+      p_current->p_payload_end[1] = p_descriptor->i_length;
+      memcpy(p_current->p_payload_end + 2, p_descriptor->p_data, p_descriptor->i_length);
+      p_current->p_payload_end += p_descriptor->i_length + 2;
+      p_descriptor = p_descriptor->p_next;
+    }
+    i_loop_length = p_current->p_payload_end - p_length - 2;
+    p_length[0] = 0xf0 | ((i_loop_length >> 8) & 0x0f);
+    p_length[1] = i_loop_length;
+
+    /* Transport stream loop */
+    p_length = p_current->p_payload_end;
+    p_current->p_payload_end += 2;
+    while((p_descriptor == NULL) && (p_transport != NULL))
+    {
+      uint8_t *p_transport_start = p_current->p_payload_end;
+      uint16_t i_transport_length = 6;
+      dvbpsi_descriptor_t *p_ts_descriptor = p_transport->p_first_descriptor;
+
+      while(p_ts_descriptor != NULL)
+      {
+        i_transport_length += p_ts_descriptor->i_length + 2;
+        p_ts_descriptor = p_ts_descriptor->p_next;
+      }
+
+      if(((p_transport_start - p_current->p_data) + i_transport_length + 4 > 1024) &&
+         (p_transport_start != p_length + 2))
+      {
+        /* Carry this transport in the next section */
+        DVBPSI_DEBUG("NIT generator","create a new section to carry more transports");
+        break;
+      }
+
+      p_transport_start[0] = p_transport->i_ts_id >> 8;
+      p_transport_start[1] = p_transport->i_ts_id;
+      p_transport_start[2] = p_transport->i_original_network_id >> 8;
+      p_transport_start[3] = p_transport->i_original_network_id;
+      p_current->p_payload_end += 6;
+
+      p_ts_descriptor = p_transport->p_first_descriptor;
+      while((p_ts_descriptor != NULL) &&
+            ((p_current->p_payload_end - p_current->p_data) + p_ts_descriptor->i_length + 2 + 4 <= 1024))
+      {
+        p_current->p_payload_end[0] = p_ts_descriptor->i_tag;
+        p_current->p_payload_end[1] = p_ts_descriptor->i_length;
+        memcpy(p_current->p_payload_end + 2, p_ts_descriptor->p_data, p_ts_descriptor->i_length);
+        p_current->p_payload_end += p_ts_descriptor->i_length + 2;
+        p_ts_descriptor = p_ts_descriptor->p_next;
+      }
+
+      if(p_ts_descriptor != NULL)
+        DVBPSI_ERROR("NIT generator", "unable to carry all the descriptors");
+
+      i_transport_length = p_current->p_payload_end - p_transport_start - 6;
+      p_transport_start[4] = 0xf0 | ((i_transport_length >> 8) & 0x0f);
+      p_transport_start[5] = i_transport_length;
+
+      p_transport = p_transport->p_next;
+    }
+    i_loop_length = p_current->p_payload_end - p_length - 2;
+    p_length[0] = 0xf0 | ((i_loop_length >> 8) & 0x0f);
+    p_length[1] = i_loop_length;
+
+    /* header (minus the first 3 bytes) + payload + CRC_32 */
+    p_current->i_length = (p_current->p_payload_end - p_current->p_data) - 3 + 4;
+  }
+  while((p_descriptor != NULL) || (p_transport != NULL));
+
+  /* Finalization */
+  p_prev = p_result;
+  while(p_prev != NULL)
+  {
+    p_prev->i_last_number = p_current->i_number;
+    dvbpsi_BuildPSISection(p_prev);
+    p_prev = p_prev->p_next;
+  }
+  return p_result;
+}
+
+/*****************************************************************************
+ * dvbpsi_NewNITSection
+ *****************************************************************************
+ * Allocate a NIT section and fill in the header fields.
+ *****************************************************************************/
+static dvbpsi_psi_section_t *dvbpsi_NewNITSection(dvbpsi_nit_t *p_nit,
+                                                  uint8_t i_number)
+{
+  dvbpsi_psi_section_t *p_section = dvbpsi_NewPSISection(1024);
+
+  p_section->i_table_id = p_nit->b_actual ? 0x40 : 0x41;
+  p_section->b_syntax_indicator = 1;
+  p_section->b_private_indicator = 1;
+  p_section->i_extension = p_nit->i_network_id;
+  p_section->i_version = p_nit->i_version;
+  p_section->b_current_next = p_nit->b_current_next;
+  p_section->i_number = i_number;
+  p_section->p_payload_end += 8;                /* just after the header */
+  p_section->p_payload_start = p_section->p_data + 8;
+
+  return p_section;
+}
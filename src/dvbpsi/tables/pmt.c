@@ -79,6 +79,7 @@ dvbpsi_handle dvbpsi_AttachPMT(uint16_t i_program_number,
   h_dvbpsi->i_continuity_counter = 31;
   h_dvbpsi->b_discontinuity = 1;
   h_dvbpsi->p_current_section = NULL;
+  h_dvbpsi->pf_header_filter = NULL;
   h_dvbpsi->p_free_sections = NULL;  
 
   /* PMT decoder configuration */
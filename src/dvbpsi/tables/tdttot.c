@@ -98,6 +98,7 @@ dvbpsi_handle dvbpsi_AttachTDTTOT(dvbpsi_tdt_tot_callback pf_callback,
   h_dvbpsi->i_continuity_counter = 31;
   h_dvbpsi->b_discontinuity = 1;
   h_dvbpsi->p_current_section = NULL;
+  h_dvbpsi->pf_header_filter = NULL;
   h_dvbpsi->p_free_sections = NULL;
 
   /* TDT/TOT decoder information */
@@ -257,3 +258,25 @@ dvbpsi_descriptor_t *dvbpsi_TOTAddDescriptor(
 
   return p_descriptor;
 }
+
+/*****************************************************************************
+ * dvbpsi_GenTDTSections
+ *****************************************************************************
+ * Generate a TDT section based on the dvbpsi_tdt_tot_t structure.
+ *****************************************************************************/
+dvbpsi_psi_section_t *dvbpsi_GenTDTSections(dvbpsi_tdt_tot_t *p_tdt)
+{
+  dvbpsi_psi_section_t *p_result = dvbpsi_NewPSISection(1024);
+
+  p_result->i_table_id = 0x70;
+  p_result->b_syntax_indicator = 0;
+  p_result->b_private_indicator = 1;
+  p_result->i_length = 5;                       /* UTC_time */
+  p_result->p_payload_start = p_result->p_data + 3;
+  p_result->p_payload_end += 8;
+
+  dvbpsi_EncodeMJDUTC(&p_tdt->t_date_time, p_result->p_payload_start);
+  dvbpsi_BuildPSISection(p_result);
+
+  return p_result;
+}
@@ -30,6 +30,9 @@ Opens/Closes and setups dvb adapter for use in the rest of the application.
 #include <errno.h>
 #include <sys/time.h>
 #include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
 #include <sys/poll.h>
 #include <sys/ioctl.h>
 #include <linux/dvb/dmx.h>
@@ -46,6 +49,9 @@ Opens/Closes and setups dvb adapter for use in the rest of the application.
 #include "main.h"
 #include "dispatchers.h"
 #include "yamlutils.h"
+#include "ts.h"
+#include "tsframer.h"
+#include "adapter_private.h"
 
 /*******************************************************************************
 * Defines                                                                      *
@@ -54,11 +60,38 @@ Opens/Closes and setups dvb adapter for use in the rest of the application.
 #define MONITOR_CMD_RETUNING          1
 #define MONITOR_CMD_FE_ACTIVATE       2
 #define MONITOR_CMD_FE_DEACTIVATE     3
+#define MONITOR_CMD_REPLAY_MODE       4
+
+/* Maximum number of separate regions of the stream file written in one go. */
+#define FILEADAPTER_MAX_IOV           1024
+/* Number of packets consumed per callback in fast mode. */
+#define FILEADAPTER_FAST_BATCH        8192
+/* Amount of the file searched at a time when hunting for sync. */
+#define FILEADAPTER_HUNT_WINDOW       (1024 * 1024)
+/* Number of packets to search for the next PCR. */
+#define FILEADAPTER_PCR_LOOKAHEAD     65536
+/* Interval between paced sends in seconds. */
+#define FILEADAPTER_TICK              0.01
+/* How far (in seconds) pacing may fall behind before giving up on catching up. */
+#define FILEADAPTER_MAX_LAG           1.0
+
+#define PIDBITMAP_WORDS                (TS_MAX_PIDS / 32)
+#define PIDBITMAP_ISSET(_bitmap, _pid) ((_bitmap)[(_pid) >> 5] & (1U << ((_pid) & 31)))
+#define PIDBITMAP_SET(_bitmap, _pid)   ((_bitmap)[(_pid) >> 5] |= (1U << ((_pid) & 31)))
+
 /*******************************************************************************
 * Typedefs                                                                     *
 *******************************************************************************/
+typedef enum FileReplayMode_e
+{
+    FileReplayMode_Fast,    /**< Send packets as fast as the pipe will accept them. */
+    FileReplayMode_Bitrate, /**< Send packets at the bit rate given in the frequency file. */
+    FileReplayMode_PCR,     /**< Send packets at the rate indicated by the PCRs in the stream. */
+}FileReplayMode_e;
+
 struct DVBAdapter_s
 {
+    DVBAdapterCommon_t common;        /**< MUST BE FIRST FIELD */
     int adapter;                      /**< The adapter number ie /dev/dvb/adapter<#adapter> */
 
     DVBSupportedDeliverySys_t *supportedDelSystems;
@@ -83,22 +116,90 @@ struct DVBAdapter_s
     int cmdSendFd;                    /**< File descriptor to send commands to monitor task. */
     ev_io commandWatcher;
     int sendFd;
-    ev_timer sendTimer; 
+    ev_timer sendTimer;               /**< Paces sends in bitrate/PCR mode */
+    ev_io sendWatcher;                /**< Fires when the pipe has space in fast mode */
+
+    FileReplayMode_e replayMode;      /**< How the stream file is replayed */
+    FileReplayMode_e requestedReplayMode; /**< Mode set via the replay property */
+    unsigned long rate;               /**< Bit rate of the stream file in bits per second */
+    uint8_t *map;                     /**< Stream file mapped into memory */
+    size_t mapLength;                 /**< Size of the mapping */
+    size_t mapPos;                    /**< Offset of the next packet in the mapping */
+    unsigned int mapPacketSize;       /**< Size of packets in the file, 0 when hunting for sync */
+
+    uint32_t pidBitmap[PIDBITMAP_WORDS];/**< PIDs with a filter allocated */
+    bool allPids;                     /**< Whether a filter for all PIDs is allocated */
+    bool anyPids;                     /**< Whether any filters are allocated */
+
+    struct iovec iov[FILEADAPTER_MAX_IOV];/**< Packets waiting to be written to the pipe */
+    int iovStart;                     /**< First iovec still to be written */
+    int iovCount;                     /**< Number of iovecs in use */
+
+    ev_tstamp paceStart;              /**< Time bitrate pacing started */
+    unsigned long long paceCount;     /**< Packets consumed since paceStart */
+
+    int pcrPid;                       /**< PID the PCRs are taken from, -1 until one is seen */
+    bool pcrLocked;                   /**< Whether pcrBase/pcrWallBase are valid */
+    uint64_t pcrBase;                 /**< PCR corresponding to pcrWallBase */
+    ev_tstamp pcrWallBase;            /**< Time pcrBase is due to be sent */
+    uint64_t pcrLast;                 /**< Last PCR sent */
+    ev_tstamp segmentDue;             /**< Time the last PCR was due */
+    ev_tstamp segmentInterval;        /**< Time between packets until the next PCR */
+    unsigned int segmentIndex;        /**< Packets sent since the last PCR */
+
+    int packetsSent;                  /**< Packets written to the pipe */
+    int syncLosses;                   /**< Times sync was lost in the stream file */
 } ;
 
 /*******************************************************************************
 * Prototypes                                                                   *
 *******************************************************************************/
+static DVBAdapter_t *FileInit(DVBAdapterCommon_t *common, int adapter, bool hwRestricted, bool forceISDB);
+static void FileDispose(DVBAdapter_t *adapter);
+static DVBSupportedDeliverySys_t *FileFrontEndGetDeliverySystems(DVBAdapter_t *adapter);
+static bool FileFrontEndDeliverySystemSupported(DVBAdapter_t * adapter,DVBDeliverySystem_e system);
+static int FileFrontEndTune(DVBAdapter_t *adapter, DVBDeliverySystem_e system, char *params);
+static char* FileFrontEndParametersGet(DVBAdapter_t *adapter, DVBDeliverySystem_e *system);
+static bool FileFrontEndParameterSupported(DVBAdapter_t *adapter,DVBDeliverySystem_e system, char *param, char *value);
+static void FileFrontEndLNBInfoSet(DVBAdapter_t *adapter, LNBInfo_t *info);
+static void FileFrontEndLNBInfoGet(DVBAdapter_t *adapter, LNBInfo_t *lnbInfo);
+static bool FileFrontEndIsLocked(DVBAdapter_t *adapter);
+static int FileFrontEndStatus(DVBAdapter_t *adapter, DVBFrontEndStatus_e *status,
+                            unsigned int *ber, unsigned int *strength,
+                            unsigned int *snr, unsigned int *ucblock);
+static int FileFrontEndSetActive(DVBAdapter_t *adapter, bool active);
+static int FileDemuxGetMaxFilters(DVBAdapter_t *adapter);
+static int FileDemuxGetAvailableFilters(DVBAdapter_t *adapter);
+static int FileDemuxSetBufferSize(DVBAdapter_t *adapter, unsigned long size);
+static bool FileDemuxIsHardwareRestricted(DVBAdapter_t *adapter);
+static int FileDemuxAllocateFilter(DVBAdapter_t *adapter, uint16_t pid);
+static int FileDemuxReleaseFilter(DVBAdapter_t *adapter, uint16_t pid);
+static int FileDemuxReleaseAllFilters(DVBAdapter_t *adapter);
+static int FileDVRGetFD(DVBAdapter_t *adapter);
+
 static int DVBOpenAdapterFile(DVBAdapter_t *adapter);
 static int DVBOpenStreamFile(int adapter, uint32_t freq, int *fd, unsigned long *rate);
 static void DVBFrontEndMonitorSend(DVBAdapter_t *adapter, char cmd);
 static void DVBCommandCallback(struct ev_loop *loop, ev_io *w, int revents);
 static void DVBFilterPackets(struct ev_loop *loop, ev_timer *w, int revents);
-static int DVBEventToString(yaml_document_t *document, Event_t event, void *payload);
+static void DVBSendWritable(struct ev_loop *loop, ev_io *w, int revents);
+
+static int FileReplayOpen(DVBAdapter_t *adapter, struct ev_loop *loop);
+static void FileReplayClose(DVBAdapter_t *adapter, struct ev_loop *loop);
+static void FileReplaySchedule(DVBAdapter_t *adapter, struct ev_loop *loop);
+static uint8_t *FileReplayNextPacket(DVBAdapter_t *adapter);
+static unsigned int FileReplayFill(DVBAdapter_t *adapter, unsigned int maxPackets, ev_tstamp now, ev_tstamp *wait);
+static bool FileReplayFlush(DVBAdapter_t *adapter);
+static unsigned int FileReplayBitrateBudget(DVBAdapter_t *adapter, ev_tstamp now);
+static bool FileReplayPCRDue(DVBAdapter_t *adapter, uint8_t *packet, ev_tstamp now, ev_tstamp *wait);
+static ev_tstamp FileReplayPCRInterval(DVBAdapter_t *adapter, uint8_t *packet, uint64_t pcr);
+static void FileUpdatePIDBitmap(DVBAdapter_t *adapter);
 
 static int DVBPropertyActiveGet(void *userArg, PropertyValue_t *value);
 static int DVBPropertyActiveSet(void *userArg, PropertyValue_t *value);
 static int DVBPropertyDeliverySystemsGet(void *userArg, PropertyValue_t *value);
+static int DVBPropertyReplayGet(void *userArg, PropertyValue_t *value);
+static int DVBPropertyReplaySet(void *userArg, PropertyValue_t *value);
 static uint32_t ConvertStringToUInt32(const char *str, uint32_t defaultValue);
 static uint32_t ConvertYamlNode(yaml_document_t * document, const char *key, 
                         uint32_t (*convert)(const char *, uint32_t), uint32_t defaultValue);
@@ -107,42 +208,55 @@ static uint32_t ConvertYamlNode(yaml_document_t * document, const char *key,
 * Global variables                                                             *
 *******************************************************************************/
 static const char FILEADAPTER[] = "FileAdapter";
-static const char propertyParent[] = "adapter";
+static const char FILEADAPTER_CLASS[] = "FileAdapter_t";
 static const char adapterName[] = "File Adapter";
-static EventSource_t dvbSource = NULL;
-static Event_t lockedEvent;
-static Event_t unlockedEvent;
-static Event_t tuningFailedEvent;
-static Event_t feActiveEvent;
-static Event_t feIdleEvent;
+static const char *replayModeNames[] = {"fast", "bitrate", "pcr"};
+
+DVBAdapterOps_t FileAdapterOps = {
+    "File",
+    FileInit,
+    FileDispose,
+    FileFrontEndGetDeliverySystems,
+    FileFrontEndDeliverySystemSupported,
+    FileFrontEndTune,
+    FileFrontEndParametersGet,
+    FileFrontEndParameterSupported,
+    FileFrontEndLNBInfoSet,
+    FileFrontEndLNBInfoGet,
+    FileFrontEndStatus,
+    FileFrontEndIsLocked,
+    FileFrontEndSetActive,
+    FileDemuxSetBufferSize,
+    FileDemuxIsHardwareRestricted,
+    FileDemuxGetMaxFilters,
+    FileDemuxGetAvailableFilters,
+    FileDemuxAllocateFilter,
+    FileDemuxReleaseFilter,
+    FileDemuxReleaseAllFilters,
+    FileDVRGetFD
+};
 
 /*******************************************************************************
 * Global functions                                                             *
 *******************************************************************************/
-DVBAdapter_t *DVBInit(int adapter, bool hwRestricted, bool forceISDB)
+static DVBAdapter_t *FileInit(DVBAdapterCommon_t *common, int adapter, bool hwRestricted, bool forceISDB)
 {
     DVBAdapter_t *result = NULL;
     int monitorFds[2];
     int sendRecvFds[2];
     struct ev_loop *inputLoop;
 
-    if (dvbSource == NULL)
-    {
-        dvbSource = EventsRegisterSource("DVBAdapter");
-        lockedEvent = EventsRegisterEvent(dvbSource, "Locked", DVBEventToString);
-        unlockedEvent = EventsRegisterEvent(dvbSource, "Unlocked", DVBEventToString);
-        tuningFailedEvent = EventsRegisterEvent(dvbSource, "TuneFailed", DVBEventToString);
-        feActiveEvent  = EventsRegisterEvent(dvbSource, "FrontEndActive", DVBEventToString);
-        feIdleEvent  = EventsRegisterEvent(dvbSource, "FrontEndIdle", DVBEventToString);
-    }
-    
-    ObjectRegisterType(DVBAdapter_t);
+    /* Registered under a different name to LinuxDVB adapters as the structures
+     * differ in size and both types may be open at once.
+     */
+    ObjectRegisterClass((char *)FILEADAPTER_CLASS, sizeof(DVBAdapter_t), NULL);
     ObjectRegisterCollection(TOSTRING(DVBSupportedDeliverySys_t), sizeof(DVBDeliverySystem_e), NULL);
-    result = (DVBAdapter_t*)ObjectCreateType(DVBAdapter_t);
+    result = (DVBAdapter_t*)ObjectCreate((char *)FILEADAPTER_CLASS);
     
     if (result)
     {
         int i;
+        result->common = *common;
         /* Set all filters to be unallocated */
         for (i = 0; i < DVB_MAX_PID_FILTERS; i ++)
         {
@@ -152,18 +266,20 @@ DVBAdapter_t *DVBInit(int adapter, bool hwRestricted, bool forceISDB)
         result->frontEndFd = -1;
         result->dvrFd = -1;
         result->adapter = adapter;
+        result->replayMode = FileReplayMode_Bitrate;
+        result->requestedReplayMode = FileReplayMode_Bitrate;
 
         if (DVBOpenAdapterFile(result) == -1)
         {
             LogModule(LOG_ERROR, FILEADAPTER, "Failed to processs adapter file!\n");
-            DVBDispose(result);
+            FileDispose(result);
             return NULL;
         }
         
         if (pipe(sendRecvFds) == -1)
         {
             LogModule(LOG_ERROR, FILEADAPTER, "Failed to create pipe : %s\n", strerror(errno));
-            DVBDispose(result);
+            FileDispose(result);
             return NULL;
         }
 
@@ -183,7 +299,7 @@ DVBAdapter_t *DVBInit(int adapter, bool hwRestricted, bool forceISDB)
         if (pipe(monitorFds) == -1)
         {
             LogModule(LOG_ERROR, FILEADAPTER, "Failed to create pipe : %s\n", strerror(errno));
-            DVBDispose(result);
+            FileDispose(result);
             return NULL;
         }
 
@@ -202,28 +318,35 @@ DVBAdapter_t *DVBInit(int adapter, bool hwRestricted, bool forceISDB)
         
         inputLoop = DispatchersGetInput();
         ev_io_init(&result->commandWatcher, DVBCommandCallback, result->cmdRecvFd, EV_READ);
-        ev_timer_init(&result->sendTimer, DVBFilterPackets, 0.1, 0.1);
+        ev_timer_init(&result->sendTimer, DVBFilterPackets, FILEADAPTER_TICK, 0.0);
+        ev_io_init(&result->sendWatcher, DVBSendWritable, result->sendFd, EV_WRITE);
         result->sendTimer.data = result;
+        result->sendWatcher.data = result;
         result->commandWatcher.data = result;
-        ev_timer_start(inputLoop, &result->sendTimer);
         ev_io_start(inputLoop, &result->commandWatcher);   
 
         /* Add properties */
-        PropertiesAddSimpleProperty(propertyParent, "number", "The number of the adapter being used",
+        PropertiesAddSimpleProperty(result->common.propertyPath, "number", "The number of the adapter being used",
             PropertyType_Int, &result->adapter, SIMPLEPROPERTY_R);
-        PropertiesAddSimpleProperty(propertyParent, "name", "Hardware driver name",
+        PropertiesAddSimpleProperty(result->common.propertyPath, "name", "Hardware driver name",
             PropertyType_String, (void*)adapterName, SIMPLEPROPERTY_R);
-        PropertiesAddSimpleProperty(propertyParent, "hwrestricted", "Whether the hardware is not capable of supplying the entire TS.",
+        PropertiesAddSimpleProperty(result->common.propertyPath, "hwrestricted", "Whether the hardware is not capable of supplying the entire TS.",
             PropertyType_Boolean, &result->hardwareRestricted, SIMPLEPROPERTY_R);
-        PropertiesAddProperty(propertyParent, "systems", "The broadcast systems the frontend is capable of receiving",
+        PropertiesAddProperty(result->common.propertyPath, "systems", "The broadcast systems the frontend is capable of receiving",
             PropertyType_String, result, DVBPropertyDeliverySystemsGet, NULL);
-        PropertiesAddProperty(propertyParent, "active","Whether the frontend is currently in use.",
+        PropertiesAddProperty(result->common.propertyPath, "active","Whether the frontend is currently in use.",
             PropertyType_Boolean, result,DVBPropertyActiveGet,DVBPropertyActiveSet);
+        PropertiesAddProperty(result->common.propertyPath, "replay", "How the stream file is replayed (fast, bitrate or pcr).",
+            PropertyType_String, result, DVBPropertyReplayGet, DVBPropertyReplaySet);
+        PropertiesAddSimpleProperty(result->common.propertyPath, "replaypackets", "Number of packets sent from the stream file.",
+            PropertyType_Int, &result->packetsSent, SIMPLEPROPERTY_R);
+        PropertiesAddSimpleProperty(result->common.propertyPath, "replaysynclosses", "Number of times sync was lost in the stream file.",
+            PropertyType_Int, &result->syncLosses, SIMPLEPROPERTY_R);
     }
     return result;
 }
 
-void DVBDispose(DVBAdapter_t *adapter)
+static void FileDispose(DVBAdapter_t *adapter)
 {
     struct ev_loop *inputLoop = DispatchersGetInput();
     if (adapter->dvrFd > -1)
@@ -234,33 +357,33 @@ void DVBDispose(DVBAdapter_t *adapter)
     }
 
     LogModule(LOG_DEBUGV, FILEADAPTER, "Closing Demux file descriptors\n");
-    DVBDemuxReleaseAllFilters(adapter);
+    FileDemuxReleaseAllFilters(adapter);
 
     if (adapter->frontEndFd > -1)
     {
         LogModule(LOG_DEBUGV, FILEADAPTER, "Closing Frontend file descriptor\n");
-        close(adapter->frontEndFd);
+        FileReplayClose(adapter, inputLoop);
         LogModule(LOG_DEBUGV, FILEADAPTER, "Closed Frontend file descriptor\n");
-        adapter->frontEndFd = -1;
     }
 
     ev_io_stop(inputLoop, &adapter->commandWatcher);
     ev_timer_stop(inputLoop, &adapter->sendTimer);
+    ev_io_stop(inputLoop, &adapter->sendWatcher);
     
     close(adapter->cmdRecvFd);
     close(adapter->cmdSendFd);
 
-    PropertiesRemoveAllProperties(propertyParent);
+    PropertiesRemoveAllProperties(adapter->common.propertyPath);
     ObjectRefDec(adapter->supportedDelSystems);
     ObjectRefDec(adapter);
 }
 
-DVBSupportedDeliverySys_t *DVBFrontEndGetDeliverySystems(DVBAdapter_t *adapter)
+static DVBSupportedDeliverySys_t *FileFrontEndGetDeliverySystems(DVBAdapter_t *adapter)
 {
     return adapter->supportedDelSystems;
 }
 
-bool DVBFrontEndDeliverySystemSupported(DVBAdapter_t * adapter,DVBDeliverySystem_e system)
+static bool FileFrontEndDeliverySystemSupported(DVBAdapter_t * adapter,DVBDeliverySystem_e system)
 {
     int i;
     for (i = 0; i < adapter->supportedDelSystems->nrofSystems; i ++)
@@ -274,7 +397,7 @@ bool DVBFrontEndDeliverySystemSupported(DVBAdapter_t * adapter,DVBDeliverySystem
 }
 
 
-int DVBFrontEndTune(DVBAdapter_t *adapter, DVBDeliverySystem_e system, char *params)
+static int FileFrontEndTune(DVBAdapter_t *adapter, DVBDeliverySystem_e system, char *params)
 {
     yaml_document_t document;
     memset(&document, 0, sizeof(document));
@@ -290,34 +413,34 @@ int DVBFrontEndTune(DVBAdapter_t *adapter, DVBDeliverySystem_e system, char *par
     return 0;
 }
 
-char* DVBFrontEndParametersGet(DVBAdapter_t *adapter, DVBDeliverySystem_e *system)
+static char* FileFrontEndParametersGet(DVBAdapter_t *adapter, DVBDeliverySystem_e *system)
 {
     *system = adapter->currentDeliverySystem;
     return strdup(adapter->frontEndParams);
 }
 
-bool DVBFrontEndParameterSupported(DVBAdapter_t *adapter,DVBDeliverySystem_e system, char *param, char *value)
+static bool FileFrontEndParameterSupported(DVBAdapter_t *adapter,DVBDeliverySystem_e system, char *param, char *value)
 {
     return TRUE;
 }
 
 
-void DVBFrontEndLNBInfoSet(DVBAdapter_t *adapter, LNBInfo_t *info)
+static void FileFrontEndLNBInfoSet(DVBAdapter_t *adapter, LNBInfo_t *info)
 {
     adapter->lnbInfo = *info;
 }
 
-void DVBFrontEndLNBInfoGet(DVBAdapter_t *adapter, LNBInfo_t *lnbInfo)
+static void FileFrontEndLNBInfoGet(DVBAdapter_t *adapter, LNBInfo_t *lnbInfo)
 {
     *lnbInfo = adapter->lnbInfo;
 }
 
-bool DVBFrontEndIsLocked(DVBAdapter_t *adapter)
+static bool FileFrontEndIsLocked(DVBAdapter_t *adapter)
 {
     return adapter->frontEndLocked;
 }
 
-int DVBFrontEndStatus(DVBAdapter_t *adapter, DVBFrontEndStatus_e *status,
+static int FileFrontEndStatus(DVBAdapter_t *adapter, DVBFrontEndStatus_e *status,
                             unsigned int *ber, unsigned int *strength,
                             unsigned int *snr, unsigned int *ucblock)
 {
@@ -374,14 +497,14 @@ int DVBFrontEndStatus(DVBAdapter_t *adapter, DVBFrontEndStatus_e *status,
     return 0;
 }
 
-int DVBFrontEndSetActive(DVBAdapter_t *adapter, bool active)
+static int FileFrontEndSetActive(DVBAdapter_t *adapter, bool active)
 {
     if (active && (adapter->frontEndFd == -1))
     {
         /* Signal monitor thread */
         DVBFrontEndMonitorSend(adapter, MONITOR_CMD_FE_ACTIVATE);
         /* Fire frontend active event */
-        EventsFireEventListeners(feActiveEvent, adapter);
+        EventsFireEventListeners(DVBAdapterFEActiveEvent, adapter);
         return 0;
     }
 
@@ -390,27 +513,51 @@ int DVBFrontEndSetActive(DVBAdapter_t *adapter, bool active)
         /* Signal monitor thread */
         DVBFrontEndMonitorSend(adapter, MONITOR_CMD_FE_DEACTIVATE);
         /* Fire frontend idle event */
-        EventsFireEventListeners(feIdleEvent, adapter);
+        EventsFireEventListeners(DVBAdapterFEIdleEvent, adapter);
     }
     return 0;
 }
 
-int DVBDemuxGetMaxFilters(DVBAdapter_t *adapter)
+static int FileDemuxGetMaxFilters(DVBAdapter_t *adapter)
 {
     return adapter->maxFilters;
 }
 
-int DVBDemuxSetBufferSize(DVBAdapter_t *adapter, unsigned long size)
+static int FileDemuxGetAvailableFilters(DVBAdapter_t *adapter)
 {
+    int count = 0;
+    int i;
+    for (i = 0; i < adapter->maxFilters; i ++)
+    {
+        if (adapter->filters[i].demuxFd == -1)
+        {
+            count ++;
+        }
+    }
+    return count;
+}
+
+static int FileDemuxSetBufferSize(DVBAdapter_t *adapter, unsigned long size)
+{
+#ifdef F_SETPIPE_SZ
+    /* Grow the pipe feeding the TSReader, the kernel will limit this to
+     * /proc/sys/fs/pipe-max-size for unprivileged processes.
+     */
+    if (fcntl(adapter->sendFd, F_SETPIPE_SZ, size) < 0)
+    {
+        LogModule(LOG_DEBUG, FILEADAPTER, "Failed to set pipe size to %lu (%s)\n", size, strerror(errno));
+        return -1;
+    }
+#endif
     return 0;
 }
 
-bool DVBDemuxIsHardwareRestricted(DVBAdapter_t *adapter)
+static bool FileDemuxIsHardwareRestricted(DVBAdapter_t *adapter)
 {
     return adapter->hardwareRestricted;
 }
 
-int DVBDemuxAllocateFilter(DVBAdapter_t *adapter, uint16_t pid)
+static int FileDemuxAllocateFilter(DVBAdapter_t *adapter, uint16_t pid)
 {
     int result = -1;
     int i;
@@ -438,13 +585,14 @@ int DVBDemuxAllocateFilter(DVBAdapter_t *adapter, uint16_t pid)
         LogModule(LOG_DEBUG, FILEADAPTER, "Allocated filter for pid 0x%x\n", pid);
         adapter->filters[idxToUse].demuxFd = 1;
         adapter->filters[idxToUse].pid = pid;
+        FileUpdatePIDBitmap(adapter);
         result = 0;
     }
 
     return result;
 }
 
-int DVBDemuxReleaseFilter(DVBAdapter_t *adapter, uint16_t pid)
+static int FileDemuxReleaseFilter(DVBAdapter_t *adapter, uint16_t pid)
 {
     int result = -1;
     if (adapter->hardwareRestricted || (pid == 8192))
@@ -456,6 +604,7 @@ int DVBDemuxReleaseFilter(DVBAdapter_t *adapter, uint16_t pid)
             {
                 LogModule(LOG_DEBUG, FILEADAPTER, "Releasing filter for pid 0x%x\n", pid);
                 adapter->filters[i].demuxFd = -1;
+                FileUpdatePIDBitmap(adapter);
                 result = 0;
                 break;
             }
@@ -464,7 +613,7 @@ int DVBDemuxReleaseFilter(DVBAdapter_t *adapter, uint16_t pid)
     return result;
 }
 
-int DVBDemuxReleaseAllFilters(DVBAdapter_t *adapter)
+static int FileDemuxReleaseAllFilters(DVBAdapter_t *adapter)
 {
     int result = -1;
     int i;
@@ -473,16 +622,17 @@ int DVBDemuxReleaseAllFilters(DVBAdapter_t *adapter)
     {
         if (adapter->filters[i].demuxFd != -1)
         {
-            close(adapter->filters[i].demuxFd);
+            /* No real file descriptor behind the filter, just mark it free. */
             adapter->filters[i].demuxFd = -1;
             result = 0;
         }
     }
+    FileUpdatePIDBitmap(adapter);
 
     return result;
 }
 
-int DVBDVRGetFD(DVBAdapter_t *adapter)
+static int FileDVRGetFD(DVBAdapter_t *adapter)
 {
     return adapter->dvrFd;
 }
@@ -500,7 +650,6 @@ static void DVBFrontEndMonitorSend(DVBAdapter_t *adapter, char cmd)
 static void DVBCommandCallback(struct ev_loop *loop, ev_io *w, int revents)
 {
     DVBAdapter_t *adapter = w->data;
-    unsigned long rate;
     char cmd;
     ev_io_start(loop, w);
     
@@ -512,26 +661,28 @@ static void DVBCommandCallback(struct ev_loop *loop, ev_io *w, int revents)
                 break;
             case MONITOR_CMD_RETUNING:
                 adapter->frontEndLocked = FALSE;
-                EventsFireEventListeners(unlockedEvent, adapter);
+                EventsFireEventListeners(DVBAdapterUnlockedEvent, adapter);
+                FileReplayClose(adapter, loop);
 
             case MONITOR_CMD_FE_ACTIVATE:
                 /* Open description file for freq */
-                if (DVBOpenStreamFile(adapter->adapter, adapter->frontEndRequestedFreq, &adapter->frontEndFd, &rate) == 0)
+                if (FileReplayOpen(adapter, loop) == 0)
                 {
                     adapter->frontEndLocked = TRUE;
-                    EventsFireEventListeners(lockedEvent, adapter);
-                    ev_timer_set(&adapter->sendTimer, 0.1,0.1);
-                    ev_timer_start(loop, &adapter->sendTimer);
-                }
-                else
-                {
-                    ev_timer_stop(loop, &adapter->sendTimer);
+                    EventsFireEventListeners(DVBAdapterLockedEvent, adapter);
+                    FileReplaySchedule(adapter, loop);
                 }
                 break;
             case MONITOR_CMD_FE_DEACTIVATE:
-                close(adapter->frontEndFd);
-                adapter->frontEndFd = -1;
-                ev_timer_stop(loop, &adapter->sendTimer);
+                FileReplayClose(adapter, loop);
+                break;
+            case MONITOR_CMD_REPLAY_MODE:
+                adapter->replayMode = adapter->requestedReplayMode;
+                LogModule(LOG_INFO, FILEADAPTER, "Replay mode now %s\n", replayModeNames[adapter->replayMode]);
+                if (adapter->frontEndFd != -1)
+                {
+                    FileReplaySchedule(adapter, loop);
+                }
                 break;
         }
     }
@@ -540,39 +691,477 @@ static void DVBCommandCallback(struct ev_loop *loop, ev_io *w, int revents)
 static void DVBFilterPackets(struct ev_loop *loop, ev_timer *w, int revents)
 {
     DVBAdapter_t *adapter = w->data;
-    char buffer[188 * 10];
+    ev_tstamp now = ev_now(loop);
+    ev_tstamp wait = FILEADAPTER_TICK;
+    unsigned int budget;
+
+    if (adapter->map == NULL)
+    {
+        return;
+    }
+
+    /* Anything left over from last time must go first, if the pipe is still
+     * full leave it to the TSReader to drain it.
+     */
+    if (FileReplayFlush(adapter))
+    {
+        switch (adapter->replayMode)
+        {
+            case FileReplayMode_Fast:
+                /* Only get here when idle waiting for filters. */
+                if (adapter->anyPids)
+                {
+                    ev_io_start(loop, &adapter->sendWatcher);
+                    return;
+                }
+                break;
+
+            case FileReplayMode_Bitrate:
+                budget = FileReplayBitrateBudget(adapter, now);
+                FileReplayFill(adapter, budget, now, NULL);
+                FileReplayFlush(adapter);
+                break;
+
+            case FileReplayMode_PCR:
+                /* Use the bit rate until the first PCR is found. */
+                budget = adapter->pcrLocked ? UINT_MAX : FileReplayBitrateBudget(adapter, now);
+                if ((FileReplayFill(adapter, budget, now, &wait) != 0) && (adapter->iovCount == FILEADAPTER_MAX_IOV))
+                {
+                    /* Stopped because there were too many regions to write,
+                     * not because the next packet isn't due yet.
+                     */
+                    wait = 0.0;
+                }
+                FileReplayFlush(adapter);
+                if (wait > FILEADAPTER_TICK)
+                {
+                    wait = FILEADAPTER_TICK;
+                }
+                break;
+        }
+    }
+
+    ev_timer_set(w, wait, 0.0);
+    ev_timer_start(loop, w);
+}
+
+static void DVBSendWritable(struct ev_loop *loop, ev_io *w, int revents)
+{
+    DVBAdapter_t *adapter = w->data;
+
+    if (!FileReplayFlush(adapter))
+    {
+        return;
+    }
+
+    if (!adapter->anyPids || (FileReplayFill(adapter, FILEADAPTER_FAST_BATCH, ev_now(loop), NULL) == 0))
+    {
+        /* Nothing to send, so the pipe will stay writable, poll instead of
+         * spinning until filters are added (or the file has packets again).
+         */
+        ev_io_stop(loop, w);
+        ev_timer_set(&adapter->sendTimer, FILEADAPTER_TICK, 0.0);
+        ev_timer_start(loop, &adapter->sendTimer);
+        return;
+    }
+    FileReplayFlush(adapter);
+}
+
+static int FileReplayOpen(DVBAdapter_t *adapter, struct ev_loop *loop)
+{
+    struct stat info;
+    void *map;
+
+    if (DVBOpenStreamFile(adapter->adapter, adapter->frontEndRequestedFreq, &adapter->frontEndFd, &adapter->rate) != 0)
+    {
+        return -1;
+    }
+
+    if ((fstat(adapter->frontEndFd, &info) != 0) || (info.st_size < TSPACKET_SIZE))
+    {
+        LogModule(LOG_ERROR, FILEADAPTER, "Stream file is too small or cannot be read\n");
+        FileReplayClose(adapter, loop);
+        return -1;
+    }
+
+    map = mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, adapter->frontEndFd, 0);
+    if (map == MAP_FAILED)
+    {
+        LogModule(LOG_ERROR, FILEADAPTER, "Failed to map stream file (%s)\n", strerror(errno));
+        FileReplayClose(adapter, loop);
+        return -1;
+    }
+    madvise(map, info.st_size, MADV_SEQUENTIAL);
+
+    adapter->map = map;
+    adapter->mapLength = info.st_size;
+    adapter->mapPos = 0;
+    adapter->mapPacketSize = 0;
+    return 0;
+}
+
+static void FileReplayClose(DVBAdapter_t *adapter, struct ev_loop *loop)
+{
+    ev_timer_stop(loop, &adapter->sendTimer);
+    ev_io_stop(loop, &adapter->sendWatcher);
+
+    /* Pending iovecs point into the mapping so must go with it. */
+    adapter->iovStart = 0;
+    adapter->iovCount = 0;
+
+    if (adapter->map)
+    {
+        munmap(adapter->map, adapter->mapLength);
+        adapter->map = NULL;
+        adapter->mapLength = 0;
+    }
     if (adapter->frontEndFd != -1)
     {
-        int r = read(adapter->frontEndFd, buffer, sizeof(buffer));
-        if (r <= 0)
+        close(adapter->frontEndFd);
+        adapter->frontEndFd = -1;
+    }
+}
+
+static void FileReplaySchedule(DVBAdapter_t *adapter, struct ev_loop *loop)
+{
+    ev_timer_stop(loop, &adapter->sendTimer);
+    ev_io_stop(loop, &adapter->sendWatcher);
+
+    adapter->paceStart = ev_now(loop);
+    adapter->paceCount = 0;
+    adapter->pcrPid = -1;
+    adapter->pcrLocked = FALSE;
+    adapter->segmentInterval = 0.0;
+    adapter->segmentIndex = 0;
+
+    if (adapter->replayMode == FileReplayMode_Fast)
+    {
+        ev_io_start(loop, &adapter->sendWatcher);
+    }
+    else
+    {
+        ev_timer_set(&adapter->sendTimer, 0.0, 0.0);
+        ev_timer_start(loop, &adapter->sendTimer);
+    }
+}
+
+static uint8_t *FileReplayNextPacket(DVBAdapter_t *adapter)
+{
+    bool wrapped = FALSE;
+    uint8_t *packet;
+
+    while (TRUE)
+    {
+        if (adapter->mapPacketSize == 0)
+        {
+            size_t remaining = adapter->mapLength - adapter->mapPos;
+            unsigned int window = (remaining > FILEADAPTER_HUNT_WINDOW) ? FILEADAPTER_HUNT_WINDOW : remaining;
+            bool needMore = FALSE;
+            unsigned int offset;
+
+            offset = TSFramerFindSync(adapter->map + adapter->mapPos, window, &adapter->mapPacketSize, &needMore);
+            if (adapter->mapPacketSize)
+            {
+                LogModule(LOG_DEBUG, FILEADAPTER, "Locked on to %u byte packets at offset %lu\n",
+                    adapter->mapPacketSize, (unsigned long)(adapter->mapPos + offset));
+                adapter->mapPos += offset;
+            }
+            else if (window < remaining)
+            {
+                adapter->mapPos += offset;
+                continue;
+            }
+            else
+            {
+                /* Reached the end of the file without finding sync. */
+                adapter->mapPos = adapter->mapLength;
+            }
+        }
+
+        if (adapter->mapPos + TSPACKET_SIZE > adapter->mapLength)
         {
-            lseek(adapter->frontEndFd, 0, SEEK_SET);
+            if (wrapped)
+            {
+                /* No packets anywhere in the file. */
+                return NULL;
+            }
+            wrapped = TRUE;
+            adapter->mapPos = 0;
+            /* Don't try and join the end of the file to the start. */
+            adapter->mapPacketSize = 0;
+            continue;
         }
-        else
+
+        packet = adapter->map + adapter->mapPos;
+        if (packet[0] != TSFRAMER_SYNC_BYTE)
         {
-            int i, p;
+            LogModule(LOG_DEBUG, FILEADAPTER, "Lost sync at offset %lu\n", (unsigned long)adapter->mapPos);
+            adapter->syncLosses ++;
+            adapter->mapPacketSize = 0;
+            continue;
+        }
+        adapter->mapPos += adapter->mapPacketSize;
+        return packet;
+    }
+}
 
-            for (i = 0; i < r/188; i ++)
+/* Queues up to maxPackets packets for writing, stopping early if wait is not
+ * NULL and the next packet is not due to be sent until after now.
+ * Returns the number of packets consumed from the file, whether or not they
+ * passed the filters.
+ */
+static unsigned int FileReplayFill(DVBAdapter_t *adapter, unsigned int maxPackets, ev_tstamp now, ev_tstamp *wait)
+{
+    unsigned int consumed = 0;
+    uint8_t *packet;
+
+    while ((consumed < maxPackets) && (adapter->iovCount < FILEADAPTER_MAX_IOV))
+    {
+        uint16_t pid;
+
+        packet = FileReplayNextPacket(adapter);
+        if (packet == NULL)
+        {
+            break;
+        }
+        if (wait && !FileReplayPCRDue(adapter, packet, now, wait))
+        {
+            /* Put it back for next time. */
+            adapter->mapPos = packet - adapter->map;
+            break;
+        }
+        consumed ++;
+
+        pid = TSPACKET_GETPID(*(TSPacket_t*)packet);
+        if (adapter->allPids || PIDBITMAP_ISSET(adapter->pidBitmap, pid))
+        {
+            struct iovec *last = adapter->iovCount ? &adapter->iov[adapter->iovCount - 1] : NULL;
+            /* Runs of 188 byte packets are written straight from the mapping
+             * as one region.
+             */
+            if (last && ((uint8_t*)last->iov_base + last->iov_len == packet))
             {
-                TSPacket_t *packet = (TSPacket_t*)&buffer[i * 188];
-                uint16_t pid = TSPACKET_GETPID(*packet);
-                for (p = 0; p < adapter->maxFilters; p ++)
-                {
-                    if (((adapter->filters[p].pid == 8192) || (pid == adapter->filters[p].pid)) && 
-                         (adapter->filters[p].demuxFd != -1))
-                    {
-                        if (write(adapter->sendFd, packet, 188) == -1)
-                        {
-                            /* do nothing */
-                        }
-                        break;
-                    }
-                }
+                last->iov_len += TSPACKET_SIZE;
+            }
+            else
+            {
+                adapter->iov[adapter->iovCount].iov_base = packet;
+                adapter->iov[adapter->iovCount].iov_len = TSPACKET_SIZE;
+                adapter->iovCount ++;
+            }
+            adapter->packetsSent ++;
+        }
+    }
+    adapter->paceCount += consumed;
+    return consumed;
+}
+
+/* Writes as much of the queued data as the pipe will accept, returns TRUE if
+ * nothing is left queued.
+ */
+static bool FileReplayFlush(DVBAdapter_t *adapter)
+{
+    while (adapter->iovStart < adapter->iovCount)
+    {
+        ssize_t written = writev(adapter->sendFd, &adapter->iov[adapter->iovStart],
+                                 adapter->iovCount - adapter->iovStart);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            if (errno != EAGAIN)
+            {
+                LogModule(LOG_DEBUG, FILEADAPTER, "Failed to write packets (%s)\n", strerror(errno));
+                adapter->iovStart = adapter->iovCount;
+                break;
+            }
+            return FALSE;
+        }
+
+        while (written > 0)
+        {
+            struct iovec *v = &adapter->iov[adapter->iovStart];
+            if (written >= v->iov_len)
+            {
+                written -= v->iov_len;
+                adapter->iovStart ++;
+            }
+            else
+            {
+                v->iov_base = (uint8_t*)v->iov_base + written;
+                v->iov_len -= written;
+                written = 0;
+            }
+        }
+    }
+    adapter->iovStart = 0;
+    adapter->iovCount = 0;
+    return TRUE;
+}
+
+/* Number of packets that should have been sent by now at the stream file's
+ * bit rate, measured from the start of pacing so rounding errors don't build
+ * up.
+ */
+static unsigned int FileReplayBitrateBudget(DVBAdapter_t *adapter, ev_tstamp now)
+{
+    double packetsPerSecond = (double)adapter->rate / (TSPACKET_SIZE * 8);
+    unsigned long long target = (unsigned long long)((now - adapter->paceStart) * packetsPerSecond);
+
+    if (target <= adapter->paceCount)
+    {
+        return 0;
+    }
+    if (target - adapter->paceCount > packetsPerSecond * FILEADAPTER_MAX_LAG)
+    {
+        /* Fallen too far behind (pipe full/loop stalled), start again from now
+         * rather than sending a burst.
+         */
+        adapter->paceStart = now;
+        adapter->paceCount = 0;
+        return 0;
+    }
+    return (unsigned int)(target - adapter->paceCount);
+}
+
+/* Determines whether packet is due to be sent, based on the PCRs in the stream.
+ * Packets between PCRs are spread evenly across the time between the PCRs.
+ */
+static bool FileReplayPCRDue(DVBAdapter_t *adapter, uint8_t *packet, ev_tstamp now, ev_tstamp *wait)
+{
+    TSPacket_t *tsPacket = (TSPacket_t *)packet;
+    ev_tstamp due;
+    uint64_t pcr;
+
+    if (!TSPACKET_HASPCR(*tsPacket) ||
+        ((adapter->pcrPid != -1) && (TSPACKET_GETPID(*tsPacket) != adapter->pcrPid)))
+    {
+        if (!adapter->pcrLocked)
+        {
+            return TRUE;
+        }
+        due = adapter->segmentDue + ((adapter->segmentIndex + 1) * adapter->segmentInterval);
+        if (due > now)
+        {
+            *wait = due - now;
+            return FALSE;
+        }
+        adapter->segmentIndex ++;
+        return TRUE;
+    }
+
+    pcr = TSPACKET_GETPCR(*tsPacket);
+    if (adapter->pcrPid == -1)
+    {
+        adapter->pcrPid = TSPACKET_GETPID(*tsPacket);
+        LogModule(LOG_DEBUG, FILEADAPTER, "Pacing replay using PCRs on PID 0x%x\n", adapter->pcrPid);
+    }
+
+    if (!adapter->pcrLocked)
+    {
+        adapter->pcrLocked = TRUE;
+        adapter->pcrBase = pcr;
+        adapter->pcrWallBase = now;
+    }
+    else if ((pcr < adapter->pcrLast) || (pcr - adapter->pcrLast > TSPACKET_PCR_HZ) ||
+             TSPACKET_ISDISCONTINUITY(*tsPacket))
+    {
+        /* Discontinuity (or the file looped), carry on from where the last
+         * PCR left off.
+         */
+        adapter->pcrBase = pcr;
+        adapter->pcrWallBase = adapter->segmentDue + ((adapter->segmentIndex + 1) * adapter->segmentInterval);
+    }
+
+    due = adapter->pcrWallBase + ((ev_tstamp)(pcr - adapter->pcrBase) / TSPACKET_PCR_HZ);
+    if (due > now)
+    {
+        *wait = due - now;
+        return FALSE;
+    }
+    if (now - due > FILEADAPTER_MAX_LAG)
+    {
+        /* Fallen too far behind to catch up. */
+        adapter->pcrBase = pcr;
+        adapter->pcrWallBase = now;
+        due = now;
+    }
+
+    adapter->pcrLast = pcr;
+    adapter->segmentDue = due;
+    adapter->segmentIndex = 0;
+    adapter->segmentInterval = FileReplayPCRInterval(adapter, packet, pcr);
+    return TRUE;
+}
+
+/* Looks ahead for the next PCR to work out how far apart the packets until
+ * then should be sent, returns 0 (send them as quickly as possible) if the
+ * next PCR can't be found.
+ */
+static ev_tstamp FileReplayPCRInterval(DVBAdapter_t *adapter, uint8_t *packet, uint64_t pcr)
+{
+    size_t pos = (packet - adapter->map) + adapter->mapPacketSize;
+    unsigned int count = 1;
+
+    while ((pos + TSPACKET_SIZE <= adapter->mapLength) && (count < FILEADAPTER_PCR_LOOKAHEAD) &&
+           (adapter->map[pos] == TSFRAMER_SYNC_BYTE))
+    {
+        TSPacket_t *next = (TSPacket_t *)(adapter->map + pos);
+        if (TSPACKET_HASPCR(*next) && (TSPACKET_GETPID(*next) == adapter->pcrPid))
+        {
+            uint64_t nextPcr = TSPACKET_GETPCR(*next);
+            if ((nextPcr > pcr) && (nextPcr - pcr <= TSPACKET_PCR_HZ))
+            {
+                return ((ev_tstamp)(nextPcr - pcr) / TSPACKET_PCR_HZ) / count;
             }
+            break;
         }
+        pos += adapter->mapPacketSize;
+        count ++;
     }
+    return 0.0;
 }
 
+static void FileUpdatePIDBitmap(DVBAdapter_t *adapter)
+{
+    uint32_t bitmap[PIDBITMAP_WORDS];
+    bool allPids = FALSE;
+    bool anyPids = FALSE;
+    int i;
+
+    memset(bitmap, 0, sizeof(bitmap));
+    for (i = 0; i < adapter->maxFilters; i ++)
+    {
+        if (adapter->filters[i].demuxFd != -1)
+        {
+            anyPids = TRUE;
+            if (adapter->filters[i].pid == TSREADER_PID_ALL)
+            {
+                allPids = TRUE;
+            }
+            else
+            {
+                PIDBITMAP_SET(bitmap, adapter->filters[i].pid);
+            }
+        }
+    }
+
+    /*
+     * The replay loop filters packets while this is going on, so rather than
+     * clearing the bitmap and building it in place (dropping packets on PIDs
+     * that stay selected) copy a word at a time. Each PID is then either in
+     * the old or the new state, and allPids is only changed once the bitmap
+     * is complete.
+     */
+    for (i = 0; i < PIDBITMAP_WORDS; i ++)
+    {
+        adapter->pidBitmap[i] = bitmap[i];
+    }
+    adapter->allPids = allPids;
+    adapter->anyPids = anyPids;
+}
 
 static int DVBOpenAdapterFile(DVBAdapter_t *adapter)
 {
@@ -658,7 +1247,7 @@ static int DVBOpenStreamFile(int adapter, uint32_t freq, int *fd, unsigned long
             LogModule(LOG_DEBUG, FILEADAPTER, "Opening stream file %s", path);
             if (fscanf(fp, "%lu", &temp_rate) == 1)
             {
-                LogModule(LOG_DEBUG, FILEADAPTER, "Stream rate : %lu bps (UNUSED)", temp_rate);
+                LogModule(LOG_DEBUG, FILEADAPTER, "Stream rate : %lu bps", temp_rate);
                 if (temp_rate > 0)
                 {
                     *fd = open(path, O_RDONLY);
@@ -670,20 +1259,11 @@ static int DVBOpenStreamFile(int adapter, uint32_t freq, int *fd, unsigned long
                 }
             }
         }
+        fclose(fp);
     }
     return result;
 }
 
-static int DVBEventToString(yaml_document_t *document, Event_t event, void *payload)
-{
-    DVBAdapter_t *adapter = payload;
-    char adapterStr[4];
-    int mappingId = yaml_document_add_mapping(document, (yaml_char_t*)YAML_MAP_TAG, YAML_ANY_MAPPING_STYLE);
-    sprintf(adapterStr, "%d", adapter->adapter);
-    YamlUtils_MappingAdd(document, mappingId, "Adapter", adapterStr);
-    return mappingId;
-}
-
 static int DVBPropertyActiveGet(void *userArg, PropertyValue_t *value)
 {
     DVBAdapter_t *adapter = userArg;
@@ -694,7 +1274,7 @@ static int DVBPropertyActiveGet(void *userArg, PropertyValue_t *value)
 static int DVBPropertyActiveSet(void *userArg, PropertyValue_t *value)
 {
     DVBAdapter_t *adapter = userArg;
-    return DVBFrontEndSetActive(adapter,value->u.boolean);
+    return FileFrontEndSetActive(adapter,value->u.boolean);
 }
 
 static int DVBPropertyDeliverySystemsGet(void *userArg, PropertyValue_t *value)
@@ -718,6 +1298,31 @@ static int DVBPropertyDeliverySystemsGet(void *userArg, PropertyValue_t *value)
     return 0;
 }
 
+static int DVBPropertyReplayGet(void *userArg, PropertyValue_t *value)
+{
+    DVBAdapter_t *adapter = userArg;
+    value->u.string = strdup(replayModeNames[adapter->requestedReplayMode]);
+    return 0;
+}
+
+static int DVBPropertyReplaySet(void *userArg, PropertyValue_t *value)
+{
+    DVBAdapter_t *adapter = userArg;
+    int i;
+
+    for (i = 0; i < sizeof(replayModeNames) / sizeof(replayModeNames[0]); i ++)
+    {
+        if (strcasecmp(value->u.string, replayModeNames[i]) == 0)
+        {
+            adapter->requestedReplayMode = i;
+            /* Watchers belong to the input loop so let it switch modes. */
+            DVBFrontEndMonitorSend(adapter, MONITOR_CMD_REPLAY_MODE);
+            return 0;
+        }
+    }
+    return -1;
+}
+
 static uint32_t ConvertStringToUInt32(const char *str, uint32_t defaultValue)
 {
     char *suffix;
@@ -61,6 +61,8 @@ Entry point to the application.
 #include "events.h"
 #include "properties.h"
 
+#include <dvbpsi/pool.h>
+
 #include "standard/mpeg2.h"
 #include "standard/dvb.h"
 #include "standard/atsc.h"
@@ -116,6 +118,9 @@ static void DeInitDaemon(void);
 static void InstallSysProperties(void);
 static int SysPropertyGetUptime(void *userArg, PropertyValue_t *value);
 static int SysPropertyGetUptimeSecs(void *userArg, PropertyValue_t *value);
+static int SysPropertyGetSectionPool(void *userArg, PropertyValue_t *value);
+static int SysPropertyGetSectionPoolLimit(void *userArg, PropertyValue_t *value);
+static int SysPropertySetSectionPoolLimit(void *userArg, PropertyValue_t *value);
 
 /*******************************************************************************
 * Global variables                                                             *
@@ -129,6 +134,10 @@ char DataDirectory[PATH_MAX];
 static char PidFile[PATH_MAX];
 static TSReader_t *TSReader;
 static DVBAdapter_t *DVBAdapter;
+/* All adapters/readers in use, index 0 being the primary (TSReader/DVBAdapter). */
+static TSReader_t *TSReaders[DVB_MAX_ADAPTERS];
+static DVBAdapter_t *DVBAdapters[DVB_MAX_ADAPTERS];
+static int NrofAdapters = 0;
 static ServiceFilter_t PrimaryServiceFilter;
 static const char MAIN[] = "Main";
 static time_t StartTime;
@@ -142,6 +151,11 @@ int main(int argc, char *argv[])
 {
     char *startupFile = NULL;
     int adapterNumber = 0;
+    char *adapterSpecs[DVB_MAX_ADAPTERS];
+    DVBAdapterType_e adapterTypes[DVB_MAX_ADAPTERS];
+    int adapterNumbers[DVB_MAX_ADAPTERS];
+    int nrofAdapterSpecs = 0;
+    int i;
     int scanAll = 0;
     int logLevel = 0;
     char *username = "dvbstreamer";
@@ -184,8 +198,27 @@ int main(int argc, char *argv[])
                 break;
                 case 'o': primaryMRL = optarg;
                 break;
-                case 'a': adapterNumber = atoi(optarg);
-
+                case 'a':
+                {
+                    char *saveptr = NULL;
+                    char *spec;
+                    for (spec = strtok_r(optarg, ",", &saveptr); spec; spec = strtok_r(NULL, ",", &saveptr))
+                    {
+                        if (nrofAdapterSpecs == DVB_MAX_ADAPTERS)
+                        {
+                            fprintf(stderr, "Too many adapters specified (maximum %d)\n", DVB_MAX_ADAPTERS);
+                            exit(1);
+                        }
+                        adapterSpecs[nrofAdapterSpecs] = spec;
+                        if (!DVBAdapterSpecParse(spec, &adapterTypes[nrofAdapterSpecs], &adapterNumbers[nrofAdapterSpecs]))
+                        {
+                            fprintf(stderr, "Invalid adapter \"%s\"\n", spec);
+                            usage(argv[0]);
+                            exit(1);
+                        }
+                        nrofAdapterSpecs ++;
+                    }
+                }
                 break;
                 case 'R':
 #if defined(ENABLE_DVB)
@@ -226,6 +259,17 @@ int main(int argc, char *argv[])
         exit(1);
     }
 
+    if (nrofAdapterSpecs == 0)
+    {
+        adapterSpecs[0] = "0";
+        adapterTypes[0] = DVBAdapterType_Default;
+        adapterNumbers[0] = 0;
+        nrofAdapterSpecs = 1;
+    }
+    /* The first adapter is the primary adapter, it determines the database, log
+     * files and remote interface used.
+     */
+    adapterNumber = adapterNumbers[0];
 
     if (logFilename[0])
     {
@@ -273,7 +317,10 @@ int main(int argc, char *argv[])
 
     LogRegisterThread(pthread_self(), "Main");
     LogModule(LOG_INFO, MAIN, "DVBStreamer starting");
-    LogModule(LOG_INFOV, MAIN, "Using adapter %d\n", adapterNumber);
+    for (i = 0; i < nrofAdapterSpecs; i ++)
+    {
+        LogModule(LOG_INFOV, MAIN, "Using adapter %s\n", adapterSpecs[i]);
+    }
     if (startupFile)
     {
         LogModule(LOG_INFOV, MAIN, "Using startup script %s\n", startupFile);
@@ -303,17 +350,21 @@ int main(int argc, char *argv[])
     LogModule(LOG_INFO, MAIN, "%d Services available on %d Multiplexes\n", ServiceCount(), 
                                                                            MultiplexCount());
 
-    /* Initialise the DVB adapter */
-    DVBAdapter = DVBInit(adapterNumber, hwRestricted, forceISDB);
-    if (!DVBAdapter)
+    /* Initialise the DVB adapters */
+    for (i = 0; i < nrofAdapterSpecs; i ++)
     {
-        printf("Could not open dvb adapter %d!\n", adapterNumber);
-        exit(1);
+        DVBAdapters[i] = DVBInitType(adapterTypes[i], adapterNumbers[i], hwRestricted, forceISDB);
+        if (!DVBAdapters[i])
+        {
+            printf("Could not open dvb adapter %s!\n", adapterSpecs[i]);
+            exit(1);
+        }
+        NrofAdapters ++;
     }
+    DVBAdapter = DVBAdapters[0];
 
 #if defined(ENABLE_DVB)
     {
-        int i;
         DVBSupportedDeliverySys_t *supportedSystems = DVBFrontEndGetDeliverySystems(DVBAdapter);
         for (i = 0; i < supportedSystems->nrofSystems; i ++)
         {
@@ -339,29 +390,37 @@ int main(int argc, char *argv[])
     }
 #endif
 
-    /* Create Transport stream filter thread */
-    INIT(!(TSReader = TSReaderCreate(DVBAdapter)), "TS reader");
+    /* Create a Transport stream reader (and input thread) per adapter */
+    for (i = 0; i < NrofAdapters; i ++)
+    {
+        INIT(!(TSReaders[i] = TSReaderCreate(DVBAdapters[i])), "TS reader");
+    }
+    TSReader = TSReaders[0];
 
-    if (MainIsDVB())
+    /* PSI/SI is processed for every adapter, each filling its own cache */
+    for (i = 0; i < NrofAdapters; i ++)
     {
+        if (MainIsDVB())
+        {
 #if defined(ENABLE_DVB)
-        LogModule(LOG_INFO, MAIN, "Starting DVB filters\n");
-        INIT(DVBStandardInit(TSReader), "DVB Filters");
+            LogModule(LOG_INFO, MAIN, "Starting DVB filters on adapter %d\n", i);
+            INIT(DVBStandardInit(TSReaders[i]), "DVB Filters");
 #endif
-    }
-    
-    if (MainIsATSC())
-    {
+        }
+        
+        if (MainIsATSC())
+        {
 #if defined(ENABLE_ATSC)
-        LogModule(LOG_INFO, MAIN, "Starting ATSC filters\n");
-        INIT(ATSCStandardInit(TSReader), "ATSC Filters");
+            LogModule(LOG_INFO, MAIN, "Starting ATSC filters on adapter %d\n", i);
+            INIT(ATSCStandardInit(TSReaders[i]), "ATSC Filters");
 #endif
-    }
-    
-    if (MainIsISDB())
-    {
-        LogModule(LOG_INFO, MAIN, "Starting ISDB filters\n");
-        INIT(MPEG2StandardInit(TSReader), "ISDB Filters");
+        }
+        
+        if (MainIsISDB())
+        {
+            LogModule(LOG_INFO, MAIN, "Starting ISDB filters on adapter %d\n", i);
+            INIT(MPEG2StandardInit(TSReaders[i]), "ISDB Filters");
+        }
     }
     
     INIT(ServiceFilterInit(), "service filter");
@@ -473,9 +532,15 @@ int main(int argc, char *argv[])
         }
     }
     DispatchersStop();
-    TSReaderEnable(TSReader, FALSE);
+    for (i = 0; i < NrofAdapters; i ++)
+    {
+        TSReaderEnable(TSReaders[i], FALSE);
+    }
 
-    ServiceFilterDestroyAll(TSReader);
+    for (i = 0; i < NrofAdapters; i ++)
+    {
+        ServiceFilterDestroyAll(TSReaders[i]);
+    }
 
     /* Stop the deferred processing as when we unload the plugins we may be
      * unloading code that is required by any jobs left on the queue
@@ -504,27 +569,35 @@ int main(int argc, char *argv[])
     DEINIT(CommandDeInit(), "commands");
     DEINIT(ServiceFilterDeInit(), "service filter");
 
-    if (MainIsDVB())
+    for (i = 0; i < NrofAdapters; i ++)
     {
+        if (MainIsDVB())
+        {
 #if defined(ENABLE_DVB)
-        DVBStandardDeinit(TSReader);
+            DVBStandardDeinit(TSReaders[i]);
 #endif
-    }
+        }
 
-    if (MainIsATSC())
-    {
+        if (MainIsATSC())
+        {
 #if defined(ENABLE_ATSC)
-        ATSCStandardDeinit(TSReader);
+            ATSCStandardDeinit(TSReaders[i]);
 #endif
-    }
-    
-    if (MainIsISDB())
-    {
-        MPEG2StandardDeinit(TSReader);
+        }
+        
+        if (MainIsISDB())
+        {
+            MPEG2StandardDeinit(TSReaders[i]);
+        }
     }
 
     LogModule(LOG_DEBUGV, MAIN, "Processors destroyed\n");
-    /* Close the adapter and shutdown the filter etc*/
+    /* Close the adapters and shutdown the filters etc*/
+    for (i = NrofAdapters - 1; i > 0; i --)
+    {
+        DEINIT(TSReaderDestroy(TSReaders[i]), "TS filter");
+        DEINIT(DVBDispose(DVBAdapters[i]), "DVB adapter");
+    }
     DEINIT(TSReaderDestroy(TSReader), "TS filter");
 
     DVBFrontEndLNBInfoGet(DVBAdapter, &lnbInfo);
@@ -567,9 +640,13 @@ int main(int argc, char *argv[])
 
 void UpdateDatabase()
 {
-    TSReaderLock(TSReader);
-    CacheWriteback();
-    TSReaderUnLock(TSReader);
+    int i;
+    for (i = 0; i < NrofAdapters; i ++)
+    {
+        TSReaderLock(TSReaders[i]);
+        CacheWriteback(CacheGet(i));
+        TSReaderUnLock(TSReaders[i]);
+    }
 }
 
 static void InstallSysProperties(void)
@@ -583,6 +660,16 @@ static void InstallSysProperties(void)
                       PropertyType_String, NULL, SysPropertyGetUptime, NULL);
     PropertiesAddProperty("sys.uptime", "seconds", "The time that this instance has been running in seconds.",
                           PropertyType_Int, NULL, SysPropertyGetUptimeSecs, NULL);
+    PropertiesAddProperty("sys.sectionpool", "outstanding", "Number of PSI section buffers in use.",
+                          PropertyType_Int, "outstanding", SysPropertyGetSectionPool, NULL);
+    PropertiesAddProperty("sys.sectionpool", "free", "Number of PSI section buffers kept for reuse.",
+                          PropertyType_Int, "free", SysPropertyGetSectionPool, NULL);
+    PropertiesAddProperty("sys.sectionpool", "peak", "Highest number of PSI section buffers in use at once.",
+                          PropertyType_Int, "peak", SysPropertyGetSectionPool, NULL);
+    PropertiesAddProperty("sys.sectionpool", "freekb", "Memory kept for reuse by the PSI section pool in KB.",
+                          PropertyType_Int, "freekb", SysPropertyGetSectionPool, NULL);
+    PropertiesAddProperty("sys.sectionpool", "limitkb", "Most memory the shared PSI section pool keeps for reuse in KB.",
+                          PropertyType_Int, NULL, SysPropertyGetSectionPoolLimit, SysPropertySetSectionPoolLimit);
 }
 
 static int SysPropertyGetUptime(void *userArg, PropertyValue_t *value)
@@ -614,6 +701,50 @@ static int SysPropertyGetUptimeSecs(void *userArg, PropertyValue_t *value)
     return 0;
 }
 
+static int SysPropertyGetSectionPool(void *userArg, PropertyValue_t *value)
+{
+    char *stat = userArg;
+    dvbpsi_pool_stats_t stats;
+
+    dvbpsi_PoolGetStats(&stats);
+    if (strcmp(stat, "outstanding") == 0)
+    {
+        value->u.integer = stats.i_outstanding;
+    }
+    else if (strcmp(stat, "free") == 0)
+    {
+        value->u.integer = stats.i_free;
+    }
+    else if (strcmp(stat, "peak") == 0)
+    {
+        value->u.integer = stats.i_peak;
+    }
+    else
+    {
+        value->u.integer = stats.i_free_bytes / 1024;
+    }
+    return 0;
+}
+
+static int SysPropertyGetSectionPoolLimit(void *userArg, PropertyValue_t *value)
+{
+    dvbpsi_pool_stats_t stats;
+
+    dvbpsi_PoolGetStats(&stats);
+    value->u.integer = stats.i_limit / 1024;
+    return 0;
+}
+
+static int SysPropertySetSectionPoolLimit(void *userArg, PropertyValue_t *value)
+{
+    if (value->u.integer < 0)
+    {
+        return -1;
+    }
+    dvbpsi_PoolSetLimit((size_t)value->u.integer * 1024);
+    return 0;
+}
+
 
 TSReader_t *MainTSReaderGet(void)
 {
@@ -625,6 +756,29 @@ DVBAdapter_t *MainDVBAdapterGet(void)
     return DVBAdapter;
 }
 
+int MainAdapterCount(void)
+{
+    return NrofAdapters;
+}
+
+TSReader_t *MainTSReaderGetByIndex(int index)
+{
+    if ((index < 0) || (index >= NrofAdapters))
+    {
+        return NULL;
+    }
+    return TSReaders[index];
+}
+
+DVBAdapter_t *MainDVBAdapterGetByIndex(int index)
+{
+    if ((index < 0) || (index >= NrofAdapters))
+    {
+        return NULL;
+    }
+    return DVBAdapters[index];
+}
+
 ServiceFilter_t MainServiceFilterGetPrimary(void)
 {
     return PrimaryServiceFilter;
@@ -708,6 +862,10 @@ static void usage(char *appname)
             "      -V            : Print version information then exit\n"
             "      -o <mrl>      : Output primary service to the specified mrl.\n"
             "      -a <adapter>  : Use adapter number (ie /dev/dvb/adapter<adapter>/...)\n"
+            "                      May be repeated or comma separated to add more\n"
+            "                      adapters, the first being the primary adapter\n"
+            "                      which is tuned by selecting a service.\n"
+            "                      Prefix with dvb: or file: to select the adapter type.\n"
             "      -f <file>     : Run startup script file before starting the command prompt\n"
             "      -d            : Run as a daemon.\n"
             "      -R            : Use hardware PID filters, only 1 service filter supported.\n"
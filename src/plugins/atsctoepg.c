@@ -29,6 +29,7 @@ Plugin to collect EPG schedule information from ATSC/PSIP.
 
 #include "plugin.h"
 #include "epgchannel.h"
+#include "dvbpsi/atsc/mgt.h"
 #include "dvbpsi/atsc/ett.h"
 #include "dvbpsi/atsc/eit.h"
 
@@ -46,6 +47,8 @@ Plugin to collect EPG schedule information from ATSC/PSIP.
 *******************************************************************************/
 #define MAX_EITS 128 /* Maximum number of EIT tables (PIDs) */
 #define MAX_ETTS 128 /* Maximum number of ETT tables (PIDs) */
+#define PID_PSIP 0x1ffb
+#define TABLE_ID_MGT 0xc7
 /*******************************************************************************
 * Typedefs                                                                     *
 *******************************************************************************/
@@ -55,6 +58,18 @@ typedef struct TableInfo_s
     dvbpsi_handle decoder;
 }TableInfo_t;
 
+typedef struct ATSCEPGCapture_s
+{
+    int adapterIndex;
+    TSFilterGroup_t *mgtgroup; /* Kept separate so the EIT/ETT filters can all be removed. */
+    dvbpsi_handle mgtDemux;
+    TSFilterGroup_t *tsgroup;
+    int eventInfoTableCount;
+    TableInfo_t eventInfoTableInfo[MAX_EITS];
+    int extendedTextTableCount;
+    TableInfo_t extendedTextTableInfo[MAX_ETTS];
+}ATSCEPGCapture_t;
+
 typedef struct TSCEPGDeferredInfo_s
 {
     uint16_t netId;
@@ -70,13 +85,15 @@ typedef struct TSCEPGDeferredInfo_s
 *******************************************************************************/
 static void Install(bool installed);
 
-static void NewMGT(dvbpsi_atsc_mgt_t *newMGT);
+static void MGTSubTableHandler(void * arg, dvbpsi_handle demuxHandle, uint8_t tableId, uint16_t extension);
+static void NewMGT(void *arg, dvbpsi_atsc_mgt_t *newMGT);
 static void NewSTT(dvbpsi_atsc_stt_t *newSTT);
 
 static void ATSCtoEPGFilterGroupEventCallback(void *arg, TSFilterGroup_t *group, TSFilterEventType_e event, void *details);
 
-static void ClearTableInfo(void);
-static void StartEPGCapture(void);
+static void AddMGTFilter(ATSCEPGCapture_t *capture);
+static void ClearTableInfo(ATSCEPGCapture_t *capture);
+static void StartEPGCapture(ATSCEPGCapture_t *capture);
 
 static void SubTableHandler(void * arg, dvbpsi_handle demuxHandle, uint8_t tableId, uint16_t extension);
 static void ProcessETT(void *arg, dvbpsi_atsc_ett_t *newETT);
@@ -97,20 +114,15 @@ static void CommandEPGCapStop(int argc, char **argv);
 *******************************************************************************/
 static const char ATSCTOEPG[] = "ATSCtoEPG";
 
-static TSFilterGroup_t *tsgroup = NULL;
+static ATSCEPGCapture_t captures[DVB_MAX_ADAPTERS];
+static bool capturing = FALSE;
 static uint8_t GPStoUTCSecondsOffset = 14; /* From the test streams 24th May 2007 */
 
-static int EventInfoTableCount = 0;
-static TableInfo_t EventInfoTableInfo[MAX_EITS];
-static int ExtendedTextTableCount = 0;
-static TableInfo_t ExtendedTextTableInfo[MAX_ETTS];
-
 /*******************************************************************************
 * Plugin Setup                                                                 *
 *******************************************************************************/
 PLUGIN_FEATURES(
     PLUGIN_FEATURE_INSTALL(Install),
-    PLUGIN_FEATURE_MGTPROCESSOR(NewMGT),
     PLUGIN_FEATURE_STTPROCESSOR(NewSTT)
     );
 
@@ -118,21 +130,21 @@ PLUGIN_COMMANDS({
         "epgcaprestart",
         0, 0,
         "Starts or restarts the capturing of EPG content.",
-        "Starts or restarts the capturing of EPG content, for use by EPG capture applications.",
+        "Starts or restarts the capturing of EPG content on all adapters, for use by EPG capture applications.",
         CommandEPGCapRestart
     },
     {
         "epgcapstart",
         0, 0,
         "Starts the capturing of EPG content.",
-        "Starts the capturing of EPG content, for use by EPG capture applications.",
+        "Starts the capturing of EPG content on all adapters, for use by EPG capture applications.",
         CommandEPGCapStart
     },
     {
         "epgcapstop",
         0, 0,
         "Stops the capturing of EPG content.",
-        "Stops the capturing of EPG content, for use by EPG capture applications.",
+        "Stops the capturing of EPG content on all adapters, for use by EPG capture applications.",
         CommandEPGCapStop
     }
 );
@@ -152,51 +164,73 @@ static void Install(bool installed)
     {
         ObjectRegisterType(ATSCEPGDeferredInfo_t);
     }
+    else if (capturing)
+    {
+        CommandEPGCapStop(0, NULL);
+    }
 }
 
 
-static void ClearTableInfo(void)
+static void AddMGTFilter(ATSCEPGCapture_t *capture)
+{
+    TSSectionMatch_t match;
+
+    memset(&match, 0, sizeof(match));
+    match.filter[0] = TABLE_ID_MGT;
+    match.mask[0] = 0xff;
+    capture->mgtDemux = dvbpsi_AttachDemux(MGTSubTableHandler, capture);
+    TSFilterGroupAddSectionFilterMatch(capture->mgtgroup, PID_PSIP, 3, capture->mgtDemux, &match);
+}
+
+static void ClearTableInfo(ATSCEPGCapture_t *capture)
 {
     int i;
-    if (tsgroup)
+    if (capture->tsgroup)
     {
-        TSFilterGroupRemoveAllFilters(tsgroup);
-        for (i = 0; i < EventInfoTableCount; i ++)
+        TSFilterGroupRemoveAllFilters(capture->tsgroup);
+        for (i = 0; i < capture->eventInfoTableCount; i ++)
         {
-            dvbpsi_DetachDemux(EventInfoTableInfo[i].decoder);
+            dvbpsi_DetachDemux(capture->eventInfoTableInfo[i].decoder);
         }
-        for (i = 0; i < ExtendedTextTableCount; i ++)
+        for (i = 0; i < capture->extendedTextTableCount; i ++)
         {
-            dvbpsi_atsc_DetachETT(ExtendedTextTableInfo[i].decoder);
+            dvbpsi_atsc_DetachETT(capture->extendedTextTableInfo[i].decoder);
         }
 
     }
-    EventInfoTableCount = 0;
-    ExtendedTextTableCount = 0;
+    capture->eventInfoTableCount = 0;
+    capture->extendedTextTableCount = 0;
+}
+
+static void MGTSubTableHandler(void * arg, dvbpsi_handle demuxHandle, uint8_t tableId, uint16_t extension)
+{
+    if (tableId == TABLE_ID_MGT)
+    {
+        dvbpsi_atsc_AttachMGT(demuxHandle, tableId, NewMGT, arg);
+    }
 }
 
-static void NewMGT(dvbpsi_atsc_mgt_t *newMGT)
+static void NewMGT(void *arg, dvbpsi_atsc_mgt_t *newMGT)
 {
+    ATSCEPGCapture_t *capture = arg;
     dvbpsi_atsc_mgt_table_t * table;
-    ClearTableInfo();
+    ClearTableInfo(capture);
 
     for (table = newMGT->p_first_table; table; table = table->p_next)
     {
-        if ((table->i_type >= 0x100) && (table->i_type <= 0x17f))
+        if ((table->i_type >= 0x100) && (table->i_type <= 0x17f) && (capture->eventInfoTableCount < MAX_EITS))
         {
-            EventInfoTableInfo[EventInfoTableCount].pid = table->i_pid;
-            EventInfoTableCount ++;
+            capture->eventInfoTableInfo[capture->eventInfoTableCount].pid = table->i_pid;
+            capture->eventInfoTableCount ++;
         }
-        if ((table->i_type >= 0x200) && (table->i_type <= 0x27f))
+        if ((table->i_type >= 0x200) && (table->i_type <= 0x27f) && (capture->extendedTextTableCount < MAX_ETTS))
         {
-            ExtendedTextTableInfo[ExtendedTextTableCount].pid = table->i_pid;
-            ExtendedTextTableCount ++;
+            capture->extendedTextTableInfo[capture->extendedTextTableCount].pid = table->i_pid;
+            capture->extendedTextTableCount ++;
         }
     }
-    if (tsgroup)
-    {
-        StartEPGCapture();
-    }
+    StartEPGCapture(capture);
+    ObjectRefDec(newMGT);
 }
 
 static void NewSTT(dvbpsi_atsc_stt_t *newSTT)
@@ -206,21 +240,27 @@ static void NewSTT(dvbpsi_atsc_stt_t *newSTT)
 
 static void ATSCtoEPGFilterGroupEventCallback(void *arg, TSFilterGroup_t *group, TSFilterEventType_e event, void *details)
 {
+    ATSCEPGCapture_t *capture = arg;
     if (event == TSFilterEventType_MuxChanged)
     {
-        ClearTableInfo();
+        ClearTableInfo(capture);
+        /* Reattach the MGT decoder so the new multiplex's MGT is always processed. */
+        TSFilterGroupRemoveSectionFilter(capture->mgtgroup, PID_PSIP);
+        dvbpsi_DetachDemux(capture->mgtDemux);
+        AddMGTFilter(capture);
     }
 }
 
 
 static void SubTableHandler(void * arg, dvbpsi_handle demuxHandle, uint8_t tableId, uint16_t extension)
 {
-    dvbpsi_atsc_AttachEIT(demuxHandle, tableId, extension, ProcessEIT, NULL);
+    dvbpsi_atsc_AttachEIT(demuxHandle, tableId, extension, ProcessEIT, arg);
 }
 
 static void ProcessETT(void *arg, dvbpsi_atsc_ett_t *newETT)
 {
-    Multiplex_t *multiplex = TuningCurrentMultiplexGet();
+    ATSCEPGCapture_t *capture = arg;
+    Multiplex_t *multiplex = TuningAdapterMultiplexGet(capture->adapterIndex);
     ATSCEPGDeferredInfo_t *info = ObjectCreateType(ATSCEPGDeferredInfo_t);
     info->netId = multiplex->networkId;
     info->tsId = multiplex->tsId;
@@ -232,7 +272,8 @@ static void ProcessETT(void *arg, dvbpsi_atsc_ett_t *newETT)
 
 static void ProcessEIT(void *arg, dvbpsi_atsc_eit_t *newEIT)
 {
-    Multiplex_t *multiplex = TuningCurrentMultiplexGet();
+    ATSCEPGCapture_t *capture = arg;
+    Multiplex_t *multiplex = TuningAdapterMultiplexGet(capture->adapterIndex);
     ATSCEPGDeferredInfo_t *info = ObjectCreateType(ATSCEPGDeferredInfo_t);
     info->netId = multiplex->networkId;
     info->tsId = multiplex->tsId;
@@ -307,48 +348,83 @@ static void DeferredProcessETT(void *arg)
 *******************************************************************************/
 static void CommandEPGCapRestart(int argc, char **argv)
 {
-    if (!tsgroup)
+    int i;
+    if (!capturing)
     {
         CommandEPGCapStart(argc, argv);
         return;
     }
-    ClearTableInfo();
-    StartEPGCapture();
+    for (i = 0; i < MainAdapterCount(); i ++)
+    {
+        TSReader_t *reader = MainTSReaderGetByIndex(i);
+        TSReaderLock(reader);
+        ATSCtoEPGFilterGroupEventCallback(&captures[i], captures[i].mgtgroup, TSFilterEventType_MuxChanged, NULL);
+        TSReaderUnLock(reader);
+    }
 }
 
 static void CommandEPGCapStart(int argc, char **argv)
 {
-    tsgroup = TSReaderCreateFilterGroup(MainTSReaderGet(), ATSCTOEPG, "ATSC", ATSCtoEPGFilterGroupEventCallback, NULL);
-    StartEPGCapture();
+    int i;
+    if (capturing)
+    {
+        CommandError(COMMAND_ERROR_GENERIC, "Already started!");
+        return;
+    }
+    for (i = 0; i < MainAdapterCount(); i ++)
+    {
+        TSReader_t *reader = MainTSReaderGetByIndex(i);
+        ATSCEPGCapture_t *capture = &captures[i];
+        TSReaderLock(reader);
+        capture->adapterIndex = i;
+        capture->tsgroup = TSReaderCreateFilterGroup(reader, ATSCTOEPG, "ATSC", NULL, NULL);
+        capture->mgtgroup = TSReaderCreateFilterGroup(reader, ATSCTOEPG, "ATSC", ATSCtoEPGFilterGroupEventCallback, capture);
+        AddMGTFilter(capture);
+        TSReaderUnLock(reader);
+    }
+    capturing = TRUE;
 }
 
 static void CommandEPGCapStop(int argc, char **argv)
 {
-    if (!tsgroup)
+    int i;
+    if (!capturing)
     {
         CommandError(COMMAND_ERROR_GENERIC, "Not yet started!");
         return;
     }
-    ClearTableInfo();
-    TSFilterGroupDestroy(tsgroup);
-    tsgroup = NULL;
+    for (i = 0; i < MainAdapterCount(); i ++)
+    {
+        TSReader_t *reader = MainTSReaderGetByIndex(i);
+        ATSCEPGCapture_t *capture = &captures[i];
+        TSReaderLock(reader);
+        ClearTableInfo(capture);
+        TSFilterGroupDestroy(capture->tsgroup);
+        TSFilterGroupDestroy(capture->mgtgroup);
+        dvbpsi_DetachDemux(capture->mgtDemux);
+        capture->tsgroup = NULL;
+        capture->mgtgroup = NULL;
+        capture->mgtDemux = NULL;
+        TSReaderUnLock(reader);
+    }
+    capturing = FALSE;
 }
 
 /*******************************************************************************
 * Helper Functions                                                             *
 *******************************************************************************/
-static void StartEPGCapture(void)
+static void StartEPGCapture(ATSCEPGCapture_t *capture)
 {
     int i;
-    for (i = 0; i < EventInfoTableCount; i ++)
+    for (i = 0; i < capture->eventInfoTableCount; i ++)
     {
-        EventInfoTableInfo[i].decoder = dvbpsi_AttachDemux(SubTableHandler, NULL);
-        TSFilterGroupAddSectionFilter(tsgroup, EventInfoTableInfo[i].pid, 3, EventInfoTableInfo[i].decoder);
+        capture->eventInfoTableInfo[i].decoder = dvbpsi_AttachDemux(SubTableHandler, capture);
+        TSFilterGroupAddSectionFilter(capture->tsgroup, capture->eventInfoTableInfo[i].pid, 3, capture->eventInfoTableInfo[i].decoder);
     }
-    for (i = 0; i < ExtendedTextTableCount; i ++)
+    for (i = 0; i < capture->extendedTextTableCount; i ++)
     {
-        ExtendedTextTableInfo[i].decoder = dvbpsi_atsc_AttachETT(ProcessETT, NULL);
-        TSFilterGroupAddSectionFilter(tsgroup,ExtendedTextTableInfo[i].pid, 3, ExtendedTextTableInfo[i].decoder);
+        capture->extendedTextTableInfo[i].decoder = dvbpsi_atsc_AttachETT(ProcessETT, capture);
+        TSFilterGroupAddSectionFilter(capture->tsgroup, capture->extendedTextTableInfo[i].pid, 3, capture->extendedTextTableInfo[i].decoder);
     }
 }
 
@@ -426,7 +426,7 @@ static void DSMCCPIDDestructor(void *arg)
 
 static void DownloadSessionProcessPIDs(DSMCCDownloadSession_t *session)
 {
-    ProgramInfo_t *info= CacheProgramInfoGet(session->service);
+    ProgramInfo_t *info= CacheProgramInfoGet(CacheGet(0), session->service);
     if (info != NULL)
     {
         int i;
@@ -504,7 +504,7 @@ static void DownloadSessionProcessPIDs(DSMCCDownloadSession_t *session)
 static uint16_t AssociationTagToPID(Service_t *service, uint16_t tag)
 {
     int i;
-    ProgramInfo_t *info = CacheProgramInfoGet(service);
+    ProgramInfo_t *info = CacheProgramInfoGet(CacheGet(0), service);
     if (info == NULL)
     {
         return INVALID_PID;
@@ -26,6 +26,7 @@ Plugin to collect EPG schedule information.
 #include <string.h>
 #include <stdint.h>
 #include <time.h>
+#include <pthread.h>
 
 #include "plugin.h"
 #include "main.h"
@@ -87,10 +88,19 @@ typedef struct ServiceNowNextInfo_s
     NNEvent_t  next;
 }ServiceNowNextInfo_t;
 
+typedef struct EITCapture_s
+{
+    TSFilterGroup_t *tsgroup;
+    dvbpsi_handle eitDemux;
+    dvbpsi_handle freesatDemux;
+}EITCapture_t;
+
 /*******************************************************************************
 * Prototypes                                                                   *
 *******************************************************************************/
 static void Install(bool installed);
+static void AddEITFilters(EITCapture_t *capture);
+static void RemoveEITFilters(EITCapture_t *capture);
 static void SubTableHandler(void * arg, dvbpsi_handle demuxHandle, uint8_t tableId, uint16_t extension);
 static void ProcessEIT(void *arg, dvbpsi_eit_t *newEIT);
 static void ProcessPFEIT(void *arg, dvbpsi_eit_t *newEIT);
@@ -113,8 +123,6 @@ static void PrintEvent(NNEvent_t *event);
 
 static ServiceNowNextInfo_t *FindServiceName(char *name);
 static ServiceNowNextInfo_t *FindService(uint16_t networkId, uint16_t tsId, uint16_t serviceId);
-static void SubTableHandler(void * arg, dvbpsi_handle demuxHandle, uint8_t tableId, uint16_t extension);
-static void ProcessPFEIT(void *arg, dvbpsi_eit_t *newEIT);
 static void UpdateEvent(NNEvent_t *event, dvbpsi_eit_event_t *eitevent);
 
 
@@ -155,21 +163,24 @@ PLUGIN_COMMANDS({
         "epgcaprestart",
         0, 0,
         "Starts or restarts the capturing of EPG content.",
-        "Starts or restarts the capturing of EPG content, for use by EPG capture applications.",
+        "Starts or restarts the capturing of EPG content on all adapters, for use by EPG capture applications.",
         CommandEPGCapRestart
     },
     {
         "epgcapstart",
-        0, 0,
+        0, 1,
         "Starts the capturing of EPG content.",
-        "Starts the capturing of EPG content, for use by EPG capture applications.",
+        "epgcapstart [nownext]\n"
+        "Starts the capturing of EPG content on all adapters, for use by EPG capture applications.\n"
+        "If nownext is specified only present/following events are captured, "
+        "schedule sections are dropped before they are reassembled.",
         CommandEPGCapStart
     },
     {
         "epgcapstop",
         0, 0,
         "Stops the capturing of EPG content.",
-        "Stops the capturing of EPG content, for use by EPG capture applications.",
+        "Stops the capturing of EPG content on all adapters, for use by EPG capture applications.",
         CommandEPGCapStop
     },
     {
@@ -202,9 +213,12 @@ PLUGIN_INTERFACE_CF(
 * Global variables                                                             *
 *******************************************************************************/
 
-static TSFilterGroup_t *tsgroup = NULL;
-static dvbpsi_handle eitDemux = NULL, freesatDemux = NULL;
+static EITCapture_t captures[DVB_MAX_ADAPTERS];
+static bool capturing = FALSE;
+static bool nowNextOnly = FALSE;
 static List_t *serviceNowNextInfoList;
+/* Present/following EITs are processed on the thread of each adapter. */
+static pthread_mutex_t serviceNowNextInfoMutex = PTHREAD_MUTEX_INITIALIZER;
 
 /*******************************************************************************
 * Filter Functions                                                             *
@@ -218,11 +232,9 @@ static void Install(bool installed)
     }
     else
     {
-        if (tsgroup)
+        if (capturing)
         {
-            TSFilterGroupDestroy(tsgroup);
-            dvbpsi_DetachDemux(eitDemux);
-            dvbpsi_DetachDemux(freesatDemux); 
+            CommandEPGCapStop(0, NULL);
         }
         ListFree(serviceNowNextInfoList, free);
         
@@ -231,19 +243,41 @@ static void Install(bool installed)
 
 static void DVBtoEPGFilterGroupEventCallback(void *arg, TSFilterGroup_t *group, TSFilterEventType_e event, void *details)
 {
-    if ((event == TSFilterEventType_MuxChanged) && tsgroup)
+    EITCapture_t *capture = arg;
+    if ((event == TSFilterEventType_MuxChanged) && capture->tsgroup)
     {
-        if (eitDemux)
-        {
-            TSFilterGroupRemoveSectionFilter(tsgroup, PID_EIT);
-            TSFilterGroupRemoveSectionFilter(tsgroup, PID_FREESAT_EIT);            
-            dvbpsi_DetachDemux(eitDemux);
-            dvbpsi_DetachDemux(freesatDemux);            
-        }
-        eitDemux = dvbpsi_AttachDemux(SubTableHandler, NULL);
-        TSFilterGroupAddSectionFilter(tsgroup, PID_EIT, 3, eitDemux);
-        freesatDemux = dvbpsi_AttachDemux(SubTableHandler, NULL);
-        TSFilterGroupAddSectionFilter(tsgroup, PID_FREESAT_EIT, 3, freesatDemux);        
+        RemoveEITFilters(capture);
+        AddEITFilters(capture);
+    }
+}
+
+static void AddEITFilters(EITCapture_t *capture)
+{
+    TSSectionMatch_t match;
+
+    /* Present/following tables are 0x4e (actual) and 0x4f (other). */
+    memset(&match, 0, sizeof(match));
+    if (nowNextOnly)
+    {
+        match.filter[0] = TABLE_ID_PF_ACTUAL;
+        match.mask[0] = 0xfe;
+    }
+    capture->eitDemux = dvbpsi_AttachDemux(SubTableHandler, capture);
+    TSFilterGroupAddSectionFilterMatch(capture->tsgroup, PID_EIT, 3, capture->eitDemux, &match);
+    capture->freesatDemux = dvbpsi_AttachDemux(SubTableHandler, capture);
+    TSFilterGroupAddSectionFilterMatch(capture->tsgroup, PID_FREESAT_EIT, 3, capture->freesatDemux, &match);
+}
+
+static void RemoveEITFilters(EITCapture_t *capture)
+{
+    if (capture->eitDemux)
+    {
+        TSFilterGroupRemoveSectionFilter(capture->tsgroup, PID_EIT);
+        TSFilterGroupRemoveSectionFilter(capture->tsgroup, PID_FREESAT_EIT);            
+        dvbpsi_DetachDemux(capture->eitDemux);
+        dvbpsi_DetachDemux(capture->freesatDemux);            
+        capture->eitDemux = NULL;
+        capture->freesatDemux = NULL;
     }
 }
 
@@ -297,45 +331,79 @@ static void DeferredProcessEIT(void *arg)
 *******************************************************************************/
 static void CommandEPGCapRestart(int argc, char **argv)
 {
-    if (tsgroup)
+    int i;
+    if (capturing)
     {
-        DVBtoEPGFilterGroupEventCallback(NULL, tsgroup, TSFilterEventType_MuxChanged, NULL);
+        for (i = 0; i < MainAdapterCount(); i ++)
+        {
+            TSReader_t *reader = MainTSReaderGetByIndex(i);
+            TSReaderLock(reader);
+            DVBtoEPGFilterGroupEventCallback(&captures[i], captures[i].tsgroup, TSFilterEventType_MuxChanged, NULL);
+            TSReaderUnLock(reader);
+        }
     }
 }
 
 static void CommandEPGCapStart(int argc, char **argv)
 {
-    if (tsgroup)
+    int i;
+    if (capturing)
     {
         CommandError(COMMAND_ERROR_GENERIC, "Already started!");
         return;
     }
-    tsgroup = TSReaderCreateFilterGroup(MainTSReaderGet(), DVBTOEPG, "DVB", DVBtoEPGFilterGroupEventCallback, NULL);
-    eitDemux = dvbpsi_AttachDemux(SubTableHandler, NULL);
-    TSFilterGroupAddSectionFilter(tsgroup, PID_EIT, 3, eitDemux);
-    freesatDemux = dvbpsi_AttachDemux(SubTableHandler, NULL);
-    TSFilterGroupAddSectionFilter(tsgroup, PID_FREESAT_EIT, 3, freesatDemux);        
-    
+    if (argc == 1)
+    {
+        if (strcmp(argv[0], "nownext"))
+        {
+            CommandError(COMMAND_ERROR_GENERIC, "Unknown option %s!", argv[0]);
+            return;
+        }
+        nowNextOnly = TRUE;
+    }
+    else
+    {
+        nowNextOnly = FALSE;
+    }
+    for (i = 0; i < MainAdapterCount(); i ++)
+    {
+        TSReader_t *reader = MainTSReaderGetByIndex(i);
+        TSReaderLock(reader);
+        captures[i].tsgroup = TSReaderCreateFilterGroup(reader, DVBTOEPG, "DVB", DVBtoEPGFilterGroupEventCallback, &captures[i]);
+        AddEITFilters(&captures[i]);
+        TSReaderUnLock(reader);
+    }
+    capturing = TRUE;
 }
 
 static void CommandEPGCapStop(int argc, char **argv)
 {
-    if (!tsgroup)
+    int i;
+    if (!capturing)
     {
         CommandError(COMMAND_ERROR_GENERIC, "Not yet started!");
         return;
     }
-    TSFilterGroupDestroy(tsgroup);
-    dvbpsi_DetachDemux(eitDemux);
-    dvbpsi_DetachDemux(freesatDemux); 
-    eitDemux = NULL;
-    freesatDemux = NULL;
-    tsgroup = NULL;
+    for (i = 0; i < MainAdapterCount(); i ++)
+    {
+        TSReader_t *reader = MainTSReaderGetByIndex(i);
+        TSReaderLock(reader);
+        TSFilterGroupDestroy(captures[i].tsgroup);
+        dvbpsi_DetachDemux(captures[i].eitDemux);
+        dvbpsi_DetachDemux(captures[i].freesatDemux); 
+        captures[i].eitDemux = NULL;
+        captures[i].freesatDemux = NULL;
+        captures[i].tsgroup = NULL;
+        TSReaderUnLock(reader);
+    }
+    capturing = FALSE;
 }
 
 static void CommandNow(int argc, char **argv)
 {
-    ServiceNowNextInfo_t *info = FindServiceName(argv[0]);
+    ServiceNowNextInfo_t *info;
+    pthread_mutex_lock(&serviceNowNextInfoMutex);
+    info = FindServiceName(argv[0]);
     if (info)
     {
         PrintEvent(&info->now);
@@ -344,11 +412,14 @@ static void CommandNow(int argc, char **argv)
     {
         CommandError(COMMAND_ERROR_GENERIC, "No info found for \"%s\"", argv[0]);
     }
+    pthread_mutex_unlock(&serviceNowNextInfoMutex);
 }
 
 static void CommandNext(int argc, char **argv)
 {
-    ServiceNowNextInfo_t *info = FindServiceName(argv[0]);
+    ServiceNowNextInfo_t *info;
+    pthread_mutex_lock(&serviceNowNextInfoMutex);
+    info = FindServiceName(argv[0]);
     if (info)
     {
         PrintEvent(&info->next);
@@ -357,6 +428,7 @@ static void CommandNext(int argc, char **argv)
     {
         CommandError(COMMAND_ERROR_GENERIC, "No info found for \"%s\"", argv[0]);
     }
+    pthread_mutex_unlock(&serviceNowNextInfoMutex);
 }
 
 static void PrintEvent(NNEvent_t *event)
@@ -646,7 +718,9 @@ static void ExtTextDescDestructor(void *ptr)
 
 static void ProcessPFEIT(void *arg, dvbpsi_eit_t *newEIT)
 {
-    ServiceNowNextInfo_t *info = FindService(newEIT->i_network_id, newEIT->i_ts_id, newEIT->i_service_id);
+    ServiceNowNextInfo_t *info;
+    pthread_mutex_lock(&serviceNowNextInfoMutex);
+    info = FindService(newEIT->i_network_id, newEIT->i_ts_id, newEIT->i_service_id);
     LogModule(LOG_DEBUG, DVBTOEPG, "EIT received (version %d) net id %x ts id %x service id %x info %p\n",
         newEIT->i_version, newEIT->i_network_id, newEIT->i_ts_id, newEIT->i_service_id, info);
     if (!info)
@@ -674,6 +748,7 @@ static void ProcessPFEIT(void *arg, dvbpsi_eit_t *newEIT)
             }
         }
     }
+    pthread_mutex_unlock(&serviceNowNextInfoMutex);
 
     ObjectRefDec(newEIT);
 }
@@ -19,21 +19,81 @@ fileoutput.c
 
 File Delivery Method handler, all packets are written to the file of choosing.
 
+Packets are copied into large page aligned blocks on the calling thread, full
+blocks are queued to a writer thread which writes each one with a single
+pwrite(), optionally with O_DIRECT and with space preallocated using
+fallocate(). Blocks that are only partly filled are queued once they have held
+data for FLUSH_INTERVAL seconds. This is checked at the end of each batch of
+input and, as the input may stop altogether, by the writer whenever it has
+been idle for WAIT_TIMEOUT seconds. The calling thread's state is protected by
+producerMutex so the writer can queue the block (or start the next segment)
+itself.
+
+The recording can be split into segments by time or size. Each segment is
+written as <name>.part and renamed once it is complete, so anything watching
+the directory never sees a partly written segment. Header space is reserved at
+the start of every segment and new segments start with the last header set.
+
 */
 #define _FILE_OFFSET_BITS 64
+#include "config.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
 
 #include "plugin.h"
 #include "ts.h"
 #include "deliverymethod.h"
 #include "logging.h"
 
+/*******************************************************************************
+* Defines                                                                      *
+*******************************************************************************/
+/* Alignment of the blocks and of their size, enough for O_DIRECT on any
+ * device with sectors up to 4K. */
+#define BLOCK_ALIGNMENT 4096
+
+#define DEFAULT_BLOCK_SIZE (1024 * 1024)
+#define DEFAULT_BUFFERS    4
+#define MAX_BUFFERS        64
+
+/* Maximum number of blocks and headers waiting for the writer. */
+#define QUEUE_SIZE (MAX_BUFFERS + 16)
+
+/* Longest time (in seconds) data sits in a partly filled block. */
+#define FLUSH_INTERVAL 2
+
+/* Longest time (in seconds) the writer waits before checking for a partly
+ * filled block or a segment that is due to end. */
+#define WAIT_TIMEOUT 1
+
+#define MB (1024ULL * 1024ULL)
+
 /*******************************************************************************
 * Typedefs                                                                     *
 *******************************************************************************/
+typedef enum FileItemType_e
+{
+    FileItem_Data,              /* A block of data to write. */
+    FileItem_Header,            /* Header packets to write at the start of the segment. */
+    FileItem_NextSegment        /* Close the segment and start the next one. */
+}FileItemType_e;
+
+typedef struct FileItem_t
+{
+    FileItemType_e type;
+    uint8_t *data;
+    unsigned int length;
+}FileItem_t;
+
 struct FileOutputInstance_t
 {
     /* !!! MUST BE THE FIRST FIELD IN THE STRUCTURE !!!
@@ -42,9 +102,56 @@ struct FileOutputInstance_t
      */
     DeliveryMethodInstance_t instance;
 
-    FILE *fp;
-};
+    /* Options */
+    char *path;                 /* File name, or the template for segment names. */
+    bool append;
+    bool direct;
+    unsigned int blockSize;
+    unsigned long long preallocate; /* Bytes to reserve at a time, 0 for none. */
+    unsigned int segmentTime;   /* Seconds per segment, 0 for no limit. */
+    unsigned long long segmentSize; /* Bytes per segment, 0 for no limit. */
+    int nrofBuffers;
 
+    /* Calling thread, protected by producerMutex */
+    pthread_mutex_t producerMutex;
+    uint8_t *block;             /* Block being filled. */
+    unsigned int blockUsed;
+    time_t blockStarted;        /* When data was first added to the block. */
+    unsigned long long segmentBytes; /* Bytes added to the segment, including the block. */
+    time_t segmentStarted;
+    int segment;
+    int headerReserved;         /* Packets reserved at the start of each segment. */
+    TSPacket_t *header;         /* Last header set, written at the start of new segments. */
+    int headerCount;
+
+    /* Shared */
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    FileItem_t queue[QUEUE_SIZE];
+    int queueHead;
+    int queueCount;
+    uint8_t *freeBuffers[MAX_BUFFERS];
+    int nrofFree;
+    bool quit;
+    pthread_t thread;
+    uint8_t **buffers;
+
+    /* Writer thread */
+    int fd;
+    char *partName;             /* Name the segment is written under, NULL if not segmenting. */
+    char *finalName;
+    bool fdDirect;              /* Whether fd was opened with O_DIRECT. */
+    off_t base;                 /* Offset of the start of the segment, non 0 when appending. */
+    unsigned long long written; /* Bytes written to the segment. */
+    unsigned long long allocated; /* Bytes preallocated from base. */
+    bool padded;                /* Last write was padded to the alignment. */
+    int writerSegment;
+
+    /* Statistics */
+    unsigned long long totalWritten;
+    unsigned int writes;
+    unsigned int stalls;
+};
 
 /*******************************************************************************
 * Prototypes                                                                   *
@@ -52,11 +159,32 @@ struct FileOutputInstance_t
 bool FileOutputCanHandle(char *mrl);
 DeliveryMethodInstance_t *FileOutputCreate(char *arg);
 void FileOutputSendPacket(DeliveryMethodInstance_t *this, TSPacket_t *packet);
+void FileOutputSendPackets(DeliveryMethodInstance_t *this, TSPacket_t **packets, int count);
 void FileOutputSendBlock(DeliveryMethodInstance_t *this, void *block, unsigned long blockLen);
 void FileOutputDestroy(DeliveryMethodInstance_t *this);
 void FileReserveHeaderSpace(DeliveryMethodInstance_t *this, int packets);
 void FileSetHeader(struct DeliveryMethodInstance_t *this,
                         TSPacket_t *packets, int count);
+void FileOutputFlush(DeliveryMethodInstance_t *this);
+
+static void FreeInstance(struct FileOutputInstance_t *instance);
+static char *SplitOptions(char *name);
+static bool ParseOptions(char *options, struct FileOutputInstance_t *instance);
+static char *SegmentName(struct FileOutputInstance_t *instance, int segment);
+static void UpdateHeader(struct FileOutputInstance_t *instance, TSPacket_t *packets, int count);
+static void CheckBlock(struct FileOutputInstance_t *instance, time_t now);
+static void AddData(struct FileOutputInstance_t *instance, void *data, unsigned long length);
+static void QueueBlock(struct FileOutputInstance_t *instance, bool whole);
+static void QueueItem(struct FileOutputInstance_t *instance, FileItemType_e type, uint8_t *data, unsigned int length);
+static uint8_t *TakeBuffer(struct FileOutputInstance_t *instance);
+static void NextSegment(struct FileOutputInstance_t *instance);
+static void StartSegment(struct FileOutputInstance_t *instance);
+static void *WriterThread(void *arg);
+static void Wait(struct FileOutputInstance_t *instance);
+static bool OpenSegment(struct FileOutputInstance_t *instance, int segment);
+static void CloseSegment(struct FileOutputInstance_t *instance);
+static void WriteData(struct FileOutputInstance_t *instance, uint8_t *data, unsigned int length);
+static void WriteHeader(struct FileOutputInstance_t *instance, uint8_t *data, unsigned int length);
 
 /*******************************************************************************
 * Global variables                                                             *
@@ -71,10 +199,16 @@ DeliveryMethodInstanceOps_t FileInstanceOps ={
     FileOutputDestroy,
     FileReserveHeaderSpace,
     FileSetHeader,
+    FileOutputSendPackets,
+    FileOutputFlush,
 };
 
 static const char FILEOUTPUT[] = "FileOutput";
 
+static const char *optionNames[] = {
+    "block", "buffers", "direct", "prealloc", "segment", "segmentsize"
+};
+
 /*******************************************************************************
 * Plugin Setup                                                                 *
 *******************************************************************************/
@@ -85,12 +219,22 @@ PLUGIN_FEATURES(
 PLUGIN_INTERFACE_F(
     PLUGIN_FOR_ALL,
     "FileOutput",
-    "0.2",
-    "File Delivery method.\nUse file://<file name>\n"
+    "0.3",
+    "File Delivery method.\nUse file://<file name>[,<options>]\n"
     "File name can be in absolute or relative.\n"
     "For an absolute file name use file:///home/user/myts.ts.\n"
     "For a relative file name use file://myts.ts.\n"
-    "Use the filea:// prefix to append data to an existing file.",
+    "Use the filea:// prefix to append data to an existing file.\n"
+    "Options are comma separated and may be:\n"
+    "    block=<KB>         Size of each write (default 1024).\n"
+    "    buffers=<n>        Number of blocks that can be waiting to be written (default 4).\n"
+    "    direct=yes         Write with O_DIRECT, bypassing the page cache.\n"
+    "    prealloc=<MB>      Reserve disk space this many MB at a time.\n"
+    "    segment=<seconds>  Start a new file after this many seconds.\n"
+    "    segmentsize=<MB>   Start a new file after this many MB.\n"
+    "When segmenting files are named <name>-00001.<ext> and so on, each is\n"
+    "written as <file>.part and renamed once complete.\n"
+    "For example file:///recordings/bbc1.ts,segment=3600,prealloc=64",
     "charrea6@users.sourceforge.net"
 );
 
@@ -100,7 +244,7 @@ PLUGIN_INTERFACE_F(
 
 bool FileOutputCanHandle(char *mrl)
 {
-    return (strncmp(FilePrefix, mrl, sizeof(FilePrefix)-1) == 0) || 
+    return (strncmp(FilePrefix, mrl, sizeof(FilePrefix)-1) == 0) ||
            (strncmp(FileAppendPrefix, mrl, sizeof(FileAppendPrefix)-1) == 0);
 }
 
@@ -108,32 +252,95 @@ DeliveryMethodInstance_t *FileOutputCreate(char *arg)
 {
     struct FileOutputInstance_t *instance = calloc(1, sizeof(struct FileOutputInstance_t));
     bool append = (strncmp(FileAppendPrefix, arg, sizeof(FileAppendPrefix)-1) == 0);
-    char *mode;
+    char *options;
     int prefixLen;
-    
+    int i;
+
     if (instance == NULL)
     {
         return NULL;
     }
     if (append)
     {
-        mode = "ab";
         prefixLen = sizeof(FileAppendPrefix)-1;
     }
     else
     {
-        mode = "wb";
         prefixLen = sizeof(FilePrefix)-1;
     }
     instance->instance.ops = &FileInstanceOps;
+    instance->append = append;
+    instance->blockSize = DEFAULT_BLOCK_SIZE;
+    instance->nrofBuffers = DEFAULT_BUFFERS;
+    instance->fd = -1;
 
-    instance->fp = fopen((char*)(arg + prefixLen), mode);
-
-    if (!instance->fp)
+    instance->path = strdup(arg + prefixLen);
+    if (instance->path == NULL)
     {
         free(instance);
         return NULL;
     }
+    options = SplitOptions(instance->path);
+    if (options && !ParseOptions(options, instance))
+    {
+        FreeInstance(instance);
+        return NULL;
+    }
+    if (instance->direct && instance->append)
+    {
+        LogModule(LOG_INFO, FILEOUTPUT, "direct is not supported when appending, ignoring.\n");
+        instance->direct = FALSE;
+    }
+
+    instance->buffers = calloc(instance->nrofBuffers, sizeof(uint8_t *));
+    if (instance->buffers == NULL)
+    {
+        FreeInstance(instance);
+        return NULL;
+    }
+    for (i = 0; i < instance->nrofBuffers; i ++)
+    {
+        void *buffer;
+        if (posix_memalign(&buffer, BLOCK_ALIGNMENT, instance->blockSize))
+        {
+            LogModule(LOG_ERROR, FILEOUTPUT, "Failed to allocate %d blocks of %u bytes\n",
+                instance->nrofBuffers, instance->blockSize);
+            break;
+        }
+        instance->buffers[i] = buffer;
+        instance->freeBuffers[i] = buffer;
+    }
+    instance->nrofFree = i;
+
+    instance->segment = 1;
+    if ((instance->nrofFree < instance->nrofBuffers) || !OpenSegment(instance, instance->segment))
+    {
+        CloseSegment(instance);
+        FreeInstance(instance);
+        return NULL;
+    }
+
+    pthread_mutex_init(&instance->producerMutex, NULL);
+    pthread_mutex_init(&instance->mutex, NULL);
+    pthread_cond_init(&instance->cond, NULL);
+    instance->block = TakeBuffer(instance);
+    instance->segmentStarted = time(NULL);
+    if (pthread_create(&instance->thread, NULL, WriterThread, instance))
+    {
+        LogModule(LOG_ERROR, FILEOUTPUT, "Failed to start writer thread\n");
+        close(instance->fd);
+        instance->fd = -1;
+        if (instance->partName)
+        {
+            unlink(instance->partName);
+        }
+        CloseSegment(instance);
+        pthread_cond_destroy(&instance->cond);
+        pthread_mutex_destroy(&instance->mutex);
+        pthread_mutex_destroy(&instance->producerMutex);
+        FreeInstance(instance);
+        return NULL;
+    }
 
     instance->instance.mrl = strdup(arg);
     return &instance->instance;
@@ -144,57 +351,687 @@ void FileOutputSendPacket(DeliveryMethodInstance_t *this, TSPacket_t *packet)
     FileOutputSendBlock(this, (void *)packet, sizeof(TSPacket_t));
 }
 
+void FileOutputSendPackets(DeliveryMethodInstance_t *this, TSPacket_t **packets, int count)
+{
+    struct FileOutputInstance_t *instance = (struct FileOutputInstance_t*)this;
+    int i;
+
+    pthread_mutex_lock(&instance->producerMutex);
+    for (i = 0; i < count; i ++)
+    {
+        AddData(instance, packets[i], sizeof(TSPacket_t));
+    }
+    pthread_mutex_unlock(&instance->producerMutex);
+}
+
 void FileOutputSendBlock(DeliveryMethodInstance_t *this, void *block, unsigned long blockLen)
 {
     struct FileOutputInstance_t *instance = (struct FileOutputInstance_t*)this;
-    if (fwrite(block, 1, blockLen, instance->fp) != blockLen)
+
+    pthread_mutex_lock(&instance->producerMutex);
+    AddData(instance, block, blockLen);
+    pthread_mutex_unlock(&instance->producerMutex);
+}
+
+void FileOutputFlush(DeliveryMethodInstance_t *this)
+{
+    struct FileOutputInstance_t *instance = (struct FileOutputInstance_t*)this;
+
+    pthread_mutex_lock(&instance->producerMutex);
+    if (instance->blockUsed || instance->segmentTime)
     {
-        LogModule(LOG_INFO, FILEOUTPUT, "Failed to write entire block to file!\n");
+        CheckBlock(instance, time(NULL));
     }
-    fflush(instance->fp);
+    pthread_mutex_unlock(&instance->producerMutex);
 }
 
 void FileOutputDestroy(DeliveryMethodInstance_t *this)
 {
     struct FileOutputInstance_t *instance = (struct FileOutputInstance_t*)this;
-    fclose(instance->fp);
+
+    /* Held until the writer exits so it does not start another segment. */
+    pthread_mutex_lock(&instance->producerMutex);
+    if (instance->blockUsed)
+    {
+        QueueBlock(instance, TRUE);
+    }
+    pthread_mutex_lock(&instance->mutex);
+    instance->quit = TRUE;
+    pthread_cond_broadcast(&instance->cond);
+    pthread_mutex_unlock(&instance->mutex);
+    pthread_join(instance->thread, NULL);
+    pthread_mutex_unlock(&instance->producerMutex);
+
+    LogModule(LOG_DEBUG, FILEOUTPUT, "%s: %llu bytes in %u writes, %d segments, waited for the disk %u times\n",
+        instance->path, instance->totalWritten, instance->writes, instance->segment, instance->stalls);
+
+    pthread_mutex_destroy(&instance->producerMutex);
+    pthread_mutex_destroy(&instance->mutex);
+    pthread_cond_destroy(&instance->cond);
     free(this->mrl);
-    free(this);
+    FreeInstance(instance);
 }
 
 void FileReserveHeaderSpace(DeliveryMethodInstance_t *this, int packets)
 {
     struct FileOutputInstance_t *instance = (struct FileOutputInstance_t*)this;
+
+    pthread_mutex_lock(&instance->producerMutex);
+    if (instance->segmentBytes)
+    {
+        LogModule(LOG_INFO, FILEOUTPUT, "Header space must be reserved before any packets are sent.\n");
+    }
+    else
+    {
+        instance->headerReserved = packets;
+        StartSegment(instance);
+    }
+    pthread_mutex_unlock(&instance->producerMutex);
+}
+
+void FileSetHeader(struct DeliveryMethodInstance_t *this,
+                        TSPacket_t *packets, int count)
+{
+    struct FileOutputInstance_t *instance = (struct FileOutputInstance_t*)this;
+
+    pthread_mutex_lock(&instance->producerMutex);
+    UpdateHeader(instance, packets, count);
+    pthread_mutex_unlock(&instance->producerMutex);
+}
+
+/*******************************************************************************
+* Local Functions                                                              *
+*******************************************************************************/
+static void FreeInstance(struct FileOutputInstance_t *instance)
+{
+    int i;
+
+    if (instance->buffers)
+    {
+        for (i = 0; i < instance->nrofBuffers; i ++)
+        {
+            free(instance->buffers[i]);
+        }
+        free(instance->buffers);
+    }
+    if (instance->header)
+    {
+        free(instance->header);
+    }
+    free(instance->path);
+    free(instance);
+}
+
+static void UpdateHeader(struct FileOutputInstance_t *instance, TSPacket_t *packets, int count)
+{
+    unsigned long long blockOffset = instance->segmentBytes - instance->blockUsed;
+    unsigned int length;
+
+    if (count > instance->headerReserved)
+    {
+        LogModule(LOG_INFO, FILEOUTPUT, "Header of %d packets does not fit in %d reserved.\n",
+            count, instance->headerReserved);
+        count = instance->headerReserved;
+    }
+    if (count <= 0)
+    {
+        return;
+    }
+    if (instance->header)
+    {
+        free(instance->header);
+    }
+    instance->headerCount = count;
+    instance->header = malloc(count * TSPACKET_SIZE);
+    if (instance->header == NULL)
+    {
+        instance->headerCount = 0;
+        return;
+    }
+    memcpy(instance->header, packets, count * TSPACKET_SIZE);
+    length = count * TSPACKET_SIZE;
+
+    /* Whatever part of the header is still in the block is updated there, the
+     * writer updates the part already handed to it once it has been written. */
+    if (blockOffset < length)
+    {
+        memcpy(instance->block, (uint8_t *)packets + blockOffset, length - blockOffset);
+    }
+    if (blockOffset > 0)
+    {
+        uint8_t *copy = malloc(length);
+        if (copy)
+        {
+            memcpy(copy, packets, length);
+            QueueItem(instance, FileItem_Header, copy, length);
+        }
+    }
+}
+
+/*
+ * Start the next segment if this one is due to end, otherwise queue the block
+ * if it has held data for too long.
+ * Must be called with the producer mutex held.
+ */
+static void CheckBlock(struct FileOutputInstance_t *instance, time_t now)
+{
+    unsigned long long headerBytes = instance->headerReserved * TSPACKET_SIZE;
+
+    /* Only move on once something other than the header is in the segment. */
+    if ((instance->segmentBytes > headerBytes) &&
+        ((instance->segmentTime && (now - instance->segmentStarted >= instance->segmentTime)) ||
+         (instance->segmentSize && (instance->segmentBytes >= instance->segmentSize))))
+    {
+        NextSegment(instance);
+        instance->segmentStarted = now;
+    }
+    else if (instance->blockUsed && (now - instance->blockStarted >= FLUSH_INTERVAL))
+    {
+        QueueBlock(instance, FALSE);
+    }
+}
+
+/*
+ * Options follow the first comma that is followed by a known option name, so
+ * file names containing commas still work. Returns the options (with the file
+ * name terminated) or NULL if there are none.
+ */
+static char *SplitOptions(char *name)
+{
+    char *comma;
+    int i;
+
+    for (comma = strchr(name, ','); comma; comma = strchr(comma + 1, ','))
+    {
+        for (i = 0; i < sizeof(optionNames) / sizeof(optionNames[0]); i ++)
+        {
+            int len = strlen(optionNames[i]);
+            if ((strncmp(comma + 1, optionNames[i], len) == 0) && (comma[1 + len] == '='))
+            {
+                *comma = 0;
+                return comma + 1;
+            }
+        }
+    }
+    return NULL;
+}
+
+static bool ParseOptions(char *options, struct FileOutputInstance_t *instance)
+{
+    char option[32];
+    int i;
+
+    while (*options)
+    {
+        char *value;
+        for (i = 0; options[i] && (options[i] != ',') && (i < sizeof(option) - 1); i ++)
+        {
+            option[i] = options[i];
+        }
+        option[i] = 0;
+        options += i;
+        if (*options == ',')
+        {
+            options ++;
+        }
+
+        value = strchr(option, '=');
+        if (value == NULL)
+        {
+            LogModule(LOG_ERROR, FILEOUTPUT, "Option \"%s\" has no value\n", option);
+            return FALSE;
+        }
+        *value = 0;
+        value ++;
+
+        if (strcmp(option, "block") == 0)
+        {
+            int kb = atoi(value);
+            if ((kb < 4) || (kb > 65536))
+            {
+                LogModule(LOG_ERROR, FILEOUTPUT, "block must be between 4 and 65536 KB\n");
+                return FALSE;
+            }
+            instance->blockSize = ((kb * 1024) + BLOCK_ALIGNMENT - 1) & ~(BLOCK_ALIGNMENT - 1);
+        }
+        else if (strcmp(option, "buffers") == 0)
+        {
+            instance->nrofBuffers = atoi(value);
+            if ((instance->nrofBuffers < 2) || (instance->nrofBuffers > MAX_BUFFERS))
+            {
+                LogModule(LOG_ERROR, FILEOUTPUT, "buffers must be between 2 and %d\n", MAX_BUFFERS);
+                return FALSE;
+            }
+        }
+        else if (strcmp(option, "direct") == 0)
+        {
+            instance->direct = (strcmp(value, "yes") == 0) || (strcmp(value, "on") == 0) || (strcmp(value, "1") == 0);
+        }
+        else if (strcmp(option, "prealloc") == 0)
+        {
+            instance->preallocate = strtoull(value, NULL, 10) * MB;
+        }
+        else if (strcmp(option, "segment") == 0)
+        {
+            int seconds = atoi(value);
+            if (seconds < 0)
+            {
+                LogModule(LOG_ERROR, FILEOUTPUT, "segment must not be negative\n");
+                return FALSE;
+            }
+            instance->segmentTime = seconds;
+        }
+        else if (strcmp(option, "segmentsize") == 0)
+        {
+            instance->segmentSize = strtoull(value, NULL, 10) * MB;
+        }
+        else
+        {
+            LogModule(LOG_ERROR, FILEOUTPUT, "Unknown option \"%s\"\n", option);
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+/*
+ * Name of a segment, the number is inserted before the extension of the file
+ * name, ie recording.ts becomes recording-00001.ts.
+ */
+static char *SegmentName(struct FileOutputInstance_t *instance, int segment)
+{
+    char *slash = strrchr(instance->path, '/');
+    char *dot = strrchr(instance->path, '.');
+    char *name;
+    int prefixLen;
+
+    if ((dot == NULL) || (slash && (dot < slash)))
+    {
+        dot = instance->path + strlen(instance->path);
+    }
+    prefixLen = dot - instance->path;
+    name = malloc(strlen(instance->path) + 16);
+    if (name)
+    {
+        sprintf(name, "%.*s-%05d%s", prefixLen, instance->path, segment, dot);
+    }
+    return name;
+}
+
+static void AddData(struct FileOutputInstance_t *instance, void *data, unsigned long length)
+{
+    uint8_t *bytes = data;
+
+    if (instance->blockUsed == 0)
+    {
+        instance->blockStarted = time(NULL);
+    }
+    instance->segmentBytes += length;
+    while (length)
+    {
+        unsigned long space = instance->blockSize - instance->blockUsed;
+        unsigned long toCopy = (length < space) ? length : space;
+        memcpy(instance->block + instance->blockUsed, bytes, toCopy);
+        instance->blockUsed += toCopy;
+        bytes += toCopy;
+        length -= toCopy;
+        if (instance->blockUsed == instance->blockSize)
+        {
+            QueueBlock(instance, TRUE);
+        }
+    }
+}
+
+/*
+ * Hand the block to the writer and start a new one. With O_DIRECT a partial
+ * block is only written up to the last aligned byte, the rest is carried over
+ * to the new block, unless whole is set as the segment is about to end.
+ */
+static void QueueBlock(struct FileOutputInstance_t *instance, bool whole)
+{
+    uint8_t *block = instance->block;
+    unsigned int length = instance->blockUsed;
+    unsigned int carry = 0;
+
+    if (instance->direct && !whole)
+    {
+        carry = length & (BLOCK_ALIGNMENT - 1);
+        length -= carry;
+        if (length == 0)
+        {
+            return;
+        }
+    }
+    instance->block = TakeBuffer(instance);
+    memcpy(instance->block, block + length, carry);
+    instance->blockUsed = carry;
+    instance->blockStarted = time(NULL);
+    QueueItem(instance, FileItem_Data, block, length);
+}
+
+static void QueueItem(struct FileOutputInstance_t *instance, FileItemType_e type, uint8_t *data, unsigned int length)
+{
+    FileItem_t *item;
+
+    pthread_mutex_lock(&instance->mutex);
+    while (instance->queueCount == QUEUE_SIZE)
+    {
+        pthread_cond_wait(&instance->cond, &instance->mutex);
+    }
+    item = &instance->queue[(instance->queueHead + instance->queueCount) % QUEUE_SIZE];
+    item->type = type;
+    item->data = data;
+    item->length = length;
+    instance->queueCount ++;
+    pthread_cond_broadcast(&instance->cond);
+    pthread_mutex_unlock(&instance->mutex);
+}
+
+/*
+ * Take a free block, waiting for the writer if they are all queued. Nothing is
+ * dropped, wrap the output in async:// if the input must never wait.
+ */
+static uint8_t *TakeBuffer(struct FileOutputInstance_t *instance)
+{
+    uint8_t *buffer;
+
+    pthread_mutex_lock(&instance->mutex);
+    if (instance->nrofFree == 0)
+    {
+        instance->stalls ++;
+        while (instance->nrofFree == 0)
+        {
+            pthread_cond_wait(&instance->cond, &instance->mutex);
+        }
+    }
+    instance->nrofFree --;
+    buffer = instance->freeBuffers[instance->nrofFree];
+    pthread_mutex_unlock(&instance->mutex);
+    return buffer;
+}
+
+static void NextSegment(struct FileOutputInstance_t *instance)
+{
+    if (instance->blockUsed)
+    {
+        QueueBlock(instance, TRUE);
+    }
+    instance->segment ++;
+    QueueItem(instance, FileItem_NextSegment, NULL, instance->segment);
+    instance->segmentBytes = 0;
+    StartSegment(instance);
+}
+
+/*
+ * Start the segment with the last header set, padded to the reserved space
+ * with null packets.
+ */
+static void StartSegment(struct FileOutputInstance_t *instance)
+{
     TSPacket_t nullPacket;
     int i;
+
+    if (instance->headerCount)
+    {
+        AddData(instance, instance->header, instance->headerCount * TSPACKET_SIZE);
+    }
+
+    memset(&nullPacket, 0xff, sizeof(nullPacket));
     nullPacket.header[0] = 0x47;
     nullPacket.header[1] = 0x00;
     nullPacket.header[2] = 0x00;
-    nullPacket.header[3] = 0x00;
+    nullPacket.header[3] = 0x10;
     TSPACKET_SETPID(nullPacket, 0x1fff);
 
-    for (i=0; i< packets; i ++)
+    for (i = instance->headerCount; i < instance->headerReserved; i ++)
+    {
+        AddData(instance, &nullPacket, TSPACKET_SIZE);
+    }
+}
+
+static void *WriterThread(void *arg)
+{
+    struct FileOutputInstance_t *instance = arg;
+    FileItem_t item;
+
+    while (TRUE)
     {
-        if (fwrite(&nullPacket, TSPACKET_SIZE, 1, instance->fp) != 1)
+        pthread_mutex_lock(&instance->mutex);
+        if ((instance->queueCount == 0) && !instance->quit)
         {
-            LogModule(LOG_INFO, FILEOUTPUT, "Failed to write all of null packet to start of file.\n");
+            Wait(instance);
+        }
+        if (instance->queueCount == 0)
+        {
+            bool quit = instance->quit;
+            pthread_mutex_unlock(&instance->mutex);
+            if (quit)
+            {
+                break;
+            }
+            /* The input may have stopped, so queue the block or start the
+             * next segment from here unless the calling thread is busy. With
+             * nothing queued every other buffer is free, so this never waits
+             * on itself. */
+            if (pthread_mutex_trylock(&instance->producerMutex) == 0)
+            {
+                CheckBlock(instance, time(NULL));
+                pthread_mutex_unlock(&instance->producerMutex);
+            }
+            continue;
+        }
+        item = instance->queue[instance->queueHead];
+        instance->queueHead = (instance->queueHead + 1) % QUEUE_SIZE;
+        instance->queueCount --;
+        pthread_cond_broadcast(&instance->cond);
+        pthread_mutex_unlock(&instance->mutex);
+
+        switch (item.type)
+        {
+            case FileItem_Data:
+                WriteData(instance, item.data, item.length);
+                pthread_mutex_lock(&instance->mutex);
+                instance->freeBuffers[instance->nrofFree] = item.data;
+                instance->nrofFree ++;
+                pthread_cond_broadcast(&instance->cond);
+                pthread_mutex_unlock(&instance->mutex);
+                break;
+            case FileItem_Header:
+                WriteHeader(instance, item.data, item.length);
+                free(item.data);
+                break;
+            case FileItem_NextSegment:
+                CloseSegment(instance);
+                OpenSegment(instance, item.length);
+                break;
         }
     }
+    CloseSegment(instance);
+    return NULL;
 }
 
-void FileSetHeader(struct DeliveryMethodInstance_t *this,
-                        TSPacket_t *packets, int count)
+/* Must be called with the mutex held. */
+static void Wait(struct FileOutputInstance_t *instance)
 {
-    struct FileOutputInstance_t *instance = (struct FileOutputInstance_t*)this;
-    fpos_t current;
-    fgetpos(instance->fp, &current);
+    struct timespec until;
+
+    clock_gettime(CLOCK_REALTIME, &until);
+    until.tv_sec += WAIT_TIMEOUT;
+    pthread_cond_timedwait(&instance->cond, &instance->mutex, &until);
+}
+
+static bool OpenSegment(struct FileOutputInstance_t *instance, int segment)
+{
+    int flags = O_WRONLY | O_CREAT;
+    char *name = instance->path;
+    struct stat st;
+
+    instance->writerSegment = segment;
+    instance->partName = NULL;
+    instance->finalName = NULL;
+    if (instance->segmentTime || instance->segmentSize)
+    {
+        instance->finalName = SegmentName(instance, segment);
+        instance->partName = malloc(strlen(instance->finalName) + 6);
+        if (instance->partName == NULL)
+        {
+            free(instance->finalName);
+            instance->finalName = NULL;
+            return FALSE;
+        }
+        sprintf(instance->partName, "%s.part", instance->finalName);
+        name = instance->partName;
+    }
+    if (!instance->append)
+    {
+        flags |= O_TRUNC;
+    }
+
+    instance->fdDirect = FALSE;
+#ifdef O_DIRECT
+    if (instance->direct)
+    {
+        instance->fd = open(name, flags | O_DIRECT, 0666);
+        if (instance->fd != -1)
+        {
+            instance->fdDirect = TRUE;
+        }
+        else if (errno == EINVAL)
+        {
+            LogModule(LOG_INFO, FILEOUTPUT, "O_DIRECT not supported for %s, using buffered writes.\n", name);
+            instance->fd = open(name, flags, 0666);
+        }
+    }
+    else
+#endif
+    {
+        instance->fd = open(name, flags, 0666);
+    }
+    if (instance->fd == -1)
+    {
+        LogModule(LOG_ERROR, FILEOUTPUT, "Failed to open %s: %s\n", name, strerror(errno));
+        return FALSE;
+    }
+
+    instance->base = 0;
+    if (instance->append && (fstat(instance->fd, &st) == 0))
+    {
+        instance->base = st.st_size;
+    }
+    instance->written = 0;
+    instance->allocated = 0;
+    instance->padded = FALSE;
+    return TRUE;
+}
+
+static void CloseSegment(struct FileOutputInstance_t *instance)
+{
+    if (instance->fd != -1)
+    {
+        /* Drop the padding of the last O_DIRECT write and any space
+         * preallocated past the end of the data. */
+        if (instance->padded || (instance->allocated > instance->written))
+        {
+            if (ftruncate(instance->fd, instance->base + instance->written))
+            {
+                LogModule(LOG_INFO, FILEOUTPUT, "Failed to truncate segment %d: %s\n",
+                    instance->writerSegment, strerror(errno));
+            }
+        }
+        close(instance->fd);
+        instance->fd = -1;
+        if (instance->partName && (rename(instance->partName, instance->finalName) == -1))
+        {
+            LogModule(LOG_ERROR, FILEOUTPUT, "Failed to rename %s to %s: %s\n",
+                instance->partName, instance->finalName, strerror(errno));
+        }
+    }
+    if (instance->partName)
+    {
+        free(instance->partName);
+        free(instance->finalName);
+        instance->partName = NULL;
+        instance->finalName = NULL;
+    }
+}
 
-    rewind(instance->fp);
+static void WriteData(struct FileOutputInstance_t *instance, uint8_t *data, unsigned int length)
+{
+    unsigned int toWrite = length;
+    ssize_t result;
 
-    if (fwrite(packets, TSPACKET_SIZE, count, instance->fp))
+    if (instance->fd == -1)
     {
-        LogModule(LOG_INFO, FILEOUTPUT, "Failed to write all of packet to file.\n");
+        return;
     }
 
-    fsetpos(instance->fp, &current);
+#ifdef HAVE_FALLOCATE
+    if (instance->preallocate && (instance->written + length > instance->allocated))
+    {
+        if (fallocate(instance->fd, FALLOC_FL_KEEP_SIZE, instance->base + instance->allocated,
+                      instance->preallocate) == -1)
+        {
+            LogModule(LOG_INFO, FILEOUTPUT, "Failed to preallocate space (%s), disabling.\n", strerror(errno));
+            instance->preallocate = 0;
+        }
+        else
+        {
+            instance->allocated += instance->preallocate;
+        }
+    }
+#endif
+
+    /* O_DIRECT writes must be a multiple of the alignment, the buffers are
+     * always big enough to pad the last one of a segment. */
+    if (instance->fdDirect && (length & (BLOCK_ALIGNMENT - 1)))
+    {
+        toWrite = (length + BLOCK_ALIGNMENT - 1) & ~(BLOCK_ALIGNMENT - 1);
+        memset(data + length, 0, toWrite - length);
+        instance->padded = TRUE;
+    }
+
+    result = pwrite(instance->fd, data, toWrite, instance->base + instance->written);
+    if (result != (ssize_t)toWrite)
+    {
+        LogModule(LOG_INFO, FILEOUTPUT, "Failed to write entire block to file! (%s)\n",
+            (result == -1) ? strerror(errno) : "short write");
+    }
+    instance->written += length;
+    instance->totalWritten += length;
+    instance->writes ++;
+}
+
+/*
+ * Rewrite the part of the header at the start of the segment that has already
+ * been written, the rest was updated before its block was queued.
+ */
+static void WriteHeader(struct FileOutputInstance_t *instance, uint8_t *data, unsigned int length)
+{
+    int flags = 0;
+
+    if (instance->fd == -1)
+    {
+        return;
+    }
+    if (length > instance->written)
+    {
+        length = instance->written;
+    }
+#ifdef O_DIRECT
+    if (instance->fdDirect)
+    {
+        flags = fcntl(instance->fd, F_GETFL);
+        fcntl(instance->fd, F_SETFL, flags & ~O_DIRECT);
+    }
+#endif
+    if (pwrite(instance->fd, data, length, instance->base) != (ssize_t)length)
+    {
+        LogModule(LOG_INFO, FILEOUTPUT, "Failed to write all of the header to the file.\n");
+    }
+#ifdef O_DIRECT
+    if (instance->fdDirect)
+    {
+        fcntl(instance->fd, F_SETFL, flags);
+    }
+#endif
 }
@@ -41,7 +41,7 @@ Plugin to allow manual filtering of PIDs.
 *******************************************************************************/
 #define FIND_MANUAL_FILTER(_name) \
     {\
-        TSFilterGroup_t *group = TSReaderFindFilterGroup(MainTSReaderGet(), (_name), ManualPIDFilterType);\
+        TSFilterGroup_t *group = FindManualFilterGroup(_name);\
         if (!group)\
         {\
             CommandError(COMMAND_ERROR_GENERIC, "Manual filter not found!");\
@@ -69,7 +69,8 @@ static void CommandSetOutputMRL(int argc, char **argv);
 static void CommandAddMFPID(int argc, char **argv);
 static void CommandRemoveMFPID(int argc, char **argv);
 static void CommandListMFPIDs(int argc, char **argv);
-static void OutputPacket(void *userArg, TSFilterGroup_t *group, TSPacket_t *packet);
+static void OutputPackets(void *userArg, TSFilterGroup_t *group, TSPacket_t **packets, int count);
+static TSFilterGroup_t *FindManualFilterGroup(char *name);
 static int ParsePID(char *argument);
 
 
@@ -89,13 +90,14 @@ static pthread_mutex_t manualFiltersMutex = PTHREAD_MUTEX_INITIALIZER;
 PLUGIN_COMMANDS(
     {
         "addmf",
-        2, 2,
+        2, 3,
         "Add a new destination for manually filtered PIDs.",
-        "addmf <filter name> <mrl>\n"
+        "addmf <filter name> <mrl> [adapter index]\n"
         "Adds a new destination for sending packets to. This is only used for "
         "manually filtered packets. "
         "To send packets to this destination you'll need to also call \'addmfpid\' "
-        "with this output as an argument.",
+        "with this output as an argument.\n"
+        "Packets are taken from the primary adapter unless an adapter index is given.",
         CommandAddMF
     },
     {
@@ -165,25 +167,29 @@ static void PluginInstall(bool installed)
 {
     if (!installed)
     {
-        TSReader_t *tsReader = MainTSReaderGet();
         ListIterator_t iterator;
         ManualFilter_t *filter;
+        int i;
 
         pthread_mutex_lock(&manualFiltersMutex);
-        for ( ListIterator_Init(iterator, tsReader->groups);
-              ListIterator_MoreEntries(iterator);
-              )
+        for (i = 0; i < MainAdapterCount(); i ++)
         {
-            TSFilterGroup_t *group = (TSFilterGroup_t *)ListIterator_Current(iterator);
-            if (strcmp(group->type, ManualPIDFilterType) == 0)
-            {
-                ListIterator_Next(iterator);
-                filter = group->userArg;
-                TSFilterGroupDestroy(filter->tsgroup);                
-            }
-            else
+            TSReader_t *tsReader = MainTSReaderGetByIndex(i);
+            for ( ListIterator_Init(iterator, tsReader->groups);
+                  ListIterator_MoreEntries(iterator);
+                  )
             {
-                ListIterator_Next(iterator);
+                TSFilterGroup_t *group = (TSFilterGroup_t *)ListIterator_Current(iterator);
+                if (strcmp(group->type, ManualPIDFilterType) == 0)
+                {
+                    ListIterator_Next(iterator);
+                    filter = group->userArg;
+                    TSFilterGroupDestroy(filter->tsgroup);                
+                }
+                else
+                {
+                    ListIterator_Next(iterator);
+                }
             }
         }
         pthread_mutex_unlock(&manualFiltersMutex);
@@ -202,7 +208,19 @@ static void CommandAddMF(int argc, char **argv)
 
     CommandCheckAuthenticated();
 
-    group = TSReaderFindFilterGroup(tsReader, argv[0], ManualPIDFilterType);
+    if (argc == 3)
+    {
+        char *end;
+        int index = (int)strtol(argv[2], &end, 10);
+        tsReader = (*end == 0) ? MainTSReaderGetByIndex(index) : NULL;
+        if (!tsReader)
+        {
+            CommandError(COMMAND_ERROR_GENERIC, "Unknown adapter index!");
+            return;
+        }
+    }
+
+    group = FindManualFilterGroup(argv[0]);
     if (group)
     {
         CommandError(COMMAND_ERROR_GENERIC, "A manual filter with this name exists!");
@@ -254,17 +272,29 @@ static void CommandRemoveMF(int argc, char **argv)
 
 static void CommandListMF(int argc, char **argv)
 {
-    TSReader_t *tsReader = MainTSReaderGet();
     ListIterator_t iterator;
+    int i;
     pthread_mutex_lock(&manualFiltersMutex);
-    for ( ListIterator_Init(iterator, tsReader->groups);
-          ListIterator_MoreEntries(iterator);
-          ListIterator_Next(iterator))
+    for (i = 0; i < MainAdapterCount(); i ++)
     {
-        TSFilterGroup_t *group = (TSFilterGroup_t *)ListIterator_Current(iterator);
-        if (strcmp(group->type, ManualPIDFilterType) == 0)
+        TSReader_t *tsReader = MainTSReaderGetByIndex(i);
+        for ( ListIterator_Init(iterator, tsReader->groups);
+              ListIterator_MoreEntries(iterator);
+              ListIterator_Next(iterator))
         {
-            CommandPrintf("%10s : %s\n", group->name,  DeliveryMethodGetMRL(group->userArg));
+            TSFilterGroup_t *group = (TSFilterGroup_t *)ListIterator_Current(iterator);
+            if (strcmp(group->type, ManualPIDFilterType) == 0)
+            {
+                ManualFilter_t *filter = group->userArg;
+                if (i == 0)
+                {
+                    CommandPrintf("%10s : %s\n", group->name,  DeliveryMethodGetMRL(filter->dmInstance));
+                }
+                else
+                {
+                    CommandPrintf("%10s : %s (adapter %d)\n", group->name,  DeliveryMethodGetMRL(filter->dmInstance), i);
+                }
+            }
         }
     }
     pthread_mutex_unlock(&manualFiltersMutex);
@@ -311,7 +341,7 @@ static void CommandAddMFPID(int argc, char **argv)
         return;
     }
     pthread_mutex_lock(&manualFiltersMutex);    
-    if (TSFilterGroupAddPacketFilter(filter->tsgroup, pid, OutputPacket, filter))
+    if (!TSFilterGroupAddPacketBatchFilter(filter->tsgroup, pid, OutputPackets, filter))
     {
         CommandError(COMMAND_ERROR_GENERIC,"No more available PID entries!");
     }
@@ -363,10 +393,22 @@ static void CommandListMFPIDs(int argc, char **argv)
 /*******************************************************************************
 * Helper Functions                                                             *
 *******************************************************************************/
-static void OutputPacket(void *userArg, TSFilterGroup_t *group, TSPacket_t *packet)
+static void OutputPackets(void *userArg, TSFilterGroup_t *group, TSPacket_t **packets, int count)
 {
     ManualFilter_t *filter = userArg;
-    DeliveryMethodOutputPacket(filter->dmInstance, packet);
+    DeliveryMethodOutputPackets(filter->dmInstance, packets, count);
+    DeliveryMethodFlush(filter->dmInstance);
+}
+
+static TSFilterGroup_t *FindManualFilterGroup(char *name)
+{
+    TSFilterGroup_t *group = NULL;
+    int i;
+    for (i = 0; (i < MainAdapterCount()) && !group; i ++)
+    {
+        group = TSReaderFindFilterGroup(MainTSReaderGetByIndex(i), name, ManualPIDFilterType);
+    }
+    return group;
 }
 
 static int ParsePID(char *argument)
@@ -72,6 +72,8 @@ static bool OutputsCanHandle(char *mrl);
 static DeliveryMethodInstance_t *OutputsCreate(char *arg);
 static void OutputsSendPacket(DeliveryMethodInstance_t *this, TSPacket_t *packet);
 static void OutputsSendBlock(DeliveryMethodInstance_t *this, void *block, unsigned long blockLen);
+static void OutputsSendPackets(DeliveryMethodInstance_t *this, TSPacket_t **packets, int count);
+static void OutputsFlush(DeliveryMethodInstance_t *this);
 static void OutputsDestroy(DeliveryMethodInstance_t *this);
 
 static void CommandAddOutput(int argc, char **argv);
@@ -93,7 +95,9 @@ DeliveryMethodInstanceOps_t OutputInstanceOps = {
     OutputsSendBlock,
     OutputsDestroy,
     NULL,
-    NULL
+    NULL,
+    OutputsSendPackets,
+    OutputsFlush
 };
 
 const char OUTPUTS[] = "Outputs";
@@ -229,6 +233,22 @@ static void OutputsSendBlock(DeliveryMethodInstance_t *this, void *block, unsign
     pthread_mutex_unlock(&outputsMutex);
 }
 
+static void OutputsSendPackets(DeliveryMethodInstance_t *this, TSPacket_t **packets, int count)
+{
+    OutputsState_t *state = (OutputsState_t *)this;
+    pthread_mutex_lock(&outputsMutex);
+    DeliveryMethodOutputPackets(state->output->dmInstance, packets, count);
+    pthread_mutex_unlock(&outputsMutex);
+}
+
+static void OutputsFlush(DeliveryMethodInstance_t *this)
+{
+    OutputsState_t *state = (OutputsState_t *)this;
+    pthread_mutex_lock(&outputsMutex);
+    DeliveryMethodFlush(state->output->dmInstance);
+    pthread_mutex_unlock(&outputsMutex);
+}
+
 /*******************************************************************************
 * Command functions                                                            *
 *******************************************************************************/
@@ -27,6 +27,7 @@ Pipe/Named Fifo Delivery Method handler.
 #include <fcntl.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
 #include "plugin.h"
@@ -34,6 +35,12 @@ Pipe/Named Fifo Delivery Method handler.
 #include "deliverymethod.h"
 #include "logging.h"
 
+/*******************************************************************************
+* Defines                                                                      *
+*******************************************************************************/
+/* Most packets passed to writev() at once, well below IOV_MAX. */
+#define MAX_PACKETS_PER_WRITE 256
+
 /*******************************************************************************
 * Typedefs                                                                     *
 *******************************************************************************/
@@ -56,6 +63,7 @@ bool PipeOutputCanHandle(char *mrl);
 DeliveryMethodInstance_t *PipeOutputCreate(char *arg);
 void PipeOutputSendPacket(DeliveryMethodInstance_t *this, TSPacket_t *packet);
 void PipeOutputSendBlock(DeliveryMethodInstance_t *this, void *block, unsigned long blockLen);
+void PipeOutputSendPackets(DeliveryMethodInstance_t *this, TSPacket_t **packets, int count);
 void PipeOutputDestroy(DeliveryMethodInstance_t *this);
 
 /*******************************************************************************
@@ -70,6 +78,7 @@ DeliveryMethodInstanceOps_t PipeInstanceOps ={
     PipeOutputDestroy,
     NULL,
     NULL,
+    PipeOutputSendPackets,
 };
 
 static const char PIPEOUTPUT[] = "PipeOutput";
@@ -84,7 +93,7 @@ PLUGIN_FEATURES(
 PLUGIN_INTERFACE_F(
     PLUGIN_FOR_ALL,
     "PipeOutput",
-    "0.1",
+    "0.2",
     "Pipe/Named fifo Delivery method.\nUse pipe://<file name>\n"
     "File name can be in absolute or relative.\n"
     "For an absolute file name use pipe:///home/user/mypipe.\n"
@@ -155,6 +164,31 @@ void PipeOutputSendBlock(DeliveryMethodInstance_t *this, void *block, unsigned l
     }
 }
 
+void PipeOutputSendPackets(DeliveryMethodInstance_t *this, TSPacket_t **packets, int count)
+{
+    struct PipeOutputInstance_t *instance = (struct PipeOutputInstance_t*)this;
+    struct iovec iov[MAX_PACKETS_PER_WRITE];
+    int i, n;
+
+    /* Write as many packets as possible with each call. */
+    while (count > 0)
+    {
+        n = (count > MAX_PACKETS_PER_WRITE) ? MAX_PACKETS_PER_WRITE : count;
+        for (i = 0; i < n; i ++)
+        {
+            iov[i].iov_base = packets[i];
+            iov[i].iov_len = sizeof(TSPacket_t);
+        }
+        if (writev(instance->fd, iov, n) != n * sizeof(TSPacket_t))
+        {
+            LogModule(LOG_INFO, PIPEOUTPUT, "Failed to write all packets to pipe!\n");
+            break;
+        }
+        packets += n;
+        count -= n;
+    }
+}
+
 void PipeOutputDestroy(DeliveryMethodInstance_t *this)
 {
     struct PipeOutputInstance_t *instance = (struct PipeOutputInstance_t*)this;
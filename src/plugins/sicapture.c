@@ -26,6 +26,7 @@ Plugin to capture only PSI/SI information to an MRL.
 #include <string.h>
 #include <stdint.h>
 #include <time.h>
+#include <pthread.h>
 
 #include "main.h"
 #include "plugin.h"
@@ -35,6 +36,7 @@ Plugin to capture only PSI/SI information to an MRL.
 #include "cache.h"
 #include "logging.h"
 #include "deliverymethod.h"
+#include "events.h"
 
 /*******************************************************************************
 * Defines                                                                      *
@@ -42,11 +44,17 @@ Plugin to capture only PSI/SI information to an MRL.
 #define MAX_EITS 128 /* Maximum number of EIT tables (PIDs) */
 #define MAX_ETTS 128 /* Maximum number of ETT tables (PIDs) */
 
+#define PID_BITMAP_WORDS (8192 / 32)
+#define SET_PID(_bitmap, _pid) ((_bitmap)[(_pid) >> 5] |= 1U << ((_pid) & 31))
+
 /*******************************************************************************
 * Prototypes                                                                   *
 *******************************************************************************/
+static void Install(bool installed);
 static void NewMGT(dvbpsi_atsc_mgt_t *newMGT);
 static void FilterPacket(void *arg, TSFilterGroup_t *group, TSPacket_t *packet);
+static void PIDsChanged(void *arg, Event_t event, void *payload);
+static void BuildPIDBitmap(void);
 
 static void CommandEnableSICapture(int argc, char **argv);
 static void CommandDisableSICapture(int argc, char **argv);
@@ -67,11 +75,23 @@ static uint16_t ExtendedTextTablePIDs[MAX_ETTS];
 
 static uint16_t channelETT = 0;
 
+/* PIDs to capture, one bit per PID. */
+static uint32_t PIDBitmap[PID_BITMAP_WORDS];
+static pthread_mutex_t bitmapMutex = PTHREAD_MUTEX_INITIALIZER;
+
+static const char *PIDEvents[] =
+{
+    "MPEG2.PAT",
+    "Cache.PIDsUpdated",
+    "Tuning.MultiplexChanged"
+};
+
 /*******************************************************************************
 * Plugin Setup                                                                 *
 *******************************************************************************/
 
 PLUGIN_FEATURES(
+    PLUGIN_FEATURE_INSTALL(Install),
     PLUGIN_FEATURE_MGTPROCESSOR(NewMGT)
     );
 
@@ -103,10 +123,31 @@ PLUGIN_INTERFACE_CF(
 /*******************************************************************************
 * Filter Functions                                                             *
 *******************************************************************************/
+static void Install(bool installed)
+{
+    int i;
+    for (i = 0; i < sizeof(PIDEvents) / sizeof(PIDEvents[0]); i ++)
+    {
+        Event_t event = EventsFindEvent(PIDEvents[i]);
+        if (installed)
+        {
+            EventsRegisterEventListener(event, PIDsChanged, NULL);
+        }
+        else
+        {
+            EventsUnregisterEventListener(event, PIDsChanged, NULL);
+        }
+    }
+    if (installed)
+    {
+        BuildPIDBitmap();
+    }
+}
 
 static void NewMGT(dvbpsi_atsc_mgt_t *newMGT)
 {
     dvbpsi_atsc_mgt_table_t * table;
+    pthread_mutex_lock(&bitmapMutex);
     EventInfoTableCount = 0;
     ExtendedTextTableCount = 0;
     channelETT = 0;
@@ -130,144 +171,126 @@ static void NewMGT(dvbpsi_atsc_mgt_t *newMGT)
             ExtendedTextTableCount ++;
         }
     }
+    pthread_mutex_unlock(&bitmapMutex);
+    BuildPIDBitmap();
 }
 
 static void FilterPacket(void *arg, TSFilterGroup_t *group, TSPacket_t *packet)
 {
-    int result = 0;
-    int i;
-    Multiplex_t *mux;
     uint16_t pid = TSPACKET_GETPID(*packet);
 
-    /* Handle PAT */
-    if (pid == 0)
+    if (PIDBitmap[pid >> 5] & (1U << (pid & 31)))
     {
-        result = 1;
+        /* Packets arrive one at a time, so there is no end of batch to wait for. */
+        DeliveryMethodOutputPacket(dmInstance, packet);
+        DeliveryMethodFlush(dmInstance);
     }
+}
 
-    /* Handle CAT */
-    if (pid == 1)
-    {
-        result = 1;
-    }
+static void PIDsChanged(void *arg, Event_t event, void *payload)
+{
+    BuildPIDBitmap();
+}
 
-    /* Handle PMTs */
-    if(result == 0)
+/*
+ * Work out which PIDs carry PSI/SI, called whenever the PMT PIDs or ATSC
+ * table PIDs change so that FilterPacket only has to test a bit.
+ */
+static void BuildPIDBitmap(void)
+{
+    uint32_t bitmap[PID_BITMAP_WORDS];
+    Multiplex_t *mux;
+    int i;
+
+    pthread_mutex_lock(&bitmapMutex);
+    memset(bitmap, 0, sizeof(bitmap));
+
+    /* PAT and CAT */
+    SET_PID(bitmap, 0x00);
+    SET_PID(bitmap, 0x01);
+
+    /* PMTs */
+    mux = TuningCurrentMultiplexGet();
+    if (mux)
     {
-        mux = TuningCurrentMultiplexGet();
-        if (mux)
-        {
-            int i;
-            int count;
-            Service_t **services;
+        int count;
+        Service_t **services;
 
-            services = CacheServicesGet(&count);
-            for (i = 0; i < count; i ++)
+        services = CacheServicesGet(CacheGet(0), &count);
+        for (i = 0; i < count; i ++)
+        {
+            /* Services not yet in the PAT use the stuffing PID. */
+            if (services[i]->pmtPID < 0x1fff)
             {
-                if (pid == services[i]->pmtPID)
-                {
-                    result =  1;
-                    break;
-                }
+                SET_PID(bitmap, services[i]->pmtPID);
             }
-            CacheServicesRelease();
-            MultiplexRefDec(mux);
         }
+        CacheServicesRelease(CacheGet(0));
+        MultiplexRefDec(mux);
     }
 
     /* Standard specific PIDs */
-    if (result == 0)
+    if (MainIsDVB())
     {
-        if (MainIsDVB())
+        SET_PID(bitmap, 0x10); /* NIT, ST*/
+        SET_PID(bitmap, 0x11); /* SDT, BAT, ST*/
+        SET_PID(bitmap, 0x12); /* EIT, ST, CIT */
+        SET_PID(bitmap, 0x13); /* RST, ST */
+        SET_PID(bitmap, 0x14); /* TDT, TOT, ST */
+        SET_PID(bitmap, 0x16); /* RNT */
+    }
+
+    if (MainIsATSC())
+    {
+        SET_PID(bitmap, 0x1ffb);
+        if (channelETT)
         {
-            switch(pid)
-            {
-                case 0x10: /* NIT, ST*/
-                case 0x11: /* SDT, BAT, ST*/
-                case 0x12: /* EIT, ST, CIT */
-                case 0x13: /* RST, ST */
-                case 0x14: /* TDT, TOT, ST */
-                case 0x16: /* RNT */
-                    result = 1;
-                    break;
-                default:
-                    break;
-            }
+            SET_PID(bitmap, channelETT);
         }
-        
-        if (MainIsATSC())
+        for (i = 0; i < EventInfoTableCount; i ++)
         {
-            if (pid == 0x1ffb)
-            {
-                result = 1;
-            }
-            else
-            {
-                if (channelETT && (channelETT == pid))
-                {
-                    result = 1;
-                }
-                if (result == 0)
-                {
-                    for (i = 0; i < EventInfoTableCount; i ++)
-                    {
-                        if (EventInfoTablePIDs[i] == pid)
-                        {
-                            result = 1;
-                            break;
-                        }
-                    }
-                }
-                if (result == 0)
-                {
-                    for (i = 0; i < ExtendedTextTableCount; i ++)
-                    {
-                        if (ExtendedTextTablePIDs[i] == pid)
-                        {
-                            result = 1;
-                            break;
-                        }
-                    }
-                }
-
-            }
+            SET_PID(bitmap, EventInfoTablePIDs[i]);
         }
-        
-        if (MainIsISDB())
+        for (i = 0; i < ExtendedTextTableCount; i ++)
         {
-            switch(pid)
-            {
-                case 0x10: /* NIT, ST*/
-                case 0x11: /* SDT, BAT, ST*/
-                case 0x12: /* EIT, ST, CIT */
-                case 0x13: /* RST, ST */
-                case 0x14: /* TDT, TOT, ST */
-                case 0x16: /* RNT */
-                case 0x17: /* DCT */
-                case 0x1e: /* DIT */
-                case 0x1f: /* SIT */
-                case 0x20: /* LIT */
-                case 0x21: /* ERT */
-                case 0x22: /* PCAT */
-                case 0x23: /* SDTT */
-                case 0x24: /* BIT */
-                case 0x25: /* NBIT, LDT */
-                case 0x26: /* EIT */
-                case 0x27: /* EIT */
-                case 0x28: /* SDTT */
-                case 0x29: /* CDT */
-                    result = 1;
-                    break;
-                default:
-                    break;
-            }
+            SET_PID(bitmap, ExtendedTextTablePIDs[i]);
         }
     }
-    if (result)
+
+    if (MainIsISDB())
     {
-        DeliveryMethodOutputPacket(dmInstance, packet);
+        SET_PID(bitmap, 0x10); /* NIT, ST*/
+        SET_PID(bitmap, 0x11); /* SDT, BAT, ST*/
+        SET_PID(bitmap, 0x12); /* EIT, ST, CIT */
+        SET_PID(bitmap, 0x13); /* RST, ST */
+        SET_PID(bitmap, 0x14); /* TDT, TOT, ST */
+        SET_PID(bitmap, 0x16); /* RNT */
+        SET_PID(bitmap, 0x17); /* DCT */
+        SET_PID(bitmap, 0x1e); /* DIT */
+        SET_PID(bitmap, 0x1f); /* SIT */
+        SET_PID(bitmap, 0x20); /* LIT */
+        SET_PID(bitmap, 0x21); /* ERT */
+        SET_PID(bitmap, 0x22); /* PCAT */
+        SET_PID(bitmap, 0x23); /* SDTT */
+        SET_PID(bitmap, 0x24); /* BIT */
+        SET_PID(bitmap, 0x25); /* NBIT, LDT */
+        SET_PID(bitmap, 0x26); /* EIT */
+        SET_PID(bitmap, 0x27); /* EIT */
+        SET_PID(bitmap, 0x28); /* SDTT */
+        SET_PID(bitmap, 0x29); /* CDT */
+    }
+
+    /*
+     * Copy a word at a time, a packet being filtered while this is going on
+     * sees either the old or the new state of each PID, either of which is fine.
+     */
+    for (i = 0; i < PID_BITMAP_WORDS; i ++)
+    {
+        PIDBitmap[i] = bitmap[i];
     }
+    pthread_mutex_unlock(&bitmapMutex);
 }
+
 /*******************************************************************************
 * Command Functions                                                            *
 *******************************************************************************/
@@ -283,6 +306,7 @@ static void CommandEnableSICapture(int argc, char **argv)
     dmInstance = DeliveryMethodCreate(argv[0]);
     if (dmInstance)
     {
+        BuildPIDBitmap();
         TSFilterGroupAddPacketFilter(tsgroup, TSREADER_PID_ALL, FilterPacket, NULL);
         CommandPrintf("SI Capture started (%s)\n", argv[0]);
         
@@ -297,7 +321,7 @@ static void CommandEnableSICapture(int argc, char **argv)
 
 static void CommandDisableSICapture(int argc, char **argv)
 {
-    if (tsgroup != NULL)
+    if (tsgroup == NULL)
     {
         CommandError(COMMAND_ERROR_GENERIC, "Not enabled!");
         return;
@@ -1,434 +1,313 @@
-/*
-Copyright (C) 2008  Steve VanDeBogart
-
-This program is free software; you can redistribute it and/or
-modify it under the terms of the GNU General Public License
-as published by the Free Software Foundation; either version 2
-of the License, or (at your option) any later version.
-
-This program is distributed in the hope that it will be useful,
-but WITHOUT ANY WARRANTY; without even the implied warranty of
-MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
-GNU General Public License for more details.
-
-You should have received a copy of the GNU General Public License
-along with this program; if not, write to the Free Software
-Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
-
-traffic.c
-
-Plugin to display PID traffic.
-
-*/
-#include <stdio.h>
-#include <stdlib.h>
-#include <sys/time.h>
-#include <time.h>
-#include <unistd.h>
-#include <string.h>
-
-#include "main.h"
-#include "plugin.h"
-#include "cache.h"
-#include "tuning.h"
-#include "list.h"
-
-/*******************************************************************************
-* Typedefs                                                                     *
-*******************************************************************************/
-typedef struct TrafficPIDCount_s {
-    uint16_t PID;
-    uint16_t count;
-    uint16_t oldCount;
-} TrafficPIDCount_t;
-
-#define PID_EOL ((1 << 16) - 1)
-
-/*******************************************************************************
-* Prototypes                                                                   *
-*******************************************************************************/
-static void InitFilter(PIDFilter_t *filter);
-static void DeinitFilter(PIDFilter_t *filter);
-
-static int FilterPacket(PIDFilter_t *pidfilter, void *arg, uint16_t pid, TSPacket_t *packet);
-static TSPacket_t* ProcessPacket(PIDFilter_t *pidfilter, void *arg, TSPacket_t *packet);
-static void HandleMuxChange(struct PIDFilter_s *pidfilter, void *userarg, Multiplex_t *multiplex);
-static void RotateData(void);
-static TrafficPIDCount_t * CopyPIDCounts(void);
-
-static void CommandTraffic(int argc, char **argv);
-
-/*******************************************************************************
-* Global variables                                                             *
-*******************************************************************************/
-static PluginFilter_t TrafficFilter = {NULL, InitFilter, DeinitFilter};
-
-static pthread_mutex_t TrafficMutex = PTHREAD_MUTEX_INITIALIZER;
-
-static List_t * PIDCounts = NULL;
-static int pidListLength = 0;
-static struct timeval currentStart;
-static struct timeval lastStart;
-static bool serviceLock;
-
-/*******************************************************************************
-* Plugin Setup                                                                 *
-*******************************************************************************/
-
-PLUGIN_FEATURES(
-    PLUGIN_FEATURE_FILTER(TrafficFilter)
-    );
-
-PLUGIN_COMMANDS(
-    {
-        "traffic",
-        0, 2,
-        "Display the packet rate for each PID in the TS",
-        "traffic [-s] [-i]\n"
-        "Display the packet rate for each PID in the TS.\n"
-        "Optionally, display known service association (-s) or information (-i).",
-        CommandTraffic
-    }
-    );
-
-PLUGIN_INTERFACE_CF(
-    PLUGIN_FOR_ALL,
-    "Traffic", "0.1",
-    "Plugin to display traffic on the current mux.",
-    "dvbstreamerplugin@nerdbox.net"
-    );
-/*******************************************************************************
-* Filter Functions                                                             *
-*******************************************************************************/
-static void InitFilter(PIDFilter_t *filter)
-{
-    filter->name = "Traffic Capture";
-
-    PIDFilterFilterPacketSet(filter, FilterPacket, NULL);
-    PIDFilterProcessPacketSet(filter, ProcessPacket, NULL);
-    PIDFilterMultiplexChangeSet(filter, HandleMuxChange, NULL);
-
-    pthread_mutex_lock(&TrafficMutex);
-
-    PIDCounts = ListCreate();
-    pidListLength = 0;
-    serviceLock = FALSE;
-    lastStart.tv_sec = currentStart.tv_sec = 0;
-    lastStart.tv_usec = currentStart.tv_usec = 0;
-
-    filter->enabled = TRUE;
-
-    pthread_mutex_unlock(&TrafficMutex);
-}
-
-static void DeinitFilter(PIDFilter_t *filter)
-{
-    filter->enabled = FALSE;
-
-    pthread_mutex_lock(&TrafficMutex);
-
-    ListFree(PIDCounts, free);
-    pidListLength = 0;
-    PIDCounts = NULL;
-
-    pthread_mutex_unlock(&TrafficMutex);
-}
-
-static void HandleMuxChange(struct PIDFilter_s *pidfilter, void *userarg, Multiplex_t *multiplex)
-{
-    pthread_mutex_lock(&TrafficMutex);
-
-    ListFree(PIDCounts, free);
-    PIDCounts = ListCreate();
-    pidListLength = 0;
-    serviceLock = FALSE;
-    lastStart.tv_sec = currentStart.tv_sec = 0;
-    lastStart.tv_usec = currentStart.tv_usec = 0;
-
-    pthread_mutex_unlock(&TrafficMutex);
-}
-
-static int FilterPacket(PIDFilter_t *pidfilter, void *arg, uint16_t pid, TSPacket_t *packet)
-{
-    // We're only interested in collecting data when there's a lock on a mux
-    if (serviceLock == FALSE)
-    {
-        DVBAdapter_t *adapter;
-        Service_t * service;
-
-        service = TuningCurrentServiceGet();
-        if (!service)
-        {
-            return 0;
-        }
-        ServiceRefDec(service);
-        adapter = MainDVBAdapterGet();
-        if (!adapter->frontEndLocked)
-        {
-            return 0;
-        }
-
-        serviceLock = TRUE;
-    }
-
-    return 1;
-}
-
-static TSPacket_t * ProcessPacket(PIDFilter_t *pidfilter, void *arg, TSPacket_t *packet)
-{
-    ListIterator_t iterator;
-    TrafficPIDCount_t * data = NULL;
-    uint16_t pid = TSPACKET_GETPID(*packet);
-
-    if (PIDCounts != NULL)
-    {
-        pthread_mutex_lock(&TrafficMutex);
-        RotateData();
-        for (ListIterator_Init(iterator, PIDCounts);
-                ListIterator_MoreEntries(iterator); ListIterator_Next(iterator))
-        {
-            data = (TrafficPIDCount_t *)ListIterator_Current(iterator);
-            if (data->PID >= pid)
-            {
-                break;
-            }
-        }
-        if (data && data->PID == pid)
-        {
-            data->count++;
-        }
-        else
-        {
-            data = calloc(1, sizeof(TrafficPIDCount_t));
-            if (data)
-            {
-                data->PID = pid;
-                data->count = 1;
-                data->oldCount = 0;
-                ListInsertBeforeCurrent(&iterator, data);
-                pidListLength++;
-            }
-        }
-        pthread_mutex_unlock(&TrafficMutex);
-    }
-    return NULL;
-}
-
-static void subtract_timeval(struct timeval a, struct timeval b,
-    struct timeval * result)
-{
-    result->tv_sec = a.tv_sec - b.tv_sec;
-    result->tv_usec = a.tv_usec - b.tv_usec;
-    if (result->tv_usec < 0) {
-        result->tv_sec--;
-        result->tv_usec += 1000000;
-    }
-}
-
-static void RotateData()
-{
-    ListIterator_t iterator;
-    TrafficPIDCount_t * data;
-    struct timeval tmp;
-    struct timeval now;
-
-    if (serviceLock == FALSE)
-    {
-        return;
-    }
-
-    gettimeofday(&now, 0);
-    if (currentStart.tv_sec == 0)
-    {
-        currentStart = now;
-        lastStart = now;
-    }
-
-    subtract_timeval(now, currentStart, &tmp);
-    if (tmp.tv_sec)
-    {
-        lastStart = currentStart;
-        currentStart = now;
-        for (ListIterator_Init(iterator, PIDCounts);
-                ListIterator_MoreEntries(iterator); )
-        {
-            data = (TrafficPIDCount_t *)ListIterator_Current(iterator);
-            if (data->count == 0 && data->oldCount == 0)
-            {
-                ListRemoveCurrent(&iterator);
-                pidListLength--;
-            }
-            else
-            {
-                data->oldCount = data->count;
-                data->count = 0;
-                ListIterator_Next(iterator);
-            }
-        }
-    }
-}
-
-static TrafficPIDCount_t * CopyPIDCounts(void)
-{
-    ListIterator_t iterator;
-    TrafficPIDCount_t * data;
-    int i;
-
-    data = calloc(pidListLength + 1, sizeof(TrafficPIDCount_t));
-    if (data == NULL)
-    {
-        return NULL;
-    }
-    for (i = 0, ListIterator_Init(iterator, PIDCounts);
-         i < pidListLength && ListIterator_MoreEntries(iterator);
-         i++, ListIterator_Next(iterator))
-    {
-        data[i] = *(TrafficPIDCount_t *)ListIterator_Current(iterator);
-    }
-    data[i].PID = PID_EOL;
-
-    return data;
-}
-
-/*******************************************************************************
-* Command Functions                                                            *
-*******************************************************************************/
-static void CommandTraffic(int argc, char **argv)
-{
-    bool printService = FALSE;
-    bool printServiceName = FALSE;
-    bool printServiceInfo = FALSE;
-    TrafficPIDCount_t * data;
-    Multiplex_t *multiplex = NULL;
-    int i;
-    uint64_t freq = 0;
-    uint64_t rate;
-
-    struct timeval tmp;
-    uint64_t time;
-    int timeout = 30; // Wait up to 6s, (30 * 200000 usec)
-
-    for (i = 0; i < argc; i++)
-    {
-        if (strcmp(argv[i], "-s") == 0)
-        {
-            printService = TRUE;
-            printServiceName = TRUE;
-        }
-        else if (strcmp(argv[i], "-i") == 0)
-        {
-            printService = TRUE;
-            printServiceInfo = TRUE;
-        }
-        else
-        {
-            CommandPrintf("Invalid argument\n");
-            return;
-        }
-    }
-
-    /* Ensure the database is up-to-date */
-    UpdateDatabase();
-
-    /* Wait until there's data available */
-    pthread_mutex_lock(&TrafficMutex);
-    if (lastStart.tv_sec == currentStart.tv_sec
-            && lastStart.tv_usec == currentStart.tv_usec)
-    {
-        RotateData();
-        while (timeout > 0 && lastStart.tv_sec == currentStart.tv_sec
-                && lastStart.tv_usec == currentStart.tv_usec)
-        {
-            pthread_mutex_unlock(&TrafficMutex);
-            if (timeout == 28)
-            {
-                CommandPrintf("...Waiting up to 6 seconds for data to arrive...\n");
-            }
-            usleep(200000);
-            pthread_mutex_lock(&TrafficMutex);
-            RotateData();
-            timeout--;
-        }
-    }
-    if (serviceLock == FALSE)
-    {
-        pthread_mutex_unlock(&TrafficMutex);
-        return;
-    }
-
-    /* Copy the data so that we don't printf on the critical path */
-    data = CopyPIDCounts();
-    pthread_mutex_unlock(&TrafficMutex);
-
-    CommandPrintf(" PID          Frequency Datarate%s\n",
-            printService ? "   Service" : "");
-    CommandPrintf("               (pkts/s) (kbit/s)\n");
-
-    subtract_timeval(currentStart, lastStart, &tmp);
-    time = tmp.tv_usec + tmp.tv_sec * 1000000;
-
-    if (data == NULL)
-    {
-        printService = FALSE;
-    }
-    if (printService)
-    {
-        multiplex = TuningCurrentMultiplexGet();
-    }
-    if (!multiplex) {
-        printService = FALSE;
-    }
-
-    for (i = 0; data[i].PID != PID_EOL; i++)
-    {
-        if (time != 0 && data[i].oldCount != 0)
-        {
-            freq = ((uint64_t)data[i].oldCount * 1000000)/time;
-            rate = (freq * 188 * 8)/1024;
-            if (printService)
-            {
-                char * name = "";
-                char * info = "";
-                Service_t *service;
-                void **ptr = (void*)&service;
-                List_t *list = ServiceListForPID(data[i].PID, multiplex);
-                if (list && (ListCount(list) > 0))
-                {
-                    ListGet(list, 0, ptr);
-                    if (printServiceName)
-                    {
-                        name = service->name;
-                    }
-                    if (printServiceInfo && data[i].PID == service->pmtPID)
-                    {
-                        info = " (PMT)";
-                    }
-                    if (printServiceInfo && data[i].PID == service->pcrPid)
-                    {
-                        info = " (PCR)";
-                    }
-                }
-                CommandPrintf("%4d (0x%04x)     %5lld    %5lld - %s%s\n",
-                    data[i].PID, data[i].PID, freq, rate, name, info);
-
-                if (list)
-                {
-                    ObjectListFree(list);
-                }
-            }
-            else
-            {
-                CommandPrintf("%4d (0x%04x)     %5lld    %5lld\n",
-                    data[i].PID, data[i].PID, freq, rate);
-            }
-        }
-    }
-
-    free(data);
-
-    if (printService)
-    {
-        MultiplexRefDec(multiplex);
-    }
-}
-
+/*
+Copyright (C) 2008  Steve VanDeBogart
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+
+traffic.c
+
+Plugin to display PID traffic.
+
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "main.h"
+#include "plugin.h"
+#include "cache.h"
+#include "pids.h"
+#include "ts.h"
+#include "properties.h"
+
+/*******************************************************************************
+* Defines                                                                      *
+*******************************************************************************/
+#define PROPERTIES_PATH "traffic"
+
+/* Convert packets per second to kbit/s */
+#define PACKETS_TO_KBITS(_packets) ((((unsigned long long)(_packets)) * TSPACKET_SIZE * 8) / 1000)
+
+/*******************************************************************************
+* Typedefs                                                                     *
+*******************************************************************************/
+typedef enum TrafficProperty_e
+{
+    TrafficProperty_Packets,
+    TrafficProperty_CCErrors,
+    TrafficProperty_Scrambled,
+    TrafficProperty_PCRs,
+    TrafficProperty_Rate1s,
+    TrafficProperty_Rate10s,
+    TrafficProperty_Rate60s
+}TrafficProperty_e;
+
+/*******************************************************************************
+* Prototypes                                                                   *
+*******************************************************************************/
+static void Install(bool installed);
+static int TrafficPropertyGet(void *userArg, PropertyValue_t *value);
+static Service_t **BuildServiceMap(const char **info);
+static void FreeServiceMap(Service_t **map);
+
+static void CommandTraffic(int argc, char **argv);
+
+/*******************************************************************************
+* Global variables                                                             *
+*******************************************************************************/
+static uint16_t propertyPID = 0;
+
+static const char *propertyNames[] = {
+    "packets",
+    "ccerrors",
+    "scrambled",
+    "pcrs",
+    "rate1s",
+    "rate10s",
+    "rate60s"
+};
+
+static const char *propertyDescs[] = {
+    "Number of packets received on the selected PID.",
+    "Number of continuity counter errors on the selected PID.",
+    "Number of packets with a scrambled payload on the selected PID.",
+    "Number of PCRs received on the selected PID.",
+    "Bit rate (in kbit/s) of the selected PID over the last second.",
+    "Bit rate (in kbit/s) of the selected PID over the last 10 seconds.",
+    "Bit rate (in kbit/s) of the selected PID over the last 60 seconds."
+};
+
+/*******************************************************************************
+* Plugin Setup                                                                 *
+*******************************************************************************/
+
+PLUGIN_FEATURES(
+    PLUGIN_FEATURE_INSTALL(Install)
+    );
+
+PLUGIN_COMMANDS(
+    {
+        "traffic",
+        0, 2,
+        "Display the packet rate for each PID in the TS",
+        "traffic [-s] [-i]\n"
+        "Display the packet and bit rates (over the last 1, 10 and 60 seconds),\n"
+        "continuity errors, scrambled packets and PCRs for each PID in the TS.\n"
+        "Optionally, display known service association (-s) or information (-i).",
+        CommandTraffic
+    }
+    );
+
+PLUGIN_INTERFACE_CF(
+    PLUGIN_FOR_ALL,
+    "Traffic", "0.2",
+    "Plugin to display traffic on the current mux.",
+    "dvbstreamerplugin@nerdbox.net"
+    );
+
+/*******************************************************************************
+* Plugin Functions                                                             *
+*******************************************************************************/
+static void Install(bool installed)
+{
+    TSReader_t *reader = MainTSReaderGet();
+    int i;
+
+    if (installed)
+    {
+        TSReaderPIDStatsEnable(reader, TRUE);
+        PropertiesAddProperty(NULL, PROPERTIES_PATH, "Per PID traffic statistics of the current mux", PropertyType_None, NULL, NULL, NULL);
+        PropertiesAddSimpleProperty(PROPERTIES_PATH, "pid", "PID the other traffic properties are for.",
+            PropertyType_PID, &propertyPID, SIMPLEPROPERTY_RW);
+        for (i = 0; i < sizeof(propertyNames) / sizeof(propertyNames[0]); i ++)
+        {
+            PropertiesAddProperty(PROPERTIES_PATH, propertyNames[i], propertyDescs[i],
+                PropertyType_Int, (void *)(long)i, TrafficPropertyGet, NULL);
+        }
+    }
+    else
+    {
+        PropertiesRemoveAllProperties(PROPERTIES_PATH);
+        TSReaderPIDStatsEnable(reader, FALSE);
+    }
+}
+
+static int TrafficPropertyGet(void *userArg, PropertyValue_t *value)
+{
+    TSReaderPIDStats_t stats;
+
+    if (!TSReaderPIDStatsGet(MainTSReaderGet(), propertyPID, &stats))
+    {
+        memset(&stats, 0, sizeof(stats));
+    }
+
+    switch ((TrafficProperty_e)(long)userArg)
+    {
+        case TrafficProperty_Packets:
+            value->u.integer = (int)stats.packets;
+            break;
+        case TrafficProperty_CCErrors:
+            value->u.integer = (int)stats.ccErrors;
+            break;
+        case TrafficProperty_Scrambled:
+            value->u.integer = (int)stats.scrambled;
+            break;
+        case TrafficProperty_PCRs:
+            value->u.integer = (int)stats.pcrs;
+            break;
+        case TrafficProperty_Rate1s:
+        case TrafficProperty_Rate10s:
+        case TrafficProperty_Rate60s:
+            value->u.integer = (int)PACKETS_TO_KBITS(stats.rates[(long)userArg - TrafficProperty_Rate1s]);
+            break;
+    }
+    return 0;
+}
+
+/*
+ * Work out which service each PID belongs to, the first service found using a
+ * PID wins.
+ */
+static Service_t **BuildServiceMap(const char **info)
+{
+    Service_t **map;
+    Service_t **services;
+    int count;
+    int i;
+
+    map = calloc(TS_MAX_PIDS, sizeof(Service_t *));
+    if (map == NULL)
+    {
+        return NULL;
+    }
+
+    services = CacheServicesGet(CacheGet(0), &count);
+    for (i = 0; i < count; i ++)
+    {
+        Service_t *service = services[i];
+        ProgramInfo_t *programInfo;
+
+        if ((service->pmtPID < TS_MAX_PIDS) && (map[service->pmtPID] == NULL))
+        {
+            ServiceRefInc(service);
+            map[service->pmtPID] = service;
+            info[service->pmtPID] = " (PMT)";
+        }
+
+        programInfo = CacheProgramInfoGet(CacheGet(0), service);
+        if (programInfo)
+        {
+            int s;
+            if ((programInfo->pcrPID < TS_MAX_PIDS) && (map[programInfo->pcrPID] == NULL))
+            {
+                ServiceRefInc(service);
+                map[programInfo->pcrPID] = service;
+                info[programInfo->pcrPID] = " (PCR)";
+            }
+            for (s = 0; s < programInfo->streamInfoList->nrofStreams; s ++)
+            {
+                int pid = programInfo->streamInfoList->streams[s].pid;
+                if ((pid < TS_MAX_PIDS) && (map[pid] == NULL))
+                {
+                    ServiceRefInc(service);
+                    map[pid] = service;
+                }
+            }
+            ObjectRefDec(programInfo);
+        }
+    }
+    CacheServicesRelease(CacheGet(0));
+    return map;
+}
+
+static void FreeServiceMap(Service_t **map)
+{
+    int i;
+    for (i = 0; i < TS_MAX_PIDS; i ++)
+    {
+        if (map[i])
+        {
+            ServiceRefDec(map[i]);
+        }
+    }
+    free(map);
+}
+
+/*******************************************************************************
+* Command Functions                                                            *
+*******************************************************************************/
+static void CommandTraffic(int argc, char **argv)
+{
+    bool printServiceName = FALSE;
+    bool printServiceInfo = FALSE;
+    Service_t **serviceMap = NULL;
+    const char **infoMap = NULL;
+    TSReader_t *reader = MainTSReaderGet();
+    TSReaderPIDStats_t stats;
+    int i;
+
+    for (i = 0; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-s") == 0)
+        {
+            printServiceName = TRUE;
+        }
+        else if (strcmp(argv[i], "-i") == 0)
+        {
+            printServiceInfo = TRUE;
+        }
+        else
+        {
+            CommandError(COMMAND_ERROR_GENERIC, "Invalid argument %s", argv[i]);
+            return;
+        }
+    }
+
+    if (printServiceName || printServiceInfo)
+    {
+        infoMap = calloc(TS_MAX_PIDS, sizeof(char *));
+        if (infoMap)
+        {
+            serviceMap = BuildServiceMap(infoMap);
+        }
+    }
+
+    CommandPrintf(" PID           Packet rate (pkts/s)    Bit rate (kbit/s)   CC errors  Scrambled       PCRs%s\n",
+        serviceMap ? "  Service" : "");
+    CommandPrintf("                  1s    10s    60s        1s   10s   60s\n");
+
+    for (i = 0; i < TS_MAX_PIDS; i ++)
+    {
+        if (!TSReaderPIDStatsGet(reader, i, &stats))
+        {
+            continue;
+        }
+        CommandPrintf("%4d (0x%04x) %6u %6u %6u    %5llu %5llu %5llu %11llu %10llu %10llu",
+            i, i, stats.rates[0], stats.rates[1], stats.rates[2],
+            PACKETS_TO_KBITS(stats.rates[0]), PACKETS_TO_KBITS(stats.rates[1]), PACKETS_TO_KBITS(stats.rates[2]),
+            stats.ccErrors, stats.scrambled, stats.pcrs);
+        if (serviceMap && serviceMap[i])
+        {
+            CommandPrintf("  %s%s", printServiceName ? serviceMap[i]->name : "",
+                (printServiceInfo && infoMap[i]) ? infoMap[i] : "");
+        }
+        CommandPrintf("\n");
+    }
+
+    if (serviceMap)
+    {
+        FreeServiceMap(serviceMap);
+    }
+    free(infoMap);
+}
@@ -29,6 +29,7 @@ Simplify UDP socket creation and packet sending.
 #include <string.h>
 #include <netdb.h>
 #include <errno.h>
+#include <netinet/udp.h>
 #include "main.h"
 #include "logging.h"
 #include "udp.h"
@@ -39,6 +40,18 @@ Simplify UDP socket creation and packet sending.
 
 #define PORT 54197 // 0xd3b5 ~= DVBS
 
+#ifndef SOL_UDP
+#define SOL_UDP IPPROTO_UDP
+#endif
+
+/*******************************************************************************
+* Prototypes                                                                   *
+*******************************************************************************/
+#ifdef UDP_SEGMENT
+static int UDPBatchSendGSO(UDPBatch_t *batch);
+#endif
+static void UDPBatchSendEach(UDPBatch_t *batch, int first);
+
 /*******************************************************************************
 * Global variables                                                             *
 *******************************************************************************/
@@ -106,3 +119,231 @@ int UDPCreateSocket(sa_family_t family)
 #endif
     return socketfd;
 }
+
+bool UDPBatchInit(UDPBatch_t *batch, int socket, struct sockaddr *address, socklen_t addressLen,
+                  int datagramSize, int depth, bool gso)
+{
+#ifdef HAVE_SENDMMSG
+    int i;
+#endif
+
+    memset(batch, 0, sizeof(UDPBatch_t));
+    batch->socket = socket;
+    batch->address = address;
+    batch->addressLen = addressLen;
+    batch->datagramSize = datagramSize;
+    batch->depth = depth;
+#ifdef UDP_SEGMENT
+    batch->gso = gso && (depth > 1);
+#endif
+    batch->buffer = malloc(depth * datagramSize);
+    if (batch->buffer == NULL)
+    {
+        return FALSE;
+    }
+#ifdef HAVE_SENDMMSG
+    batch->msgs = calloc(depth, sizeof(struct mmsghdr));
+    batch->iovs = calloc(depth, sizeof(struct iovec));
+    if ((batch->msgs == NULL) || (batch->iovs == NULL))
+    {
+        UDPBatchDeinit(batch);
+        return FALSE;
+    }
+    /* The datagrams never move, so the messages only need setting up once. */
+    for (i = 0; i < depth; i ++)
+    {
+        batch->iovs[i].iov_base = batch->buffer + (i * datagramSize);
+        batch->iovs[i].iov_len = datagramSize;
+        batch->msgs[i].msg_hdr.msg_name = address;
+        batch->msgs[i].msg_hdr.msg_namelen = addressLen;
+        batch->msgs[i].msg_hdr.msg_iov = &batch->iovs[i];
+        batch->msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+#endif
+    return TRUE;
+}
+
+void UDPBatchDeinit(UDPBatch_t *batch)
+{
+    free(batch->buffer);
+    free(batch->msgs);
+    free(batch->iovs);
+    batch->buffer = NULL;
+    batch->msgs = NULL;
+    batch->iovs = NULL;
+    batch->queued = 0;
+}
+
+void UDPBatchCommit(UDPBatch_t *batch)
+{
+    batch->queued ++;
+    if (batch->queued >= batch->depth)
+    {
+        UDPBatchFlush(batch);
+    }
+}
+
+void UDPBatchCommitShort(UDPBatch_t *batch, int length)
+{
+    batch->queued ++;
+    if (length < batch->datagramSize)
+    {
+        batch->lastLength = length;
+    }
+    UDPBatchFlush(batch);
+}
+
+void UDPBatchFlush(UDPBatch_t *batch)
+{
+    int sent = 0;
+
+    if (batch->queued == 0)
+    {
+        return;
+    }
+#ifdef UDP_SEGMENT
+    if (batch->gso && (batch->queued > 1))
+    {
+        sent = UDPBatchSendGSO(batch);
+    }
+#endif
+    UDPBatchSendEach(batch, sent);
+    batch->queued = 0;
+    batch->lastLength = 0;
+}
+
+/*******************************************************************************
+* Local Functions                                                              *
+*******************************************************************************/
+#ifdef UDP_SEGMENT
+/*
+ * Send as many of the queued datagrams as possible using GSO, returns the
+ * number sent. If the kernel or the outgoing device doesn't support GSO it is
+ * turned off and the remaining datagrams are left for UDPBatchSendEach().
+ */
+static int UDPBatchSendGSO(UDPBatch_t *batch)
+{
+    char control[CMSG_SPACE(sizeof(uint16_t))];
+    struct msghdr msg;
+    struct iovec iov;
+    struct cmsghdr *cmsg;
+    int maxSegments = UDP_GSO_MAX_BYTES / batch->datagramSize;
+    int sent = 0;
+
+    if (maxSegments > UDP_GSO_MAX_SEGMENTS)
+    {
+        maxSegments = UDP_GSO_MAX_SEGMENTS;
+    }
+
+    memset(&msg, 0, sizeof(msg));
+    memset(control, 0, sizeof(control));
+    msg.msg_name = batch->address;
+    msg.msg_namelen = batch->addressLen;
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_UDP;
+    cmsg->cmsg_type = UDP_SEGMENT;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+    *(uint16_t *)CMSG_DATA(cmsg) = batch->datagramSize;
+
+    while (sent < batch->queued)
+    {
+        int segments = batch->queued - sent;
+        if (segments > maxSegments)
+        {
+            segments = maxSegments;
+        }
+        iov.iov_base = batch->buffer + (sent * batch->datagramSize);
+        iov.iov_len = segments * batch->datagramSize;
+        /* The kernel allows the last segment to be short. */
+        if (batch->lastLength && (sent + segments == batch->queued))
+        {
+            iov.iov_len -= batch->datagramSize - batch->lastLength;
+        }
+        batch->syscalls ++;
+        if (sendmsg(batch->socket, &msg, 0) < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            if ((errno == EINVAL) || (errno == EIO) || (errno == ENOPROTOOPT) || (errno == EOPNOTSUPP))
+            {
+                LogModule(LOG_INFO, UDP, "UDP GSO not supported (%d: %s), sending datagrams individually\n", errno, strerror(errno));
+                batch->gso = FALSE;
+                break;
+            }
+            batch->drops += segments;
+        }
+        else
+        {
+            batch->datagrams += segments;
+        }
+        sent += segments;
+    }
+    return sent;
+}
+#endif
+
+/*
+ * Send the queued datagrams from first onwards, with sendmmsg() where
+ * available.
+ */
+static void UDPBatchSendEach(UDPBatch_t *batch, int first)
+{
+    int i = first;
+
+#ifdef HAVE_SENDMMSG
+    if (batch->queued - i > 1)
+    {
+        if (batch->lastLength)
+        {
+            batch->iovs[batch->queued - 1].iov_len = batch->lastLength;
+        }
+        while (i < batch->queued)
+        {
+            int result;
+            batch->syscalls ++;
+            result = sendmmsg(batch->socket, &batch->msgs[i], batch->queued - i, 0);
+            if (result < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                /* Only the first datagram failed, carry on with the rest. */
+                batch->drops ++;
+                i ++;
+            }
+            else
+            {
+                batch->datagrams += result;
+                i += result;
+            }
+        }
+        batch->iovs[batch->queued - 1].iov_len = batch->datagramSize;
+        return;
+    }
+#endif
+    for (; i < batch->queued; i ++)
+    {
+        int length = batch->datagramSize;
+        if (batch->lastLength && (i == batch->queued - 1))
+        {
+            length = batch->lastLength;
+        }
+        batch->syscalls ++;
+        if (UDPSendTo(batch->socket, (char *)batch->buffer + (i * batch->datagramSize),
+                      length, batch->address, batch->addressLen) < 0)
+        {
+            batch->drops ++;
+        }
+        else
+        {
+            batch->datagrams ++;
+        }
+    }
+}
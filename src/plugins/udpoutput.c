@@ -24,11 +24,14 @@ UDP Output Delivery Method handler.
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <fcntl.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <arpa/inet.h>
 #include <netdb.h>
 #include <sys/time.h>
+#include <time.h>
+#include <pthread.h>
 
 #include "plugin.h"
 #include "ts.h"
@@ -46,6 +49,55 @@ UDP Output Delivery Method handler.
 #define MAX_TS_PACKETS_PER_DATAGRAM ((MTU - (IP_HEADER+UDP_HEADER)) / sizeof(TSPacket_t))
 #define RTP_HEADER_SIZE 12
 
+/* RTP timestamps for MP2T use a 90kHz clock. */
+#define PCR_TICKS_PER_RTP_TICK (TSPACKET_PCR_HZ / 90000)
+
+/* Stream time (in PCR ticks) between RTCP sender reports. */
+#define RTCP_REPORT_INTERVAL (5 * (uint64_t)TSPACKET_PCR_HZ)
+
+/* RTCP packet types */
+#define RTCP_SR   200
+#define RTCP_SDES 202
+#define RTCP_BYE  203
+
+#define RTCP_SDES_CNAME 1
+
+/* Largest RTCP compound packet sent, a sender report, CNAME and BYE. */
+#define RTCP_MAX_SIZE (28 + 8 + 2 + 255 + 4 + 8)
+
+/* Seconds between 1900 (NTP) and 1970 (Unix) */
+#define NTP_EPOCH_OFFSET 2208988800UL
+
+/* Default and maximum number of datagrams queued before they are sent. */
+#define DEFAULT_BATCH 32
+#define MAX_BATCH     1024
+
+/* Number of datagrams the scheduler can hold waiting to be sent. */
+#define SCHEDULER_SLOTS 1024
+
+/* Default time (in seconds) paced output is allowed to run behind the input. */
+#define DEFAULT_PACE_DELAY 0.1
+
+/* Rate pacing sends slightly faster than the measured rate so it doesn't fall behind. */
+#define PACE_HEADROOM 1.02
+
+/* Interval (in seconds) the output bitrate is measured over for rate pacing. */
+#define RATE_INTERVAL 0.5
+
+/* Datagrams due within this time (in seconds) of each other are sent together. */
+#define SCHEDULER_TICK 0.0005
+
+/* Buffer the next datagram is built in when there is a scheduler. */
+#define SCHEDULER_NEXT(_state) \
+    ((_state)->scheduler->slots + \
+     ((((_state)->scheduler->head + (_state)->scheduler->count) % SCHEDULER_SLOTS) * (_state)->batch.datagramSize))
+
+/* PCRs wrap at 2^33 * 300 */
+#define PCR_WRAP ((1ULL << 33) * 300)
+
+/* Largest gap (in PCR ticks) between PCRs that isn't a discontinuity. */
+#define PCR_MAX_GAP (TSPACKET_PCR_HZ / 5)
+
 /* Default output targets if only host or port part is given */
 #define DEFAULT_HOST "localhost"
 #define DEFAULT_PORT "1234"
@@ -53,6 +105,66 @@ UDP Output Delivery Method handler.
 /*******************************************************************************
 * Typedefs                                                                     *
 *******************************************************************************/
+typedef enum PaceMode_e
+{
+    PaceMode_None = 0,  /* Send datagrams as soon as they are full. */
+    PaceMode_Rate,      /* Spread datagrams evenly at the measured bitrate. */
+    PaceMode_PCR        /* Send datagrams at the time given by the PCRs in them. */
+}PaceMode_e;
+
+typedef struct UDPOutputOptions_t
+{
+    int batch;
+    bool flushOnBatch;
+    bool gso;
+    PaceMode_e pace;
+    double latency;
+    double delay;
+}UDPOutputOptions_t;
+
+/* Follows the stream clock using the PCRs on the first PID seen carrying them,
+ * packets between PCRs are timed at the packet rate between the last two. */
+typedef struct PCRClock_t
+{
+    int pid;                    /* PID the PCRs are taken from, -1 until one is seen. */
+    uint64_t lastPCR;           /* Last PCR seen. */
+    unsigned int packets;       /* Packets since lastPCR. */
+    double ticksPerPacket;      /* 0 until two PCRs have been seen. */
+}PCRClock_t;
+
+/* Holds complete datagrams until they are due to be sent, and the datagram
+ * being filled if it has been waiting too long. */
+typedef struct Scheduler_t
+{
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    bool quit;
+    PaceMode_e pace;
+    double latency;             /* Longest time a packet may wait in a partial datagram, 0 for no limit. */
+    double delay;               /* Longest time paced output may run behind the input. */
+    uint8_t *slots;             /* SCHEDULER_SLOTS datagrams. */
+    double sendTimes[SCHEDULER_SLOTS];
+    int lengths[SCHEDULER_SLOTS];
+    bool timed[SCHEDULER_SLOTS];  /* Whether the stream time of each datagram is known. */
+    uint64_t pcrs[SCHEDULER_SLOTS]; /* Stream time of each datagram. */
+    int head;                   /* Slot of the oldest datagram waiting to be sent. */
+    int count;                  /* Number of datagrams waiting to be sent. */
+    double partialStart;        /* Time the first packet of the datagram being filled was queued. */
+    double lastSend;            /* Time the last datagram is due to be sent. */
+
+    double rate;                /* Measured output bitrate, 0 until measured. */
+    double rateStart;           /* Start of the current rate measurement. */
+    unsigned long long rateBytes; /* Bytes committed since rateStart. */
+
+    bool pcrBased;              /* Whether basePCR/baseTime are valid. */
+    uint64_t basePCR;           /* Stream time corresponding to baseTime. */
+    double baseTime;
+
+    unsigned long long drops;   /* Datagrams dropped because the scheduler was full. */
+    unsigned long long latencyFlushes; /* Partial datagrams sent because of the latency limit. */
+}Scheduler_t;
+
 struct UDPOutputState_t
 {
     /* !!! MUST BE THE FIRST FIELD IN THE STRUCTURE !!!
@@ -64,15 +176,38 @@ struct UDPOutputState_t
     socklen_t addressLen;
     struct sockaddr_storage address;
     SAPSessionHandle_t sapHandle;
+    UDPBatch_t batch;
+    bool flushOnBatch; /* Send queued datagrams at the end of each input batch, not just when the queue is full. */
+    int headerSize;    /* Bytes before the TS packets in each datagram (RTP header). */
     int datagramFullCount;
     int tsPacketCount;
     uint16_t sequence;
-    /* rtpHeader must always come before outputBuffer as the order is important
-       when sending RTP packets as rtpHeader is passed as the address of the
-       buffer to send!
-    */
-    uint8_t rtpHeader[RTP_HEADER_SIZE];
-    TSPacket_t outputBuffer[MAX_TS_PACKETS_PER_DATAGRAM];
+    Scheduler_t *scheduler; /* NULL unless pacing or a latency limit is used. */
+
+    bool clockUsed;         /* Whether the stream clock is followed, for RTP or PCR pacing. */
+    PCRClock_t clock;
+    bool datagramTimed;     /* Whether datagramPCR is valid. */
+    uint64_t datagramPCR;   /* Stream time of the first packet of the datagram being filled. */
+
+    /* RTP/RTCP */
+    uint32_t ssrc;
+    uint32_t timestampOffset; /* Random offset added to all timestamps. */
+    uint32_t timestamp;     /* Timestamp of the last datagram built. */
+    /* The fields below are only updated as datagrams are sent (by the
+     * scheduler thread when there is one), so sender reports describe what
+     * has actually gone out. */
+    uint32_t rtpPackets;    /* Datagrams sent, for sender reports. */
+    uint32_t rtpOctets;     /* Payload bytes sent, for sender reports. */
+    uint32_t sentTimestamp; /* Timestamp of the last datagram sent. */
+    int pendingPackets;     /* Datagrams handed to the batch but not yet sent. */
+    uint32_t pendingOctets; /* Payload bytes of those datagrams. */
+    uint32_t pendingTimestamp; /* Timestamp of the last of those datagrams. */
+    bool pendingTimed;      /* Whether pendingPCR is valid. */
+    uint64_t pendingPCR;    /* Stream time of the last timed one of those datagrams. */
+    bool reported;          /* Whether lastReportPCR is valid. */
+    uint64_t lastReportPCR; /* Stream time of the last sender report. */
+    struct sockaddr_storage rtcpAddress;
+    char cname[256];
 };
 
 /*******************************************************************************
@@ -84,14 +219,42 @@ static DeliveryMethodInstance_t *UDPOutputCreate(char *arg);
 static void UDPOutputSendPacket(DeliveryMethodInstance_t *this, TSPacket_t *packet);
 static void UDPOutputSendBlock(DeliveryMethodInstance_t *this, void *block, unsigned long blockLen);
 static void UDPOutputDestroy(DeliveryMethodInstance_t *this);
-static void RTPOutputSendPacket(DeliveryMethodInstance_t *this, TSPacket_t *packet);
-static void RTPHeaderInit(uint8_t *header, uint16_t sequence);
+static void UDPOutputSendPackets(DeliveryMethodInstance_t *this, TSPacket_t **packets, int count);
+static void UDPOutputFlush(DeliveryMethodInstance_t *this);
+static void QueuePacket(struct UDPOutputState_t *state, TSPacket_t *packet);
+static void CompleteDatagram(struct UDPOutputState_t *state, uint8_t *datagram);
+static void FlushBatch(struct UDPOutputState_t *state);
+static char *FindOptions(char *mrl);
+static bool ParseOptions(char *options, UDPOutputOptions_t *result);
+static bool SchedulerStart(struct UDPOutputState_t *state, UDPOutputOptions_t *options);
+static void SchedulerStop(struct UDPOutputState_t *state);
+static void *SchedulerThread(void *arg);
+static void SchedulerDatagramStarted(Scheduler_t *scheduler);
+static void SchedulerCommit(struct UDPOutputState_t *state, int length);
+static void SchedulerSend(struct UDPOutputState_t *state, int first, int count);
+static double SchedulerNow(void);
+static bool PCRClockPacket(PCRClock_t *clock, TSPacket_t *packet, uint64_t *pcr);
+static int64_t PCRDifference(uint64_t a, uint64_t b);
+static void RTPInit(struct UDPOutputState_t *state);
+static void RTPHeaderInit(struct UDPOutputState_t *state, uint8_t *header);
+static void RTPDatagramQueued(struct UDPOutputState_t *state, uint8_t *datagram, int length, bool timed, uint64_t pcr);
+static void RTPDatagramsSent(struct UDPOutputState_t *state);
+static void RTCPSend(struct UDPOutputState_t *state, bool bye);
+static uint32_t RTPRandom(void);
+static void Put32(uint8_t *buffer, uint32_t value);
+static uint32_t Get32(uint8_t *buffer);
 static void CreateSAPSession(struct UDPOutputState_t *state, bool rtp, unsigned char ttl, char *sessionName);
 
 
 /*******************************************************************************
 * Global variables                                                             *
 *******************************************************************************/
+static const char *PaceModeNames[] = {"none", "rate", "pcr"};
+
+static const char *optionNames[] = {
+    "batch", "delay", "flush", "gso", "latency", "pace"
+};
+
 /** Constants for the start of the MRL **/
 #define PREFIX_LEN (sizeof(UDPPrefix) - 1)
 const char UDPPrefix[] = "udp://";
@@ -102,15 +265,19 @@ DeliveryMethodInstanceOps_t UDPInstanceOps = {
     UDPOutputSendBlock,
     UDPOutputDestroy,
     NULL,
-    NULL
+    NULL,
+    UDPOutputSendPackets,
+    UDPOutputFlush
 };
 
 DeliveryMethodInstanceOps_t RTPInstanceOps = {
-    RTPOutputSendPacket,
+    UDPOutputSendPacket,
     NULL,
     UDPOutputDestroy,
     NULL,
-    NULL
+    NULL,
+    UDPOutputSendPackets,
+    UDPOutputFlush
 };
 
 const char UDPOUTPUT[] = "UDPOutput";
@@ -127,11 +294,18 @@ PLUGIN_FEATURES(
 PLUGIN_INTERFACE_F(
     PLUGIN_FOR_ALL,
     "UDPOutput",
-    "0.3",
+    "0.4",
     "UDP Delivery methods.\n"
-    "Use udp://[<host>:[<port>[:<ttl>[:session name]]]] for simple raw TS packets in a UDP datagram.\n"
-    "Use rtp://[<host>:[<port>[:<ttl>[:session name]]]] for RTP encapsulation.\n"
-    "Default host is localhost, default port is 1234",
+    "Use udp://[<host>:[<port>[:<ttl>[:session name]]]][,<options>] for simple raw TS packets in a UDP datagram.\n"
+    "Use rtp://[<host>:[<port>[:<ttl>[:session name]]]][,<options>] for RTP encapsulation.\n"
+    "Default host is localhost, default port is 1234\n"
+    "Options (comma separated):\n"
+    "    batch=<n>         Number of datagrams to queue and send together (default 32, 1 to send each as it is filled).\n"
+    "    flush=batch|full  Send queued datagrams at the end of each input batch (default) or only when the queue is full.\n"
+    "    gso=yes|no        Use UDP segmentation offload to send queued datagrams when the kernel supports it (default yes).\n"
+    "    latency=<ms>      Send a partly filled datagram once its first packet has waited this long (default 0, wait until full).\n"
+    "    pace=none|rate|pcr Spread datagrams out at the measured bitrate or at the times given by the PCRs (default none).\n"
+    "    delay=<ms>        How far paced output may run behind the input (default 100).",
     "charrea6@users.sourceforge.net"
 );
 
@@ -163,12 +337,28 @@ static DeliveryMethodInstance_t *UDPOutputCreate(char *arg)
     unsigned char ttl = 1;
     char hostbuffer[256];
     char portbuffer[6]; /* 65536\0 */
+    char sessionbuffer[256];
     char *sessionName= "DVBStreamer";
+    char *optionsStr;
+    UDPOutputOptions_t options;
     bool rtp;
     char *mrl = arg;
     hostbuffer[0] = 0;
     portbuffer[0] = 0;
 
+    /* Options follow the first comma that is followed by a known option */
+    options.batch = DEFAULT_BATCH;
+    options.flushOnBatch = TRUE;
+    options.gso = TRUE;
+    options.pace = PaceMode_None;
+    options.latency = 0.0;
+    options.delay = DEFAULT_PACE_DELAY;
+    optionsStr = FindOptions(mrl);
+    if (optionsStr && !ParseOptions(optionsStr + 1, &options))
+    {
+        return NULL;
+    }
+
     /*
      * Process the mrl
      */
@@ -197,7 +387,7 @@ static DeliveryMethodInstance_t *UDPOutputCreate(char *arg)
     else
     {
         LogModule(LOG_DEBUG, UDPOUTPUT, "IPv4 Address! %s\n", mrl);
-        for (i = 0;mrl[i] && (mrl[i] != ':'); i ++)
+        for (i = 0;mrl[i] && (mrl[i] != ':') && (mrl + i != optionsStr); i ++)
         {
             hostbuffer[i] = mrl[i];
         }
@@ -210,7 +400,7 @@ static DeliveryMethodInstance_t *UDPOutputCreate(char *arg)
         mrl ++;
         LogModule(LOG_DEBUG, UDPOUTPUT, "Port parameter detected! %s\n", mrl);
         /* Process port */
-        for (i = 0;mrl[i] && (mrl[i] != ':'); i ++)
+        for (i = 0;mrl[i] && (mrl[i] != ':') && (mrl + i != optionsStr) && (i < sizeof(portbuffer) - 1); i ++)
         {
             portbuffer[i] = mrl[i];
         }
@@ -224,10 +414,11 @@ static DeliveryMethodInstance_t *UDPOutputCreate(char *arg)
         mrl ++;
         LogModule(LOG_DEBUG, UDPOUTPUT, "TTL parameter detected! %s\n", mrl);
 
-        for (i = 0;mrl[i] && (mrl[i] != ':') && (i < 3); i ++)
+        for (i = 0;mrl[i] && (mrl[i] != ':') && (mrl + i != optionsStr) && (i < 3); i ++)
         {
             ttlbuffer[i] = mrl[i];
         }
+        ttlbuffer[i] = 0;
         /* process ttl */
         ttl = (unsigned char)atoi(ttlbuffer) & 255;
         mrl += i;
@@ -236,7 +427,12 @@ static DeliveryMethodInstance_t *UDPOutputCreate(char *arg)
     if (*mrl == ':')
     {
         mrl ++;
-        sessionName = mrl;
+        for (i = 0;mrl[i] && (mrl + i != optionsStr) && (i < sizeof(sessionbuffer) - 1); i ++)
+        {
+            sessionbuffer[i] = mrl[i];
+        }
+        sessionbuffer[i] = 0;
+        sessionName = sessionbuffer;
     }
 
     /*
@@ -261,6 +457,7 @@ static DeliveryMethodInstance_t *UDPOutputCreate(char *arg)
     if (rtp)
     {
         state->instance.ops = &RTPInstanceOps;
+        state->headerSize = RTP_HEADER_SIZE;
     }
     else
     {
@@ -318,6 +515,13 @@ static DeliveryMethodInstance_t *UDPOutputCreate(char *arg)
         return NULL;
     }
 
+    if (rtp)
+    {
+        RTPInit(state);
+    }
+    state->clockUsed = rtp || (options.pace == PaceMode_PCR);
+    state->clock.pid = -1;
+
     if (IsMulticastAddress(&state->address))
     {
         if (ttl > 1)
@@ -329,6 +533,35 @@ static DeliveryMethodInstance_t *UDPOutputCreate(char *arg)
     }
 
     state->datagramFullCount = MAX_TS_PACKETS_PER_DATAGRAM;
+    state->flushOnBatch = options.flushOnBatch;
+    if (!UDPBatchInit(&state->batch, state->socket, (struct sockaddr *)&state->address, state->addressLen,
+                      state->headerSize + (state->datagramFullCount * TSPACKET_SIZE), options.batch, options.gso))
+    {
+        LogModule(LOG_DEBUG, UDPOUTPUT,"Failed to allocate datagram queue\n");
+        UDPBatchDeinit(&state->batch);
+        if (state->sapHandle)
+        {
+            SAPServerDeleteSession(state->sapHandle);
+        }
+        close(state->socket);
+        free(state);
+        return NULL;
+    }
+    if (((options.pace != PaceMode_None) || (options.latency > 0.0)) && !SchedulerStart(state, &options))
+    {
+        LogModule(LOG_DEBUG, UDPOUTPUT,"Failed to start datagram scheduler\n");
+        UDPBatchDeinit(&state->batch);
+        if (state->sapHandle)
+        {
+            SAPServerDeleteSession(state->sapHandle);
+        }
+        close(state->socket);
+        free(state);
+        return NULL;
+    }
+    LogModule(LOG_DEBUG, UDPOUTPUT, "Queueing %d datagrams, flush %s, GSO %s, latency %.0fms, pacing %s\n", options.batch,
+        options.flushOnBatch ? "each batch" : "when full", state->batch.gso ? "on" : "off",
+        options.latency * 1000.0, PaceModeNames[options.pace]);
     state->instance.mrl = strdup(arg);
     return &state->instance;
 }
@@ -336,6 +569,18 @@ static DeliveryMethodInstance_t *UDPOutputCreate(char *arg)
 static void UDPOutputDestroy(DeliveryMethodInstance_t *this)
 {
     struct UDPOutputState_t *state = (struct UDPOutputState_t *)this;
+    if (state->scheduler)
+    {
+        SchedulerStop(state);
+    }
+    FlushBatch(state);
+    if (state->headerSize)
+    {
+        RTCPSend(state, TRUE);
+    }
+    LogModule(LOG_DEBUG, UDPOUTPUT, "%s: %llu datagrams sent in %llu calls, %llu dropped\n", this->mrl,
+        state->batch.datagrams, state->batch.syscalls, state->batch.drops);
+    UDPBatchDeinit(&state->batch);
     close(state->socket);
     if (state->sapHandle)
     {
@@ -348,64 +593,806 @@ static void UDPOutputDestroy(DeliveryMethodInstance_t *this)
 static void UDPOutputSendPacket(DeliveryMethodInstance_t *this, TSPacket_t *packet)
 {
     struct UDPOutputState_t *state = (struct UDPOutputState_t*)this;
-    state->outputBuffer[state->tsPacketCount++] = *packet;
-    if (state->tsPacketCount >= state->datagramFullCount)
+    if (state->scheduler)
     {
-        UDPSendTo(state->socket, (char*)state->outputBuffer,
-                  state->datagramFullCount * TSPACKET_SIZE,
-                  (struct sockaddr *)(&state->address), state->addressLen);
-        state->tsPacketCount = 0;
+        pthread_mutex_lock(&state->scheduler->mutex);
+        QueuePacket(state, packet);
+        pthread_mutex_unlock(&state->scheduler->mutex);
+    }
+    else
+    {
+        QueuePacket(state, packet);
     }
 }
 
 static void UDPOutputSendBlock(DeliveryMethodInstance_t *this, void *block, unsigned long blockLen)
 {
     struct UDPOutputState_t *state = (struct UDPOutputState_t*)this;
+    /* Keep the block in order with any datagrams already queued, when there
+     * is a scheduler the block goes out ahead of the datagrams it holds. */
+    if (state->scheduler == NULL)
+    {
+        FlushBatch(state);
+    }
     UDPSendTo(state->socket, (char*)block,
               blockLen,
               (struct sockaddr *)(&state->address), state->addressLen);
 }
 
-static void RTPOutputSendPacket(DeliveryMethodInstance_t *this, TSPacket_t *packet)
+static void UDPOutputSendPackets(DeliveryMethodInstance_t *this, TSPacket_t **packets, int count)
+{
+    struct UDPOutputState_t *state = (struct UDPOutputState_t*)this;
+    int i;
+    if (state->scheduler)
+    {
+        pthread_mutex_lock(&state->scheduler->mutex);
+    }
+    for (i = 0; i < count; i ++)
+    {
+        QueuePacket(state, packets[i]);
+    }
+    if (state->scheduler)
+    {
+        pthread_mutex_unlock(&state->scheduler->mutex);
+    }
+}
+
+static void UDPOutputFlush(DeliveryMethodInstance_t *this)
 {
     struct UDPOutputState_t *state = (struct UDPOutputState_t*)this;
-    state->outputBuffer[state->tsPacketCount++] = *packet;
+    /* The scheduler decides when its datagrams are sent. */
+    if (state->flushOnBatch && (state->scheduler == NULL))
+    {
+        FlushBatch(state);
+    }
+}
+
+/*
+ * Copy the packet into the datagram being built at the end of the queue, the
+ * datagram is only queued once it is full.
+ * When there is a scheduler this must be called with its mutex held.
+ */
+static void QueuePacket(struct UDPOutputState_t *state, TSPacket_t *packet)
+{
+    bool first = (state->tsPacketCount == 0);
+    uint8_t *datagram;
+
+    if (state->scheduler)
+    {
+        datagram = SCHEDULER_NEXT(state);
+        if (first)
+        {
+            SchedulerDatagramStarted(state->scheduler);
+        }
+    }
+    else
+    {
+        datagram = UDPBatchNext(&state->batch);
+    }
+
+    /* Every packet has to be seen to keep the clock interpolation right. */
+    if (state->clockUsed)
+    {
+        uint64_t pcr = 0;
+        bool timed = PCRClockPacket(&state->clock, packet, &pcr);
+        if (first)
+        {
+            state->datagramTimed = timed;
+            state->datagramPCR = pcr;
+        }
+    }
+
+    memcpy(datagram + state->headerSize + (state->tsPacketCount * TSPACKET_SIZE), packet, TSPACKET_SIZE);
+    state->tsPacketCount ++;
     if (state->tsPacketCount >= state->datagramFullCount)
     {
-        RTPHeaderInit(state->rtpHeader, state->sequence);
-        UDPSendTo(state->socket, (char*)state->rtpHeader,
-                  (state->datagramFullCount * TSPACKET_SIZE) + RTP_HEADER_SIZE,
-                  (struct sockaddr *)(&state->address), state->addressLen);
-        state->tsPacketCount = 0;
-        state->sequence ++;
+        CompleteDatagram(state, datagram);
     }
 }
 
-static void RTPHeaderInit(uint8_t *header, uint16_t sequence)
+/*
+ * Queue the datagram being built, which will only be partly full if the
+ * scheduler's latency limit has been reached.
+ */
+static void CompleteDatagram(struct UDPOutputState_t *state, uint8_t *datagram)
+{
+    int length = state->headerSize + (state->tsPacketCount * TSPACKET_SIZE);
+
+    if (state->headerSize)
+    {
+        RTPHeaderInit(state, datagram);
+    }
+    state->tsPacketCount = 0;
+    if (state->scheduler)
+    {
+        SchedulerCommit(state, length);
+    }
+    else
+    {
+        if (state->headerSize)
+        {
+            RTPDatagramQueued(state, datagram, length, state->datagramTimed, state->datagramPCR);
+        }
+        UDPBatchCommit(&state->batch);
+        /* The batch sends itself once it is full. */
+        if (state->headerSize && (state->batch.queued == 0))
+        {
+            RTPDatagramsSent(state);
+        }
+    }
+}
+
+/*
+ * Send the datagrams queued in the batch when there is no scheduler.
+ */
+static void FlushBatch(struct UDPOutputState_t *state)
+{
+    UDPBatchFlush(&state->batch);
+    if (state->headerSize)
+    {
+        RTPDatagramsSent(state);
+    }
+}
+
+/*
+ * Options follow the first comma that is followed by a known option name, so
+ * session names containing commas still work. Returns the comma or NULL if
+ * there are no options.
+ */
+static char *FindOptions(char *mrl)
+{
+    char *comma;
+    int i;
+
+    for (comma = strchr(mrl, ','); comma; comma = strchr(comma + 1, ','))
+    {
+        for (i = 0; i < sizeof(optionNames) / sizeof(optionNames[0]); i ++)
+        {
+            int len = strlen(optionNames[i]);
+            if ((strncmp(comma + 1, optionNames[i], len) == 0) && (comma[1 + len] == '='))
+            {
+                return comma;
+            }
+        }
+    }
+    return NULL;
+}
+
+static bool ParseOptions(char *options, UDPOutputOptions_t *result)
+{
+    char option[32];
+    int i;
+
+    while (*options)
+    {
+        char *value;
+        for (i = 0; options[i] && (options[i] != ',') && (i < sizeof(option) - 1); i ++)
+        {
+            option[i] = options[i];
+        }
+        option[i] = 0;
+        options += i;
+        if (*options == ',')
+        {
+            options ++;
+        }
+
+        value = strchr(option, '=');
+        if (value == NULL)
+        {
+            LogModule(LOG_ERROR, UDPOUTPUT, "Option \"%s\" has no value\n", option);
+            return FALSE;
+        }
+        *value = 0;
+        value ++;
+
+        if (strcmp(option, "batch") == 0)
+        {
+            result->batch = atoi(value);
+            if ((result->batch < 1) || (result->batch > MAX_BATCH))
+            {
+                LogModule(LOG_ERROR, UDPOUTPUT, "batch must be between 1 and %d\n", MAX_BATCH);
+                return FALSE;
+            }
+        }
+        else if (strcmp(option, "flush") == 0)
+        {
+            if (strcmp(value, "batch") == 0)
+            {
+                result->flushOnBatch = TRUE;
+            }
+            else if (strcmp(value, "full") == 0)
+            {
+                result->flushOnBatch = FALSE;
+            }
+            else
+            {
+                LogModule(LOG_ERROR, UDPOUTPUT, "flush must be batch or full\n");
+                return FALSE;
+            }
+        }
+        else if (strcmp(option, "gso") == 0)
+        {
+            result->gso = (strcmp(value, "yes") == 0) || (strcmp(value, "on") == 0) || (strcmp(value, "1") == 0);
+        }
+        else if (strcmp(option, "latency") == 0)
+        {
+            result->latency = atoi(value) / 1000.0;
+            if (result->latency < 0.0)
+            {
+                LogModule(LOG_ERROR, UDPOUTPUT, "latency must not be negative\n");
+                return FALSE;
+            }
+        }
+        else if (strcmp(option, "pace") == 0)
+        {
+            if (strcmp(value, "none") == 0)
+            {
+                result->pace = PaceMode_None;
+            }
+            else if (strcmp(value, "rate") == 0)
+            {
+                result->pace = PaceMode_Rate;
+            }
+            else if (strcmp(value, "pcr") == 0)
+            {
+                result->pace = PaceMode_PCR;
+            }
+            else
+            {
+                LogModule(LOG_ERROR, UDPOUTPUT, "pace must be none, rate or pcr\n");
+                return FALSE;
+            }
+        }
+        else if (strcmp(option, "delay") == 0)
+        {
+            result->delay = atoi(value) / 1000.0;
+            if (result->delay <= 0.0)
+            {
+                LogModule(LOG_ERROR, UDPOUTPUT, "delay must be greater than 0\n");
+                return FALSE;
+            }
+        }
+        else
+        {
+            LogModule(LOG_ERROR, UDPOUTPUT, "Unknown option \"%s\"\n", option);
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+/*******************************************************************************
+* Scheduler Functions                                                          *
+*******************************************************************************/
+static bool SchedulerStart(struct UDPOutputState_t *state, UDPOutputOptions_t *options)
+{
+    Scheduler_t *scheduler;
+    pthread_condattr_t condAttr;
+
+    scheduler = calloc(1, sizeof(Scheduler_t));
+    if (scheduler == NULL)
+    {
+        return FALSE;
+    }
+    scheduler->slots = malloc(SCHEDULER_SLOTS * state->batch.datagramSize);
+    if (scheduler->slots == NULL)
+    {
+        free(scheduler);
+        return FALSE;
+    }
+    scheduler->pace = options->pace;
+    scheduler->latency = options->latency;
+    scheduler->delay = options->delay;
+    scheduler->rateStart = SchedulerNow();
+
+    pthread_mutex_init(&scheduler->mutex, NULL);
+    pthread_condattr_init(&condAttr);
+    pthread_condattr_setclock(&condAttr, CLOCK_MONOTONIC);
+    pthread_cond_init(&scheduler->cond, &condAttr);
+    pthread_condattr_destroy(&condAttr);
+
+    state->scheduler = scheduler;
+    if (pthread_create(&scheduler->thread, NULL, SchedulerThread, state))
+    {
+        state->scheduler = NULL;
+        pthread_cond_destroy(&scheduler->cond);
+        pthread_mutex_destroy(&scheduler->mutex);
+        free(scheduler->slots);
+        free(scheduler);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+static void SchedulerStop(struct UDPOutputState_t *state)
+{
+    Scheduler_t *scheduler = state->scheduler;
+
+    pthread_mutex_lock(&scheduler->mutex);
+    scheduler->quit = TRUE;
+    pthread_cond_signal(&scheduler->cond);
+    pthread_mutex_unlock(&scheduler->mutex);
+    pthread_join(scheduler->thread, NULL);
+
+    /* Send anything still waiting straight away. */
+    while (scheduler->count > 0)
+    {
+        int due = scheduler->count;
+        if (scheduler->head + due > SCHEDULER_SLOTS)
+        {
+            due = SCHEDULER_SLOTS - scheduler->head;
+        }
+        SchedulerSend(state, scheduler->head, due);
+        scheduler->head = (scheduler->head + due) % SCHEDULER_SLOTS;
+        scheduler->count -= due;
+    }
+
+    LogModule(LOG_DEBUG, UDPOUTPUT, "%s: %llu datagrams dropped by the scheduler, %llu sent early to limit latency\n",
+        state->instance.mrl, scheduler->drops, scheduler->latencyFlushes);
+    state->scheduler = NULL;
+    pthread_cond_destroy(&scheduler->cond);
+    pthread_mutex_destroy(&scheduler->mutex);
+    free(scheduler->slots);
+    free(scheduler);
+}
+
+static void *SchedulerThread(void *arg)
+{
+    struct UDPOutputState_t *state = arg;
+    Scheduler_t *scheduler = state->scheduler;
+    struct timespec until;
+    double now, wake;
+    int due;
+
+    pthread_mutex_lock(&scheduler->mutex);
+    while (!scheduler->quit)
+    {
+        now = SchedulerNow();
+        if ((scheduler->latency > 0.0) && (state->tsPacketCount > 0) &&
+            (now >= scheduler->partialStart + scheduler->latency))
+        {
+            scheduler->latencyFlushes ++;
+            CompleteDatagram(state, SCHEDULER_NEXT(state));
+        }
+
+        /* Everything due in the next tick goes out together, up to the end of
+         * the slots so the datagrams are one after the other. */
+        for (due = 0; (due < scheduler->count) && (scheduler->head + due < SCHEDULER_SLOTS); due ++)
+        {
+            if (scheduler->sendTimes[scheduler->head + due] > now + SCHEDULER_TICK)
+            {
+                break;
+            }
+        }
+        if (due > 0)
+        {
+            int head = scheduler->head;
+            /* Queued slots are left alone by QueuePacket(), so they can be
+             * sent without holding the lock. */
+            pthread_mutex_unlock(&scheduler->mutex);
+            SchedulerSend(state, head, due);
+            pthread_mutex_lock(&scheduler->mutex);
+            scheduler->head = (head + due) % SCHEDULER_SLOTS;
+            scheduler->count -= due;
+            continue;
+        }
+
+        wake = 0.0;
+        if (scheduler->count > 0)
+        {
+            wake = scheduler->sendTimes[scheduler->head];
+        }
+        if ((scheduler->latency > 0.0) && (state->tsPacketCount > 0) &&
+            ((wake == 0.0) || (scheduler->partialStart + scheduler->latency < wake)))
+        {
+            wake = scheduler->partialStart + scheduler->latency;
+        }
+        if (wake == 0.0)
+        {
+            pthread_cond_wait(&scheduler->cond, &scheduler->mutex);
+        }
+        else
+        {
+            until.tv_sec = (time_t)wake;
+            until.tv_nsec = (long)((wake - until.tv_sec) * 1000000000.0);
+            pthread_cond_timedwait(&scheduler->cond, &scheduler->mutex, &until);
+        }
+    }
+    pthread_mutex_unlock(&scheduler->mutex);
+    return NULL;
+}
+
+/*
+ * Send count datagrams starting at slot first, which must not wrap around the
+ * end of the slots.
+ */
+static void SchedulerSend(struct UDPOutputState_t *state, int first, int count)
+{
+    Scheduler_t *scheduler = state->scheduler;
+    int datagramSize = state->batch.datagramSize;
+    int i;
+
+    for (i = first; i < first + count; i ++)
+    {
+        int length = scheduler->lengths[i];
+        uint8_t *datagram = scheduler->slots + (i * datagramSize);
+        if (state->headerSize)
+        {
+            RTPDatagramQueued(state, datagram, length, scheduler->timed[i], scheduler->pcrs[i]);
+        }
+        memcpy(UDPBatchNext(&state->batch), datagram, length);
+        if (length < datagramSize)
+        {
+            UDPBatchCommitShort(&state->batch, length);
+        }
+        else
+        {
+            UDPBatchCommit(&state->batch);
+        }
+    }
+    FlushBatch(state);
+}
+
+/*
+ * Called when the first packet is added to the datagram being built. Must be
+ * called with the mutex held.
+ */
+static void SchedulerDatagramStarted(Scheduler_t *scheduler)
+{
+    if (scheduler->latency > 0.0)
+    {
+        scheduler->partialStart = SchedulerNow();
+        pthread_cond_signal(&scheduler->cond);
+    }
+}
+
+/*
+ * Work out when the datagram just built should be sent and queue it. Must be
+ * called with the mutex held.
+ */
+static void SchedulerCommit(struct UDPOutputState_t *state, int length)
+{
+    Scheduler_t *scheduler = state->scheduler;
+    double now = SchedulerNow();
+    double sendTime = now;
+    int slot;
+
+    /* One slot is always kept free for the next datagram to be built in. */
+    if (scheduler->count >= SCHEDULER_SLOTS - 1)
+    {
+        scheduler->drops ++;
+        return;
+    }
+
+    switch (scheduler->pace)
+    {
+        case PaceMode_Rate:
+            scheduler->rateBytes += length;
+            if (now - scheduler->rateStart >= RATE_INTERVAL)
+            {
+                double sample = (scheduler->rateBytes * 8) / (now - scheduler->rateStart);
+                scheduler->rate = (scheduler->rate == 0.0) ? sample : ((scheduler->rate * 3.0) + sample) / 4.0;
+                scheduler->rateStart = now;
+                scheduler->rateBytes = 0;
+            }
+            if (scheduler->rate > 0.0)
+            {
+                double next = scheduler->lastSend + ((length * 8) / (scheduler->rate * PACE_HEADROOM));
+                if (next > now)
+                {
+                    sendTime = next;
+                }
+            }
+            /* Bursts above the measured rate can only be held back so far. */
+            if (sendTime > now + scheduler->delay)
+            {
+                sendTime = now + scheduler->delay;
+            }
+            break;
+
+        case PaceMode_PCR:
+            if (state->datagramTimed)
+            {
+                if (scheduler->pcrBased)
+                {
+                    sendTime = scheduler->baseTime +
+                        ((double)PCRDifference(state->datagramPCR, scheduler->basePCR) / TSPACKET_PCR_HZ);
+                }
+                /* Start again from this datagram if the stream clock has
+                 * jumped or drifted too far from ours. */
+                if (!scheduler->pcrBased ||
+                    (sendTime < now - scheduler->delay) || (sendTime > now + scheduler->delay))
+                {
+                    scheduler->pcrBased = TRUE;
+                    scheduler->basePCR = state->datagramPCR;
+                    scheduler->baseTime = now + (scheduler->delay / 2);
+                    sendTime = scheduler->baseTime;
+                }
+            }
+            break;
+
+        default:
+            break;
+    }
+
+    /* Never send a datagram ahead of the one before it. */
+    if (sendTime < scheduler->lastSend)
+    {
+        sendTime = scheduler->lastSend;
+    }
+    scheduler->lastSend = sendTime;
+
+    slot = (scheduler->head + scheduler->count) % SCHEDULER_SLOTS;
+    scheduler->sendTimes[slot] = sendTime;
+    scheduler->lengths[slot] = length;
+    scheduler->timed[slot] = state->datagramTimed;
+    scheduler->pcrs[slot] = state->datagramPCR;
+    scheduler->count ++;
+    if (scheduler->count == 1)
+    {
+        pthread_cond_signal(&scheduler->cond);
+    }
+}
+
+static double SchedulerNow(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + (ts.tv_nsec / 1000000000.0);
+}
+
+/*
+ * Update the clock with the next packet of the output, returns TRUE and the
+ * stream time of the packet in pcr if it is known.
+ */
+static bool PCRClockPacket(PCRClock_t *clock, TSPacket_t *packet, uint64_t *pcr)
+{
+    if (TSPACKET_HASPCR(*packet) &&
+        ((clock->pid == -1) || (clock->pid == TSPACKET_GETPID(*packet))))
+    {
+        uint64_t current = TSPACKET_GETPCR(*packet);
+        if (clock->pid == -1)
+        {
+            clock->pid = TSPACKET_GETPID(*packet);
+            LogModule(LOG_DEBUG, UDPOUTPUT, "Using PCRs on PID 0x%x\n", clock->pid);
+        }
+        else
+        {
+            int64_t gap = PCRDifference(current, clock->lastPCR);
+            if (TSPACKET_ISDISCONTINUITY(*packet) || (gap <= 0) || (gap > PCR_MAX_GAP))
+            {
+                clock->ticksPerPacket = 0.0;
+            }
+            else
+            {
+                clock->ticksPerPacket = (double)gap / (clock->packets + 1);
+            }
+        }
+        clock->lastPCR = current;
+        clock->packets = 0;
+        *pcr = current;
+        return TRUE;
+    }
+
+    if (clock->pid == -1)
+    {
+        return FALSE;
+    }
+    clock->packets ++;
+    if (clock->ticksPerPacket == 0.0)
+    {
+        return FALSE;
+    }
+    *pcr = (clock->lastPCR + (uint64_t)(clock->packets * clock->ticksPerPacket)) % PCR_WRAP;
+    return TRUE;
+}
+
+/* Difference between two PCRs allowing for wrap around. */
+static int64_t PCRDifference(uint64_t a, uint64_t b)
+{
+    int64_t diff = (int64_t)((a + PCR_WRAP - b) % PCR_WRAP);
+    if (diff > (int64_t)(PCR_WRAP / 2))
+    {
+        diff -= PCR_WRAP;
+    }
+    return diff;
+}
+
+/*
+ * Pick a random SSRC, initial sequence number and timestamp offset (as
+ * recommended by RFC 3550) and work out where RTCP packets go.
+ */
+static void RTPInit(struct UDPOutputState_t *state)
+{
+    char hostname[200];
+
+    state->ssrc = RTPRandom();
+    state->sequence = (uint16_t)RTPRandom();
+    state->timestampOffset = RTPRandom();
+    state->timestamp = state->timestampOffset;
+    state->sentTimestamp = state->timestampOffset;
+
+    /* RTCP goes to the next port up */
+    memcpy(&state->rtcpAddress, &state->address, state->addressLen);
+    if (state->rtcpAddress.ss_family == AF_INET)
+    {
+        struct sockaddr_in *inaddr = (struct sockaddr_in *) &state->rtcpAddress;
+        inaddr->sin_port = htons(ntohs(inaddr->sin_port) + 1);
+    }
+    else
+    {
+        struct sockaddr_in6 *in6addr = (struct sockaddr_in6 *) &state->rtcpAddress;
+        in6addr->sin6_port = htons(ntohs(in6addr->sin6_port) + 1);
+    }
+
+    hostname[0] = 0;
+    gethostname(hostname, sizeof(hostname) - 1);
+    hostname[sizeof(hostname) - 1] = 0;
+    snprintf(state->cname, sizeof(state->cname), "dvbstreamer@%s", hostname);
+    LogModule(LOG_DEBUG, UDPOUTPUT, "RTP SSRC 0x%08x CNAME %s\n", state->ssrc, state->cname);
+}
+
+static void RTPHeaderInit(struct UDPOutputState_t *state, uint8_t *header)
 {
-    uint32_t temp;
-    struct timeval tv;
-    gettimeofday(&tv,(struct timezone*) NULL);
     /* Flags and payload type */
     header[0] = (2 << 6); /* Version 2, No Padding, No Extensions, No CSRC count */
     header[1] = 33;       /* No Marker, Payload type MP2T */
 
     /* Sequence */
-    header[2] = (uint8_t) (sequence >> 8) & 0xff;
-    header[3] = (uint8_t) (sequence >> 0) & 0xff;
-
-    /* Time stamp */
-    temp = ((tv.tv_sec%1000000)*1000000 + tv.tv_usec)/11; /* approximately a 90Khz clock (1000000/90000 = 11.1111111...)*/
-    header[4] = (temp >> 24) & 0xff;
-    header[5] = (temp >> 16) & 0xff;
-    header[6] = (temp >>  8) & 0xff;
-    header[7] =  temp        & 0xff;
-
-    /* SSRC (Not implemented) */
-    header[8] = 0x0f;
-    header[9] = 0x0f;
-    header[10] = 0x0f;
-    header[11] = 0x0f;
+    header[2] = (uint8_t) (state->sequence >> 8) & 0xff;
+    header[3] = (uint8_t) (state->sequence >> 0) & 0xff;
+    state->sequence ++;
+
+    /* Time stamp, the stream time of the first packet in the datagram. Until
+     * the stream time is known (or after a discontinuity) the last timestamp
+     * is repeated. */
+    if (state->datagramTimed)
+    {
+        state->timestamp = (uint32_t)(state->datagramPCR / PCR_TICKS_PER_RTP_TICK) + state->timestampOffset;
+    }
+    Put32(header + 4, state->timestamp);
+
+    /* SSRC */
+    Put32(header + 8, state->ssrc);
+}
+
+/*
+ * Note an RTP datagram handed to the batch to be sent, timed and pcr give the
+ * stream time of its first packet.
+ */
+static void RTPDatagramQueued(struct UDPOutputState_t *state, uint8_t *datagram, int length, bool timed, uint64_t pcr)
+{
+    state->pendingPackets ++;
+    state->pendingOctets += length - state->headerSize;
+    state->pendingTimestamp = Get32(datagram + 4);
+    if (timed)
+    {
+        state->pendingTimed = TRUE;
+        state->pendingPCR = pcr;
+    }
+}
+
+/*
+ * Called once the datagrams noted by RTPDatagramQueued() have been sent, so
+ * a sender report pairs the time it is sent with the timestamp of the
+ * datagram that has just gone out (RFC 3550 6.4.1) and never overtakes
+ * datagrams that are still waiting to be sent.
+ */
+static void RTPDatagramsSent(struct UDPOutputState_t *state)
+{
+    if (state->pendingPackets == 0)
+    {
+        return;
+    }
+    state->rtpPackets += state->pendingPackets;
+    state->rtpOctets += state->pendingOctets;
+    state->sentTimestamp = state->pendingTimestamp;
+    state->pendingPackets = 0;
+    state->pendingOctets = 0;
+
+    /* Sender reports follow the stream clock, so there is no need to read
+     * the system clock for each datagram. */
+    if (state->pendingTimed &&
+        (!state->reported ||
+         (PCRDifference(state->pendingPCR, state->lastReportPCR) >= RTCP_REPORT_INTERVAL) ||
+         (PCRDifference(state->pendingPCR, state->lastReportPCR) < 0)))
+    {
+        state->reported = TRUE;
+        state->lastReportPCR = state->pendingPCR;
+        RTCPSend(state, FALSE);
+    }
+    state->pendingTimed = FALSE;
+}
+
+/*
+ * Send an RTCP compound packet of a sender report and our CNAME, followed by
+ * a BYE if bye is TRUE.
+ */
+static void RTCPSend(struct UDPOutputState_t *state, bool bye)
+{
+    uint8_t packet[RTCP_MAX_SIZE];
+    struct timeval tv;
+    int cnameLen = strlen(state->cname);
+    int sdesLen;
+    int len;
+
+    gettimeofday(&tv,(struct timezone*) NULL);
+
+    /* Sender report, no reception report blocks */
+    packet[0] = (2 << 6);
+    packet[1] = RTCP_SR;
+    packet[2] = 0;
+    packet[3] = 6; /* Length in 32bit words - 1 */
+    Put32(packet + 4, state->ssrc);
+    Put32(packet + 8, (uint32_t)tv.tv_sec + NTP_EPOCH_OFFSET);
+    Put32(packet + 12, (uint32_t)(((uint64_t)tv.tv_usec << 32) / 1000000));
+    Put32(packet + 16, state->sentTimestamp);
+    Put32(packet + 20, state->rtpPackets);
+    Put32(packet + 24, state->rtpOctets);
+    len = 28;
+
+    /* Source description, one chunk with the CNAME. The item list ends with
+     * at least one null octet and is padded to a 32bit boundary. */
+    sdesLen = (8 + 2 + cnameLen + 4) & ~3;
+    memset(packet + len, 0, sdesLen);
+    packet[len] = (2 << 6) | 1;
+    packet[len + 1] = RTCP_SDES;
+    packet[len + 2] = 0;
+    packet[len + 3] = (sdesLen / 4) - 1;
+    Put32(packet + len + 4, state->ssrc);
+    packet[len + 8] = RTCP_SDES_CNAME;
+    packet[len + 9] = cnameLen;
+    memcpy(packet + len + 10, state->cname, cnameLen);
+    len += sdesLen;
+
+    if (bye)
+    {
+        packet[len] = (2 << 6) | 1;
+        packet[len + 1] = RTCP_BYE;
+        packet[len + 2] = 0;
+        packet[len + 3] = 1;
+        Put32(packet + len + 4, state->ssrc);
+        len += 8;
+    }
+
+    UDPSendTo(state->socket, (char*)packet, len,
+              (struct sockaddr *)(&state->rtcpAddress), state->addressLen);
+}
+
+static uint32_t RTPRandom(void)
+{
+    uint32_t value = 0;
+    int fd = open("/dev/urandom", O_RDONLY);
+
+    if ((fd == -1) || (read(fd, &value, sizeof(value)) != sizeof(value)))
+    {
+        /* Fall back to something that differs between outputs and runs. */
+        static uint32_t counter = 0;
+        struct timeval tv;
+        gettimeofday(&tv,(struct timezone*) NULL);
+        value = ((uint32_t)tv.tv_usec * 2654435761U) ^ ((uint32_t)tv.tv_sec << 12) ^
+                ((uint32_t)getpid() << 16) ^ (counter++ * 40503U);
+    }
+    if (fd != -1)
+    {
+        close(fd);
+    }
+    return value;
+}
+
+static void Put32(uint8_t *buffer, uint32_t value)
+{
+    buffer[0] = (value >> 24) & 0xff;
+    buffer[1] = (value >> 16) & 0xff;
+    buffer[2] = (value >>  8) & 0xff;
+    buffer[3] =  value        & 0xff;
+}
+
+static uint32_t Get32(uint8_t *buffer)
+{
+    return ((uint32_t)buffer[0] << 24) | ((uint32_t)buffer[1] << 16) |
+           ((uint32_t)buffer[2] << 8) | buffer[3];
 }
 
 static void CreateSAPSession(struct UDPOutputState_t *state, bool rtp, unsigned char ttl, char *sessionName)
@@ -0,0 +1,206 @@
+/*
+Copyright (C) 2006  Adam Charrett
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+
+sectioncache.c
+
+Cache of the PSI/SI sections already seen on a PID, used to drop repeats.
+
+*/
+#include "config.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "logging.h"
+#include "sectioncache.h"
+
+/*******************************************************************************
+* Defines                                                                      *
+*******************************************************************************/
+#define SECTION_KEY(_section) \
+    (((_section)->i_table_id << 24) | ((_section)->i_extension << 8) | (_section)->i_number)
+
+/*******************************************************************************
+* Prototypes                                                                   *
+*******************************************************************************/
+static unsigned int Hash(uint32_t key, unsigned int bits);
+static SectionCacheEntry_t *FindEntry(SectionCacheEntry_t *entries, unsigned int bits, uint32_t key);
+static bool Grow(SectionCache_t *cache);
+
+/*******************************************************************************
+* Global variables                                                             *
+*******************************************************************************/
+static char SECTIONCACHE[] = "SectionCache";
+
+/*******************************************************************************
+* Global functions                                                             *
+*******************************************************************************/
+void SectionCacheInit(SectionCache_t *cache, unsigned int maxSize)
+{
+    memset(cache, 0, sizeof(SectionCache_t));
+    cache->maxSize = maxSize;
+}
+
+void SectionCacheDeinit(SectionCache_t *cache)
+{
+    if (cache->entries)
+    {
+        free(cache->entries);
+        cache->entries = NULL;
+    }
+    cache->bits = 0;
+    cache->count = 0;
+}
+
+bool SectionCacheCheck(SectionCache_t *cache, dvbpsi_psi_section_t *section)
+{
+    SectionCacheEntry_t *entry;
+    uint32_t key;
+    uint32_t crc;
+
+    /*
+     * Only sections with the long header have a version and a CRC to go by.
+     * DSM-CC sections (0x38-0x3f) are always passed on, the carousel code
+     * relies on repeats to pick up blocks it could not place the first time.
+     */
+    if (!section->b_syntax_indicator ||
+        ((section->i_table_id >= 0x38) && (section->i_table_id <= 0x3f)))
+    {
+        cache->misses ++;
+        return TRUE;
+    }
+
+    /* Keep at most half the entries in use so probe sequences stay short. */
+    if (((cache->count + 1) * 2 > (1U << cache->bits)) && !Grow(cache) && (cache->entries == NULL))
+    {
+        cache->misses ++;
+        return TRUE;
+    }
+
+    key = SECTION_KEY(section);
+    crc = (section->p_payload_end[0] << 24) | (section->p_payload_end[1] << 16) |
+          (section->p_payload_end[2] << 8) | section->p_payload_end[3];
+    entry = FindEntry(cache->entries, cache->bits, key);
+
+    if (entry->valid)
+    {
+        if ((entry->crc == crc) && (entry->version == section->i_version))
+        {
+            cache->hits ++;
+            return FALSE;
+        }
+    }
+    else if ((cache->count + 1) * 2 > (1U << cache->bits))
+    {
+        /* The cache could not grow, replace the entry the section hashes to
+         * rather than let the probe sequences get longer. If that is free
+         * using it would fill the hash further, so the section is not kept. */
+        entry = &cache->entries[Hash(key, cache->bits)];
+        if (!entry->valid)
+        {
+            cache->misses ++;
+            return TRUE;
+        }
+        cache->replaced ++;
+    }
+    else
+    {
+        cache->count ++;
+    }
+
+    entry->valid = TRUE;
+    entry->key = key;
+    entry->crc = crc;
+    entry->version = section->i_version;
+    cache->misses ++;
+    return TRUE;
+}
+
+void SectionCacheFlush(SectionCache_t *cache)
+{
+    if (cache->entries)
+    {
+        memset(cache->entries, 0, sizeof(SectionCacheEntry_t) << cache->bits);
+    }
+    cache->count = 0;
+    cache->flushes ++;
+}
+
+/*******************************************************************************
+* Local Functions                                                              *
+*******************************************************************************/
+static unsigned int Hash(uint32_t key, unsigned int bits)
+{
+    return (key * 0x9e3779b1U) >> (32 - bits);
+}
+
+/*
+ * Find the entry for key, or the free entry it would go in. The hash is never
+ * more than half full so there is always a free entry.
+ */
+static SectionCacheEntry_t *FindEntry(SectionCacheEntry_t *entries, unsigned int bits, uint32_t key)
+{
+    unsigned int mask = (1U << bits) - 1;
+    unsigned int i;
+
+    for (i = Hash(key, bits); entries[i].valid && (entries[i].key != key); i = (i + 1) & mask);
+    return &entries[i];
+}
+
+/*
+ * Double the size of the hash, returns FALSE if it is already as large as
+ * allowed or memory could not be allocated.
+ */
+static bool Grow(SectionCache_t *cache)
+{
+    unsigned int bits = cache->bits ? cache->bits + 1 : 0;
+    SectionCacheEntry_t *entries;
+    unsigned int i;
+
+    if (bits == 0)
+    {
+        while ((1U << bits) < SECTIONCACHE_INITIAL_SIZE)
+        {
+            bits ++;
+        }
+    }
+    if ((1U << bits) > cache->maxSize)
+    {
+        return FALSE;
+    }
+
+    entries = calloc(1U << bits, sizeof(SectionCacheEntry_t));
+    if (entries == NULL)
+    {
+        LogModule(LOG_ERROR, SECTIONCACHE, "Failed to grow the cache to %u entries\n", 1U << bits);
+        return FALSE;
+    }
+    if (cache->entries)
+    {
+        for (i = 0; i < (1U << cache->bits); i ++)
+        {
+            if (cache->entries[i].valid)
+            {
+                *FindEntry(entries, bits, cache->entries[i].key) = cache->entries[i];
+            }
+        }
+        free(cache->entries);
+    }
+    cache->entries = entries;
+    cache->bits = bits;
+    return TRUE;
+}
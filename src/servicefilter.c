@@ -64,6 +64,7 @@ struct ServiceFilter_s
 {
     char            *name;
     TSFilterGroup_t *tsgroup;
+    Cache_t        *cache;
     char            propertyPath[PROPERTIES_PATH_MAX];
     DeliveryMethodInstance_t *dmInstance;
     Service_t      *service;
@@ -100,6 +101,7 @@ struct ServiceFilter_s
 static void ServiceFilterFilterEventCallback(void *userArg, TSFilterGroup_t *group, TSFilterEventType_e event, void *details);
 static void ServiceFilterPIDSUpdatedListener(void *userArg, Event_t event, void *details);
 static void ServiceFilterProcessPacket(void *arg, TSFilterGroup_t *group, TSPacket_t *packet);
+static void ServiceFilterProcessPackets(void *arg, TSFilterGroup_t *group, TSPacket_t **packets, int count);
 static void ServiceFilterPATRewrite(ServiceFilter_t filter);
 static void ServiceFilterPMTRewrite(ServiceFilter_t filter);
 static void ServiceFilterInitPacket(TSPacket_t *packet, dvbpsi_psi_section_t* section, char *sectionname);
@@ -150,12 +152,12 @@ int ServiceFilterDeInit(void)
 ServiceFilter_t ServiceFilterCreate(TSReader_t *reader, char* name)
 {
     ServiceFilter_t result;
-    Event_t cachePIDSUpdatedEvent;
 
     result = ObjectCreateType(ServiceFilter_t);
     if (result)
     {
         result->name = strdup(name);
+        result->cache = CacheGet(DVBAdapterIndexGet(reader->adapter));
         result->tsgroup = TSReaderCreateFilterGroup(reader, name, ServiceFilterGroupType, ServiceFilterFilterEventCallback, result);
 
         sprintf(result->propertyPath, "filters.service.%s", name);
@@ -165,8 +167,7 @@ ServiceFilter_t ServiceFilterCreate(TSReader_t *reader, char* name)
         PropertiesAddProperty(result->propertyPath, "avsonly", "Whether only the first Audio/Video/Subtitle streams should be filtered.", 
             PropertyType_Boolean, result, ServiceFilterPropertyAVSOnlyGet, ServiceFilterPropertyAVSOnlySet);
 
-        cachePIDSUpdatedEvent = EventsFindEvent("Cache.PIDsUpdated");
-        EventsRegisterEventListener(cachePIDSUpdatedEvent, ServiceFilterPIDSUpdatedListener, result);
+        EventsRegisterEventListener(CachePIDsUpdatedEventGet(result->cache), ServiceFilterPIDSUpdatedListener, result);
         ListAdd(ServiceFilterList, result);
         EventsFireEventListeners(filterAddedEvent, result);
     }
@@ -175,12 +176,9 @@ ServiceFilter_t ServiceFilterCreate(TSReader_t *reader, char* name)
 
 void ServiceFilterDestroy(ServiceFilter_t filter)
 {
-    Event_t cachePIDSUpdatedEvent;
-
     EventsFireEventListeners(filterRemovedEvent, filter);    
 
-    cachePIDSUpdatedEvent = EventsFindEvent("Cache.PIDsUpdated");    
-    EventsUnregisterEventListener(cachePIDSUpdatedEvent, ServiceFilterPIDSUpdatedListener, filter);
+    EventsUnregisterEventListener(CachePIDsUpdatedEventGet(filter->cache), ServiceFilterPIDSUpdatedListener, filter);
     
     PropertiesRemoveAllProperties(filter->propertyPath);
     TSFilterGroupDestroy(filter->tsgroup);
@@ -210,7 +208,10 @@ void ServiceFilterDestroyAll(TSReader_t *reader)
     {
         ServiceFilter_t filter = (ServiceFilter_t)ListIterator_Current(iterator);
         ListIterator_Next(iterator);
-        ServiceFilterDestroy(filter);
+        if (filter->tsgroup->tsReader == reader)
+        {
+            ServiceFilterDestroy(filter);
+        }
     }    
     TSReaderUnLock(reader);
 }
@@ -275,6 +276,11 @@ char *ServiceFilterNameGet(ServiceFilter_t filter)
     return filter->name;
 }
 
+TSReader_t *ServiceFilterTSReaderGet(ServiceFilter_t filter)
+{
+    return filter->tsgroup->tsReader;
+}
+
 Service_t *ServiceFilterServiceGet(ServiceFilter_t filter)
 {
     return filter->service;
@@ -402,6 +408,42 @@ static void ServiceFilterProcessPacket(void *arg, TSFilterGroup_t *group, TSPack
     DeliveryMethodOutputPacket(filter->dmInstance, packet);
 }
 
+static void ServiceFilterProcessPackets(void *arg, TSFilterGroup_t *group, TSPacket_t **packets, int count)
+{
+    ServiceFilter_t filter = (ServiceFilter_t)arg;
+    int start = 0;
+    int i;
+
+    if (filter->setHeader && filter->headerGotPMT)
+    {
+        DeliveryMethodSetHeader(filter->dmInstance, filter->packets, filter->headerCount);
+        filter->setHeader = FALSE;
+    }
+
+    for (i = 0; i < count; i ++)
+    {
+        unsigned short pid = TSPACKET_GETPID(*packets[i]);
+        /* PAT/PMT packets may be rewritten or used to build the header so
+         * output the run so far and then process these individually.
+         */
+        if ((pid == 0) || (pid == filter->service->pmtPID))
+        {
+            if (i > start)
+            {
+                DeliveryMethodOutputPackets(filter->dmInstance, &packets[start], i - start);
+            }
+            ServiceFilterProcessPacket(arg, group, packets[i]);
+            start = i + 1;
+        }
+    }
+
+    if (count > start)
+    {
+        DeliveryMethodOutputPackets(filter->dmInstance, &packets[start], count - start);
+    }
+    DeliveryMethodFlush(filter->dmInstance);
+}
+
 static void ServiceFilterPATRewrite(ServiceFilter_t filter)
 {
     dvbpsi_pat_t pat;
@@ -442,7 +484,7 @@ static void ServiceFilterPMTRewrite(ServiceFilter_t state)
     state->ttPID    = INVALID_PID;
     LogModule(LOG_DEBUG, SERVICEFILTER, "!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!\n");
     LogModule(LOG_DEBUG, SERVICEFILTER, "Rewriting PMT on PID %x\n", state->service->pmtPID);
-    info = CacheProgramInfoGet(state->service);
+    info = CacheProgramInfoGet(state->cache, state->service);
     if (info)
     {
         pmt.i_pcr_pid = state->pcrPID = info->pcrPID;
@@ -559,7 +601,7 @@ static void ServiceFilterInitPacket(TSPacket_t *packet, dvbpsi_psi_section_t* se
 static void ServiceFilterAllocateFilters(ServiceFilter_t filter)
 {
     int muxUID;
-    Multiplex_t *mux = TuningCurrentMultiplexGet();
+    Multiplex_t *mux = TuningAdapterMultiplexGet(DVBAdapterIndexGet(filter->tsgroup->tsReader->adapter));
 
     /* No mux is selected yet */
     if (mux == NULL)
@@ -577,48 +619,48 @@ static void ServiceFilterAllocateFilters(ServiceFilter_t filter)
     }
     
     TSReaderLock(filter->tsgroup->tsReader);
-    TSFilterGroupAddPacketFilter(filter->tsgroup, 0x00, ServiceFilterProcessPacket, filter);                    /* PAT */
-    TSFilterGroupAddPacketFilter(filter->tsgroup, filter->service->pmtPID, ServiceFilterProcessPacket, filter); /* PMT */
+    TSFilterGroupAddPacketBatchFilter(filter->tsgroup, 0x00, ServiceFilterProcessPackets, filter);                    /* PAT */
+    TSFilterGroupAddPacketBatchFilter(filter->tsgroup, filter->service->pmtPID, ServiceFilterProcessPackets, filter); /* PMT */
 
 
     if (filter->avsOnly)
     {
         /* Make sure we also stream the PCR PID just in case its not the audio/video */
-        TSFilterGroupAddPacketFilter(filter->tsgroup, filter->pcrPID, ServiceFilterProcessPacket, filter); /* PCR */
+        TSFilterGroupAddPacketBatchFilter(filter->tsgroup, filter->pcrPID, ServiceFilterProcessPackets, filter); /* PCR */
         
         if ((filter->audioPID != INVALID_PID) && (filter->audioPID != filter->pcrPID))
         {
-            TSFilterGroupAddPacketFilter(filter->tsgroup, filter->audioPID, ServiceFilterProcessPacket, filter);
+            TSFilterGroupAddPacketBatchFilter(filter->tsgroup, filter->audioPID, ServiceFilterProcessPackets, filter);
         }
         if ((filter->videoPID != INVALID_PID) && (filter->videoPID != filter->pcrPID))
         {
-            TSFilterGroupAddPacketFilter(filter->tsgroup, filter->videoPID, ServiceFilterProcessPacket, filter);
+            TSFilterGroupAddPacketBatchFilter(filter->tsgroup, filter->videoPID, ServiceFilterProcessPackets, filter);
         }
         if ((filter->subPID != INVALID_PID) && (filter->subPID != filter->pcrPID))
         {
-            TSFilterGroupAddPacketFilter(filter->tsgroup, filter->subPID, ServiceFilterProcessPacket, filter);
+            TSFilterGroupAddPacketBatchFilter(filter->tsgroup, filter->subPID, ServiceFilterProcessPackets, filter);
         }
         if ((filter->ttPID != INVALID_PID) && (filter->ttPID != filter->pcrPID))
         {
-            TSFilterGroupAddPacketFilter(filter->tsgroup, filter->ttPID, ServiceFilterProcessPacket, filter);
+            TSFilterGroupAddPacketBatchFilter(filter->tsgroup, filter->ttPID, ServiceFilterProcessPackets, filter);
         }
     }
     else
     {
-        ProgramInfo_t *info = CacheProgramInfoGet(filter->service);
+        ProgramInfo_t *info = CacheProgramInfoGet(filter->cache, filter->service);
         if (info)
         {
             int i;
             /* Make sure we also stream the PCR PID just in case its not the audio/video */
             if (info->pcrPID != PID_STUFFING)
             {
-                TSFilterGroupAddPacketFilter(filter->tsgroup, info->pcrPID, ServiceFilterProcessPacket, filter); /* PCR */
+                TSFilterGroupAddPacketBatchFilter(filter->tsgroup, info->pcrPID, ServiceFilterProcessPackets, filter); /* PCR */
             }
             for (i = 0; i < info->streamInfoList->nrofStreams; i ++)
             {
                 if (info->streamInfoList->streams[i].pid != info->pcrPID)
                 {
-                    TSFilterGroupAddPacketFilter(filter->tsgroup, info->streamInfoList->streams[i].pid, ServiceFilterProcessPacket, filter);
+                    TSFilterGroupAddPacketBatchFilter(filter->tsgroup, info->streamInfoList->streams[i].pid, ServiceFilterProcessPackets, filter);
                 }
             }
             ObjectRefDec(info);            
@@ -31,13 +31,15 @@ Initialise/Deinitialise the ATSC Standard.
 #include "standard/atsc.h"
 #include "psipprocessor.h"
 #include "atsctext.h"
+#include "dvbadapter.h"
 
 /*******************************************************************************
 * Global variables                                                             *
 *******************************************************************************/
 EventSource_t ATSCEventSource = NULL;
 char ATSCFilterType[]="ATSC";
-static PSIPProcessor_t psipProcessor;
+static PSIPProcessor_t psipProcessors[DVB_MAX_ADAPTERS];
+static int nrofReaders = 0;
 
 /*******************************************************************************
 * Global functions                                                             *
@@ -45,34 +47,49 @@ static PSIPProcessor_t psipProcessor;
 
 int ATSCStandardInit(TSReader_t *reader)
 {
+    int index = DVBAdapterIndexGet(reader->adapter);
     if (ATSCEventSource == NULL)
     {
         ATSCEventSource = EventsRegisterSource(ATSCFilterType);
     }
 
-    if (ATSCMultipleStringsInit())
+    /* The text converters are shared by all readers. */
+    if ((nrofReaders == 0) && ATSCMultipleStringsInit())
     {
         return -1;
     }
     
     if (MPEG2StandardInit(reader))
     {
-        return -1;
+        goto failure;
     }
     
-    psipProcessor = PSIPProcessorCreate(reader);
-    if (psipProcessor == NULL)
+    psipProcessors[index] = PSIPProcessorCreate(reader);
+    if (psipProcessors[index] == NULL)
     {
         MPEG2StandardDeinit(reader);        
-        return -1;
+        goto failure;
     }
+    nrofReaders ++;
     return 0;
+failure:
+    if (nrofReaders == 0)
+    {
+        ATSCMultipleStringsDeInit();
+    }
+    return -1;
 }
 
 int ATSCStandardDeinit(TSReader_t *reader)
 {
+    int index = DVBAdapterIndexGet(reader->adapter);
     MPEG2StandardDeinit(reader);
-    PSIPProcessorDestroy(psipProcessor);
-    ATSCMultipleStringsDeInit();
+    PSIPProcessorDestroy(psipProcessors[index]);
+    psipProcessors[index] = NULL;
+    nrofReaders --;
+    if (nrofReaders == 0)
+    {
+        ATSCMultipleStringsDeInit();
+    }
     return 0;
 }
@@ -63,6 +63,9 @@ Process ATSC PSIP tables
 struct PSIPProcessor_s
 {
     TSFilterGroup_t *tsgroup;
+    Cache_t *cache;
+    bool primary;
+    iconv_t utf16ToUtf8CD;
     dvbpsi_handle demux;
 };
 
@@ -82,9 +85,6 @@ static void DumpDescriptor(char *prefix, dvbpsi_descriptor_t *descriptor);
 *******************************************************************************/
 static const char PSIPPROCESSOR[] = "PSIPProcessor";
 
-static int initCount = 0;
-static iconv_t utf16ToUtf8CD;
-
 static Event_t mgtEvent = NULL;
 static Event_t sttEvent = NULL;
 static Event_t vctEvent = NULL;
@@ -95,16 +95,16 @@ static Event_t vctEvent = NULL;
 PSIPProcessor_t PSIPProcessorCreate(TSReader_t *reader)
 {
     PSIPProcessor_t result;
-    if (initCount == 0)
+    iconv_t cd;
+    int index;
+
+    /* Each reader has its own converter as they run on separate threads. */
+    cd = iconv_open("UTF-8", "UTF-16BE");
+    if ((long)cd == -1)
     {
-        utf16ToUtf8CD = iconv_open("UTF-8", "UTF-16BE");
-        if ((long)utf16ToUtf8CD == -1)
-        {
-            LogModule(LOG_ERROR, PSIPPROCESSOR, "Failed to open iconv to convert UTF16 to UTF8\n");
-            return NULL;
-        }
+        LogModule(LOG_ERROR, PSIPPROCESSOR, "Failed to open iconv to convert UTF16 to UTF8\n");
+        return NULL;
     }
-    initCount ++;
     if (mgtEvent == NULL)
     {
         mgtEvent = EventsRegisterEvent(ATSCEventSource, "MGT", NULL);
@@ -116,8 +116,17 @@ PSIPProcessor_t PSIPProcessorCreate(TSReader_t *reader)
     result = ObjectCreateType(PSIPProcessor_t);
     if (result)
     {
+        index = DVBAdapterIndexGet(reader->adapter);
+        result->cache = CacheGet(index);
+        /* Only the primary adapter's tables are announced via events. */
+        result->primary = (index == 0);
+        result->utf16ToUtf8CD = cd;
         result->tsgroup = TSReaderCreateFilterGroup(reader, PSIPPROCESSOR, ATSCFilterType, PSIPProcessorFilterEventCallback, result);
     }
+    else
+    {
+        iconv_close(cd);
+    }
     
     return result;
 }
@@ -130,12 +139,8 @@ void PSIPProcessorDestroy(PSIPProcessor_t filter)
     {
         dvbpsi_DetachDemux(filter->demux);
     }
+    iconv_close(filter->utf16ToUtf8CD);
     ObjectRefDec(filter);
-    initCount --;
-    if (initCount == 0)
-    {
-        iconv_close(utf16ToUtf8CD);
-    }
 }
 /*******************************************************************************
 * Local Functions                                                              *
@@ -154,6 +159,7 @@ static void PSIPProcessorFilterEventCallback(void *userArg, struct TSFilterGroup
 }
 static void SubTableHandler(void * arg, dvbpsi_handle demuxHandle, uint8_t tableId, uint16_t extension)
 {
+    PSIPProcessor_t state = (PSIPProcessor_t)arg;
     switch (tableId)
     {
         /* MGT */
@@ -165,13 +171,12 @@ static void SubTableHandler(void * arg, dvbpsi_handle demuxHandle, uint8_t table
         /* CVCT */
         case 0xC9:
             {
-                Multiplex_t *current = TuningCurrentMultiplexGet();
+                Multiplex_t *current = CacheMultiplexGet(state->cache);
                 /* Currently only handle VCT for the current multiplex */
-                if (extension == current->tsId)
+                if (current && (extension == current->tsId))
                 {
                     dvbpsi_atsc_AttachVCT(demuxHandle, tableId, extension, ProcessVCT, arg);
                 }
-                MultiplexRefDec(current);
             }
             break;
         /* RRT */
@@ -188,12 +193,12 @@ static void ProcessMGT(void *arg, dvbpsi_atsc_mgt_t *newMGT)
 {
     dvbpsi_atsc_mgt_table_t *table;
     dvbpsi_descriptor_t *descriptor;    
-    Multiplex_t *current = TuningCurrentMultiplexGet();
-    if (current->networkId == -1)
+    PSIPProcessor_t state = (PSIPProcessor_t)arg;
+    Multiplex_t *current = CacheMultiplexGet(state->cache);
+    if (current && (current->networkId == -1))
     {
-        CacheUpdateNetworkId(current, current->uid & 0xffff);
+        CacheUpdateNetworkId(state->cache, current, current->uid & 0xffff);
     }
-    MultiplexRefDec(current);
     LogModule(LOG_DEBUG, PSIPPROCESSOR,"New MGT Received! Version %d Protocol %d\n", newMGT->i_version, newMGT->i_protocol);
     for (table = newMGT->p_first_table; table; table = table->p_next)
     {
@@ -213,16 +218,23 @@ static void ProcessMGT(void *arg, dvbpsi_atsc_mgt_t *newMGT)
     }
     LogModule(LOG_DEBUG, PSIPPROCESSOR, "\tEnd of Descriptors\n");        
 
-    EventsFireEventListeners(mgtEvent, newMGT);
+    if (state->primary)
+    {
+        EventsFireEventListeners(mgtEvent, newMGT);
+    }
     ObjectRefDec(newMGT);
 }
 
 static void ProcessSTT(void *arg, dvbpsi_atsc_stt_t *newSTT)
 {
+    PSIPProcessor_t state = (PSIPProcessor_t)arg;
     LogModule(LOG_DEBUGV, PSIPPROCESSOR,"New STT Received! Protocol %d GPS Time =%lu GPS->UTC Offset = %u \n",
             newSTT->i_protocol, newSTT->i_system_time, newSTT->i_gps_utc_offset);
 
-    EventsFireEventListeners(sttEvent, newSTT);   
+    if (state->primary)
+    {
+        EventsFireEventListeners(sttEvent, newSTT);   
+    }
     ObjectRefDec(newSTT);
 }
 
@@ -232,7 +244,8 @@ static void ProcessVCT(void *arg, dvbpsi_atsc_vct_t *newVCT)
     dvbpsi_atsc_vct_channel_t *channel;
     int count,i;
     Service_t **services;
-    TSReader_t *tsReader = ((TSFilterGroup_t*)arg)->tsReader;
+    PSIPProcessor_t state = (PSIPProcessor_t)arg;
+    TSReader_t *tsReader = state->tsgroup->tsReader;
     
     LogModule(LOG_DEBUG, PSIPPROCESSOR, "New VCT Recieved! Version %d Protocol %d Cable VCT? %s TS Id = 0x%04x\n", 
         newVCT->i_version, newVCT->i_protocol, newVCT->b_cable_vct ? "Yes":"No", newVCT->i_ts_id);
@@ -255,32 +268,32 @@ static void ProcessVCT(void *arg, dvbpsi_atsc_vct_t *newVCT)
         outbuf = serviceName + strlen(serviceName);
         outbytes = sizeof(serviceName) - 10;
 
-        ret = iconv(utf16ToUtf8CD, (ICONV_INPUT_CAST) &inbuf, &inbytes, &outbuf, &outbytes);
+        ret = iconv(state->utf16ToUtf8CD, (ICONV_INPUT_CAST) &inbuf, &inbytes, &outbuf, &outbytes);
         if (ret == -1)
         {
             LogModule(LOG_ERROR, PSIPPROCESSOR, "Failed to convert service name\n");
         }
         else
         {
-            Service_t *service = CacheServiceFindId(channel->i_program_number);
+            Service_t *service = CacheServiceFindId(state->cache, channel->i_program_number);
             *outbuf = 0;
 
             if (!service)
             {
-               service = CacheServiceAdd(channel->i_program_number, channel->i_source_id);
+               service = CacheServiceAdd(state->cache, channel->i_program_number, channel->i_source_id);
             }
             else
             {
-                CacheServiceSeen(service, TRUE, FALSE);
+                CacheServiceSeen(state->cache, service, TRUE, FALSE);
             }
 
             if (service->source != channel->i_source_id)
             {
-                CacheUpdateServiceSource(service, channel->i_source_id);
+                CacheUpdateServiceSource(state->cache, service, channel->i_source_id);
             }
             if (strcmp(service->name, serviceName))
             {
-                CacheUpdateServiceName(service, serviceName);
+                CacheUpdateServiceName(state->cache, service, serviceName);
             }
 
             LogModule(LOG_DEBUG, PSIPPROCESSOR, "\t%s\n", serviceName);
@@ -319,7 +332,7 @@ static void ProcessVCT(void *arg, dvbpsi_atsc_vct_t *newVCT)
     LogModule(LOG_DEBUG, PSIPPROCESSOR, "\tEnd of Descriptors\n");
 
     /* Delete any services that no longer exist */
-    services = CacheServicesGet(&count);
+    services = CacheServicesGet(state->cache, &count);
     for (i = 0; i < count; i ++)
     {
         bool found = FALSE;
@@ -335,19 +348,22 @@ static void ProcessVCT(void *arg, dvbpsi_atsc_vct_t *newVCT)
         {
             LogModule(LOG_DEBUG, PSIPPROCESSOR, "Channel not found in VCT while checking cache, deleting 0x%04x (%s)\n",
                 services[i]->id, services[i]->name);
-            if (!CacheServiceSeen(services[i], FALSE, FALSE))
+            if (!CacheServiceSeen(state->cache, services[i], FALSE, FALSE))
             {
-                CacheServicesRelease();
-                CacheServiceDelete(services[i]);
-                services = CacheServicesGet(&count);
+                CacheServicesRelease(state->cache);
+                CacheServiceDelete(state->cache, services[i]);
+                services = CacheServicesGet(state->cache, &count);
                 i --;
                 /* Cause a TS Structure change call back*/
                 tsReader->tsStructureChanged = TRUE;
             }
         }
     }
-    CacheServicesRelease();
-    EventsFireEventListeners(vctEvent, newVCT);
+    CacheServicesRelease(state->cache);
+    if (state->primary)
+    {
+        EventsFireEventListeners(vctEvent, newVCT);
+    }
     ObjectRefDec(newVCT);
         
 }
@@ -32,15 +32,16 @@ Initialise/Deinitialise the DVB Standard.
 #include "sdtprocessor.h"
 #include "nitprocessor.h"
 #include "tdtprocessor.h"
+#include "dvbadapter.h"
 
 /*******************************************************************************
 * Global variables                                                             *
 *******************************************************************************/
 EventSource_t DVBEventSource;
 char DVBFilterType[] = "DVB";
-static SDTProcessor_t sdtProcessor = NULL;
-static NITProcessor_t nitProcessor = NULL;
-static TDTProcessor_t tdtProcessor = NULL;
+static SDTProcessor_t sdtProcessors[DVB_MAX_ADAPTERS];
+static NITProcessor_t nitProcessors[DVB_MAX_ADAPTERS];
+static TDTProcessor_t tdtProcessors[DVB_MAX_ADAPTERS];
 
 /*******************************************************************************
 * Global functions                                                             *
@@ -48,6 +49,7 @@ static TDTProcessor_t tdtProcessor = NULL;
 
 int DVBStandardInit(TSReader_t *reader)
 {
+    int index = DVBAdapterIndexGet(reader->adapter);
     if (DVBEventSource == NULL)
     {
         DVBEventSource = EventsRegisterSource(DVBFilterType);
@@ -56,44 +58,56 @@ int DVBStandardInit(TSReader_t *reader)
     {
         return -1;
     }
-    sdtProcessor = SDTProcessorCreate(reader);
-    if (sdtProcessor == NULL)
+    sdtProcessors[index] = SDTProcessorCreate(reader);
+    if (sdtProcessors[index] == NULL)
     {
         goto failure;
     }
-    nitProcessor = NITProcessorCreate(reader);
-    if (nitProcessor == NULL)
+    /* 
+     * The NIT and TDT are only used to fire events, which are only announced
+     * for the primary adapter.
+     */
+    if (index == 0)
     {
-        goto failure;
+        nitProcessors[index] = NITProcessorCreate(reader);
+        if (nitProcessors[index] == NULL)
+        {
+            goto failure;
+        }
+        tdtProcessors[index] = TDTProcessorCreate(reader);    
+        if (tdtProcessors[index] == NULL)
+        {
+            goto failure;
+        }    
     }
-    tdtProcessor = TDTProcessorCreate(reader);    
-    if (tdtProcessor == NULL)
-    {
-        goto failure;
-    }    
     return 0;
 failure:
     MPEG2StandardDeinit(reader);
-    if (sdtProcessor)
+    if (sdtProcessors[index])
     {
-        SDTProcessorDestroy(sdtProcessor);
+        SDTProcessorDestroy(sdtProcessors[index]);
+        sdtProcessors[index] = NULL;
     }
-    if (nitProcessor)
+    if (nitProcessors[index])
     {
-        NITProcessorDestroy(nitProcessor);
+        NITProcessorDestroy(nitProcessors[index]);
+        nitProcessors[index] = NULL;
     }
-    if (tdtProcessor)
-    {
-        TDTProcessorDestroy(tdtProcessor);
-    }    
     return -1;
 }
 
 int DVBStandardDeinit(TSReader_t *reader)
 {
+    int index = DVBAdapterIndexGet(reader->adapter);
     MPEG2StandardDeinit(reader);
-    SDTProcessorDestroy(sdtProcessor);
-    NITProcessorDestroy(nitProcessor);
-    TDTProcessorDestroy(tdtProcessor);
+    SDTProcessorDestroy(sdtProcessors[index]);
+    if (nitProcessors[index])
+    {
+        NITProcessorDestroy(nitProcessors[index]);
+        TDTProcessorDestroy(tdtProcessors[index]);
+    }
+    sdtProcessors[index] = NULL;
+    nitProcessors[index] = NULL;
+    tdtProcessors[index] = NULL;
     return 0;
 }
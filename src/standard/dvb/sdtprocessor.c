@@ -65,6 +65,8 @@ Process Service Description Tables and update the services information.
 struct SDTProcessor_s
 {
     TSFilterGroup_t *tsgroup;    
+    Cache_t *cache;
+    bool primary;
     dvbpsi_handle demux;
 };
 
@@ -97,6 +99,10 @@ SDTProcessor_t SDTProcessorCreate(TSReader_t *reader)
     state = ObjectCreateType(SDTProcessor_t);
     if (state)
     {
+        int index = DVBAdapterIndexGet(reader->adapter);
+        state->cache = CacheGet(index);
+        /* Only the primary adapter's tables are announced via events. */
+        state->primary = (index == 0);
         state->tsgroup = TSReaderCreateFilterGroup(reader, SDTPROCESSOR, "DVB", SDTProcessorFilterEventCallback, state);
     }
     return state;
@@ -149,15 +155,15 @@ static void SDTHandler(void* arg, dvbpsi_sdt_t* newSDT)
     {
         dvbpsi_descriptor_t* descriptor = sdtservice->p_first_descriptor;
         bool ca;
-        Service_t *service = CacheServiceFindId(sdtservice->i_service_id);
+        Service_t *service = CacheServiceFindId(state->cache, sdtservice->i_service_id);
         
         if (!service)
         {
-            service = CacheServiceAdd(sdtservice->i_service_id, sdtservice->i_service_id);
+            service = CacheServiceAdd(state->cache, sdtservice->i_service_id, sdtservice->i_service_id);
         }
         else
         {
-            CacheServiceSeen(service, TRUE, FALSE);
+            CacheServiceSeen(state->cache, service, TRUE, FALSE);
         }
         
         while(descriptor)
@@ -179,7 +185,7 @@ static void SDTHandler(void* arg, dvbpsi_sdt_t* newSDT)
                         if (strcmp(name, service->name))
                         {
                             LogModule(LOG_DEBUG, SDTPROCESSOR, "Updating service 0x%04x = %s\n", sdtservice->i_service_id, name);
-                            CacheUpdateServiceName(service, name);
+                            CacheUpdateServiceName(state->cache, service, name);
                         }
                         free(name);
                     }
@@ -189,13 +195,13 @@ static void SDTHandler(void* arg, dvbpsi_sdt_t* newSDT)
                         if ((service->provider==NULL) || strcmp(name, service->provider))
                         {
                             LogModule(LOG_DEBUG, SDTPROCESSOR, "Updating service provider 0x%04x = %s\n", sdtservice->i_service_id, name);
-                            CacheUpdateServiceProvider(service, name);                        
+                            CacheUpdateServiceProvider(state->cache, service, name);                        
                         }
                         free(name);
                     }
                     if (service->type != type)
                     {
-                        CacheUpdateServiceType(service, type);
+                        CacheUpdateServiceType(state->cache, service, type);
                     }
                 }
             }
@@ -208,7 +214,7 @@ static void SDTHandler(void* arg, dvbpsi_sdt_t* newSDT)
                     if ((service->defaultAuthority == NULL) || strcmp((char*)defAuthDesc->authority, service->defaultAuthority))
                     {
                         LogModule(LOG_DEBUG, SDTPROCESSOR, "Updating service default authority 0x%04x = %s\n", sdtservice->i_service_id, defAuthDesc->authority);
-                        CacheUpdateServiceDefaultAuthority(service, (char*)defAuthDesc->authority);                        
+                        CacheUpdateServiceDefaultAuthority(state->cache, service, (char*)defAuthDesc->authority);                        
                     }
                 }
             }
@@ -217,7 +223,7 @@ static void SDTHandler(void* arg, dvbpsi_sdt_t* newSDT)
         ca = sdtservice->b_free_ca ? TRUE:FALSE;
         if (service->conditionalAccess != ca)
         {
-            CacheUpdateServiceConditionalAccess(service,ca);
+            CacheUpdateServiceConditionalAccess(state->cache, service,ca);
         }
         
         ServiceRefDec(service);
@@ -226,7 +232,7 @@ static void SDTHandler(void* arg, dvbpsi_sdt_t* newSDT)
     }
 
     /* Delete any services that no longer exist */
-    services = CacheServicesGet(&count);
+    services = CacheServicesGet(state->cache, &count);
     for (i = 0; i < count; i ++)
     {
         bool found = FALSE;
@@ -242,27 +248,29 @@ static void SDTHandler(void* arg, dvbpsi_sdt_t* newSDT)
         {
             LogModule(LOG_DEBUG, SDTPROCESSOR, "Service not found in SDT while checking cache, deleting 0x%04x (%s)\n",
                 services[i]->id, services[i]->name);
-            if (!CacheServiceSeen(services[i], FALSE, FALSE))
+            if (!CacheServiceSeen(state->cache, services[i], FALSE, FALSE))
             {
-                CacheServicesRelease();
-                CacheServiceDelete(services[i]);
-                services = CacheServicesGet(&count);
+                CacheServicesRelease(state->cache);
+                CacheServiceDelete(state->cache, services[i]);
+                services = CacheServicesGet(state->cache, &count);
                 i --;
                 /* Cause a TS Structure change call back*/
                 state->tsgroup->tsReader->tsStructureChanged = TRUE;
             }
         }
     }
-    CacheServicesRelease();
-    mux = TuningCurrentMultiplexGet();
+    CacheServicesRelease(state->cache);
+    mux = CacheMultiplexGet(state->cache);
     /* Set the Original Network id, this is a hack should really get and decode the NIT */
-    if (mux->networkId != newSDT->i_network_id)
+    if (mux && (mux->networkId != newSDT->i_network_id))
     {
-        CacheUpdateNetworkId(mux, newSDT->i_network_id);
+        CacheUpdateNetworkId(state->cache, mux, newSDT->i_network_id);
     }
-    MultiplexRefDec(mux);
     
-    EventsFireEventListeners(sdtEvent, newSDT);
+    if (state->primary)
+    {
+        EventsFireEventListeners(sdtEvent, newSDT);
+    }
     ObjectRefDec(newSDT);
 }
 
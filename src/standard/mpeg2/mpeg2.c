@@ -40,8 +40,8 @@ Initialise/Deinitialise the MPEG2 Standard.
 *******************************************************************************/
 EventSource_t MPEG2EventSource = NULL;
 char MPEG2FilterType[]="MPEG2";
-static PATProcessor_t patProcessor;
-static PMTProcessor_t pmtProcessor;
+static PATProcessor_t patProcessors[DVB_MAX_ADAPTERS];
+static PMTProcessor_t pmtProcessors[DVB_MAX_ADAPTERS];
 
 /*******************************************************************************
 * Global functions                                                             *
@@ -49,19 +49,21 @@ static PMTProcessor_t pmtProcessor;
 
 int MPEG2StandardInit(TSReader_t *reader)
 {
+    int index = DVBAdapterIndexGet(reader->adapter);
     if (MPEG2EventSource == NULL)
     {
         MPEG2EventSource = EventsRegisterSource(MPEG2FilterType);
     }
-    patProcessor = PATProcessorCreate(reader);
-    if (patProcessor == NULL)
+    patProcessors[index] = PATProcessorCreate(reader);
+    if (patProcessors[index] == NULL)
     {
         return -1;
     }
-    pmtProcessor = PMTProcessorCreate(reader);
-    if (pmtProcessor == NULL)
+    pmtProcessors[index] = PMTProcessorCreate(reader);
+    if (pmtProcessors[index] == NULL)
     {
-        PATProcessorDestroy(patProcessor);
+        PATProcessorDestroy(patProcessors[index]);
+        patProcessors[index] = NULL;
         return -1;
     }
     return 0;
@@ -69,8 +71,10 @@ int MPEG2StandardInit(TSReader_t *reader)
 
 int MPEG2StandardDeinit(TSReader_t *reader)
 {
-    reader = reader;
-    PATProcessorDestroy(patProcessor);
-    PMTProcessorDestroy(pmtProcessor);
+    int index = DVBAdapterIndexGet(reader->adapter);
+    PATProcessorDestroy(patProcessors[index]);
+    PMTProcessorDestroy(pmtProcessors[index]);
+    patProcessors[index] = NULL;
+    pmtProcessors[index] = NULL;
     return 0;
 }
@@ -45,6 +45,8 @@ Process Program Association Tables and update the services information.
 struct PATProcessor_s
 {
     TSFilterGroup_t *tsgroup;
+    Cache_t *cache;
+    bool primary;
     Multiplex_t *multiplex;
     dvbpsi_handle pathandle;
 };
@@ -76,6 +78,10 @@ PATProcessor_t PATProcessorCreate(TSReader_t *reader)
     state = ObjectCreateType(PATProcessor_t);
     if (state)
     {
+        int index = DVBAdapterIndexGet(reader->adapter);
+        state->cache = CacheGet(index);
+        /* Only the primary adapter's tables are announced via events. */
+        state->primary = (index == 0);
         state->tsgroup = TSReaderCreateFilterGroup(reader, PATPROCESSOR, MPEG2FilterType, PATProcessorFilterEventCallback, state);
     }
     return state;
@@ -140,22 +146,22 @@ static void PATHandler(void* arg, dvbpsi_pat_t* newpat)
         LogModule(LOG_DEBUG, PATPROCESSOR, "Service 0x%04x PMT PID 0x%04x\n", patentry->i_number, patentry->i_pid);
         if (patentry->i_number != 0x0000)
         {
-            Service_t *service = CacheServiceFindId(patentry->i_number);
+            Service_t *service = CacheServiceFindId(state->cache, patentry->i_number);
             if (!service)
             {
                 LogModule(LOG_DEBUG, PATPROCESSOR, "Service not found in cache while processing PAT, adding 0x%04x\n", patentry->i_number);
-                service = CacheServiceAdd(patentry->i_number, patentry->i_number);
+                service = CacheServiceAdd(state->cache, patentry->i_number, patentry->i_number);
                 /* Cause a TS Structure change call back*/
                 state->tsgroup->tsReader->tsStructureChanged = TRUE;
             }
             else
             {
-                CacheServiceSeen(service, TRUE, TRUE);
+                CacheServiceSeen(state->cache, service, TRUE, TRUE);
             }
 
             if (service && (service->pmtPID != patentry->i_pid))
             {
-                CacheUpdateServicePMTPID(service, patentry->i_pid);
+                CacheUpdateServicePMTPID(state->cache, service, patentry->i_pid);
             }
 
             if (service)
@@ -166,7 +172,7 @@ static void PATHandler(void* arg, dvbpsi_pat_t* newpat)
     }
 
     /* Delete any services that no longer exist */
-    services = CacheServicesGet(&count);
+    services = CacheServicesGet(state->cache, &count);
     for (i = 0; i < count; i ++)
     {
         bool found = FALSE;
@@ -182,11 +188,11 @@ static void PATHandler(void* arg, dvbpsi_pat_t* newpat)
         {
             LogModule(LOG_DEBUG, PATPROCESSOR, "Service not found in PAT while checking cache, deleting 0x%04x (%s)\n",
                 services[i]->id, services[i]->name);
-            if (!CacheServiceSeen(services[i], FALSE, TRUE))
+            if (!CacheServiceSeen(state->cache, services[i], FALSE, TRUE))
             {
-                CacheServicesRelease();
-                CacheServiceDelete(services[i]);
-                services = CacheServicesGet(&count);
+                CacheServicesRelease(state->cache);
+                CacheServiceDelete(state->cache, services[i]);
+                services = CacheServicesGet(state->cache, &count);
                 i --;
                 /* Cause a TS Structure change call back*/
                 state->tsgroup->tsReader->tsStructureChanged = TRUE;
@@ -194,10 +200,13 @@ static void PATHandler(void* arg, dvbpsi_pat_t* newpat)
         }
     }
 
-    CacheServicesRelease();
-    CacheUpdateMultiplex(multiplex, newpat->i_version, newpat->i_ts_id);
+    CacheServicesRelease(state->cache);
+    CacheUpdateMultiplex(state->cache, multiplex, newpat->i_version, newpat->i_ts_id);
 
-    EventsFireEventListeners(patEvent, newpat);
+    if (state->primary)
+    {
+        EventsFireEventListeners(patEvent, newpat);
+    }
     ObjectRefDec(newpat);
 }
 
@@ -50,12 +50,19 @@ Process Program Map Tables and update the services information and PIDs.
 * Typedefs                                                                     *
 *******************************************************************************/
 
+typedef struct PMTServiceHandle_s
+{
+    struct PMTProcessor_s *processor;
+    Service_t     *service;
+    dvbpsi_handle  pmthandle;
+}PMTServiceHandle_t;
+
 struct PMTProcessor_s
 {
     TSFilterGroup_t *tsgroup;
-    Service_t     *services[MAX_HANDLES];
-    unsigned short pmtpids[MAX_HANDLES];
-    dvbpsi_handle  pmthandles[MAX_HANDLES];
+    Cache_t *cache;
+    bool primary;
+    PMTServiceHandle_t handles[MAX_HANDLES];
 };
 
 /*******************************************************************************
@@ -86,6 +93,10 @@ PMTProcessor_t PMTProcessorCreate(TSReader_t *reader)
     state = ObjectCreateType(PMTProcessor_t);
     if (state)
     {
+        int index = DVBAdapterIndexGet(reader->adapter);
+        state->cache = CacheGet(index);
+        /* Only the primary adapter's tables are announced via events. */
+        state->primary = (index == 0);
         state->tsgroup = TSReaderCreateFilterGroup(reader, PMTPROCESSOR, MPEG2FilterType, PMTProcessorFilterEventCallback, state);
     }
     return state;
@@ -97,12 +108,12 @@ void PMTProcessorDestroy(PMTProcessor_t processor)
     TSFilterGroupDestroy(processor->tsgroup);
     for (i = 0; i < MAX_HANDLES; i ++)
     {
-        if (processor->pmthandles[i])
+        if (processor->handles[i].pmthandle)
         {
-            dvbpsi_DetachPMT(processor->pmthandles[i]);
-            processor->pmthandles[i] = NULL;
-            ServiceRefDec(processor->services[i]);
-            processor->services[i]   = NULL;
+            dvbpsi_DetachPMT(processor->handles[i].pmthandle);
+            processor->handles[i].pmthandle = NULL;
+            ServiceRefDec(processor->handles[i].service);
+            processor->handles[i].service   = NULL;
         }
     }
     ObjectRefDec(processor);
@@ -122,17 +133,17 @@ static void PMTProcessorFilterEventCallback(void *userArg, struct TSFilterGroup_
 
     for (i = 0; i < MAX_HANDLES; i ++)
     {
-        if (state->pmthandles[i])
+        if (state->handles[i].pmthandle)
         {
-            dvbpsi_DetachPMT(state->pmthandles[i]);
-            state->pmthandles[i] = NULL;
-            ServiceRefDec(state->services[i]);
-            state->services[i]   = NULL;
+            dvbpsi_DetachPMT(state->handles[i].pmthandle);
+            state->handles[i].pmthandle = NULL;
+            ServiceRefDec(state->handles[i].service);
+            state->handles[i].service   = NULL;
         }
     }
 
     
-    services = CacheServicesGet(&count);
+    services = CacheServicesGet(state->cache, &count);
     if (count > MAX_HANDLES)
     {
         LogModule(LOG_ERROR, PMTPROCESSOR, "Too many services in TS, cannot monitor them all only monitoring %d out of %d\n", MAX_HANDLES, count);
@@ -141,28 +152,35 @@ static void PMTProcessorFilterEventCallback(void *userArg, struct TSFilterGroup_
     for (i = 0; i < count; i ++)
     {
         ServiceRefInc(services[i]);
-        state->services[i] = services[i];
+        state->handles[i].processor = state;
+        state->handles[i].service = services[i];
     }
-    CacheServicesRelease();    
+    CacheServicesRelease(state->cache);    
     /* Make sure we don't try and create the filter while we have the cache locked. */
     for (i = 0; i < count; i ++)
     {
-        state->pmthandles[i] = dvbpsi_AttachPMT(services[i]->id, PMTHandler, (void*)services[i]);
-        TSFilterGroupAddSectionFilter(state->tsgroup, services[i]->pmtPID, 0, state->pmthandles[i]);
+        Service_t *service = state->handles[i].service;
+        state->handles[i].pmthandle = dvbpsi_AttachPMT(service->id, PMTHandler, (void*)&state->handles[i]);
+        TSFilterGroupAddSectionFilter(state->tsgroup, service->pmtPID, 0, state->handles[i].pmthandle);
     }
 
 }
 
 static void PMTHandler(void* arg, dvbpsi_pmt_t* newpmt)
 {
-    Service_t *service = (Service_t*)arg;
+    PMTServiceHandle_t *handle = (PMTServiceHandle_t*)arg;
+    PMTProcessor_t state = handle->processor;
+    Service_t *service = handle->service;
     ProgramInfo_t *info;
     dvbpsi_pmt_es_t *esentry = newpmt->p_first_es;
     int count = 0;
 
     LogModule(LOG_DEBUG, PMTPROCESSOR, "PMT recieved, version %d on PID %d\n", newpmt->i_version, service->pmtPID);
 
-    EventsFireEventListeners(pmtEvent, newpmt);
+    if (state->primary)
+    {
+        EventsFireEventListeners(pmtEvent, newpmt);
+    }
     
     while(esentry)
     {
@@ -198,7 +216,7 @@ static void PMTHandler(void* arg, dvbpsi_pmt_t* newpmt)
             esentry = esentry->p_next;
         }
         LogModule(LOG_DEBUGV,PMTPROCESSOR, "About to update cache\n");
-        CacheUpdateProgramInfo(service, info);
+        CacheUpdateProgramInfo(state->cache, service, info);
     }
 
     ObjectRefDec(newpmt);
@@ -0,0 +1,99 @@
+/*
+Copyright (C) 2006  Adam Charrett
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+
+ringbuffer.c
+
+Lock-free single producer/single consumer ring buffer.
+
+*/
+#include "ringbuffer.h"
+
+/*******************************************************************************
+* Global functions                                                             *
+*******************************************************************************/
+void RingBufferInit(RingBuffer_t *ring, unsigned int size)
+{
+    ring->size = size;
+    RingBufferReset(ring);
+}
+
+void RingBufferReset(RingBuffer_t *ring)
+{
+    ring->head = 0;
+    ring->tail = 0;
+    ring->highWaterMark = 0;
+    __sync_synchronize();
+}
+
+int RingBufferWriteSlot(RingBuffer_t *ring)
+{
+    unsigned int head = ring->head;
+    if (head - ring->tail >= ring->size)
+    {
+        return -1;
+    }
+    /* Make sure the consumer has finished with the slot before it is reused */
+    __sync_synchronize();
+    return head & (ring->size - 1);
+}
+
+void RingBufferCommit(RingBuffer_t *ring)
+{
+    unsigned int used;
+    /* Slot contents must be visible before the new head */
+    __sync_synchronize();
+    ring->head ++;
+    used = ring->head - ring->tail;
+    if (used > ring->highWaterMark)
+    {
+        ring->highWaterMark = used;
+    }
+}
+
+int RingBufferReadSlot(RingBuffer_t *ring)
+{
+    unsigned int tail = ring->tail;
+    if (ring->head == tail)
+    {
+        return -1;
+    }
+    /* Don't read the slot contents before seeing the head */
+    __sync_synchronize();
+    return tail & (ring->size - 1);
+}
+
+int RingBufferPeekSlot(RingBuffer_t *ring, unsigned int sequence)
+{
+    if (ring->head == sequence)
+    {
+        return -1;
+    }
+    __sync_synchronize();
+    return sequence & (ring->size - 1);
+}
+
+void RingBufferRelease(RingBuffer_t *ring)
+{
+    /* Acts as a barrier so the slot contents are finished with before it is
+     * handed back */
+    __sync_fetch_and_add(&ring->tail, 1);
+}
+
+unsigned int RingBufferUsed(RingBuffer_t *ring)
+{
+    return ring->head - ring->tail;
+}
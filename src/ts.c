@@ -26,24 +26,31 @@ Transport stream processing and filter management.
 #include <unistd.h>
 #include <string.h>
 #include <stdint.h>
+#include <errno.h>
 #include <sys/time.h>
 #include <sys/types.h>
+#include <sys/mman.h>
+#include <poll.h>
 
 #include <dvbpsi/dvbpsi.h>
 #include <dvbpsi/descriptor.h>
 #include <dvbpsi/psi.h>
 #include <dvbpsi/sections.h>
+#include <dvbpsi/pool.h>
 
 #include "multiplexes.h"
 #include "services.h"
 #include "ts.h"
 #include "logging.h"
 #include "dispatchers.h"
+#include "properties.h"
+#include "pids.h"
+#include "events.h"
+#include "yamlutils.h"
 
 /*******************************************************************************
 * Defines                                                                      *
 *******************************************************************************/
-#define PACKET_FILTER_DISABLED 0x8000
 #define TSREADER_PID_INVALID 0xffff
 
 #define CHECK_PID_VALID(pid) \
@@ -60,6 +67,41 @@ Transport stream processing and filter management.
  */
 #define MIN_SECTION_FILTER_PIDS 4
 
+/**
+ * How often (in seconds) section filters are time sliced when there are more 
+ * section filter PIDs than PID filters available.
+ */
+#define SECTION_SCHEDULE_INTERVAL 0.05
+
+/**
+ * Minimum time (in seconds) a section filter is scheduled for before it can be
+ * descheduled to let a filter that has not received any sections yet run.
+ */
+#define SECTION_MIN_DWELL 0.1
+
+/**
+ * Default maximum time (in milliseconds) a section filter is scheduled for 
+ * while other section filters are waiting.
+ */
+#define SECTION_DEFAULT_MAX_DWELL 2000
+
+/**
+ * Size of a huge page, the input buffer is rounded up to a multiple of this
+ * when attempting to back it with huge pages.
+ */
+#define HUGEPAGE_SIZE (2 * 1024 * 1024)
+
+/**
+ * Time (in milliseconds) the reader thread waits for data before checking
+ * whether it should exit.
+ */
+#define READER_POLL_TIMEOUT 100
+
+/**
+ * Weight given to the existing average when updating the ring latency.
+ */
+#define RING_LATENCY_WEIGHT 16
+
 
 /*******************************************************************************
 * Prototypes                                                                   *
@@ -69,24 +111,76 @@ static void StatsAddFilterGroupStats(TSReaderStats_t *stats, const char *type, T
 static void PromiscusModeEnable(TSReader_t *reader, bool enable);
 static TSPacketFilter_t * PacketFilterListAddFilter(TSReader_t *reader, TSFilterGroup_t *group, uint16_t pid, TSPacketFilterCallback_t callback, void *userArg);
 static void PacketFilterListRemoveFilter(TSReader_t *reader, TSPacketFilter_t *packetFilter);
+static void PacketDispatchListRebuild(TSReader_t *reader, uint16_t pid, TSPacketFilter_t *add, TSPacketFilter_t *remove);
+static void PacketDispatchListFreeRetired(TSReader_t *reader);
+static bool FilterGroupAddPacketFilter(TSFilterGroup_t *group, uint16_t pid, TSPacketFilterCallback_t callback, void *userArg, TSPacketBatch_t *batch);
+static void PacketBatchAppend(void *userArg, struct TSFilterGroup_t *group, TSPacket_t *packet);
+static void PacketBatchDeliver(TSPacketBatch_t *batch);
+static void PacketBatchRelease(TSReader_t *reader, TSPacketBatch_t *batch);
+static void PacketBatchDeliverAll(TSReaderProcessor_t *processor);
 static TSSectionFilterList_t * SectionFilterListCreate(TSReader_t *reader, uint16_t pid);
 static void SectionFilterListDestroy(TSReader_t *reader, TSSectionFilterList_t *sfList);
 static void SectionFilterListAddFilter(TSReader_t *reader, TSSectionFilter_t *filter);
 static void SectionFilterListRemoveFilter(TSReader_t *reader, TSSectionFilter_t *filter);
 static void SectionFilterListUpdatePriority(TSSectionFilterList_t *sfList);
+static void SectionFilterListUpdateMatch(TSSectionFilterList_t *sfList);
+static int SectionFilterListHeaderFilter(void *userArg, const uint8_t *header, int size);
+static bool SectionFilterMatch(TSSectionFilter_t *filter, const uint8_t *section, int length);
 static TSSectionFilterList_t * SectionFilterListFind(TSReader_t *reader, uint16_t pid);
 static void SectionFilterListScheduleFilters(TSReader_t *reader);
+static TSSectionFilterList_t *SectionFilterListNextToSchedule(TSReader_t *reader, ev_tstamp now);
+static bool SectionFilterListRanksBefore(TSSectionFilterList_t *a, TSSectionFilterList_t *b, ev_tstamp now);
+static bool SectionFilterListCanDeschedule(TSSectionFilterList_t *sfList);
+static void SectionFilterListDeschedule(TSReader_t *reader, TSSectionFilterList_t *sfList, ev_tstamp now);
 static void SectionFilterListDescheduleFilters(TSReader_t *reader);
 static void SectionFilterListDescheduleOneFilter(TSReader_t *reader);
+static void SectionFilterListScheduleCallback(struct ev_loop *loop, ev_timer *w, int revents);
+static void SectionFilterListTrackCycle(TSSectionFilterList_t *sfList, dvbpsi_psi_section_t *section);
 static void SectionFilterListPacketCallback(void *userArg, struct TSFilterGroup_t *group, TSPacket_t *packet);
 static void SectionFilterListPushSection(void *userArg, dvbpsi_handle sectionsHandle, dvbpsi_psi_section_t *section);
-
-static void TSReaderDVRCallback(struct ev_loop *loop, ev_io *w, int revents);
+static void SectionFilterListFlushAllCaches(TSReader_t *reader);
+static void SectionFilterListResetAcquisition(TSReader_t *reader);
+
+static bool TSReaderBufferAlloc(TSReader_t *reader, unsigned int size);
+static void TSReaderBufferFree(TSReader_t *reader);
+static int TSReaderPropertyBufferSizeGet(void *userArg, PropertyValue_t *value);
+static int TSReaderPropertyBufferSizeSet(void *userArg, PropertyValue_t *value);
+
+static void TSReaderThreadStart(TSReader_t *reader);
+static void TSReaderThreadStop(TSReader_t *reader);
+static void *TSReaderThread(void *arg);
+static unsigned int TSReaderRead(TSReader_t *reader, int fd, uint8_t *data, unsigned int bytes, bool *wait);
+static void TSReaderRingCallback(struct ev_loop *loop, ev_async *w, int revents);
+static void TSReaderLoopStart(TSReader_t *reader);
+static void TSReaderLoopStop(TSReader_t *reader);
+static void *TSReaderLoopThread(void *arg);
+static void TSReaderLoopExitCallback(struct ev_loop *loop, ev_async *w, int revents);
+static int TSReaderPropertyThreadsGet(void *userArg, PropertyValue_t *value);
+static int TSReaderPropertyThreadsSet(void *userArg, PropertyValue_t *value);
+
+static void ProcessorsInit(TSReader_t *reader);
+static void ProcessorsStartWorkers(TSReader_t *reader, int count);
+static void ProcessorsStopWorkers(TSReader_t *reader);
+static void ProcessorsDrain(TSReader_t *reader);
+static void ProcessorsAssignGroups(TSReader_t *reader);
+static int ProcessorAssign(TSReader_t *reader);
+static TSReaderProcessor_t *ProcessorCurrent(TSReader_t *reader);
+static void *ProcessorWorkerThread(void *arg);
+static void ProcessorRun(TSReaderProcessor_t *processor, bool wait);
+static void ProcessorProcessPackets(TSReaderProcessor_t *processor, TSPacket_t *packets, int count);
 static void TSReaderBitrateCallback(struct ev_loop *loop, ev_timer *w, int revents);
 static void TSReaderNotificationCallback(struct ev_loop *loop, ev_async *w, int revents);
-
-static void ProcessPacket(TSReader_t *reader, TSPacket_t *packet);
-static void SendToPacketFilters(TSReader_t *reader, uint16_t pid, TSPacket_t *packet);
+static void MonitorEventsInit(void);
+static void MonitorCheckReset(TSReader_t *reader);
+static void MonitorReport(void *userArg, TSMonitorIndicator_e indicator, uint16_t pid, unsigned int count);
+static int MonitorEventToString(yaml_document_t *document, Event_t event, void *payload);
+
+static void ProcessPacket(TSReaderProcessor_t *processor, TSPacket_t *packet);
+static void PIDStatsCount(TSReader_t *reader, TSPacket_t *packet);
+static void PIDStatsSample(TSReader_t *reader);
+static void PIDStatsZero(TSReader_t *reader);
+static void PIDRatesReset(TSPIDRates_t *rates);
+static void SendToPacketFilters(TSReaderProcessor_t *processor, uint16_t pid, TSPacket_t *packet);
 static void InformTSStructureChanged(TSReader_t *reader);
 static void InformMultiplexChanged(TSReader_t *reader);
 
@@ -96,6 +190,22 @@ static void InformMultiplexChanged(TSReader_t *reader);
 
 char PSISIPIDFilterType[] = "PSI/SI";
 static char TSREADER[] = "TSReader";
+static char TSREADERWORKER[] = "TSReaderWorker";
+
+static EventSource_t monitorSource = NULL;
+static Event_t monitorEvents[TSMonitorIndicator_Count];
+
+/* Names of the monitor error count properties, in TSMonitorIndicator_e order. */
+static const char *monitorPropertyNames[TSMonitorIndicator_Count] = {
+    "syncloss",
+    "paterrors",
+    "ccerrors",
+    "pmterrors",
+    "transporterrors",
+    "pcrrepetitionerrors",
+    "pcrdiscontinuityerrors",
+    "pcraccuracyerrors"
+};
 
 /*******************************************************************************
 * Transport Stream Filter Functions                                            *
@@ -103,12 +213,15 @@ static char TSREADER[] = "TSReader";
 TSReader_t* TSReaderCreate(DVBAdapter_t *adapter)
 {
     TSReader_t *result;
-    struct ev_loop *inputLoop;
+    int i;
+    char ringPropertyPath[sizeof(result->propertyPath) + 5];
+    char monitorPropertyPath[sizeof(result->propertyPath) + 8];
     ObjectRegisterType(TSReader_t);
     ObjectRegisterType(TSFilterGroup_t);
     ObjectRegisterType(TSSectionFilter_t);
     ObjectRegisterType(TSSectionFilterList_t);
     ObjectRegisterType(TSPacketFilter_t);
+    ObjectRegisterType(TSPacketBatch_t);
     ObjectRegisterTypeDestructor(TSReaderStats_t, TSReaderStatsDestructor);
     ObjectRegisterType(TSFilterGroupTypeStats_t);
     ObjectRegisterType(TSFilterGroupStats_t);    
@@ -119,25 +232,110 @@ TSReader_t* TSReaderCreate(DVBAdapter_t *adapter)
         pthread_mutexattr_t mutexAttr;
 
         result->adapter = adapter;
-        DVBDemuxSetBufferSize(adapter, TSREADER_MAX_PACKETS * TSPACKET_SIZE);
+        RingBufferInit(&result->ring, TSREADER_RING_SLOTS);
+        if (!TSReaderBufferAlloc(result, TSREADER_DEFAULT_BUFFER_SIZE))
+        {
+            ObjectRefDec(result);
+            return NULL;
+        }
+        DVBDemuxSetBufferSize(adapter, result->bufferSize);
+        if (!TSMonitorInit(&result->monitor))
+        {
+            TSReaderBufferFree(result);
+            ObjectRefDec(result);
+            return NULL;
+        }
+        /* The primary adapter's packets are processed on the input dispatcher
+         * thread along with the PSI/SI, scanning and tuning callbacks that
+         * expect to run alongside them. Other adapters get a loop and thread
+         * of their own so one adapter's filters can't hold up another's.
+         */
+        result->loop = DispatchersGetInput();
+        if (DVBAdapterIndexGet(adapter) != 0)
+        {
+            result->loop = ev_loop_new(EVFLAG_AUTO);
+            if (result->loop == NULL)
+            {
+                LogModule(LOG_ERROR, TSREADER, "Failed to create event loop for adapter %d", DVBAdapterIndexGet(adapter));
+                TSMonitorDeinit(&result->monitor);
+                TSReaderBufferFree(result);
+                ObjectRefDec(result);
+                return NULL;
+            }
+        }
+        result->monitorEnabled = TRUE;
+        MonitorEventsInit();
         result->groups = ListCreate();
         result->activeSectionFilters = ListCreate();
         result->sectionFilters = ListCreate();
-        result->currentlyProcessingPid = TSREADER_PID_INVALID;
         pthread_mutexattr_init(&mutexAttr);
         pthread_mutexattr_settype(&mutexAttr, PTHREAD_MUTEX_RECURSIVE);
         pthread_mutex_init(&result->mutex, &mutexAttr);
         pthread_mutexattr_destroy(&mutexAttr);
-        inputLoop = DispatchersGetInput();
-        ev_io_init(&result->dvrWatcher, TSReaderDVRCallback, DVBDVRGetFD(adapter), EV_READ);
+        ProcessorsInit(result);
+        ev_async_init(&result->ringWatcher, TSReaderRingCallback);
         ev_timer_init(&result->bitrateWatcher, TSReaderBitrateCallback, 1.0, 1.0);
         ev_async_init(&result->notificationWatcher, TSReaderNotificationCallback);
-        result->dvrWatcher.data = result;
+        ev_timer_init(&result->sectionScheduleWatcher, SectionFilterListScheduleCallback, 
+            SECTION_SCHEDULE_INTERVAL, SECTION_SCHEDULE_INTERVAL);
+        result->ringWatcher.data = result;
         result->bitrateWatcher.data = result;
         result->notificationWatcher.data = result;
-        ev_io_start(inputLoop, &result->dvrWatcher);
-        ev_timer_start(inputLoop, &result->bitrateWatcher);
-        ev_async_start(inputLoop, &result->notificationWatcher);
+        result->sectionScheduleWatcher.data = result;
+        result->sectionMaxDwell = SECTION_DEFAULT_MAX_DWELL;
+        ev_async_start(result->loop, &result->ringWatcher);
+        ev_timer_start(result->loop, &result->bitrateWatcher);
+        ev_async_start(result->loop, &result->notificationWatcher);
+        ev_timer_start(result->loop, &result->sectionScheduleWatcher);
+
+        if (DVBAdapterIndexGet(adapter) == 0)
+        {
+            strcpy(result->propertyPath, "tsreader");
+        }
+        else
+        {
+            sprintf(result->propertyPath, "tsreader%d", DVBAdapterIndexGet(adapter));
+        }
+        sprintf(ringPropertyPath, "%s.ring", result->propertyPath);
+        sprintf(monitorPropertyPath, "%s.monitor", result->propertyPath);
+        PropertiesAddProperty(result->propertyPath, "buffersize", "Size of the input buffer (and adapter DVR buffer) in KB.",
+            PropertyType_Int, result, TSReaderPropertyBufferSizeGet, TSReaderPropertyBufferSizeSet);
+        PropertiesAddSimpleProperty(result->propertyPath, "hugepages", "Whether the input buffer is backed by huge pages.",
+            PropertyType_Boolean, &result->bufferHugePages, SIMPLEPROPERTY_R);
+        PropertiesAddSimpleProperty(result->propertyPath, "overflows", "Number of times the adapter reported that its buffer overflowed.",
+            PropertyType_Int, &result->bufferOverflows, SIMPLEPROPERTY_R);
+        PropertiesAddSimpleProperty(result->propertyPath, "shortreads", "Number of reads that ended with an incomplete packet.",
+            PropertyType_Int, &result->shortReads, SIMPLEPROPERTY_R);
+        PropertiesAddSimpleProperty(result->propertyPath, "packetsize", "Size of the packets in the input stream (188, 192 or 204), 0 if not in sync.",
+            PropertyType_Int, &result->framer.packetSize, SIMPLEPROPERTY_R);
+        PropertiesAddSimpleProperty(result->propertyPath, "synclosses", "Number of times sync with the input stream has been lost.",
+            PropertyType_Int, &result->framer.syncLosses, SIMPLEPROPERTY_R);
+        PropertiesAddSimpleProperty(ringPropertyPath, "highwatermark", "Maximum number of ring slots that have been waiting to be processed.",
+            PropertyType_Int, &result->ring.highWaterMark, SIMPLEPROPERTY_R);
+        PropertiesAddSimpleProperty(ringPropertyPath, "drops", "Number of packets dropped because the ring was full.",
+            PropertyType_Int, &result->ringDrops, SIMPLEPROPERTY_R);
+        PropertiesAddSimpleProperty(ringPropertyPath, "latency", "Average time (in microseconds) between packets being read and processed.",
+            PropertyType_Int, &result->ringLatency, SIMPLEPROPERTY_R);
+        PropertiesAddSimpleProperty(ringPropertyPath, "maxlatency", "Maximum time (in microseconds) between packets being read and processed.",
+            PropertyType_Int, &result->ringLatencyMax, SIMPLEPROPERTY_R);
+        PropertiesAddProperty(result->propertyPath, "threads", "Number of worker threads filter groups are spread across (0 to process all groups on the input thread).",
+            PropertyType_Int, result, TSReaderPropertyThreadsGet, TSReaderPropertyThreadsSet);
+        PropertiesAddSimpleProperty(result->propertyPath, "sectionmaxdwell", "Longest time (in milliseconds) a section filter PID is kept while others wait for a PID filter.",
+            PropertyType_Int, &result->sectionMaxDwell, SIMPLEPROPERTY_RW);
+        PropertiesAddSimpleProperty(monitorPropertyPath, "enabled", "Whether the transport stream is checked for TR 101 290 errors.",
+            PropertyType_Boolean, &result->monitorEnabled, SIMPLEPROPERTY_RW);
+        for (i = 0; i < TSMonitorIndicator_Count; i ++)
+        {
+            char desc[80];
+            sprintf(desc, "Number of %s errors found.", TSMonitorIndicatorName(i));
+            PropertiesAddSimpleProperty(monitorPropertyPath, monitorPropertyNames[i], desc,
+                PropertyType_Int, (void *)&result->monitor.errors[i], SIMPLEPROPERTY_R);
+        }
+        PropertiesAddSimpleProperty(monitorPropertyPath, "pcrjitter", "Largest PCR accuracy deviation (in nanoseconds) over the last second.",
+            PropertyType_Int, (void *)&result->monitor.pcrJitter, SIMPLEPROPERTY_R);
+
+        TSReaderLoopStart(result);
+        TSReaderThreadStart(result);
     }
     return result;
 }
@@ -145,9 +343,18 @@ TSReader_t* TSReaderCreate(DVBAdapter_t *adapter)
 void TSReaderDestroy(TSReader_t* reader)
 {
     int i;
-    struct ev_loop *inputLoop = DispatchersGetInput();
-    ev_io_stop(inputLoop, &reader->dvrWatcher);
-    ev_timer_stop(inputLoop, &reader->bitrateWatcher);
+    TSReaderThreadStop(reader);
+    TSReaderLoopStop(reader);
+    ProcessorsStopWorkers(reader);
+    ev_async_stop(reader->loop, &reader->ringWatcher);
+    ev_timer_stop(reader->loop, &reader->bitrateWatcher);
+    ev_async_stop(reader->loop, &reader->notificationWatcher);
+    ev_timer_stop(reader->loop, &reader->sectionScheduleWatcher);
+    if (reader->loop != DispatchersGetInput())
+    {
+        ev_loop_destroy(reader->loop);
+    }
+    PropertiesRemoveAllProperties(reader->propertyPath);
     SectionFilterListDescheduleFilters(reader);
     pthread_mutex_destroy(&reader->mutex);
     
@@ -155,22 +362,41 @@ void TSReaderDestroy(TSReader_t* reader)
     
     for (i = 0; i < TSREADER_NROF_FILTERS; i ++)
     {
-        if (reader->packetFilters[i] == NULL)
+        TSPacketDispatchList_t *list = reader->packetDispatch[i];
+        if (list != NULL)
         {
-            TSPacketFilter_t *cur, *next;
+            int e;
             DVBDemuxReleaseFilter(reader->adapter, i);
-            for (cur = reader->packetFilters[i]; cur; cur = next)
+            for (e = 0; e < list->count; e ++)
             {
-                next = cur->next;
-                if (cur->group)
+                if (list->entries[e].group)
                 {
-                    ObjectRefDec(cur);
+                    if (list->entries[e].filter->batch)
+                    {
+                        PacketBatchRelease(reader, list->entries[e].filter->batch);
+                    }
+                    ObjectRefDec(list->entries[e].filter);
                 }
             }
+            ObjectFree(list);
+            reader->packetDispatch[i] = NULL;
         }
     }
     ListFree(reader->activeSectionFilters,NULL);
     ListFree(reader->sectionFilters,NULL);
+    if (reader->pidCounters)
+    {
+        for (i = 0; i < TS_MAX_PIDS; i ++)
+        {
+            free(reader->pidRates[i]);
+        }
+        free(reader->pidRates);
+        free(reader->pidCounters);
+    }
+    TSReaderBufferFree(reader);
+    TSMonitorDeinit(&reader->monitor);
+    pthread_mutex_destroy(&reader->processingMutex);
+    pthread_cond_destroy(&reader->processingCond);
 
     ObjectRefDec(reader);
 }
@@ -178,9 +404,144 @@ void TSReaderDestroy(TSReader_t* reader)
 
 void TSReaderEnable(TSReader_t* reader, bool enable)
 {
-    pthread_mutex_lock(&reader->mutex);
+    TSReaderLock(reader);
     reader->enabled = enable;
+    TSReaderUnLock(reader);
+}
+
+void TSReaderLock(TSReader_t *reader)
+{
+    pthread_t self = pthread_self();
+    TSReaderProcessor_t *processor;
+
+    if ((reader->lockDepth > 0) && pthread_equal(reader->lockOwner, self))
+    {
+        reader->lockDepth ++;
+        return;
+    }
+
+    /* If this is a processor calling from a filter callback it must not be
+     * counted as active while it waits or the holder of the lock would wait
+     * for it in turn. */
+    processor = ProcessorCurrent(reader);
+    if (processor)
+    {
+        pthread_mutex_lock(&reader->processingMutex);
+        reader->activeProcessors --;
+        pthread_cond_broadcast(&reader->processingCond);
+        pthread_mutex_unlock(&reader->processingMutex);
+    }
+
+    pthread_mutex_lock(&reader->mutex);
+
+    /* Wait for all other processors to reach the end of their current slot */
+    pthread_mutex_lock(&reader->processingMutex);
+    reader->stopProcessing = TRUE;
+    while (reader->activeProcessors > 0)
+    {
+        pthread_cond_wait(&reader->processingCond, &reader->processingMutex);
+    }
+    pthread_mutex_unlock(&reader->processingMutex);
+
+    reader->lockOwner = self;
+    reader->lockDepth = 1;
+}
+
+void TSReaderUnLock(TSReader_t *reader)
+{
+    TSReaderProcessor_t *processor;
+
+    reader->lockDepth --;
+    if (reader->lockDepth > 0)
+    {
+        return;
+    }
+
+    if (reader->retiredDispatch)
+    {
+        PacketDispatchListFreeRetired(reader);
+    }
+
+    pthread_mutex_lock(&reader->processingMutex);
+    reader->stopProcessing = FALSE;
+    pthread_cond_broadcast(&reader->processingCond);
+    pthread_mutex_unlock(&reader->processingMutex);
+
     pthread_mutex_unlock(&reader->mutex);
+
+    processor = ProcessorCurrent(reader);
+    if (processor)
+    {
+        pthread_mutex_lock(&reader->processingMutex);
+        while (reader->stopProcessing)
+        {
+            pthread_cond_wait(&reader->processingCond, &reader->processingMutex);
+        }
+        reader->activeProcessors ++;
+        pthread_mutex_unlock(&reader->processingMutex);
+    }
+}
+
+void TSReaderPIDStatsEnable(TSReader_t *reader, bool enable)
+{
+    TSReaderLock(reader);
+    if (enable)
+    {
+        if (reader->pidCounters == NULL)
+        {
+            void *counters;
+            if (posix_memalign(&counters, RINGBUFFER_CACHELINE, TS_MAX_PIDS * sizeof(TSPIDCounters_t)))
+            {
+                LogModule(LOG_ERROR, TSREADER, "Failed to allocate per PID counters!");
+                TSReaderUnLock(reader);
+                return;
+            }
+            reader->pidRates = calloc(TS_MAX_PIDS, sizeof(TSPIDRates_t *));
+            if (reader->pidRates == NULL)
+            {
+                LogModule(LOG_ERROR, TSREADER, "Failed to allocate per PID rates!");
+                free(counters);
+                TSReaderUnLock(reader);
+                return;
+            }
+            reader->pidCounters = counters;
+            PIDStatsZero(reader);
+        }
+        else if (reader->pidStatsUsers == 0)
+        {
+            /* Counts from before statistics were last disabled are stale. */
+            reader->pidStatsReset = TRUE;
+        }
+        reader->pidStatsUsers ++;
+    }
+    else if (reader->pidStatsUsers > 0)
+    {
+        reader->pidStatsUsers --;
+    }
+    TSReaderUnLock(reader);
+}
+
+bool TSReaderPIDStatsGet(TSReader_t *reader, uint16_t pid, TSReaderPIDStats_t *stats)
+{
+    TSPIDCounters_t *counters;
+    TSPIDRates_t *rates;
+    int w;
+
+    if ((reader->pidStatsUsers == 0) || (pid >= TS_MAX_PIDS))
+    {
+        return FALSE;
+    }
+    counters = &reader->pidCounters[pid];
+    stats->packets = counters->packets;
+    stats->ccErrors = counters->ccErrors;
+    stats->scrambled = counters->scrambled;
+    stats->pcrs = counters->pcrs;
+    rates = reader->pidRates[pid];
+    for (w = 0; w < TSREADER_PIDRATE_WINDOWS; w ++)
+    {
+        stats->rates[w] = rates ? rates->rates[w] : 0;
+    }
+    return stats->packets != 0;
 }
 
 TSReaderStats_t *TSReaderExtractStats(TSReader_t *reader)
@@ -188,7 +549,7 @@ TSReaderStats_t *TSReaderExtractStats(TSReader_t *reader)
     ListIterator_t iterator;
     TSReaderStats_t *stats = ObjectCreateType(TSReaderStats_t);
     
-    pthread_mutex_lock(&reader->mutex);
+    TSReaderLock(reader);
 
     /* Clear all filter stats */
     stats->totalPackets = reader->totalPackets;
@@ -204,17 +565,24 @@ TSReaderStats_t *TSReaderExtractStats(TSReader_t *reader)
         filterGroupStats->sectionsProcessed = group->sectionsProcessed;
         StatsAddFilterGroupStats(stats, group->type, filterGroupStats);
     }
-    pthread_mutex_unlock(&reader->mutex);
+    TSReaderUnLock(reader);
     return stats;
 }
 
 void TSReaderZeroStats(TSReader_t* reader)
 {
     ListIterator_t iterator;
-    pthread_mutex_lock(&reader->mutex);
+    TSReaderLock(reader);
     /* Clear all filter stats */
     reader->totalPackets = 0;
     reader->bitrate = 0;
+    reader->ring.highWaterMark = 0;
+    reader->ringDrops = 0;
+    reader->ringLatency = 0;
+    reader->ringLatencyMax = 0;
+    /* Zeroed by the input dispatcher, which is the only thread that updates them. */
+    reader->pidStatsReset = TRUE;
+    reader->monitorReset = TRUE;
 
     for (ListIterator_Init(iterator, reader->groups); ListIterator_MoreEntries(iterator); ListIterator_Next(iterator))
     {
@@ -222,43 +590,42 @@ void TSReaderZeroStats(TSReader_t* reader)
         group->packetsProcessed = 0;
         group->sectionsProcessed = 0;
     }
-    pthread_mutex_unlock(&reader->mutex);
+    TSReaderUnLock(reader);
 }
 
 void TSReaderMultiplexChanged(TSReader_t *reader, Multiplex_t *newmultiplex)
 {
-    struct ev_loop *inputLoop = DispatchersGetInput();
     reader->multiplexChanged = TRUE;
     reader->multiplex = newmultiplex;
     LogModule(LOG_INFO, TSREADER, "Notifying mux changed!");
-    ev_async_send(inputLoop, &reader->notificationWatcher);
+    ev_async_send(reader->loop, &reader->notificationWatcher);
 }
 
 
 void TSReaderSectionFilterOverridePriority(TSReader_t *reader, uint16_t pid, int priority)
 {
     TSSectionFilterList_t *sfList;
-    pthread_mutex_lock(&reader->mutex);    
+    TSReaderLock(reader);    
     sfList = SectionFilterListFind(reader, pid);
     if (sfList)
     {
         sfList->priority = priority;
         sfList->flags |= TSSectFilterListFlags_PRIORITY_OVERRIDE;
     }
-    pthread_mutex_unlock(&reader->mutex);
+    TSReaderUnLock(reader);
 }
 
 void TSReaderSectionFilterResetPriority(TSReader_t *reader, uint16_t pid)
 {
     TSSectionFilterList_t *sfList;
-    pthread_mutex_lock(&reader->mutex);
+    TSReaderLock(reader);
     sfList = SectionFilterListFind(reader, pid);
     if (sfList)
     {
         SectionFilterListUpdatePriority(sfList);
         sfList->flags &= ~TSSectFilterListFlags_PRIORITY_OVERRIDE;
     }
-    pthread_mutex_unlock(&reader->mutex);
+    TSReaderUnLock(reader);
 }
 
 TSFilterGroup_t* TSReaderCreateFilterGroup(TSReader_t *reader, const char *name, const char *type, TSFilterGroupEventCallback_t callback, void *userArg )
@@ -271,9 +638,10 @@ TSFilterGroup_t* TSReaderCreateFilterGroup(TSReader_t *reader, const char *name,
         group->eventCallback = callback;
         group->userArg = userArg;
         group->tsReader = reader;
-        pthread_mutex_lock(&reader->mutex);        
+        TSReaderLock(reader);        
+        group->processor = ProcessorAssign(reader);
         ListAdd(reader->groups, group);
-        pthread_mutex_unlock(&reader->mutex);
+        TSReaderUnLock(reader);
         
     }
     return group;
@@ -283,7 +651,7 @@ TSFilterGroup_t* TSReaderFindFilterGroup(TSReader_t *reader, const char *name, c
 {    
     ListIterator_t iterator;
     TSFilterGroup_t* result = NULL;
-    pthread_mutex_lock(&reader->mutex);
+    TSReaderLock(reader);
     for (ListIterator_Init(iterator, reader->groups); ListIterator_MoreEntries(iterator); ListIterator_Next(iterator))
     {
         TSFilterGroup_t *group = ListIterator_Current(iterator);
@@ -293,7 +661,7 @@ TSFilterGroup_t* TSReaderFindFilterGroup(TSReader_t *reader, const char *name, c
             break;
         }
     }
-    pthread_mutex_unlock(&reader->mutex);
+    TSReaderUnLock(reader);
     return result;
 }
 
@@ -302,19 +670,19 @@ void TSFilterGroupDestroy(TSFilterGroup_t* group)
 {
     LogModule(LOG_DEBUG, TSREADER, "Destroying filter group %s", group->name);
     TSFilterGroupRemoveAllFilters(group);
-    pthread_mutex_lock(&group->tsReader->mutex);
+    TSReaderLock(group->tsReader);
     ListRemove(group->tsReader->groups, group);
-    pthread_mutex_unlock(&group->tsReader->mutex);
+    TSReaderUnLock(group->tsReader);
     ObjectRefDec(group);
 }
 
 void  TSFilterGroupResetStats(TSFilterGroup_t* group)
 {
     LogModule(LOG_DEBUG, TSREADER, "Resetting stats for filter group %s", group->name);
-    pthread_mutex_lock(&group->tsReader->mutex);
+    TSReaderLock(group->tsReader);
     group->packetFilters = 0;
     group->sectionFilters = 0;
-    pthread_mutex_unlock(&group->tsReader->mutex);
+    TSReaderUnLock(group->tsReader);
 }
 
 void TSFilterGroupRemoveAllFilters(TSFilterGroup_t* group)
@@ -324,7 +692,7 @@ void TSFilterGroupRemoveAllFilters(TSFilterGroup_t* group)
     TSSectionFilter_t *sectionFilter;
     TSSectionFilter_t *sectionFilterNext;
     LogModule(LOG_DEBUG, TSREADER, "Removing all filters for filter group %s", group->name);    
-    pthread_mutex_lock(&group->tsReader->mutex);    
+    TSReaderLock(group->tsReader);    
     for (packetFilter = group->packetFilters; packetFilter; packetFilter = packetFilterNext)
     {
         LogModule(LOG_DEBUG, TSREADER, "Removing %p", packetFilter);
@@ -339,12 +707,18 @@ void TSFilterGroupRemoveAllFilters(TSFilterGroup_t* group)
         ObjectRefDec(sectionFilter);
     }
     group->sectionFilters = NULL;
-    pthread_mutex_unlock(&group->tsReader->mutex);    
+    TSReaderUnLock(group->tsReader);    
 }
 
 void TSFilterGroupAddSectionFilter(TSFilterGroup_t *group, uint16_t pid, int priority, dvbpsi_handle handle)
+{
+    TSFilterGroupAddSectionFilterMatch(group, pid, priority, handle, NULL);
+}
+
+void TSFilterGroupAddSectionFilterMatch(TSFilterGroup_t *group, uint16_t pid, int priority, dvbpsi_handle handle, const TSSectionMatch_t *match)
 {
     TSSectionFilter_t *sectionFilter;
+    int i;
 
     CHECK_PID_VALID(pid);
     
@@ -353,12 +727,26 @@ void TSFilterGroupAddSectionFilter(TSFilterGroup_t *group, uint16_t pid, int pri
     sectionFilter->priority = priority;
     sectionFilter->sectionHandle = handle;
     sectionFilter->group = group;
+    if (match)
+    {
+        sectionFilter->match = *match;
+        for (i = 0; i < TSSECTIONMATCH_SIZE; i ++)
+        {
+            if (match->mask[i])
+            {
+                sectionFilter->matchDepth = i + 1;
+            }
+        }
+    }
     LogModule(LOG_DEBUG, TSREADER, "Adding section filter 0x%04x for filter group %s", pid, group->name);    
-    pthread_mutex_lock(&group->tsReader->mutex); 
+    TSReaderLock(group->tsReader); 
     sectionFilter->next = group->sectionFilters;
     group->sectionFilters = sectionFilter;
+    /* Section filters are run on the input dispatcher, keep the rest of the
+     * group there as well so its callbacks aren't run concurrently. */
+    group->processor = 0;
     SectionFilterListAddFilter(group->tsReader, sectionFilter);
-    pthread_mutex_unlock(&group->tsReader->mutex);       
+    TSReaderUnLock(group->tsReader);       
 }
 
 void TSFilterGroupRemoveSectionFilter(TSFilterGroup_t *group, uint16_t pid)
@@ -369,7 +757,7 @@ void TSFilterGroupRemoveSectionFilter(TSFilterGroup_t *group, uint16_t pid)
     CHECK_PID_VALID(pid);
     
     LogModule(LOG_DEBUG, TSREADER, "Removing section filter 0x%04x for filter group %s", pid, group->name);        
-    pthread_mutex_lock(&group->tsReader->mutex); 
+    TSReaderLock(group->tsReader); 
     for (sectionFilter = group->sectionFilters; sectionFilter; sectionFilter = sectionFilter->next)
     {
         if (sectionFilter->pid == pid)
@@ -388,46 +776,46 @@ void TSFilterGroupRemoveSectionFilter(TSFilterGroup_t *group, uint16_t pid)
         }
         sectionFilterPrev = sectionFilter;
     }
-    pthread_mutex_unlock(&group->tsReader->mutex);
+    TSReaderUnLock(group->tsReader);
 }
 
 bool TSFilterGroupAddPacketFilter(TSFilterGroup_t *group, uint16_t pid, TSPacketFilterCallback_t callback, void *userArg)
 {
-    TSPacketFilter_t *packetFilter;
-    bool result = TRUE;
+    return FilterGroupAddPacketFilter(group, pid, callback, userArg, NULL);
+}
 
-    if (pid > TSREADER_PID_ALL)
-    {
-        LogModule(LOG_INFO, TSREADER, "Invalid PID %u supplied to %s", pid, __func__);
-        return FALSE;
-    }
-    
+bool TSFilterGroupAddPacketBatchFilter(TSFilterGroup_t *group, uint16_t pid, TSPacketBatchFilterCallback_t callback, void *userArg)
+{
+    TSPacketFilter_t *packetFilter;
+    TSPacketBatch_t *batch = NULL;
+    bool result;
 
-    pthread_mutex_lock(&group->tsReader->mutex);
+    TSReaderLock(group->tsReader);
+    /* Share the batch with any other filters for the same callback so that
+     * packets on all of the PIDs are delivered in stream order. */
     for (packetFilter = group->packetFilters; packetFilter; packetFilter = packetFilter->next)
     {
-        if (packetFilter->pid == pid)
+        if (packetFilter->batch && (packetFilter->batch->callback == callback) && (packetFilter->batch->userArg == userArg))
         {
-            LogModule(LOG_DEBUG, TSREADER, "PID 0x%04x is already being packet filtered for filter group %s", pid, group->name);
-            result = FALSE;
+            batch = packetFilter->batch;
+            ObjectRefInc(batch);
             break;
         }
     }
-    if (result)
+    if (batch == NULL)
     {
-        LogModule(LOG_DEBUG, TSREADER, "Adding packet filter 0x%04x for filter group %s", pid, group->name);
-        packetFilter = PacketFilterListAddFilter(group->tsReader, group, pid, callback, userArg); 
-        if (packetFilter != NULL)
-        {
-            packetFilter->next = group->packetFilters;
-            group->packetFilters = packetFilter;
-        }
-        else
-        {        
-            result = FALSE;
-        }
+        batch = ObjectCreateType(TSPacketBatch_t);
+        batch->callback = callback;
+        batch->userArg = userArg;
+        batch->group = group;
+    }
+    batch->filterCount ++;
+    result = FilterGroupAddPacketFilter(group, pid, PacketBatchAppend, batch, batch);
+    if (!result)
+    {
+        PacketBatchRelease(group->tsReader, batch);
     }
-    pthread_mutex_unlock(&group->tsReader->mutex);
+    TSReaderUnLock(group->tsReader);
     return result;
 }
 
@@ -439,7 +827,7 @@ void TSFilterGroupRemovePacketFilter(TSFilterGroup_t *group, uint16_t pid)
     CHECK_PID_VALID(pid);
     
     LogModule(LOG_DEBUG, TSREADER, "Removing packet filter 0x%04x for filter group %s", pid, group->name);        
-    pthread_mutex_lock(&group->tsReader->mutex);
+    TSReaderLock(group->tsReader);
     for (packetFilter = group->packetFilters; packetFilter; packetFilter = packetFilter->next)
     {
         if (packetFilter->pid == pid)
@@ -457,7 +845,7 @@ void TSFilterGroupRemovePacketFilter(TSFilterGroup_t *group, uint16_t pid)
         }
         packetFilterPrev = packetFilter;
     }
-    pthread_mutex_unlock(&group->tsReader->mutex);
+    TSReaderUnLock(group->tsReader);
 }
 
 
@@ -504,6 +892,47 @@ static void StatsAddFilterGroupStats(TSReaderStats_t *stats, const char *type, T
     typeStats->groups = filterGroupStats;
 }
 
+static bool FilterGroupAddPacketFilter(TSFilterGroup_t *group, uint16_t pid, TSPacketFilterCallback_t callback, void *userArg, TSPacketBatch_t *batch)
+{
+    TSPacketFilter_t *packetFilter;
+    bool result = TRUE;
+
+    if (pid > TSREADER_PID_ALL)
+    {
+        LogModule(LOG_INFO, TSREADER, "Invalid PID %u supplied to %s", pid, __func__);
+        return FALSE;
+    }
+    
+
+    TSReaderLock(group->tsReader);
+    for (packetFilter = group->packetFilters; packetFilter; packetFilter = packetFilter->next)
+    {
+        if (packetFilter->pid == pid)
+        {
+            LogModule(LOG_DEBUG, TSREADER, "PID 0x%04x is already being packet filtered for filter group %s", pid, group->name);
+            result = FALSE;
+            break;
+        }
+    }
+    if (result)
+    {
+        LogModule(LOG_DEBUG, TSREADER, "Adding packet filter 0x%04x for filter group %s", pid, group->name);
+        packetFilter = PacketFilterListAddFilter(group->tsReader, group, pid, callback, userArg); 
+        if (packetFilter != NULL)
+        {
+            packetFilter->batch = batch;
+            packetFilter->next = group->packetFilters;
+            group->packetFilters = packetFilter;
+        }
+        else
+        {        
+            result = FALSE;
+        }
+    }
+    TSReaderUnLock(group->tsReader);
+    return result;
+}
+
 static void PromiscusModeEnable(TSReader_t *reader, bool enable)
 {
     int i;
@@ -515,7 +944,7 @@ static void PromiscusModeEnable(TSReader_t *reader, bool enable)
 
     for (i = 0; i < TSREADER_NROF_FILTERS; i ++)
     {
-        if (reader->packetFilters[i])
+        if (reader->packetDispatch[i])
         {
             if (enable)
             {
@@ -544,7 +973,7 @@ static void PromiscusModeEnable(TSReader_t *reader, bool enable)
 static TSPacketFilter_t * PacketFilterListAddFilter(TSReader_t *reader, TSFilterGroup_t *group, uint16_t pid, TSPacketFilterCallback_t callback, void *userArg)
 {
     TSPacketFilter_t *packetFilter;
-    if (reader->packetFilters[pid] == NULL)
+    if (reader->packetDispatch[pid] == NULL)
     {
         if (!reader->promiscuousMode && (pid != TSREADER_PID_ALL))
         {
@@ -553,7 +982,7 @@ static TSPacketFilter_t * PacketFilterListAddFilter(TSReader_t *reader, TSFilter
             
             for (p = 0; p < TSREADER_NROF_FILTERS; p ++)
             {
-                pidCount += (reader->packetFilters[p] != NULL) ?  1:0;
+                pidCount += (reader->packetDispatch[p] != NULL) ?  1:0;
             }
 
             freePIDCount = DVBDemuxGetMaxFilters(reader->adapter) - pidCount;
@@ -607,84 +1036,250 @@ static TSPacketFilter_t * PacketFilterListAddFilter(TSReader_t *reader, TSFilter
     packetFilter->group = group;
     packetFilter->callback = callback;
     packetFilter->userArg = userArg;
-    packetFilter->flNext = reader->packetFilters[pid];
-    reader->packetFilters[pid] = packetFilter;
+    PacketDispatchListRebuild(reader, pid, packetFilter, NULL);
     return packetFilter;
 }
 
 static void PacketFilterListRemoveFilter(TSReader_t *reader, TSPacketFilter_t *packetFilter)
 {
-    TSPacketFilter_t *cur = NULL;
-    TSPacketFilter_t *prev = NULL;
+    uint16_t pid = packetFilter->pid;
 
-    LogModule(LOG_DEBUG, TSREADER, "Removing packet filter %p on pid 0x%02x", packetFilter, packetFilter->pid);
-    if (reader->currentlyProcessingPid == (packetFilter->pid & ~PACKET_FILTER_DISABLED))
+    LogModule(LOG_DEBUG, TSREADER, "Removing packet filter %p on pid 0x%02x", packetFilter, pid);
+    PacketDispatchListRebuild(reader, pid, NULL, packetFilter);
+    if (reader->packetDispatch[pid] == NULL)
     {
-        LogModule(LOG_DEBUG, TSREADER, "Removing packet filter (replaced with NULL)");
-        packetFilter->pid |= PACKET_FILTER_DISABLED;
-        return;
+        if (!reader->promiscuousMode && (pid != TSREADER_PID_ALL))
+        {
+            DVBDemuxReleaseFilter(reader->adapter, pid);
+        }
+        if (reader->processors[0].currentlyProcessingPid == pid)
+        {
+            reader->rescheduleSectionFilters = TRUE;
+        }
     }
-    for (cur = reader->packetFilters[packetFilter->pid]; cur; cur = cur->flNext)
+    if (packetFilter->batch)
+    {
+        PacketBatchRelease(reader, packetFilter->batch);
+    }
+    ObjectRefDec(packetFilter);
+}
+
+static void PacketDispatchListRebuild(TSReader_t *reader, uint16_t pid, TSPacketFilter_t *add, TSPacketFilter_t *remove)
+{
+    TSPacketDispatchList_t *oldList = reader->packetDispatch[pid];
+    TSPacketDispatchList_t *newList;
+    int oldCount = oldList ? oldList->count : 0;
+    int i, p, count = 0;
+    bool inUse = FALSE;
+
+    /* If the filter being removed is in a list currently being dispatched
+     * make sure it isn't called for the remainder of this packet.
+     */
+    for (p = 0; p <= TSREADER_MAX_WORKERS; p ++)
     {
-        if (cur == packetFilter)
+        TSReaderProcessor_t *processor = &reader->processors[p];
+        if (remove && processor->dispatching && (processor->currentlyProcessingPid == pid))
         {
-            break;
+            for (i = 0; i < processor->dispatching->count; i ++)
+            {
+                if (processor->dispatching->entries[i].filter == remove)
+                {
+                    processor->dispatching->entries[i].callback = NULL;
+                }
+            }
+        }
+        if (oldList && (processor->dispatching == oldList))
+        {
+            inUse = TRUE;
+        }
+    }
+
+    newList = ObjectAlloc(sizeof(TSPacketDispatchList_t) + ((oldCount + 1) * sizeof(TSPacketDispatchEntry_t)));
+    if (add)
+    {
+        newList->entries[count].callback = add->callback;
+        newList->entries[count].userArg = add->userArg;
+        newList->entries[count].group = add->group;
+        newList->entries[count].filter = add;
+        count ++;
+    }
+    for (i = 0; i < oldCount; i ++)
+    {
+        if ((oldList->entries[i].filter == remove) || (oldList->entries[i].callback == NULL))
+        {
+            continue;
         }
-        prev = cur;
+        newList->entries[count] = oldList->entries[i];
+        count ++;
+    }
+    newList->count = count;
+    if (count == 0)
+    {
+        ObjectFree(newList);
+        newList = NULL;
     }
-    if (cur == packetFilter)
+
+    reader->packetDispatch[pid] = newList;
+
+    if (oldList)
     {
-        if (prev == NULL)
+        if (inUse)
         {
-            reader->packetFilters[packetFilter->pid] = cur->flNext;
+            oldList->retiredNext = reader->retiredDispatch;
+            reader->retiredDispatch = oldList;
         }
         else
         {
-            prev->flNext = cur->flNext;
+            ObjectFree(oldList);
         }
     }
-    if (reader->packetFilters[packetFilter->pid] == NULL)
+}
+
+static void PacketDispatchListFreeRetired(TSReader_t *reader)
+{
+    TSPacketDispatchList_t *list, *next;
+    TSPacketDispatchList_t *keep = NULL;
+    int p;
+
+    for (list = reader->retiredDispatch; list; list = next)
     {
-        if (!reader->promiscuousMode && (packetFilter->pid != TSREADER_PID_ALL))
+        next = list->retiredNext;
+        /* Another processor may still be part way through the list */
+        for (p = 0; p <= TSREADER_MAX_WORKERS; p ++)
+        {
+            if (reader->processors[p].dispatching == list)
+            {
+                break;
+            }
+        }
+        if (p <= TSREADER_MAX_WORKERS)
+        {
+            list->retiredNext = keep;
+            keep = list;
+        }
+        else
         {
-            DVBDemuxReleaseFilter(reader->adapter, packetFilter->pid);
+            ObjectFree(list);
         }
     }
-    ObjectRefDec(packetFilter);
+    reader->retiredDispatch = keep;
 }
 
-static TSSectionFilterList_t * SectionFilterListCreate(TSReader_t *reader, uint16_t pid)
+static void PacketBatchAppend(void *userArg, struct TSFilterGroup_t *group, TSPacket_t *packet)
 {
-    TSSectionFilterList_t *sfList = ObjectCreateType(TSSectionFilterList_t);
-    sfList->pid = pid;
-    sfList->filters = ListCreate();
-    sfList->tsReader = reader;
-    sfList->sectionHandle = dvbpsi_AttachSections(SectionFilterListPushSection, sfList);
-    ListAdd(reader->sectionFilters, sfList);
-    return sfList;
-}
+    TSPacketBatch_t *batch = userArg;
 
-static void SectionFilterListDestroy(TSReader_t *reader, TSSectionFilterList_t *sfList)
-{
-    if (ListRemove(reader->activeSectionFilters, sfList))
+    if (!batch->pending)
     {
-        LogModule(LOG_DEBUG, TSREADER, "Removed active section filter %p", sfList);
-        PacketFilterListRemoveFilter(reader, sfList->packetFilter);
+        TSReaderProcessor_t *processor = &group->tsReader->processors[group->processor];
+        batch->pendingNext = processor->pendingBatches;
+        processor->pendingBatches = batch;
+        batch->pending = TRUE;
     }
-    else
+    batch->packets[batch->count] = packet;
+    batch->count ++;
+    if (batch->count == TSREADER_BATCH_MAX_PACKETS)
     {
-        LogModule(LOG_DEBUG, TSREADER, "Removed section filter %p", sfList);
-        ListRemove(reader->sectionFilters, sfList);
+        PacketBatchDeliver(batch);
     }
-
-    ListFree(sfList->filters, NULL);
-    dvbpsi_DetachSections(sfList->sectionHandle);
-    ObjectRefDec(sfList);
 }
 
-static void SectionFilterListAddFilter(TSReader_t *reader, TSSectionFilter_t *filter)
+static void PacketBatchDeliver(TSPacketBatch_t *batch)
 {
-    TSSectionFilterList_t *sfList = SectionFilterListFind(reader, filter->pid);
+    int count = batch->count;
+    if (count)
+    {
+        batch->count = 0;
+        /* Hold a reference in case the callback removes the last filter. */
+        ObjectRefInc(batch);
+        batch->callback(batch->userArg, batch->group, batch->packets, count);
+        ObjectRefDec(batch);
+    }
+}
+
+static void PacketBatchRelease(TSReader_t *reader, TSPacketBatch_t *batch)
+{
+    batch->filterCount --;
+    if ((batch->filterCount == 0) && batch->pending)
+    {
+        TSPacketBatch_t *cur, *prev;
+        int p;
+        /* No filters left so any outstanding packets are dropped. */
+        for (p = 0; p <= TSREADER_MAX_WORKERS; p ++)
+        {
+            prev = NULL;
+            for (cur = reader->processors[p].pendingBatches; cur; cur = cur->pendingNext)
+            {
+                if (cur == batch)
+                {
+                    if (prev)
+                    {
+                        prev->pendingNext = cur->pendingNext;
+                    }
+                    else
+                    {
+                        reader->processors[p].pendingBatches = cur->pendingNext;
+                    }
+                    break;
+                }
+                prev = cur;
+            }
+        }
+        batch->pending = FALSE;
+        batch->count = 0;
+    }
+    ObjectRefDec(batch);
+}
+
+static void PacketBatchDeliverAll(TSReaderProcessor_t *processor)
+{
+    TSPacketBatch_t *batch;
+    while ((batch = processor->pendingBatches) != NULL)
+    {
+        processor->pendingBatches = batch->pendingNext;
+        batch->pendingNext = NULL;
+        batch->pending = FALSE;
+        PacketBatchDeliver(batch);
+    }
+}
+
+static TSSectionFilterList_t * SectionFilterListCreate(TSReader_t *reader, uint16_t pid)
+{
+    TSSectionFilterList_t *sfList = ObjectCreateType(TSSectionFilterList_t);
+    sfList->pid = pid;
+    sfList->filters = ListCreate();
+    sfList->tsReader = reader;
+    sfList->acquireStart = ev_time();
+    sfList->waitingSince = sfList->acquireStart;
+    sfList->firstSectionTime = -1.0;
+    SectionCacheInit(&sfList->cache, SECTIONCACHE_MAX_SIZE);
+    sfList->sectionHandle = dvbpsi_AttachSections(SectionFilterListPushSection, sfList);
+    ListAdd(reader->sectionFilters, sfList);
+    return sfList;
+}
+
+static void SectionFilterListDestroy(TSReader_t *reader, TSSectionFilterList_t *sfList)
+{
+    if (ListRemove(reader->activeSectionFilters, sfList))
+    {
+        LogModule(LOG_DEBUG, TSREADER, "Removed active section filter %p", sfList);
+        PacketFilterListRemoveFilter(reader, sfList->packetFilter);
+    }
+    else
+    {
+        LogModule(LOG_DEBUG, TSREADER, "Removed section filter %p", sfList);
+        ListRemove(reader->sectionFilters, sfList);
+    }
+
+    ListFree(sfList->filters, NULL);
+    dvbpsi_DetachSections(sfList->sectionHandle);
+    SectionCacheDeinit(&sfList->cache);
+    ObjectRefDec(sfList);
+}
+
+static void SectionFilterListAddFilter(TSReader_t *reader, TSSectionFilter_t *filter)
+{
+    TSSectionFilterList_t *sfList = SectionFilterListFind(reader, filter->pid);
     if (sfList == NULL)
     {
         sfList = SectionFilterListCreate(reader, filter->pid);
@@ -694,7 +1289,10 @@ static void SectionFilterListAddFilter(TSReader_t *reader, TSSectionFilter_t *fi
         }
     }
     ListAdd(sfList->filters, filter);
+    /* The new filter needs to see every section at least once. */
+    SectionCacheFlush(&sfList->cache);
     SectionFilterListUpdatePriority(sfList);
+    SectionFilterListUpdateMatch(sfList);
     SectionFilterListScheduleFilters(reader);
 }
 
@@ -711,6 +1309,7 @@ static void SectionFilterListRemoveFilter(TSReader_t *reader, TSSectionFilter_t
         else
         {
             SectionFilterListUpdatePriority(sfList);
+            SectionFilterListUpdateMatch(sfList);
         }
     }
 }
@@ -745,6 +1344,92 @@ static void SectionFilterListUpdatePriority(TSSectionFilterList_t *sfList)
     sfList->priority = currentPriority;
 }
 
+/*
+ * Work out how much of each section has to be checked before it is 
+ * reassembled, nothing can be skipped if any filter wants every section.
+ */
+static void SectionFilterListUpdateMatch(TSSectionFilterList_t *sfList)
+{
+    ListIterator_t iterator;
+    int depth = 0;
+
+    ListIterator_ForEach(iterator, sfList->filters)
+    {
+        TSSectionFilter_t *filter = ListIterator_Current(iterator);
+        if (filter->matchDepth == 0)
+        {
+            depth = 0;
+            break;
+        }
+        if (filter->matchDepth > depth)
+        {
+            depth = filter->matchDepth;
+        }
+    }
+
+    if (depth != sfList->matchDepth)
+    {
+        sfList->matchDepth = depth;
+        /* Byte n of the match is byte n + 2 of the section, except the table_id. */
+        dvbpsi_SetHeaderFilter(sfList->sectionHandle, depth ? SectionFilterListHeaderFilter : NULL, 
+            sfList, depth + 2);
+    }
+}
+
+static int SectionFilterListHeaderFilter(void *userArg, const uint8_t *header, int size)
+{
+    TSSectionFilterList_t *sfList = userArg;
+    ListIterator_t iterator;
+
+    ListIterator_ForEach(iterator, sfList->filters)
+    {
+        if (SectionFilterMatch(ListIterator_Current(iterator), header, size))
+        {
+            return 1;
+        }
+    }
+    sfList->filteredSections ++;
+    return 0;
+}
+
+/*
+ * Check the first length bytes of a section against a filter's match, in the
+ * same way as the Linux DVB demux does.
+ */
+static bool SectionFilterMatch(TSSectionFilter_t *filter, const uint8_t *section, int length)
+{
+    TSSectionMatch_t *match = &filter->match;
+    bool negative = FALSE;
+    uint8_t differs = 0;
+    int i;
+
+    for (i = 0; i < filter->matchDepth; i ++)
+    {
+        int offset = i ? i + 2 : 0;
+        uint8_t bits;
+
+        if (match->mask[i] == 0)
+        {
+            continue;
+        }
+        if (offset >= length)
+        {
+            return FALSE;
+        }
+        bits = (section[offset] ^ match->filter[i]) & match->mask[i];
+        if (bits & ~match->mode[i])
+        {
+            return FALSE;
+        }
+        differs |= bits & match->mode[i];
+        if (match->mask[i] & match->mode[i])
+        {
+            negative = TRUE;
+        }
+    }
+    return !negative || differs;
+}
+
 static TSSectionFilterList_t * SectionFilterListFind(TSReader_t *reader, uint16_t pid)
 {
     ListIterator_t iterator;
@@ -770,21 +1455,89 @@ static TSSectionFilterList_t * SectionFilterListFind(TSReader_t *reader, uint16_
 
 static void SectionFilterListScheduleFilters(TSReader_t *reader)
 {
-    ListIterator_t iterator;
+    ev_tstamp now = ev_time();
     LogModule(LOG_DEBUG, TSREADER, "Scheduling section filters");
-    /* TODO: Take into account priority */
-    for (ListIterator_Init(iterator, reader->sectionFilters); ListIterator_MoreEntries(iterator);)
+    while (ListCount(reader->sectionFilters))
     {
-        TSSectionFilterList_t *sfList = ListIterator_Current(iterator);
+        TSSectionFilterList_t *sfList = SectionFilterListNextToSchedule(reader, now);
         sfList->flags |= TSSectFilterListFlags_PAYLOAD_START;
+        sfList->flags &= ~(TSSectFilterListFlags_CC_VALID | TSSectFilterListFlags_CYCLE_DONE);
         sfList->packetFilter = PacketFilterListAddFilter(reader, NULL, sfList->pid, SectionFilterListPacketCallback, sfList);
         if (sfList->packetFilter == NULL)
         {
             break;
         }
-        ListRemoveCurrent(&iterator);
+        ListRemove(reader->sectionFilters, sfList);
         ListAdd(reader->activeSectionFilters, sfList);
+        sfList->slotStart = now;
+        sfList->slotSections = 0;
+        sfList->slots ++;
+    }
+}
+
+/*
+ * Pick the waiting section filter that should be given the next PID filter.
+ */
+static TSSectionFilterList_t *SectionFilterListNextToSchedule(TSReader_t *reader, ev_tstamp now)
+{
+    ListIterator_t iterator;
+    TSSectionFilterList_t *best = NULL;
+
+    ListIterator_ForEach(iterator, reader->sectionFilters)
+    {
+        TSSectionFilterList_t *sfList = ListIterator_Current(iterator);
+        if ((best == NULL) || SectionFilterListRanksBefore(sfList, best, now))
+        {
+            best = sfList;
+        }
+    }
+    return best;
+}
+
+/*
+ * Filters that have not received a section since they were added (or the 
+ * multiplex changed) go first, most important (lowest priority value) first, 
+ * so PAT/PMT/SDT acquisition isn't held up by EPG or DSM-CC PIDs. The rest
+ * are ordered by how long they have been waiting, weighted by priority.
+ */
+static bool SectionFilterListRanksBefore(TSSectionFilterList_t *a, TSSectionFilterList_t *b, ev_tstamp now)
+{
+    bool aAcquired = a->firstSectionTime >= 0.0;
+    bool bAcquired = b->firstSectionTime >= 0.0;
+    double aUrgency, bUrgency;
+
+    if (aAcquired != bAcquired)
+    {
+        return !aAcquired;
+    }
+    if (!aAcquired && (a->priority != b->priority))
+    {
+        return a->priority < b->priority;
     }
+    aUrgency = (now - a->waitingSince) / ((a->priority < 0) ? 1 : a->priority + 2);
+    bUrgency = (now - b->waitingSince) / ((b->priority < 0) ? 1 : b->priority + 2);
+    return aUrgency > bUrgency;
+}
+
+/*
+ * Only worth descheduling a section filter if that frees up a PID filter, ie
+ * no packet filters are using the PID.
+ */
+static bool SectionFilterListCanDeschedule(TSSectionFilterList_t *sfList)
+{
+    TSPacketDispatchList_t *list = sfList->tsReader->packetDispatch[sfList->pid];
+    return list && (list->count == 1) && (list->entries[0].filter == sfList->packetFilter);
+}
+
+static void SectionFilterListDeschedule(TSReader_t *reader, TSSectionFilterList_t *sfList, ev_tstamp now)
+{
+    LogModule(LOG_DEBUG, TSREADER, "Descheduling 0x%04x after %dms (%u sections)", sfList->pid, 
+        (int)((now - sfList->slotStart) * 1000), sfList->slotSections);
+    ListRemove(reader->activeSectionFilters, sfList);
+    ListAdd(reader->sectionFilters, sfList);
+    PacketFilterListRemoveFilter(reader, sfList->packetFilter);
+    sfList->packetFilter = NULL;
+    sfList->waitingSince = now;
 }
 
 static void SectionFilterListDescheduleFilters(TSReader_t *reader)
@@ -811,7 +1564,7 @@ static void SectionFilterListDescheduleOneFilter(TSReader_t *reader)
     {
         TSSectionFilterList_t *sfList = ListIterator_Current(iterator);
 
-        if ((reader->packetFilters[sfList->pid] == sfList->packetFilter) && (sfList->packetFilter->flNext == NULL))
+        if (SectionFilterListCanDeschedule(sfList))
         {
             if ((toDeschedule == NULL) || (toDeschedule->priority < sfList->priority))
             {
@@ -822,11 +1575,88 @@ static void SectionFilterListDescheduleOneFilter(TSReader_t *reader)
     if (toDeschedule)
     {
         LogModule(LOG_DEBUG, TSREADER, "Chose %d to deschedule.", toDeschedule->pid);
-        ListRemove(reader->activeSectionFilters, toDeschedule);
-        ListAdd(reader->sectionFilters, toDeschedule);
-        PacketFilterListRemoveFilter(reader, toDeschedule->packetFilter);
-        toDeschedule->packetFilter = NULL;
+        SectionFilterListDeschedule(reader, toDeschedule, ev_time());
+    }
+}
+
+/*
+ * Time slices the section filters while some are waiting for a PID filter. A
+ * filter keeps its PID filter until the sections on the PID have repeated 
+ * (see SectionFilterListTrackCycle) or the maximum dwell time is up. Filters
+ * that have not yet received a section can take over from a less important 
+ * filter once it has had the minimum dwell time.
+ */
+static void SectionFilterListScheduleCallback(struct ev_loop *loop, ev_timer *w, int revents)
+{
+    TSReader_t *reader = (TSReader_t*)w->data;
+    TSSectionFilterList_t *waiting;
+    TSSectionFilterList_t *victim = NULL;
+    ListIterator_t iterator;
+    ev_tstamp now;
+    bool descheduled = FALSE;
+
+    /* Nothing to do (the usual case), don't pause the processors to find out. */
+    if (ListCount(reader->sectionFilters) == 0)
+    {
+        return;
+    }
+    TSReaderLock(reader);
+    if (ListCount(reader->sectionFilters) == 0)
+    {
+        TSReaderUnLock(reader);
+        return;
+    }
+
+    now = ev_time();
+    for (ListIterator_Init(iterator, reader->activeSectionFilters); ListIterator_MoreEntries(iterator);)
+    {
+        TSSectionFilterList_t *sfList = ListIterator_Current(iterator);
+        double dwell = reader->sectionMaxDwell / 1000.0;
+
+        ListIterator_Next(iterator);
+        /* No point waiting much longer than the sections take to repeat. */
+        if ((sfList->cycleTime > 0.0) && ((sfList->cycleTime * 2) + SECTION_MIN_DWELL < dwell))
+        {
+            dwell = (sfList->cycleTime * 2) + SECTION_MIN_DWELL;
+        }
+        if (SectionFilterListCanDeschedule(sfList) && (now - sfList->slotStart >= dwell))
+        {
+            SectionFilterListDeschedule(reader, sfList, now);
+            descheduled = TRUE;
+        }
+    }
+
+    if (!descheduled)
+    {
+        waiting = SectionFilterListNextToSchedule(reader, now);
+        if (waiting->firstSectionTime < 0.0)
+        {
+            ListIterator_ForEach(iterator, reader->activeSectionFilters)
+            {
+                TSSectionFilterList_t *sfList = ListIterator_Current(iterator);
+                if (!SectionFilterListCanDeschedule(sfList) || (now - sfList->slotStart < SECTION_MIN_DWELL))
+                {
+                    continue;
+                }
+                if (((sfList->firstSectionTime >= 0.0) || (sfList->priority > waiting->priority)) &&
+                    ((victim == NULL) || (sfList->priority > victim->priority)))
+                {
+                    victim = sfList;
+                }
+            }
+        }
+        if (victim)
+        {
+            SectionFilterListDeschedule(reader, victim, now);
+            descheduled = TRUE;
+        }
+    }
+
+    if (descheduled)
+    {
+        SectionFilterListScheduleFilters(reader);
     }
+    TSReaderUnLock(reader);
 }
 
 
@@ -841,6 +1671,27 @@ static void SectionFilterListPacketCallback(void *userArg, struct TSFilterGroup_
         }
         sfList->flags &= ~TSSectFilterListFlags_PAYLOAD_START;
     }
+
+    /* 
+     * A discontinuity means the cached sections may no longer describe what 
+     * is being broadcast, so start again. Gaps while the filter was not 
+     * scheduled are not counted as the CC is only tracked while scheduled.
+     */
+    if (TSPACKET_ISDISCONTINUITY(*packet))
+    {
+        SectionCacheFlush(&sfList->cache);
+    }
+    if (TSPACKET_GETADAPTATION(*packet) & 0x1)
+    {
+        uint8_t cc = TSPACKET_GETCOUNT(*packet);
+        if ((sfList->flags & TSSectFilterListFlags_CC_VALID) && 
+            (cc != sfList->lastCC) && (cc != ((sfList->lastCC + 1) & 0xf)))
+        {
+            SectionCacheFlush(&sfList->cache);
+        }
+        sfList->lastCC = cc;
+        sfList->flags |= TSSectFilterListFlags_CC_VALID;
+    }
     dvbpsi_PushPacket(sfList->sectionHandle, (uint8_t *) packet);
 }
 
@@ -849,138 +1700,903 @@ static void SectionFilterListPushSection(void *userArg, dvbpsi_handle sectionsHa
     TSSectionFilterList_t *sfList = userArg;
     ListIterator_t iterator;
     dvbpsi_psi_section_t *cloned;
+
+    if (sfList->firstSectionTime < 0.0)
+    {
+        sfList->firstSectionTime = ev_time() - sfList->acquireStart;
+        LogModule(LOG_DEBUG, TSREADER, "First section on 0x%04x after %dms", sfList->pid, 
+            (int)(sfList->firstSectionTime * 1000));
+    }
+    SectionFilterListTrackCycle(sfList, section);
     
-    for (ListIterator_Init(iterator, sfList->filters); ListIterator_MoreEntries(iterator); ListIterator_Next(iterator))
+    if (SectionCacheCheck(&sfList->cache, section))
     {
-        TSSectionFilter_t *filter = ListIterator_Current(iterator);
-        cloned = dvbpsi_ClonePSISection(filter->sectionHandle, section);
-        if (filter->group)
+        for (ListIterator_Init(iterator, sfList->filters); ListIterator_MoreEntries(iterator); ListIterator_Next(iterator))
         {
-            filter->group->sectionsProcessed ++;
+            TSSectionFilter_t *filter = ListIterator_Current(iterator);
+            if (filter->matchDepth && !SectionFilterMatch(filter, section->p_data, section->i_length + 3))
+            {
+                continue;
+            }
+            /* Clones share the section data, so this does not copy it. */
+            cloned = dvbpsi_ClonePSISection(filter->sectionHandle, section);
+            if (cloned == NULL)
+            {
+                continue;
+            }
+            if (filter->group)
+            {
+                filter->group->sectionsProcessed ++;
+            }
+            dvbpsi_PushSection(filter->sectionHandle, cloned);
         }
-        dvbpsi_PushSection(filter->sectionHandle, cloned);
     }
     
     dvbpsi_ReleasePSISections(sfList->sectionHandle, section);
 
-    if (sfList->packetFilter && ListCount(sfList->tsReader->sectionFilters))
+    /* Everything on the PID has been seen, give another filter a go. */
+    if (sfList->packetFilter && ListCount(sfList->tsReader->sectionFilters) && 
+        (sfList->flags & TSSectFilterListFlags_CYCLE_DONE))
     {
-        ListRemove(sfList->tsReader->activeSectionFilters, sfList);
-        ListAdd(sfList->tsReader->sectionFilters, sfList);
-        PacketFilterListRemoveFilter(sfList->tsReader, sfList->packetFilter);
-        sfList->packetFilter = NULL;
+        SectionFilterListDeschedule(sfList->tsReader, sfList, ev_time());
     }
 }
 
-static void TSReaderDVRCallback(struct ev_loop *loop, ev_io *w, int revents)
+/*
+ * Works out how long the sections on a PID take to repeat by timing how long
+ * it takes for the first section of a slot to come round again, at which 
+ * point the slot has seen everything being broadcast on the PID.
+ */
+static void SectionFilterListTrackCycle(TSSectionFilterList_t *sfList, dvbpsi_psi_section_t *section)
 {
-    TSReader_t *reader = (TSReader_t*)w->data;
-    DVBAdapter_t *adapter = reader->adapter;
-    int count, p;
-  
-    count = read(DVBDVRGetFD(adapter), (char*)reader->buffer, sizeof(reader->buffer));
-    if (!DVBFrontEndIsLocked(adapter) || !reader->enabled)
+    uint32_t key = (section->i_table_id << 24) | (section->i_extension << 8) | section->i_number;
+
+    if (sfList->slotSections ++ == 0)
     {
-        return;
+        sfList->slotFirstKey = key;
+        sfList->slotFirstTime = ev_time();
     }
-    pthread_mutex_lock(&reader->mutex);
-    for (p = 0; (p < (count / TSPACKET_SIZE)) && reader->enabled; p ++)
+    else if ((key == sfList->slotFirstKey) && !(sfList->flags & TSSectFilterListFlags_CYCLE_DONE))
     {
-        if (!TSPACKET_ISVALID(reader->buffer[p]))
-        {
-            continue;
-        }
-        ProcessPacket(reader, &reader->buffer[p]);
-        
-        /* The structure of the transport stream has changed in a major way,
-            (ie new services, services removed) so inform all of the filters
-            that are interested.
-          */
-        if (reader->tsStructureChanged)
-        {
-            InformTSStructureChanged(reader);
-            reader->tsStructureChanged = FALSE;
-        }
+        double cycle = ev_time() - sfList->slotFirstTime;
+        sfList->cycleTime = (sfList->cycleTime == 0.0) ? cycle : ((sfList->cycleTime * 3) + cycle) / 4;
+        sfList->flags |= TSSectFilterListFlags_CYCLE_DONE;
     }
-    pthread_mutex_unlock(&reader->mutex);
 }
 
-static void TSReaderBitrateCallback(struct ev_loop *loop, ev_timer *w, int revents)
+/*
+ * Start timing how long each PID takes to deliver its first section again, 
+ * the cycle times of the old multiplex are no longer relevant either.
+ */
+static void SectionFilterListResetAcquisition(TSReader_t *reader)
 {
-    TSReader_t *reader = (TSReader_t*)w->data;
-    reader->bitrate = (unsigned long)((reader->totalPackets - reader->prevTotalPackets) * (188 * 8));
-    reader->prevTotalPackets = reader->totalPackets;
+    ListIterator_t iterator;
+    ev_tstamp now = ev_time();
+    ListIterator_ForEach(iterator, reader->activeSectionFilters)
+    {
+        TSSectionFilterList_t *sfList = ListIterator_Current(iterator);
+        sfList->acquireStart = now;
+        sfList->firstSectionTime = -1.0;
+        sfList->cycleTime = 0.0;
+        sfList->slotSections = 0;
+        sfList->flags &= ~TSSectFilterListFlags_CYCLE_DONE;
+    }
+    ListIterator_ForEach(iterator, reader->sectionFilters)
+    {
+        TSSectionFilterList_t *sfList = ListIterator_Current(iterator);
+        sfList->acquireStart = now;
+        sfList->firstSectionTime = -1.0;
+        sfList->cycleTime = 0.0;
+    }
 }
 
-static void TSReaderNotificationCallback(struct ev_loop *loop, ev_async *w, int revents)
+static void SectionFilterListFlushAllCaches(TSReader_t *reader)
 {
-    TSReader_t *reader = (TSReader_t*)w->data;
-
-    if (reader->multiplexChanged)
+    ListIterator_t iterator;
+    TSSectionFilterList_t *sfList;
+    ListIterator_ForEach(iterator, reader->activeSectionFilters)
     {
-        LogModule(LOG_INFO, TSREADER, "Informing mux changed!");
-        InformMultiplexChanged(reader);
-        reader->multiplexChanged = FALSE;
+        sfList = ListIterator_Current(iterator);
+        SectionCacheFlush(&sfList->cache);
+    }
+    ListIterator_ForEach(iterator, reader->sectionFilters)
+    {
+        sfList = ListIterator_Current(iterator);
+        SectionCacheFlush(&sfList->cache);
     }
 }
-    
 
-static void ProcessPacket(TSReader_t *reader, TSPacket_t *packet)
+static bool TSReaderBufferAlloc(TSReader_t *reader, unsigned int size)
 {
-    SendToPacketFilters(reader, TSPACKET_GETPID(*packet), packet);
-    SendToPacketFilters(reader, TSREADER_PID_ALL, packet);        
-    reader->totalPackets ++;
-}
+    void *buffer = MAP_FAILED;
+    size_t allocSize;
+    bool hugePages = FALSE;
+    unsigned int slotSize;
+    int i;
 
-static void SendToPacketFilters(TSReader_t *reader, uint16_t pid, TSPacket_t *packet)
-{
-    TSPacketFilter_t *cur, *prev=NULL, *next;
-    if (reader->packetFilters[pid] == NULL)
+    /* Split the buffer in to ring slots (plus a spare) each a whole number of
+     * packets. */
+    slotSize = size / (TSREADER_RING_SLOTS + 1);
+    slotSize -= slotSize % TSPACKET_SIZE;
+    size = slotSize * (TSREADER_RING_SLOTS + 1);
+#ifdef MAP_HUGETLB
+    allocSize = (size + HUGEPAGE_SIZE - 1) & ~(HUGEPAGE_SIZE - 1);
+    buffer = mmap(NULL, allocSize, PROT_READ | PROT_WRITE,
+                  MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (buffer != MAP_FAILED)
     {
-        return;
+        hugePages = TRUE;
+    }
+    else
+    {
+        LogModule(LOG_DEBUG, TSREADER, "Huge pages not available for input buffer (%s)", strerror(errno));
     }
-    reader->currentlyProcessingPid = pid;
-    for (cur = reader->packetFilters[pid]; cur; cur = cur->flNext)
+#endif
+    if (buffer == MAP_FAILED)
     {
-        if (cur->pid & PACKET_FILTER_DISABLED)
-        {
-            continue;
-        }
-        if (cur->group)
+        allocSize = size;
+        buffer = mmap(NULL, allocSize, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (buffer == MAP_FAILED)
         {
-            cur->group->packetsProcessed ++;
+            LogModule(LOG_ERROR, TSREADER, "Failed to allocate %u byte input buffer (%s)", size, strerror(errno));
+            return FALSE;
         }
-        cur->callback(cur->userArg, cur->group, packet);
     }
-    reader->currentlyProcessingPid = TSREADER_PID_INVALID;
-    for (cur = reader->packetFilters[pid]; cur; cur = next)
+
+    TSReaderBufferFree(reader);
+    reader->buffer = buffer;
+    reader->bufferSize = size;
+    reader->bufferAllocSize = allocSize;
+    reader->bufferHugePages = hugePages;
+    reader->ringSlotSize = slotSize;
+    for (i = 0; i < TSREADER_RING_SLOTS; i ++)
     {
-        next = cur->flNext;
-        if (cur->pid & PACKET_FILTER_DISABLED)
-        {
-            LogModule(LOG_DEBUG, TSREADER, "Removing %p (%d) as marked as disabled", cur, cur->pid & 0x7fff);
-            if (prev == NULL)
-            {
-                reader->packetFilters[pid] = cur->flNext;
+        reader->ringSlots[i].packets = (TSPacket_t *)(reader->buffer + (i * slotSize));
+        reader->ringSlots[i].count = 0;
+    }
+    LogModule(LOG_INFO, TSREADER, "Input buffer is %u bytes%s", size, hugePages ? " (huge pages)":"");
+    return TRUE;
+}
+
+static void TSReaderBufferFree(TSReader_t *reader)
+{
+    if (reader->buffer)
+    {
+        munmap(reader->buffer, reader->bufferAllocSize);
+        reader->buffer = NULL;
+        reader->bufferSize = 0;
+        reader->bufferAllocSize = 0;
+        reader->bufferHugePages = FALSE;
+    }
+}
+
+static int TSReaderPropertyBufferSizeGet(void *userArg, PropertyValue_t *value)
+{
+    TSReader_t *reader = userArg;
+    value->u.integer = reader->bufferSize / 1024;
+    return 0;
+}
+
+static int TSReaderPropertyBufferSizeSet(void *userArg, PropertyValue_t *value)
+{
+    TSReader_t *reader = userArg;
+    unsigned int size;
+    int result = 0;
+
+    if ((value->u.integer < (TSREADER_MIN_BUFFER_SIZE / 1024)) ||
+        (value->u.integer > (TSREADER_MAX_BUFFER_SIZE / 1024)))
+    {
+        return -1;
+    }
+    size = value->u.integer * 1024;
+
+    /* The ring slots are in the buffer so stop the reader and let the
+     * processors finish with anything already read before replacing it. */
+    TSReaderThreadStop(reader);
+    ProcessorsDrain(reader);
+    TSReaderLock(reader);
+    TSFramerReset(&reader->framer);
+    if (TSReaderBufferAlloc(reader, size))
+    {
+        DVBDemuxSetBufferSize(reader->adapter, reader->bufferSize);
+    }
+    else
+    {
+        result = -1;
+    }
+    TSReaderUnLock(reader);
+    TSReaderThreadStart(reader);
+    return result;
+}
+
+static void TSReaderThreadStart(TSReader_t *reader)
+{
+    reader->quit = FALSE;
+    if (pthread_create(&reader->readerThread, NULL, TSReaderThread, reader))
+    {
+        LogModule(LOG_ERROR, TSREADER, "Failed to start reader thread (%s)", strerror(errno));
+        return;
+    }
+    reader->readerRunning = TRUE;
+}
+
+static void TSReaderThreadStop(TSReader_t *reader)
+{
+    if (reader->readerRunning)
+    {
+        reader->quit = TRUE;
+        pthread_join(reader->readerThread, NULL);
+        reader->readerRunning = FALSE;
+    }
+}
+
+static void *TSReaderThread(void *arg)
+{
+    TSReader_t *reader = (TSReader_t*)arg;
+    int fd = DVBDVRGetFD(reader->adapter);
+    struct pollfd pfd;
+    bool wait = TRUE;
+
+    LogRegisterThread(pthread_self(), TSREADER);
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+
+    /* This thread only moves packets from the adapter into the ring, all
+     * filtering is done by the reader's event loop thread (and workers) in
+     * TSReaderRingCallback so slow filters don't stall reading.
+     */
+    while (!reader->quit)
+    {
+        int index;
+        uint8_t *data;
+        unsigned int bytes;
+        int count;
+
+        if (wait && (poll(&pfd, 1, READER_POLL_TIMEOUT) <= 0))
+        {
+            continue;
+        }
+
+        index = RingBufferWriteSlot(&reader->ring);
+        if (index == -1)
+        {
+            /* Processing has fallen behind, keep draining the adapter into
+             * the spare slot so the adapter doesn't overflow. */
+            data = reader->buffer + (TSREADER_RING_SLOTS * reader->ringSlotSize);
+            bytes = TSReaderRead(reader, fd, data, 0, &wait);
+            reader->ringDrops += bytes / TSPACKET_SIZE;
+            TSFramerReset(&reader->framer);
+            continue;
+        }
+
+        data = (uint8_t*)reader->ringSlots[index].packets;
+        bytes = TSFramerCarryOver(&reader->framer, data);
+        bytes = TSReaderRead(reader, fd, data, bytes, &wait);
+
+        if (!DVBFrontEndIsLocked(reader->adapter) || !reader->enabled)
+        {
+            TSFramerReset(&reader->framer);
+            continue;
+        }
+
+        count = TSFramerFrame(&reader->framer, data, bytes);
+        if (reader->framer.carryLength)
+        {
+            reader->shortReads ++;
+        }
+        if (count == 0)
+        {
+            continue;
+        }
+        reader->ringSlots[index].count = count;
+        reader->ringSlots[index].received = ev_time();
+        reader->ringSlots[index].pending = 1 + reader->nrofWorkers;
+        RingBufferCommit(&reader->ring);
+        ev_async_send(reader->loop, &reader->ringWatcher);
+        if (reader->nrofWorkers)
+        {
+            pthread_mutex_lock(&reader->processingMutex);
+            pthread_cond_broadcast(&reader->processingCond);
+            pthread_mutex_unlock(&reader->processingMutex);
+        }
+    }
+    LogUnregisterThread(pthread_self());
+    return NULL;
+}
+
+static unsigned int TSReaderRead(TSReader_t *reader, int fd, uint8_t *data, unsigned int bytes, bool *wait)
+{
+    int count;
+
+    /* Drain as much as the adapter has available (up to the size of a slot)
+     * so that packets are processed in large batches rather than one wake up
+     * per handful of packets.
+     */
+    *wait = FALSE;
+    while (bytes < reader->ringSlotSize)
+    {
+        count = read(fd, data + bytes, reader->ringSlotSize - bytes);
+        if (count > 0)
+        {
+            bytes += count;
+        }
+        else if (count == 0)
+        {
+            *wait = TRUE;
+            break;
+        }
+        else if (errno == EOVERFLOW)
+        {
+            reader->bufferOverflows ++;
+            LogModule(LOG_DEBUG, TSREADER, "DVR buffer overflowed (%u times)", reader->bufferOverflows);
+        }
+        else if (errno != EINTR)
+        {
+            *wait = TRUE;
+            break;
+        }
+    }
+    return bytes;
+}
+
+static void TSReaderRingCallback(struct ev_loop *loop, ev_async *w, int revents)
+{
+    TSReader_t *reader = (TSReader_t*)w->data;
+
+    reader->processors[0].thread = pthread_self();
+    ProcessorRun(&reader->processors[0], FALSE);
+}
+
+static void TSReaderLoopStart(TSReader_t *reader)
+{
+    if (reader->loop == DispatchersGetInput())
+    {
+        return;
+    }
+    ev_async_init(&reader->loopExitWatcher, TSReaderLoopExitCallback);
+    ev_async_start(reader->loop, &reader->loopExitWatcher);
+    if (pthread_create(&reader->loopThread, NULL, TSReaderLoopThread, reader))
+    {
+        LogModule(LOG_ERROR, TSREADER, "Failed to start event loop thread (%s)", strerror(errno));
+        ev_async_stop(reader->loop, &reader->loopExitWatcher);
+        return;
+    }
+    reader->loopRunning = TRUE;
+}
+
+static void TSReaderLoopStop(TSReader_t *reader)
+{
+    if (reader->loopRunning)
+    {
+        ev_async_send(reader->loop, &reader->loopExitWatcher);
+        pthread_join(reader->loopThread, NULL);
+        ev_async_stop(reader->loop, &reader->loopExitWatcher);
+        reader->loopRunning = FALSE;
+    }
+}
+
+static void *TSReaderLoopThread(void *arg)
+{
+    TSReader_t *reader = (TSReader_t*)arg;
+
+    LogRegisterThread(pthread_self(), reader->propertyPath);
+    ev_loop(reader->loop, 0);
+    LogUnregisterThread(pthread_self());
+    return NULL;
+}
+
+static void TSReaderLoopExitCallback(struct ev_loop *loop, ev_async *w, int revents)
+{
+    ev_unloop(loop, EVUNLOOP_ALL);
+}
+
+static int TSReaderPropertyThreadsGet(void *userArg, PropertyValue_t *value)
+{
+    TSReader_t *reader = userArg;
+    value->u.integer = reader->nrofWorkers;
+    return 0;
+}
+
+static int TSReaderPropertyThreadsSet(void *userArg, PropertyValue_t *value)
+{
+    TSReader_t *reader = userArg;
+
+    if ((value->u.integer < 0) || (value->u.integer > TSREADER_MAX_WORKERS))
+    {
+        return -1;
+    }
+    if (value->u.integer == reader->nrofWorkers)
+    {
+        return 0;
+    }
+
+    /* Every processor must be at the same point in the ring before the
+     * number of processors sharing each slot can change. */
+    TSReaderThreadStop(reader);
+    ProcessorsDrain(reader);
+    ProcessorsStopWorkers(reader);
+    ProcessorsStartWorkers(reader, value->u.integer);
+    TSReaderLock(reader);
+    ProcessorsAssignGroups(reader);
+    TSReaderUnLock(reader);
+    TSReaderThreadStart(reader);
+    LogModule(LOG_INFO, TSREADER, "Using %d worker threads", reader->nrofWorkers);
+    return 0;
+}
+
+/*******************************************************************************
+* Processor Functions                                                          *
+*******************************************************************************/
+static void ProcessorsInit(TSReader_t *reader)
+{
+    int i;
+
+    pthread_mutex_init(&reader->processingMutex, NULL);
+    pthread_cond_init(&reader->processingCond, NULL);
+    for (i = 0; i <= TSREADER_MAX_WORKERS; i ++)
+    {
+        reader->processors[i].reader = reader;
+        reader->processors[i].index = i;
+        reader->processors[i].currentlyProcessingPid = TSREADER_PID_INVALID;
+    }
+}
+
+static void ProcessorsStartWorkers(TSReader_t *reader, int count)
+{
+    int i;
+
+    for (i = 1; i <= count; i ++)
+    {
+        TSReaderProcessor_t *processor = &reader->processors[i];
+        processor->quit = FALSE;
+        processor->sequence = reader->processors[0].sequence;
+        if (pthread_create(&processor->thread, NULL, ProcessorWorkerThread, processor))
+        {
+            LogModule(LOG_ERROR, TSREADER, "Failed to start worker thread %d (%s)", i, strerror(errno));
+            break;
+        }
+        reader->nrofWorkers = i;
+    }
+}
+
+static void ProcessorsStopWorkers(TSReader_t *reader)
+{
+    int i;
+
+    pthread_mutex_lock(&reader->processingMutex);
+    for (i = 1; i <= reader->nrofWorkers; i ++)
+    {
+        reader->processors[i].quit = TRUE;
+    }
+    pthread_cond_broadcast(&reader->processingCond);
+    pthread_mutex_unlock(&reader->processingMutex);
+
+    for (i = 1; i <= reader->nrofWorkers; i ++)
+    {
+        pthread_join(reader->processors[i].thread, NULL);
+    }
+    reader->nrofWorkers = 0;
+}
+
+static void ProcessorsDrain(TSReader_t *reader)
+{
+    pthread_mutex_lock(&reader->processingMutex);
+    while (RingBufferUsed(&reader->ring) > 0)
+    {
+        pthread_cond_wait(&reader->processingCond, &reader->processingMutex);
+    }
+    pthread_mutex_unlock(&reader->processingMutex);
+}
+
+static void ProcessorsAssignGroups(TSReader_t *reader)
+{
+    ListIterator_t iterator;
+
+    reader->nextWorker = 0;
+    for (ListIterator_Init(iterator, reader->groups); ListIterator_MoreEntries(iterator); ListIterator_Next(iterator))
+    {
+        TSFilterGroup_t *group = (TSFilterGroup_t*)ListIterator_Current(iterator);
+        group->processor = group->sectionFilters ? 0 : ProcessorAssign(reader);
+    }
+}
+
+static int ProcessorAssign(TSReader_t *reader)
+{
+    if (reader->nrofWorkers == 0)
+    {
+        return 0;
+    }
+    return 1 + (reader->nextWorker ++ % reader->nrofWorkers);
+}
+
+static TSReaderProcessor_t *ProcessorCurrent(TSReader_t *reader)
+{
+    pthread_t self = pthread_self();
+    int i;
+
+    for (i = 0; i <= reader->nrofWorkers; i ++)
+    {
+        if (reader->processors[i].active && pthread_equal(reader->processors[i].thread, self))
+        {
+            return &reader->processors[i];
+        }
+    }
+    return NULL;
+}
+
+static void *ProcessorWorkerThread(void *arg)
+{
+    TSReaderProcessor_t *processor = (TSReaderProcessor_t*)arg;
+
+    processor->thread = pthread_self();
+    LogRegisterThread(processor->thread, TSREADERWORKER);
+    ProcessorRun(processor, TRUE);
+    LogUnregisterThread(processor->thread);
+    return NULL;
+}
+
+static void ProcessorRun(TSReaderProcessor_t *processor, bool wait)
+{
+    TSReader_t *reader = processor->reader;
+
+    pthread_mutex_lock(&reader->processingMutex);
+    while (!processor->quit)
+    {
+        TSReaderRingSlot_t *slot;
+        int index = RingBufferPeekSlot(&reader->ring, processor->sequence);
+
+        if ((index == -1) && !wait)
+        {
+            break;
+        }
+        if ((index == -1) || reader->stopProcessing)
+        {
+            pthread_cond_wait(&reader->processingCond, &reader->processingMutex);
+            continue;
+        }
+        processor->active = TRUE;
+        reader->activeProcessors ++;
+        pthread_mutex_unlock(&reader->processingMutex);
+
+        slot = &reader->ringSlots[index];
+        if (processor->index == 0)
+        {
+            unsigned int latency = (unsigned int)((ev_time() - slot->received) * 1000000.0);
+            if (latency > reader->ringLatencyMax)
+            {
+                reader->ringLatencyMax = latency;
+            }
+            reader->ringLatency += ((int)latency - (int)reader->ringLatency) / RING_LATENCY_WEIGHT;
+            if (reader->monitorEnabled)
+            {
+                MonitorCheckReset(reader);
+                reader->monitor.fullTS = reader->promiscuousMode;
+                TSMonitorProcessPackets(&reader->monitor, slot->packets, slot->count, slot->received);
+            }
+        }
+        ProcessorProcessPackets(processor, slot->packets, slot->count);
+
+        pthread_mutex_lock(&reader->processingMutex);
+        processor->active = FALSE;
+        reader->activeProcessors --;
+        processor->sequence ++;
+        slot->pending --;
+        if (slot->pending == 0)
+        {
+            RingBufferRelease(&reader->ring);
+        }
+        pthread_cond_broadcast(&reader->processingCond);
+    }
+    pthread_mutex_unlock(&reader->processingMutex);
+}
+
+static void ProcessorProcessPackets(TSReaderProcessor_t *processor, TSPacket_t *packets, int count)
+{
+    TSReader_t *reader = processor->reader;
+    int p;
+
+    for (p = 0; (p < count) && reader->enabled; p ++)
+    {
+        if (!TSPACKET_ISVALID(packets[p]))
+        {
+            continue;
+        }
+        ProcessPacket(processor, &packets[p]);
+
+        /* The structure of the transport stream has changed in a major way,
+            (ie new services, services removed) so inform all of the filters
+            that are interested.
+          */
+        if (reader->tsStructureChanged && (processor->index == 0))
+        {
+            TSReaderLock(reader);
+            InformTSStructureChanged(reader);
+            reader->tsStructureChanged = FALSE;
+            TSReaderUnLock(reader);
+        }
+    }
+    /* Batched packets point into the ring slot so must be delivered before
+     * the slot is released. */
+    PacketBatchDeliverAll(processor);
+}
+
+static void TSReaderBitrateCallback(struct ev_loop *loop, ev_timer *w, int revents)
+{
+    TSReader_t *reader = (TSReader_t*)w->data;
+    reader->bitrate = (unsigned long)((reader->totalPackets - reader->prevTotalPackets) * (188 * 8));
+    reader->prevTotalPackets = reader->totalPackets;
+    if (reader->pidStatsUsers)
+    {
+        PIDStatsSample(reader);
+    }
+    if (reader->monitorEnabled)
+    {
+        MonitorCheckReset(reader);
+        TSMonitorSample(&reader->monitor, ev_time(), reader->framer.syncLosses, MonitorReport, reader);
+    }
+}
+
+static void TSReaderNotificationCallback(struct ev_loop *loop, ev_async *w, int revents)
+{
+    TSReader_t *reader = (TSReader_t*)w->data;
+
+    if (reader->multiplexChanged)
+    {
+        LogModule(LOG_INFO, TSREADER, "Informing mux changed!");
+        TSReaderLock(reader);
+        SectionFilterListFlushAllCaches(reader);
+        SectionFilterListResetAcquisition(reader);
+        reader->monitorReset = TRUE;
+        TSReaderUnLock(reader);
+        InformMultiplexChanged(reader);
+        /* Tables from the old mux have just been released, let the memory go. */
+        dvbpsi_PoolTrim();
+        reader->multiplexChanged = FALSE;
+    }
+}
+    
+
+static void ProcessPacket(TSReaderProcessor_t *processor, TSPacket_t *packet)
+{
+    SendToPacketFilters(processor, TSPACKET_GETPID(*packet), packet);
+    SendToPacketFilters(processor, TSREADER_PID_ALL, packet);
+    if (processor->index == 0)
+    {
+        processor->reader->totalPackets ++;
+        if (processor->reader->pidStatsUsers)
+        {
+            PIDStatsCount(processor->reader, packet);
+        }
+    }
+}
+
+static void PIDStatsCount(TSReader_t *reader, TSPacket_t *packet)
+{
+    uint16_t pid = TSPACKET_GETPID(*packet);
+    TSPIDCounters_t *counters = &reader->pidCounters[pid];
+
+    counters->packets ++;
+    if (TSPACKET_ISSCRAMBLED(*packet))
+    {
+        counters->scrambled ++;
+    }
+    if (TSPACKET_HASPCR(*packet))
+    {
+        counters->pcrs ++;
+    }
+
+    /* The counter only increments on packets with a payload, a repeat of the
+     * last counter is a duplicate packet rather than an error. */
+    if ((TSPACKET_GETADAPTATION(*packet) & 0x1) && (pid != PID_STUFFING))
+    {
+        int cc = TSPACKET_GETCOUNT(*packet);
+        if ((counters->lastCC != -1) && (cc != counters->lastCC) &&
+            (cc != ((counters->lastCC + 1) & 0x0f)) && !TSPACKET_ISDISCONTINUITY(*packet))
+        {
+            counters->ccErrors ++;
+        }
+        counters->lastCC = cc;
+    }
+}
+
+/*
+ * Called once a second on the input thread, so never at the same time as
+ * PIDStatsCount().
+ */
+static void PIDStatsSample(TSReader_t *reader)
+{
+    static const unsigned int windows[TSREADER_PIDRATE_WINDOWS] = {1, 10, 60};
+    int pid;
+
+    if (reader->pidStatsReset)
+    {
+        reader->pidStatsReset = FALSE;
+        PIDStatsZero(reader);
+    }
+
+    for (pid = 0; pid < TS_MAX_PIDS; pid ++)
+    {
+        TSPIDRates_t *rates = reader->pidRates[pid];
+        unsigned int packets = (unsigned int)reader->pidCounters[pid].packets;
+        unsigned int newest;
+        int w;
+
+        if (rates == NULL)
+        {
+            if (packets == 0)
+            {
+                continue;
+            }
+            rates = malloc(sizeof(TSPIDRates_t));
+            if (rates == NULL)
+            {
+                continue;
+            }
+            PIDRatesReset(rates);
+            /* Make sure the rates are initialised before others can see them. */
+            __sync_synchronize();
+            reader->pidRates[pid] = rates;
+        }
+
+        newest = rates->next;
+        rates->history[newest] = packets;
+        rates->next = (newest + 1) % TSREADER_PIDRATE_HISTORY;
+        if (rates->nrofSamples < TSREADER_PIDRATE_HISTORY)
+        {
+            rates->nrofSamples ++;
+        }
+
+        for (w = 0; w < TSREADER_PIDRATE_WINDOWS; w ++)
+        {
+            unsigned int span = windows[w];
+            if (span > rates->nrofSamples - 1)
+            {
+                span = rates->nrofSamples - 1;
+            }
+            if (span == 0)
+            {
+                rates->rates[w] = 0;
             }
             else
             {
-                prev->flNext = cur->flNext;
+                unsigned int oldest = (newest + TSREADER_PIDRATE_HISTORY - span) % TSREADER_PIDRATE_HISTORY;
+                rates->rates[w] = (packets - rates->history[oldest]) / span;
             }
-            ObjectRefDec(cur);
         }
-        else
+    }
+}
+
+static void PIDStatsZero(TSReader_t *reader)
+{
+    int pid;
+
+    for (pid = 0; pid < TS_MAX_PIDS; pid ++)
+    {
+        TSPIDCounters_t *counters = &reader->pidCounters[pid];
+        counters->packets = 0;
+        counters->ccErrors = 0;
+        counters->scrambled = 0;
+        counters->pcrs = 0;
+        counters->lastCC = -1;
+        if (reader->pidRates[pid])
+        {
+            PIDRatesReset(reader->pidRates[pid]);
+        }
+    }
+}
+
+/* Start the history with a count of 0, so the first sample covers the packets
+ * received before it. */
+static void PIDRatesReset(TSPIDRates_t *rates)
+{
+    memset(rates, 0, sizeof(TSPIDRates_t));
+    rates->nrofSamples = 1;
+    rates->next = 1;
+}
+
+static void MonitorEventsInit(void)
+{
+    int i;
+    if (monitorSource == NULL)
+    {
+        monitorSource = EventsRegisterSource("TSMonitor");
+        for (i = 0; i < TSMonitorIndicator_Count; i ++)
         {
-            prev = cur;
+            monitorEvents[i] = EventsRegisterEvent(monitorSource, (char *)TSMonitorIndicatorName(i), MonitorEventToString);
         }
     }
-    if (reader->packetFilters[pid] == NULL)
+}
+
+/* Only called on the input dispatcher, which is the only thread that updates
+ * the monitor. */
+static void MonitorCheckReset(TSReader_t *reader)
+{
+    if (reader->monitorReset)
     {
-        if (!reader->promiscuousMode && (pid != TSREADER_PID_ALL))
+        reader->monitorReset = FALSE;
+        TSMonitorReset(&reader->monitor);
+    }
+}
+
+static void MonitorReport(void *userArg, TSMonitorIndicator_e indicator, uint16_t pid, unsigned int count)
+{
+    TSReader_t *reader = userArg;
+    TSMonitorEvent_t details;
+
+    details.reader = reader;
+    details.indicator = indicator;
+    details.pid = pid;
+    details.count = count;
+    details.total = reader->monitor.errors[indicator];
+    EventsFireEventListeners(monitorEvents[indicator], &details);
+}
+
+static int MonitorEventToString(yaml_document_t *document, Event_t event, void *payload)
+{
+    TSMonitorEvent_t *details = payload;
+    char str[12];
+    int mappingId = yaml_document_add_mapping(document, (yaml_char_t*)YAML_MAP_TAG, YAML_ANY_MAPPING_STYLE);
+
+    sprintf(str, "%d", DVBAdapterIndexGet(details->reader->adapter));
+    YamlUtils_MappingAdd(document, mappingId, "Adapter", str);
+    YamlUtils_MappingAdd(document, mappingId, "Indicator", TSMonitorIndicatorName(details->indicator));
+    sprintf(str, "0x%04x", details->pid);
+    YamlUtils_MappingAdd(document, mappingId, "PID", str);
+    sprintf(str, "%u", details->count);
+    YamlUtils_MappingAdd(document, mappingId, "Count", str);
+    sprintf(str, "%u", details->total);
+    YamlUtils_MappingAdd(document, mappingId, "Total", str);
+    return mappingId;
+}
+
+static void SendToPacketFilters(TSReaderProcessor_t *processor, uint16_t pid, TSPacket_t *packet)
+{
+    TSReader_t *reader = processor->reader;
+    TSPacketDispatchList_t *list = reader->packetDispatch[pid];
+    TSPacketDispatchEntry_t *entry, *end;
+
+    if (list == NULL)
+    {
+        return;
+    }
+    processor->currentlyProcessingPid = pid;
+    processor->dispatching = list;
+    for (entry = list->entries, end = list->entries + list->count; entry < end; entry ++)
+    {
+        if (entry->callback == NULL)
         {
-            DVBDemuxReleaseFilter(reader->adapter, pid);
+            continue;
         }
-        SectionFilterListScheduleFilters(reader);
+        /* Only run the filters belonging to this processor, section filters
+         * (no group) are always run by the input dispatcher. */
+        if (entry->group)
+        {
+            if (entry->group->processor != processor->index)
+            {
+                continue;
+            }
+            entry->group->packetsProcessed ++;
+        }
+        else if (processor->index != 0)
+        {
+            continue;
+        }
+        entry->callback(entry->userArg, entry->group, packet);
+    }
+    processor->dispatching = NULL;
+    processor->currentlyProcessingPid = TSREADER_PID_INVALID;
+
+    if (reader->retiredDispatch || ((processor->index == 0) && reader->rescheduleSectionFilters))
+    {
+        TSReaderLock(reader);
+        if ((processor->index == 0) && reader->rescheduleSectionFilters)
+        {
+            reader->rescheduleSectionFilters = FALSE;
+            SectionFilterListScheduleFilters(reader);
+        }
+        /* Retired lists are freed on unlock. */
+        TSReaderUnLock(reader);
     }
 }
 
@@ -0,0 +1,196 @@
+/*
+Copyright (C) 2006  Adam Charrett
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+
+tsframer.c
+
+Transport stream packet framing/resynchronisation of a byte stream.
+
+*/
+#include "config.h"
+#include <string.h>
+#include <stdint.h>
+
+#include "tsframer.h"
+#include "logging.h"
+
+/*******************************************************************************
+* Defines                                                                      *
+*******************************************************************************/
+#define TSPACKET_SIZE 188
+
+/*******************************************************************************
+* Prototypes                                                                   *
+*******************************************************************************/
+static unsigned int TSFramerHunt(TSFramer_t *framer, uint8_t *buffer, unsigned int pos, unsigned int length, bool *needMore);
+
+/*******************************************************************************
+* Global variables                                                             *
+*******************************************************************************/
+static char TSFRAMER[] = "TSFramer";
+
+/**
+ * Packet sizes to try when hunting, in order of preference.
+ */
+static const unsigned int packetSizes[] = {188, 192, 204};
+
+/*******************************************************************************
+* Global functions                                                             *
+*******************************************************************************/
+void TSFramerReset(TSFramer_t *framer)
+{
+    framer->locked = FALSE;
+    framer->packetSize = 0;
+    framer->carryLength = 0;
+    framer->skip = 0;
+}
+
+unsigned int TSFramerCarryOver(TSFramer_t *framer, uint8_t *buffer)
+{
+    unsigned int length = framer->carryLength;
+    if (length)
+    {
+        memcpy(buffer, framer->carry, length);
+        framer->carryLength = 0;
+    }
+    return length;
+}
+
+int TSFramerFrame(TSFramer_t *framer, uint8_t *buffer, unsigned int length)
+{
+    unsigned int pos = framer->skip;
+    unsigned int out = 0;
+    bool needMore = FALSE;
+
+    framer->skip = 0;
+    while (pos < length)
+    {
+        if (!framer->locked)
+        {
+            pos = TSFramerHunt(framer, buffer, pos, length, &needMore);
+            if (needMore)
+            {
+                break;
+            }
+            continue;
+        }
+
+        /* Only the 188 bytes of the packet itself are required, the bytes
+         * after it (parity, or the next packet's timestamp) may not have
+         * arrived yet and never will for the last packet of a stream. Any
+         * that are missing are skipped at the start of the next buffer.
+         */
+        if (pos + TSPACKET_SIZE > length)
+        {
+            break;
+        }
+
+        if (buffer[pos] != TSFRAMER_SYNC_BYTE)
+        {
+            framer->locked = FALSE;
+            framer->syncLosses ++;
+            LogModule(LOG_DEBUG, TSFRAMER, "Lost sync at offset %u (packet size %u)", pos, framer->packetSize);
+            framer->packetSize = 0;
+            continue;
+        }
+
+        if (out != pos)
+        {
+            memmove(buffer + out, buffer + pos, TSPACKET_SIZE);
+        }
+        out += TSPACKET_SIZE;
+        pos += framer->packetSize;
+    }
+
+    if (pos > length)
+    {
+        framer->skip = pos - length;
+    }
+    else if (pos < length)
+    {
+        framer->carryLength = length - pos;
+        memcpy(framer->carry, buffer + pos, framer->carryLength);
+    }
+    return out / TSPACKET_SIZE;
+}
+
+unsigned int TSFramerFindSync(const uint8_t *buffer, unsigned int length, unsigned int *packetSize, bool *needMore)
+{
+    unsigned int pos;
+    int s, c;
+
+    *packetSize = 0;
+    for (pos = 0; pos < length; pos ++)
+    {
+        bool candidate = FALSE;
+
+        if (buffer[pos] != TSFRAMER_SYNC_BYTE)
+        {
+            continue;
+        }
+
+        for (s = 0; s < sizeof(packetSizes) / sizeof(packetSizes[0]); s ++)
+        {
+            unsigned int size = packetSizes[s];
+
+            if (pos + ((TSFRAMER_SYNC_CONFIRM - 1) * size) >= length)
+            {
+                /* Not enough data to confirm this size yet. */
+                candidate = TRUE;
+                continue;
+            }
+            for (c = 1; c < TSFRAMER_SYNC_CONFIRM; c ++)
+            {
+                if (buffer[pos + (c * size)] != TSFRAMER_SYNC_BYTE)
+                {
+                    break;
+                }
+            }
+            if (c == TSFRAMER_SYNC_CONFIRM)
+            {
+                *packetSize = size;
+                return pos;
+            }
+        }
+
+        if (candidate)
+        {
+            /* Wait for more data before deciding on this sync byte. */
+            *needMore = TRUE;
+            break;
+        }
+    }
+    return pos;
+}
+
+/*******************************************************************************
+* Local Functions                                                              *
+*******************************************************************************/
+static unsigned int TSFramerHunt(TSFramer_t *framer, uint8_t *buffer, unsigned int pos, unsigned int length, bool *needMore)
+{
+    unsigned int size;
+    unsigned int found = pos + TSFramerFindSync(buffer + pos, length - pos, &size, needMore);
+
+    framer->bytesDiscarded += found - pos;
+    if (size)
+    {
+        framer->locked = TRUE;
+        framer->packetSize = size;
+        LogModule(LOG_DEBUG, TSFRAMER, "Locked on to %u byte packets (%u bytes skipped)", size, found - pos);
+    }
+    return found;
+}
+
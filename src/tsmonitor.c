@@ -0,0 +1,443 @@
+/*
+Copyright (C) 2006  Adam Charrett
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+
+tsmonitor.c
+
+Transport stream health monitoring (ETSI TR 101 290 priority 1 and 2 checks).
+
+*/
+#include "config.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+#include <dvbpsi/dvbpsi.h>
+#include <dvbpsi/psi.h>
+#include <dvbpsi/pat.h>
+
+#include "ts.h"
+#include "pids.h"
+#include "objects.h"
+#include "logging.h"
+#include "tsmonitor.h"
+
+/*******************************************************************************
+* Defines                                                                      *
+*******************************************************************************/
+#define TSMONITOR_PID_PAT  0x01 /* PID carries the PAT. */
+#define TSMONITOR_PID_PMT  0x02 /* PID carries a PMT. */
+#define TSMONITOR_PID_PCR  0x04 /* lastPCR/basePCR are valid. */
+#define TSMONITOR_PID_LATE 0x08 /* PAT/PMT has already been reported as late. */
+
+#define PID_PAT 0x0000
+
+#define TABLE_ID_PAT      0x00
+#define TABLE_ID_PMT      0x02
+#define TABLE_ID_STUFFING 0xff
+
+/* PCRs wrap at 2^33 * 300 */
+#define PCR_WRAP (((uint64_t)1 << 33) * 300)
+#define PCR_TICKS(_seconds) ((uint64_t)((_seconds) * TSPACKET_PCR_HZ))
+
+/* Span of PCRs the rate of the mux is measured over, and when to start again. */
+#define PCR_RATE_MIN_SPAN PCR_TICKS(1)
+#define PCR_RATE_MAX_SPAN PCR_TICKS(60)
+
+/*******************************************************************************
+* Prototypes                                                                   *
+*******************************************************************************/
+static void MonitorPSIPacket(TSMonitor_t *monitor, uint16_t pid, TSMonitorPID_t *state, TSPacket_t *packet);
+static void MonitorTableStarted(TSMonitor_t *monitor, uint16_t pid, TSMonitorPID_t *state, TSMonitorIndicator_e indicator);
+static void MonitorTableLate(TSMonitor_t *monitor, uint16_t pid, TSMonitorIndicator_e indicator, double now);
+static void MonitorPCR(TSMonitor_t *monitor, uint16_t pid, TSMonitorPID_t *state, TSPacket_t *packet);
+static void MonitorPATCallback(void *arg, dvbpsi_pat_t *pat);
+
+/*******************************************************************************
+* Global variables                                                             *
+*******************************************************************************/
+static char TSMONITOR[] = "TSMonitor";
+
+static const char *indicatorNames[TSMonitorIndicator_Count] = {
+    "SyncLoss",
+    "PATError",
+    "ContinuityError",
+    "PMTError",
+    "TransportError",
+    "PCRRepetitionError",
+    "PCRDiscontinuityError",
+    "PCRAccuracyError"
+};
+
+/*******************************************************************************
+* Global functions                                                             *
+*******************************************************************************/
+bool TSMonitorInit(TSMonitor_t *monitor)
+{
+    void *pids;
+
+    memset(monitor, 0, sizeof(TSMonitor_t));
+    if (posix_memalign(&pids, sizeof(TSMonitorPID_t), TS_MAX_PIDS * sizeof(TSMonitorPID_t)))
+    {
+        LogModule(LOG_ERROR, TSMONITOR, "Failed to allocate PID state!");
+        return FALSE;
+    }
+    monitor->pids = pids;
+    TSMonitorReset(monitor);
+    return TRUE;
+}
+
+void TSMonitorDeinit(TSMonitor_t *monitor)
+{
+    if (monitor->patHandle)
+    {
+        dvbpsi_DetachPAT(monitor->patHandle);
+        monitor->patHandle = NULL;
+    }
+    free(monitor->pids);
+    monitor->pids = NULL;
+}
+
+void TSMonitorReset(TSMonitor_t *monitor)
+{
+    int i;
+
+    memset(monitor->pids, 0, TS_MAX_PIDS * sizeof(TSMonitorPID_t));
+    for (i = 0; i < TS_MAX_PIDS; i ++)
+    {
+        monitor->pids[i].lastCC = -1;
+    }
+    monitor->pids[PID_PAT].flags = TSMONITOR_PID_PAT;
+    monitor->packets = 0;
+    monitor->nrofPMTs = 0;
+    for (i = 0; i < TSMonitorIndicator_Count; i ++)
+    {
+        monitor->errors[i] = 0;
+        monitor->reported[i] = 0;
+        monitor->errorPID[i] = TSREADER_PID_ALL;
+    }
+    monitor->pcrJitterMax = 0;
+    monitor->pcrJitter = 0;
+
+    /* Start with a new decoder so the PAT is reported even if its version
+     * hasn't changed. */
+    if (monitor->patHandle)
+    {
+        dvbpsi_DetachPAT(monitor->patHandle);
+    }
+    monitor->patHandle = dvbpsi_AttachPAT(MonitorPATCallback, monitor);
+}
+
+void TSMonitorProcessPackets(TSMonitor_t *monitor, TSPacket_t *packets, int count, double received)
+{
+    int p;
+
+    monitor->now = received;
+    /* Give the PAT until TSMONITOR_PSI_INTERVAL after the first packet. */
+    if (monitor->pids[PID_PAT].lastTable == 0.0)
+    {
+        monitor->pids[PID_PAT].lastTable = received;
+    }
+
+    for (p = 0; p < count; p ++, monitor->packets ++)
+    {
+        TSPacket_t *packet = &packets[p];
+        TSMonitorPID_t *state;
+        uint16_t pid = TSPACKET_GETPID(*packet);
+
+        /* Nothing else in a packet with errors can be trusted. */
+        if (!TSPACKET_ISVALID(*packet))
+        {
+            monitor->errors[TSMonitorIndicator_Transport] ++;
+            monitor->errorPID[TSMonitorIndicator_Transport] = pid;
+            continue;
+        }
+
+        state = &monitor->pids[pid];
+
+        /* The count only increments on packets with a payload, a repeat of the
+         * last count is a duplicate packet rather than an error. */
+        if ((TSPACKET_GETADAPTATION(*packet) & 0x1) && (pid != PID_STUFFING))
+        {
+            int cc = TSPACKET_GETCOUNT(*packet);
+            if ((state->lastCC != -1) && (cc != state->lastCC) &&
+                (cc != ((state->lastCC + 1) & 0x0f)) && !TSPACKET_ISDISCONTINUITY(*packet))
+            {
+                state->ccErrors ++;
+                monitor->errors[TSMonitorIndicator_Continuity] ++;
+            }
+            state->lastCC = cc;
+        }
+
+        if (TSPACKET_HASPCR(*packet))
+        {
+            MonitorPCR(monitor, pid, state, packet);
+        }
+
+        if (state->flags & (TSMONITOR_PID_PAT | TSMONITOR_PID_PMT))
+        {
+            MonitorPSIPacket(monitor, pid, state, packet);
+        }
+    }
+}
+
+void TSMonitorSample(TSMonitor_t *monitor, double now, unsigned int syncLosses, TSMonitorReport_t report, void *userArg)
+{
+    int i;
+
+    if (syncLosses != monitor->syncLosses)
+    {
+        monitor->errors[TSMonitorIndicator_SyncLoss] += syncLosses - monitor->syncLosses;
+        monitor->errorPID[TSMonitorIndicator_SyncLoss] = TSREADER_PID_ALL;
+        monitor->syncLosses = syncLosses;
+    }
+
+    MonitorTableLate(monitor, PID_PAT, TSMonitorIndicator_PAT, now);
+    for (i = 0; i < monitor->nrofPMTs; i ++)
+    {
+        MonitorTableLate(monitor, monitor->pmtPIDs[i], TSMonitorIndicator_PMT, now);
+    }
+
+    monitor->pcrJitter = monitor->pcrJitterMax;
+    monitor->pcrJitterMax = 0;
+
+    for (i = 0; i < TSMonitorIndicator_Count; i ++)
+    {
+        unsigned int count = monitor->errors[i] - monitor->reported[i];
+        if (count == 0)
+        {
+            continue;
+        }
+        monitor->reported[i] = monitor->errors[i];
+
+        if (i == TSMonitorIndicator_Continuity)
+        {
+            int pid;
+            for (pid = 0; pid < TS_MAX_PIDS; pid ++)
+            {
+                TSMonitorPID_t *state = &monitor->pids[pid];
+                if (state->ccErrors != state->ccReported)
+                {
+                    if (report)
+                    {
+                        report(userArg, i, pid, state->ccErrors - state->ccReported);
+                    }
+                    state->ccReported = state->ccErrors;
+                }
+            }
+        }
+        else if (report)
+        {
+            report(userArg, i, monitor->errorPID[i], count);
+        }
+    }
+}
+
+const char *TSMonitorIndicatorName(TSMonitorIndicator_e indicator)
+{
+    if ((indicator < 0) || (indicator >= TSMonitorIndicator_Count))
+    {
+        return "Unknown";
+    }
+    return indicatorNames[indicator];
+}
+
+/*******************************************************************************
+* Local Functions                                                              *
+*******************************************************************************/
+static void MonitorPSIPacket(TSMonitor_t *monitor, uint16_t pid, TSMonitorPID_t *state, TSPacket_t *packet)
+{
+    bool pat = (state->flags & TSMONITOR_PID_PAT) != 0;
+    TSMonitorIndicator_e indicator = pat ? TSMonitorIndicator_PAT : TSMonitorIndicator_PMT;
+    unsigned int offset = 0;
+
+    if (TSPACKET_ISSCRAMBLED(*packet))
+    {
+        monitor->errors[indicator] ++;
+        monitor->errorPID[indicator] = pid;
+        return;
+    }
+
+    if (pat)
+    {
+        dvbpsi_PushPacket(monitor->patHandle, (uint8_t *)packet);
+    }
+
+    if (!TSPACKET_ISPAYLOADUNITSTART(*packet) || !(TSPACKET_GETADAPTATION(*packet) & 0x1))
+    {
+        return;
+    }
+
+    /* Only the first section starting in the packet is checked. */
+    if (TSPACKET_GETADAPTATION(*packet) & 0x2)
+    {
+        offset = 1 + TSPACKET_GETADAPTATION_LEN(*packet);
+    }
+    if (offset < sizeof(packet->payload))
+    {
+        offset += 1 + packet->payload[offset];
+    }
+    if (offset >= sizeof(packet->payload))
+    {
+        return;
+    }
+
+    if (packet->payload[offset] == (pat ? TABLE_ID_PAT : TABLE_ID_PMT))
+    {
+        MonitorTableStarted(monitor, pid, state, indicator);
+    }
+    else if (pat && (packet->payload[offset] != TABLE_ID_STUFFING))
+    {
+        /* Only the PAT may be carried on PID 0. */
+        monitor->errors[indicator] ++;
+        monitor->errorPID[indicator] = pid;
+    }
+}
+
+static void MonitorTableStarted(TSMonitor_t *monitor, uint16_t pid, TSMonitorPID_t *state, TSMonitorIndicator_e indicator)
+{
+    /* A table already reported as late by TSMonitorSample() isn't counted again. */
+    if ((state->lastTable != 0.0) && !(state->flags & TSMONITOR_PID_LATE) &&
+        (monitor->now - state->lastTable > TSMONITOR_PSI_INTERVAL))
+    {
+        monitor->errors[indicator] ++;
+        monitor->errorPID[indicator] = pid;
+    }
+    state->lastTable = monitor->now;
+    state->flags &= ~TSMONITOR_PID_LATE;
+}
+
+static void MonitorTableLate(TSMonitor_t *monitor, uint16_t pid, TSMonitorIndicator_e indicator, double now)
+{
+    TSMonitorPID_t *state = &monitor->pids[pid];
+
+    if ((state->lastTable != 0.0) && !(state->flags & TSMONITOR_PID_LATE) &&
+        (now - state->lastTable > TSMONITOR_PSI_INTERVAL))
+    {
+        monitor->errors[indicator] ++;
+        monitor->errorPID[indicator] = pid;
+        state->flags |= TSMONITOR_PID_LATE;
+    }
+}
+
+static void MonitorPCR(TSMonitor_t *monitor, uint16_t pid, TSMonitorPID_t *state, TSPacket_t *packet)
+{
+    uint64_t pcr = TSPACKET_GETPCR(*packet);
+    uint64_t delta;
+    uint64_t span;
+
+    if (TSPACKET_ISDISCONTINUITY(*packet) || !(state->flags & TSMONITOR_PID_PCR))
+    {
+        state->flags |= TSMONITOR_PID_PCR;
+        state->ticksPerPacket = 0.0;
+        state->basePCR = pcr;
+        state->basePCRPacket = monitor->packets;
+        state->lastPCR = pcr;
+        state->lastPCRPacket = monitor->packets;
+        return;
+    }
+
+    /* Going backwards shows up as a very large jump. */
+    delta = (pcr + PCR_WRAP - state->lastPCR) % PCR_WRAP;
+    if (delta > PCR_TICKS(TSMONITOR_PCR_DISCONTINUITY))
+    {
+        monitor->errors[TSMonitorIndicator_PCRDiscontinuity] ++;
+        monitor->errorPID[TSMonitorIndicator_PCRDiscontinuity] = pid;
+        state->flags &= ~TSMONITOR_PID_PCR;
+        MonitorPCR(monitor, pid, state, packet);
+        return;
+    }
+    if (delta > PCR_TICKS(TSMONITOR_PCR_INTERVAL))
+    {
+        monitor->errors[TSMonitorIndicator_PCRRepetition] ++;
+        monitor->errorPID[TSMonitorIndicator_PCRRepetition] = pid;
+    }
+
+    /*
+     * The accuracy of a PCR is how far it is from the value expected from its
+     * position in the mux and the mux rate, measured over a long span of PCRs.
+     * Without every packet of the mux the position isn't known.
+     */
+    if (monitor->fullTS)
+    {
+        span = (pcr + PCR_WRAP - state->basePCR) % PCR_WRAP;
+        if ((span >= PCR_RATE_MIN_SPAN) && (monitor->packets > state->basePCRPacket))
+        {
+            state->ticksPerPacket = (double)span / (double)(monitor->packets - state->basePCRPacket);
+        }
+        if (state->ticksPerPacket > 0.0)
+        {
+            double expected = (double)(monitor->packets - state->lastPCRPacket) * state->ticksPerPacket;
+            unsigned int deviation = (unsigned int)((fabs((double)delta - expected) * 1000000000.0) / TSPACKET_PCR_HZ);
+            if (deviation > monitor->pcrJitterMax)
+            {
+                monitor->pcrJitterMax = deviation;
+            }
+            if (deviation > TSMONITOR_PCR_ACCURACY)
+            {
+                monitor->errors[TSMonitorIndicator_PCRAccuracy] ++;
+                monitor->errorPID[TSMonitorIndicator_PCRAccuracy] = pid;
+            }
+        }
+        /* Keep the rate up to date, the last measured rate is used until the
+         * new span is long enough. */
+        if (span >= PCR_RATE_MAX_SPAN)
+        {
+            state->basePCR = pcr;
+            state->basePCRPacket = monitor->packets;
+        }
+    }
+
+    state->lastPCR = pcr;
+    state->lastPCRPacket = monitor->packets;
+}
+
+static void MonitorPATCallback(void *arg, dvbpsi_pat_t *pat)
+{
+    TSMonitor_t *monitor = arg;
+    dvbpsi_pat_program_t *program;
+    int i;
+
+    for (i = 0; i < monitor->nrofPMTs; i ++)
+    {
+        monitor->pids[monitor->pmtPIDs[i]].flags &= ~(TSMONITOR_PID_PMT | TSMONITOR_PID_LATE);
+    }
+    monitor->nrofPMTs = 0;
+
+    for (program = pat->p_first_program; program; program = program->p_next)
+    {
+        uint16_t pid = program->i_pid & PID_MASK;
+        TSMonitorPID_t *state = &monitor->pids[pid];
+
+        /* Program 0 is the NIT, several programs may share a PMT PID. */
+        if ((program->i_number == 0) || (pid == PID_PAT) || (state->flags & TSMONITOR_PID_PMT))
+        {
+            continue;
+        }
+        if (monitor->nrofPMTs == TSMONITOR_MAX_PMTS)
+        {
+            LogModule(LOG_INFO, TSMONITOR, "Too many PMTs, only checking the first %d", TSMONITOR_MAX_PMTS);
+            break;
+        }
+        state->flags |= TSMONITOR_PID_PMT;
+        state->flags &= ~TSMONITOR_PID_LATE;
+        /* The PMT has until TSMONITOR_PSI_INTERVAL after the PAT. */
+        state->lastTable = monitor->now;
+        monitor->pmtPIDs[monitor->nrofPMTs ++] = pid;
+    }
+    ObjectRefDec(pat);
+}
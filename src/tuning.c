@@ -34,13 +34,14 @@ Control tuning of the dvb adapter.
 /*******************************************************************************
 * Prototypes                                                                   *
 *******************************************************************************/
-static void TuneMultiplex(Multiplex_t *multiplex);
+static bool TuneMultiplex(int index, Multiplex_t *multiplex);
 
 /*******************************************************************************
 * Global variables                                                             *
 *******************************************************************************/
-static Multiplex_t *CurrentMultiplex = NULL;
 static Service_t *CurrentService = NULL;
+/* Index 0 is the multiplex the primary adapter is tuned to. */
+static Multiplex_t *AdapterMultiplexes[DVB_MAX_ADAPTERS];
 
 static EventSource_t tuningSource;
 static Event_t serviceChangedEvent;
@@ -65,7 +66,12 @@ int TuningInit(void)
 
 int TuningDeInit(void)
 {
-    MultiplexRefDec(CurrentMultiplex);
+    int i;
+    for (i = 0; i < DVB_MAX_ADAPTERS; i ++)
+    {
+        MultiplexRefDec(AdapterMultiplexes[i]);
+        AdapterMultiplexes[i] = NULL;
+    }
     ServiceRefDec(CurrentService);
     EventsUnregisterSource(tuningSource);
     return 0;
@@ -132,7 +138,7 @@ bool TuningCurrentServiceSet(Service_t *service)
         TSReaderEnable(reader, FALSE);
 
         multiplex = MultiplexFindUID(service->multiplexUID);
-        if ((CurrentMultiplex!= NULL) && MultiplexAreEqual(multiplex, CurrentMultiplex))
+        if ((AdapterMultiplexes[0]!= NULL) && MultiplexAreEqual(multiplex, AdapterMultiplexes[0]))
         {
             LogModule(LOG_DEBUGV, TUNING, "Same multiplex\n");
             /* TODO Reset primary service filter stats */
@@ -142,7 +148,7 @@ bool TuningCurrentServiceSet(Service_t *service)
             LogModule(LOG_DEBUG, TUNING, "New Multiplex UID = %d (%04x.%04x)\n", multiplex->uid,
                 multiplex->networkId & 0xffff, multiplex->tsId & 0xffff);
 
-            TuneMultiplex(multiplex);
+            TuneMultiplex(0, multiplex);
             /* Reset all stats as this is a new TS */
             TSReaderZeroStats(reader);
         }
@@ -154,7 +160,7 @@ bool TuningCurrentServiceSet(Service_t *service)
             ServiceRefDec(CurrentService);
         }
 
-        CurrentService = CacheServiceFindId(service->id);
+        CurrentService = CacheServiceFindId(CacheGet(0), service->id);
         ServiceFilterServiceSet(primaryServiceFilter, CurrentService);
 
 
@@ -181,11 +187,11 @@ void TuningCurrentServiceRetune(void)
     TSReaderEnable(reader, FALSE);
 
     multiplex = MultiplexFindUID(CurrentService->multiplexUID);
-    if ((CurrentMultiplex!= NULL) && MultiplexAreEqual(multiplex, CurrentMultiplex))
+    if ((AdapterMultiplexes[0]!= NULL) && MultiplexAreEqual(multiplex, AdapterMultiplexes[0]))
     {
         LogModule(LOG_DEBUGV, TUNING, "Same multiplex\n");
         ObjectRefDec(multiplex);
-        multiplex = CurrentMultiplex;
+        multiplex = AdapterMultiplexes[0];
         ObjectRefInc(multiplex);
     }
     else
@@ -194,7 +200,7 @@ void TuningCurrentServiceRetune(void)
             multiplex->networkId & 0xffff, multiplex->tsId & 0xffff);
     }
 
-    TuneMultiplex(multiplex);
+    TuneMultiplex(0, multiplex);
     /* Reset all stats as this is a new TS */
     TSReaderZeroStats(reader);
 
@@ -207,8 +213,8 @@ void TuningCurrentServiceRetune(void)
 
 Multiplex_t *TuningCurrentMultiplexGet(void)
 {
-    MultiplexRefInc(CurrentMultiplex);
-    return CurrentMultiplex;
+    MultiplexRefInc(AdapterMultiplexes[0]);
+    return AdapterMultiplexes[0];
 }
 
 void TuningCurrentMultiplexSet(Multiplex_t *multiplex)
@@ -217,13 +223,13 @@ void TuningCurrentMultiplexSet(Multiplex_t *multiplex)
 
     TSReaderLock(reader);
     LogModule(LOG_DEBUG, TUNING, "Writing changes back to database.\n");
-    CacheWriteback();
+    CacheWriteback(CacheGet(0));
     TSReaderUnLock(reader);
 
     LogModule(LOG_DEBUGV, TUNING, "Disabling filters\n");
     TSReaderEnable(reader, FALSE);
 
-    TuneMultiplex(multiplex);
+    TuneMultiplex(0, multiplex);
 
     TSReaderZeroStats(reader);
 
@@ -237,31 +243,77 @@ void TuningCurrentMultiplexSet(Multiplex_t *multiplex)
     TSReaderEnable(reader, TRUE);
 }
 
+bool TuningAdapterMultiplexSet(int index, Multiplex_t *multiplex)
+{
+    DVBAdapter_t *adapter = MainDVBAdapterGetByIndex(index);
+    TSReader_t *reader = MainTSReaderGetByIndex(index);
+    bool result;
+
+    if ((index == 0) || !adapter || !reader || !multiplex)
+    {
+        return FALSE;
+    }
+
+    TSReaderLock(reader);
+    LogModule(LOG_DEBUG, TUNING, "Writing changes on adapter %d back to database.\n", index);
+    CacheWriteback(CacheGet(index));
+    TSReaderUnLock(reader);
+
+    LogModule(LOG_DEBUGV, TUNING, "Disabling filters on adapter %d\n", index);
+    TSReaderEnable(reader, FALSE);
+
+    result = TuneMultiplex(index, multiplex);
+    TSReaderZeroStats(reader);
+
+    LogModule(LOG_DEBUGV, TUNING, "Enabling filters on adapter %d\n", index);
+    TSReaderEnable(reader, TRUE);
+    return result;
+}
+
+Multiplex_t *TuningAdapterMultiplexGet(int index)
+{
+    Multiplex_t *multiplex;
+    if ((index < 0) || (index >= DVB_MAX_ADAPTERS))
+    {
+        return NULL;
+    }
+    multiplex = AdapterMultiplexes[index];
+    MultiplexRefInc(multiplex);
+    return multiplex;
+}
+
 /*******************************************************************************
 * Local Functions                                                              *
 *******************************************************************************/
-static void TuneMultiplex(Multiplex_t *multiplex)
+static bool TuneMultiplex(int index, Multiplex_t *multiplex)
 {
-    DVBAdapter_t *dvbAdapter = MainDVBAdapterGet();
-    TSReader_t *reader = MainTSReaderGet();
+    DVBAdapter_t *dvbAdapter = MainDVBAdapterGetByIndex(index);
+    TSReader_t *reader = MainTSReaderGetByIndex(index);
+    bool result = TRUE;
 
-    MultiplexRefDec(CurrentMultiplex);
+    MultiplexRefDec(AdapterMultiplexes[index]);
 
-    LogModule(LOG_DEBUGV, TUNING, "Caching Services\n");
-    CacheLoad(multiplex);
+    LogModule(LOG_DEBUGV, TUNING, "Caching Services for adapter %d\n", index);
+    CacheLoad(CacheGet(index), multiplex);
 
     MultiplexRefInc(multiplex);
-    CurrentMultiplex = multiplex;
+    AdapterMultiplexes[index] = multiplex;
 
-    LogModule(LOG_DEBUGV, TUNING, "Tuning\n");
+    LogModule(LOG_DEBUGV, TUNING, "Tuning adapter %d\n", index);
     if (DVBFrontEndTune(dvbAdapter, multiplex->deliverySystem, multiplex->tuningParams))
     {
-        LogModule(LOG_ERROR, TUNING, "Tuning failed!\n");
+        LogModule(LOG_ERROR, TUNING, "Tuning adapter %d failed!\n", index);
+        result = FALSE;
     }
 
     LogModule(LOG_DEBUGV,TUNING, "Informing TSReader multiplex has changed!\n");
-    TSReaderMultiplexChanged(reader, CurrentMultiplex);
+    TSReaderMultiplexChanged(reader, multiplex);
 
-    EventsFireEventListeners(mulitplexChangedEvent, multiplex);
+    /* Only the primary adapter changing multiplex is announced. */
+    if (index == 0)
+    {
+        EventsFireEventListeners(mulitplexChangedEvent, multiplex);
+    }
+    return result;
 }
 